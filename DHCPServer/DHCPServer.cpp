@@ -97,6 +97,8 @@ namespace Plugin {
             index++;
         }
 
+        // The journals take a final snapshot of the leases, so they go before the servers.
+        _journals.clear();
         _servers.clear();
     }
 
@@ -186,53 +188,36 @@ namespace Plugin {
         return result;
     }
 
-    void DHCPServer::SaveLeases(const string& interface, const DHCPServerImplementation& dhcpServer) const
+    void DHCPServer::LoadLeases(const string& interface, DHCPServerImplementation& dhcpServer) 
     {
 
         if (_persistentPath.empty() == false) {
-            Core::JSON::ArrayType<Data::Server::Lease> leasesList;
-
-            // Saving to file might take a while, and lifetime of DHCPServerImplementation::Iterator
-            // object must be deterministic and short (<10ms), so we scope it 
-            {
-                DHCPServerImplementation::Iterator leases = dhcpServer.Leases();
-                while(leases.Next() && (leases.IsValid() == true)) {
-                    leasesList.Add().Set(leases.Current());
-                }        
-            }
+            auto journal = _journals.emplace(std::piecewise_construct,
+                std::forward_as_tuple(interface),
+                std::forward_as_tuple(_persistentPath + interface, dhcpServer));
 
-            Core::File leasesFile(_persistentPath + interface + ".json");
+            if (journal.first->second.Load() == false) {
+                // No binary lease storage yet, pick up the leases from the JSON file of older versions.
+                Core::File leasesFile(_persistentPath + interface + ".json");
 
-            if (leasesFile.Create() == true) {
-                leasesList.IElement::ToFile(leasesFile);
-                leasesFile.Close();
-            } else {
-                TRACE_L1("Could not save leases in pemranent storage area.\n");
-            }
-        }
-    }
+                if (leasesFile.Open(true) == true) {
+                    Core::JSON::ArrayType<Data::Server::Lease> leases;
 
-    void DHCPServer::LoadLeases(const string& interface, DHCPServerImplementation& dhcpServer) 
-    {
-
-        if (_persistentPath.empty() == false) {
-            Core::File leasesFile(_persistentPath + interface + ".json");
-
-            if (leasesFile.Open(true) == true) {
-                Core::JSON::ArrayType<Data::Server::Lease> leases;
+                    Core::OptionalType<Core::JSON::Error> error;
+                    leases.IElement::FromFile(leasesFile, error);
+                    if (error.IsSet() == true) {
+                        SYSLOG(Logging::ParsingError, (_T("Parsing failed with %s"), ErrorDisplayMessage(error.Value()).c_str()));
+                    }
+                    leasesFile.Close();
 
-                Core::OptionalType<Core::JSON::Error> error;
-                leases.IElement::FromFile(leasesFile, error);
-                if (error.IsSet() == true) {
-                    SYSLOG(Logging::ParsingError, (_T("Parsing failed with %s"), ErrorDisplayMessage(error.Value()).c_str()));
-                }
-                leasesFile.Close();
+                    auto iterator = leases.Elements();
+                    while ((iterator.Next() == true) && (iterator.IsValid() == true)) {
+                        dhcpServer.AddLease(iterator.Current().Get());
+                    }
 
-                auto iterator = leases.Elements();
-                while ((iterator.Next() == true) && (iterator.IsValid() == true)) {
-                    dhcpServer.AddLease(iterator.Current().Get());
+                    journal.first->second.Compact();
                 }
-            } 
+            }
         }
     }
 
@@ -240,9 +225,10 @@ namespace Plugin {
     {
         TRACE(Trace::Information, ("DHCP server granted address %s on interface %s", lease->Address().HostAddress().c_str(), interface.c_str()));
 
-        auto dhcpServer = _servers.find(interface);
-        if (dhcpServer != _servers.end()) {
-            SaveLeases(interface, dhcpServer->second);
+        // Only the changed lease is appended, the journal is compacted in the background.
+        auto journal = _journals.find(interface);
+        if (journal != _journals.end()) {
+            journal->second.Append(*lease);
         }
     }
 
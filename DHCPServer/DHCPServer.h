@@ -20,6 +20,7 @@
 #pragma once
 
 #include "DHCPServerImplementation.h"
+#include "LeaseJournal.h"
 #include <interfaces/json/JsonData_DHCPServer.h>
 #include "Module.h"
 
@@ -280,7 +281,6 @@ namespace Plugin {
 
         // Lease permanent storage
         // -------------------------------------------------------------------------------------------------------
-        void SaveLeases(const string& interface, const DHCPServerImplementation& dhcpServer) const;
         void LoadLeases(const string& interface, DHCPServerImplementation& dhcpServer);
 
         // Callbacks
@@ -288,6 +288,7 @@ namespace Plugin {
     private:
         uint16_t _skipURL;
         std::map<const string, DHCPServerImplementation> _servers;
+        std::map<const string, LeaseJournal> _journals;
         std::string _persistentPath;
     };
 
@@ -56,6 +56,10 @@ namespace Plugin {
                 _maxAddress = ((address & (~mask)) + ((_poolStart + _poolSize) & mask));
                 _nextFreeIp = _minAddress;
 
+                _leases.Lock();
+                _leases.Pool(_minAddress, _maxAddress);
+                _leases.Unlock();
+
                 if (_router != static_cast<uint32_t>(~0)) {
                     if (_router == 0) {
                         _router = address;
@@ -22,6 +22,9 @@
 
 #include "Module.h"
 
+#include <queue>
+#include <unordered_map>
+
 namespace WPEFramework {
 
 namespace Plugin {
@@ -440,14 +443,29 @@ namespace Plugin {
             uint32_t _preferred;
             classifications _classification;
         };
+        // The leases are kept in a list, so references to a lease remain valid, and are indexed by
+        // client identifier and by address. Within the pool, the occupied addresses are tracked in a
+        // bitmap and the expiration times in a min-heap, so allocating an address does not require
+        // walking all leases for every candidate address.
         class LeaseList : public std::list<Lease> {
         private:
             LeaseList(const LeaseList&) = delete;
             LeaseList& operator=(const LeaseList&) = delete;
 
+            using Expiry = std::pair<uint64_t, uint32_t>;
+            using ExpiryHeap = std::priority_queue<Expiry, std::vector<Expiry>, std::greater<Expiry>>;
+
+            static constexpr uint8_t BitsPerSlot = 32;
+
         public:
             LeaseList()
                 : std::list<Lease>()
+                , _byAddress()
+                , _byId()
+                , _expirations()
+                , _occupied()
+                , _minAddress(0)
+                , _maxAddress(0)
             {
             }
             ~LeaseList()
@@ -472,8 +490,144 @@ namespace Plugin {
                 _adminLock.Unlock();
             }
 
+            // NOTE:
+            // All methods below need to be executed within the lock.
+            void Pool(const uint32_t minAddress, const uint32_t maxAddress)
+            {
+                ASSERT(minAddress <= maxAddress);
+
+                _minAddress = minAddress;
+                _maxAddress = maxAddress;
+                _occupied.assign(((_maxAddress - _minAddress) / BitsPerSlot) + 1, 0);
+
+                for (const Lease& lease : *this) {
+                    Occupy(lease.Raw());
+                }
+            }
+            inline Lease* Find(const uint32_t address)
+            {
+                std::unordered_map<uint32_t, Lease*>::iterator index(_byAddress.find(address));
+
+                return (index != _byAddress.end() ? index->second : nullptr);
+            }
+            inline Lease* Find(const Identifier& id)
+            {
+                std::unordered_map<string, Lease*>::iterator index(_byId.find(Key(id)));
+
+                return (index != _byId.end() ? index->second : nullptr);
+            }
+            Lease* Create(const Identifier& id, const uint32_t address, const uint64_t expiration = 0)
+            {
+                ASSERT(Find(address) == nullptr);
+
+                push_back(Lease(id, address, expiration));
+
+                Lease* result = &(back());
+
+                _byAddress[address] = result;
+                _byId[Key(id)] = result;
+                _expirations.emplace(expiration, address);
+                Occupy(address);
+
+                return (result);
+            }
+            void Update(Lease& lease, const Identifier& id)
+            {
+                std::unordered_map<string, Lease*>::iterator index(_byId.find(Key(lease.Id())));
+
+                if ((index != _byId.end()) && (index->second == &lease)) {
+                    _byId.erase(index);
+                }
+
+                lease.Update(id);
+                _byId[Key(id)] = &lease;
+            }
+            void Expiration(Lease& lease, const uint64_t time)
+            {
+                lease.Expiration(time);
+                _expirations.emplace(time, lease.Raw());
+
+                // Renewals leave stale entries behind in the heap, do not let it grow unbounded.
+                if (_expirations.size() > (2 * size())) {
+                    ExpiryHeap fresh;
+                    for (const Lease& entry : *this) {
+                        fresh.emplace(entry.Expiration(), entry.Raw());
+                    }
+                    _expirations.swap(fresh);
+                }
+            }
+            // Returns the first address, starting at the given one, that has no lease yet, 0 if none.
+            uint32_t Unoccupied(const uint32_t start) const
+            {
+                uint32_t result = 0;
+
+                if ((_occupied.empty() == false) && (start >= _minAddress) && (start <= _maxAddress)) {
+                    uint32_t offset = (start - _minAddress);
+                    uint32_t slot = offset / BitsPerSlot;
+                    uint32_t bits = ~_occupied[slot] & (static_cast<uint32_t>(~0) << (offset % BitsPerSlot));
+
+                    while ((bits == 0) && (++slot < _occupied.size())) {
+                        bits = ~_occupied[slot];
+                    }
+
+                    if (bits != 0) {
+                        uint8_t bit = 0;
+                        while ((bits & (1u << bit)) == 0) {
+                            bit++;
+                        }
+
+                        offset = (slot * BitsPerSlot) + bit;
+
+                        if (offset <= (_maxAddress - _minAddress)) {
+                            result = _minAddress + offset;
+                        }
+                    }
+                }
+
+                return (result);
+            }
+            // Returns the lease that expired the longest time ago, if any.
+            Lease* Expired()
+            {
+                Lease* result = nullptr;
+                const uint64_t now = Core::Time::Now().Ticks();
+
+                while ((result == nullptr) && (_expirations.empty() == false) && (_expirations.top().first < now)) {
+                    const Expiry& entry(_expirations.top());
+                    Lease* lease = Find(entry.second);
+
+                    if ((lease != nullptr) && (lease->Expiration() == entry.first)) {
+                        // The entry will become stale as soon as the lease gets a new expiration.
+                        result = lease;
+                    } else {
+                        _expirations.pop();
+                    }
+                }
+
+                return (result);
+            }
+
+        private:
+            inline static string Key(const Identifier& id)
+            {
+                return (string(reinterpret_cast<const char*>(id.Id()), id.Length()));
+            }
+            inline void Occupy(const uint32_t address)
+            {
+                if ((_occupied.empty() == false) && (address >= _minAddress) && (address <= _maxAddress)) {
+                    const uint32_t offset = (address - _minAddress);
+                    _occupied[offset / BitsPerSlot] |= (1u << (offset % BitsPerSlot));
+                }
+            }
+
         private:
             mutable Core::CriticalSection _adminLock;
+            std::unordered_map<uint32_t, Lease*> _byAddress;
+            std::unordered_map<string, Lease*> _byId;
+            ExpiryHeap _expirations;
+            std::vector<uint32_t> _occupied;
+            uint32_t _minAddress;
+            uint32_t _maxAddress;
         };
 
         class Response {
@@ -557,7 +711,7 @@ namespace Plugin {
                     DNS(dns);
                 }
             }
-            inline Core::NodeId Reply() const
+            inline Core::NodeId Reply(const uint16_t port) const
             {
                 uint32_t result = _replyAddress;
 
@@ -586,7 +740,7 @@ namespace Plugin {
                 sockaddr_in saClientAddress;
                 saClientAddress.sin_family = AF_INET;
                 saClientAddress.sin_addr.s_addr = result;
-                saClientAddress.sin_port = htons(DefaultDHCPClientPort);
+                saClientAddress.sin_port = htons(port);
 
                 return (Core::NodeId(saClientAddress));
             }
@@ -670,8 +824,9 @@ namespace Plugin {
         typedef std::function<void(const string&, Lease*)> IPRequestCallback; 
 
     public:
-        DHCPServerImplementation(const string& serverName, const string& interfaceName, const uint32_t poolStart, const uint32_t poolSize, const uint32_t router, const Core::NodeId& DNS, const IPRequestCallback& ipRequestCallback)
-            : Core::SocketDatagram(false, Core::NodeId("255.255.255.255", DefaultDHCPServerPort), Core::NodeId("255.255.255.255", DefaultDHCPClientPort), 1024, 16384)
+        // The ports are only of interest to a test, that can not bind the privileged ones.
+        DHCPServerImplementation(const string& serverName, const string& interfaceName, const uint32_t poolStart, const uint32_t poolSize, const uint32_t router, const Core::NodeId& DNS, const IPRequestCallback& ipRequestCallback, const uint16_t serverPort = DefaultDHCPServerPort, const uint16_t clientPort = DefaultDHCPClientPort)
+            : Core::SocketDatagram(false, Core::NodeId("255.255.255.255", serverPort), Core::NodeId("255.255.255.255", clientPort), 1024, 16384)
             , _serverName(Core::ToString(serverName))
             , _interfaceName(interfaceName)
             , _poolStart(poolStart)
@@ -685,6 +840,7 @@ namespace Plugin {
             , _leases()
             , _responses()
             , _ipRequestCallback(ipRequestCallback)
+            , _clientPort(clientPort)
         {
             static_assert(sizeof(uint32_t) == 4, "Incorrect architecture chosen. uint32_t must by 4 bytes");
 
@@ -727,7 +883,9 @@ namespace Plugin {
         inline void AddLease(const Lease& lease)
         {
             _leases.Lock();
-            _leases.push_back(lease);
+            if (_leases.Find(lease.Raw()) == nullptr) {
+                _leases.Create(lease.Id(), lease.Raw(), lease.Expiration());
+            }
             _leases.Unlock();
         }
 
@@ -744,47 +902,22 @@ namespace Plugin {
         uint32_t Close();
 
     private:
-        // NOTE:
-        // The next three methods, Find,Find and Create need to be executed within the lock.
-        inline Lease* Find(const uint32_t address)
-        {
-            LeaseList::iterator index(_leases.begin());
-            while ((index != _leases.end()) && (index->Raw() != address)) {
-                index++;
-            }
-
-            return (index != _leases.end() ? &(*index) : nullptr);
-        }
-        inline Lease* Find(const Identifier& id)
-        {
-            LeaseList::iterator index(_leases.begin());
-            while ((index != _leases.end()) && (index->Id() != id)) {
-                index++;
-            }
-
-            return (index != _leases.end() ? &(*index) : nullptr);
-        }
-        inline Lease* Create(const Identifier& id, const uint32_t address)
-        {
-            _leases.push_back(Lease(id, address));
-            return &(_leases.back());
-        }
         void Discover(Response& response, const ScratchPad& scratchPad)
         {
             _leases.Lock();
-            Lease* result = Find(scratchPad.Id());
+            Lease* result = _leases.Find(scratchPad.Id());
 
             // RFC 2131 section 4.3.1
             if ((result == nullptr) && (scratchPad.RequestedIP() != 0)) {
                 // Make sure the preferred IP address is within the pool, otherwise offer a correct one anyway
                 if ((scratchPad.RequestedIP() >= _minAddress) && (scratchPad.RequestedIP() <= _maxAddress)) {
-                    result = Find(scratchPad.RequestedIP());
+                    result = _leases.Find(scratchPad.RequestedIP());
 
                     if (result == nullptr) {
                         // Ip address has not been taken yet, time to "assign" it to this client.
-                        result = Create(scratchPad.Id(), scratchPad.RequestedIP());
+                        result = _leases.Create(scratchPad.Id(), scratchPad.RequestedIP());
                     } else if (result->IsExpired() == true) {
-                        result->Update(scratchPad.Id());
+                        _leases.Update(*result, scratchPad.Id());
                     } else {
                         // IP address is taken
                         result = nullptr;
@@ -794,24 +927,17 @@ namespace Plugin {
 
             if (result == nullptr) {
                 // First look in previously unallocated IP slots
-                uint32_t ip;
-                for (ip = _nextFreeIp; ip <= _maxAddress; ip++) {
-                    if (Find(ip) == nullptr) {
-                        result = Create(scratchPad.Id(), ip);
-                        _nextFreeIp = (ip + 1);
-                        break;
-                    }
-                }
+                uint32_t ip = _leases.Unoccupied(_nextFreeIp);
 
-                if (result == nullptr) {
-                    // Still not found a free IP slot, attempt picking up one of the expired ones
-                    for (ip = _minAddress; ip <= _maxAddress ; ip++) {
-                        Lease* lease = Find(ip);
-                        if ((lease != nullptr) && (lease->IsExpired() == true)) {
-                            result = lease;
-                            result->Update(scratchPad.Id());
-                            break;
-                        }
+                if (ip != 0) {
+                    result = _leases.Create(scratchPad.Id(), ip);
+                    _nextFreeIp = (ip + 1);
+                } else {
+                    // Still not found a free IP slot, attempt picking up the one that expired first
+                    result = _leases.Expired();
+
+                    if (result != nullptr) {
+                        _leases.Update(*result, scratchPad.Id());
                     }
                 }
             }
@@ -823,7 +949,7 @@ namespace Plugin {
                     // Temporarily lock out the offered IP address until the client actually requests it
                     Core::Time timeout = Core::Time::Now();
                     timeout.Add(60 /* sec */ * 1000);
-                    result->Expiration(timeout.Ticks());
+                    _leases.Expiration(*result, timeout.Ticks());
                 }
 
                 response.Offer(result->Raw());
@@ -837,7 +963,7 @@ namespace Plugin {
             _leases.Lock();
 
             // RFC 2131 section 4.3.2 Determine requested IP address
-            Lease* result = Find(scratchPad.Id());
+            Lease* result = _leases.Find(scratchPad.Id());
             uint32_t serverId = scratchPad.ServerIdentifier();
             uint32_t requested = scratchPad.RequestedIP();
             
@@ -848,11 +974,11 @@ namespace Plugin {
                 Core::Time leaseExp = Core::Time::Now();
                 leaseExp.Add(DefaultLeaseTime * (60 /* min */ * 60 * 1000));
                 response.LeaseTime(DefaultLeaseTime);
-                result->Expiration(leaseExp.Ticks());
+                _leases.Expiration(*result, leaseExp.Ticks());
                 _ipRequestCallback(_interfaceName, result);
             } else {
                 if (result != nullptr) {
-                    result->Expiration(0); // Invalidate
+                    _leases.Expiration(*result, 0); // Invalidate
                 }
             }
 
@@ -884,7 +1010,7 @@ namespace Plugin {
                 if (entry->IsValid() == false) {
                     TRACE_L1("Dropped a response frame as it is invalid. [%d]", __LINE__);
                 } else {
-                    SocketDatagram::RemoteNode(entry->Reply());
+                    SocketDatagram::RemoteNode(entry->Reply(_clientPort));
                     TRACE_L1("Sending %d to %s:%d", entry->Option(), RemoteNode().HostAddress().c_str(), RemoteNode().PortNumber());
                     result = entry->SendData(dataFrame, length);
                 }
@@ -963,6 +1089,7 @@ namespace Plugin {
         LeaseList _leases;
         std::list<Core::ProxyType<Response>> _responses;
         const IPRequestCallback _ipRequestCallback;
+        const uint16_t _clientPort;
 
 
         static Core::ProxyPoolType<Response> _responseFactory;
@@ -0,0 +1,308 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "DHCPServerImplementation.h"
+#include "Module.h"
+
+#include "../helpers/JournalFile.h"
+
+#include <atomic>
+#include <unordered_map>
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // Persistent lease storage for a single DHCP server. Every granted lease is appended as a
+    // small, checksummed, binary record to a journal. Once the journal grows too large compared
+    // to the number of leases, it is compacted, on a worker pool thread, into a binary snapshot.
+    // At startup the snapshot is loaded and the journal is replayed on top of it, in one pass.
+    //
+    // Record layout (native byte order, the files never leave the device):
+    //   uint32_t address | uint64_t expiration | uint8_t length | length bytes id | uint32_t checksum
+    class LeaseJournal {
+    private:
+        static constexpr uint32_t SnapshotMagic = 0x534C4844; // "DHLS"
+        static constexpr uint8_t SnapshotVersion = 1;
+        static constexpr uint16_t MinimumCompaction = 64;
+        static constexpr uint16_t HeaderSize = sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint8_t);
+        static constexpr uint16_t MaxRecordSize = HeaderSize + 255 + sizeof(uint32_t);
+
+        class Compactor : public Core::IDispatch {
+        public:
+            Compactor() = delete;
+            Compactor(const Compactor&) = delete;
+            Compactor& operator=(const Compactor&) = delete;
+
+            Compactor(LeaseJournal* parent)
+                : _parent(*parent)
+                , _scheduled(false)
+            {
+            }
+            ~Compactor() override = default;
+
+        public:
+            void Schedule()
+            {
+                if (_scheduled.exchange(true) == false) {
+                    Core::IWorkerPool::Instance().Submit(Core::ProxyType<Core::IDispatch>(*this));
+                }
+            }
+            void Revoke()
+            {
+                Core::IWorkerPool::Instance().Revoke(Core::ProxyType<Core::IDispatch>(*this));
+                _scheduled = false;
+            }
+
+        private:
+            void Dispatch() override
+            {
+                _scheduled = false;
+                _parent.Compact();
+            }
+
+        private:
+            LeaseJournal& _parent;
+            std::atomic<bool> _scheduled;
+        };
+
+        struct Entry {
+            DHCPServerImplementation::Identifier Id;
+            uint64_t Expiration;
+        };
+
+    public:
+        LeaseJournal() = delete;
+        LeaseJournal(const LeaseJournal&) = delete;
+        LeaseJournal& operator=(const LeaseJournal&) = delete;
+
+        LeaseJournal(const string& baseName, DHCPServerImplementation& server)
+            : _adminLock()
+            , _compactLock()
+            , _snapshotName(baseName + _T(".leases"))
+            , _journalName(baseName + _T(".journal"))
+            , _journal(_journalName)
+            , _server(server)
+            , _records(0)
+            , _leases(0)
+            , _compactor(Core::ProxyType<Compactor>::Create(this))
+        {
+        }
+        ~LeaseJournal()
+        {
+            _compactor->Revoke();
+
+            if (_records > 0) {
+                Compact();
+            }
+            _journal.Close();
+        }
+
+    public:
+        // Returns false if there was no binary lease information stored at all.
+        bool Load()
+        {
+            std::unordered_map<uint32_t, Entry> leases;
+
+            _adminLock.Lock();
+
+            _records = 0;
+
+            // A rotated journal is left behind if we went down during a compaction.
+            const bool snapshot = Read(_snapshotName, true, leases);
+            const bool rotated = Read(_journalName + _T(".old"), false, leases);
+            const bool journal = Read(_journalName, false, leases) || rotated;
+
+            for (const std::pair<const uint32_t, Entry>& lease : leases) {
+                _server.AddLease(DHCPServerImplementation::Lease(lease.second.Id, lease.first, lease.second.Expiration));
+            }
+
+            _leases = static_cast<uint32_t>(leases.size());
+
+            _adminLock.Unlock();
+
+            if (journal == true) {
+                // Fold the journal into the snapshot, this also gets rid of a torn record at its end,
+                // which would otherwise hide everything appended after it.
+                Compact();
+            }
+
+            if (_journal.IsOpen() == false) {
+                if ((_journal.Exists() == true ? _journal.Open(false) : _journal.Create()) == true) {
+                    _journal.Position(false, _journal.Size());
+                } else {
+                    TRACE_L1("Could not open the DHCP lease journal %s.", _journalName.c_str());
+                }
+            }
+
+            return (snapshot || journal);
+        }
+        void Append(const DHCPServerImplementation::Lease& lease)
+        {
+            uint8_t record[MaxRecordSize];
+            const uint16_t length = Serialize(lease.Id(), lease.Raw(), lease.Expiration(), record);
+
+            _adminLock.Lock();
+
+            if ((_journal.IsOpen() == true) && (_journal.Write(record, length) == length)) {
+                _records++;
+            } else {
+                TRACE_L1("Could not append lease to the DHCP lease journal.");
+            }
+
+            const bool compact = (_records > std::max(static_cast<uint32_t>(MinimumCompaction), 2 * _leases));
+
+            _adminLock.Unlock();
+
+            if (compact == true) {
+                _compactor->Schedule();
+            }
+        }
+        // Write all current leases into a new snapshot and restart the journal.
+        void Compact()
+        {
+            std::vector<uint8_t> buffer;
+            uint8_t record[MaxRecordSize];
+            const uint32_t magic = SnapshotMagic;
+            const string rotated(_journalName + _T(".old"));
+
+            _compactLock.Lock();
+
+            // Lock order is lease list first, than the journal, as it is on the lease request path. Both are
+            // only held while serializing and rotating the journal, the snapshot is written without them.
+            {
+                DHCPServerImplementation::Iterator index(_server.Leases());
+                uint32_t count = 0;
+
+                _adminLock.Lock();
+
+                buffer.reserve(sizeof(magic) + sizeof(SnapshotVersion) + (_leases * (HeaderSize + DHCPServerImplementation::Identifier::maxLength + sizeof(uint32_t))));
+                buffer.insert(buffer.end(), reinterpret_cast<const uint8_t*>(&magic), reinterpret_cast<const uint8_t*>(&magic) + sizeof(magic));
+                buffer.push_back(static_cast<uint8_t>(SnapshotVersion));
+
+                while (index.Next() == true) {
+                    const DHCPServerImplementation::Lease& lease(index.Current());
+                    const uint16_t length = Serialize(lease.Id(), lease.Raw(), lease.Expiration(), record);
+                    buffer.insert(buffer.end(), record, record + length);
+                    count++;
+                }
+
+                // Everything in the journal is in the buffer now. Keep the journal around until the
+                // snapshot is in place, new leases go to a fresh journal.
+                _journal.Close();
+
+                if (JournalFile::Rotate(_journalName, rotated) == true) {
+                    _records = 0;
+                    if (_journal.Create() == false) {
+                        TRACE_L1("Could not restart the DHCP lease journal %s.", _journalName.c_str());
+                    }
+                } else if (_journal.Open(false) == true) {
+                    // Keep on appending, the next compaction tries again.
+                    _journal.Position(false, _journal.Size());
+                    TRACE_L1("Could not rotate the DHCP lease journal %s.", _journalName.c_str());
+                }
+                _leases = count;
+
+                _adminLock.Unlock();
+            }
+
+            if (JournalFile::Store(_snapshotName, buffer.data(), static_cast<uint32_t>(buffer.size())) == true) {
+                // Whatever the rotated journal held, is in the snapshot now.
+                Core::File(rotated).Destroy();
+            } else {
+                TRACE_L1("Could not write the DHCP lease snapshot %s.", _snapshotName.c_str());
+            }
+
+            _compactLock.Unlock();
+        }
+
+    private:
+        static uint16_t Serialize(const DHCPServerImplementation::Identifier& id, const uint32_t address, const uint64_t expiration, uint8_t record[])
+        {
+            uint16_t length = 0;
+
+            ::memcpy(&record[length], &address, sizeof(address));
+            length += sizeof(address);
+            ::memcpy(&record[length], &expiration, sizeof(expiration));
+            length += sizeof(expiration);
+            record[length++] = id.Length();
+            ::memcpy(&record[length], id.Id(), id.Length());
+            length += id.Length();
+
+            return (static_cast<uint16_t>(JournalFile::Seal(record, length)));
+        }
+        // Returns true if the file existed and was recognized.
+        bool Read(const string& fileName, const bool snapshot, std::unordered_map<uint32_t, Entry>& leases)
+        {
+            bool result = false;
+
+            JournalFile::Read(fileName, [&](const uint8_t data[], const uint32_t size) {
+                uint32_t offset = 0;
+
+                if (snapshot == true) {
+                    uint32_t magic = 0;
+                    if (size >= (sizeof(SnapshotMagic) + sizeof(SnapshotVersion))) {
+                        ::memcpy(&magic, data, sizeof(magic));
+                    }
+                    result = ((magic == SnapshotMagic) && (data[sizeof(SnapshotMagic)] == SnapshotVersion));
+                    offset = (result == true ? sizeof(SnapshotMagic) + sizeof(SnapshotVersion) : size);
+                } else {
+                    result = true;
+                }
+
+                // A torn write at the end of the journal is expected after a power cut, stop there.
+                offset += JournalFile::Replay(&data[offset], size - offset, HeaderSize,
+                    [](const uint8_t header[]) -> uint64_t {
+                        return (HeaderSize + header[HeaderSize - 1]);
+                    },
+                    [&](const uint8_t record[], const uint32_t length) -> bool {
+                        uint32_t address;
+                        Entry entry;
+
+                        ::memcpy(&address, record, sizeof(address));
+                        ::memcpy(&entry.Expiration, &record[sizeof(address)], sizeof(entry.Expiration));
+                        entry.Id = DHCPServerImplementation::Identifier(&record[HeaderSize], static_cast<uint8_t>(length - HeaderSize));
+                        leases[address] = entry;
+                        _records += (snapshot == false ? 1 : 0);
+                        return (true);
+                    });
+
+                if (offset < size) {
+                    TRACE_L1("Dropped %d trailing bytes of %s.", size - offset, fileName.c_str());
+                }
+            });
+
+            return (result);
+        }
+
+    private:
+        Core::CriticalSection _adminLock;
+        Core::CriticalSection _compactLock;
+        const string _snapshotName;
+        const string _journalName;
+        Core::File _journal;
+        DHCPServerImplementation& _server;
+        uint32_t _records;
+        uint32_t _leases;
+        Core::ProxyType<Compactor> _compactor;
+    };
+
+} // namespace Plugin
+} // namespace WPEFramework
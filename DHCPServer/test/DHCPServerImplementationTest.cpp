@@ -0,0 +1,269 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../DHCPServerImplementation.h"
+#include "../../helpers/UnitTest.h"
+
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <chrono>
+#include <set>
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+// A load generator that takes a server on the loopback through DISCOVER/OFFER/REQUEST/ACK for thousands
+// of clients, a window of them in flight at once. It poses as a relay agent (giaddr is the loopback),
+// so the replies come back unicast, and it uses ports above the privileged ones.
+
+namespace {
+
+    const uint16_t ServerPort = 16767;
+    const uint16_t ClientPort = 16768;
+    const uint32_t PoolStart = 100;
+    const uint32_t Clients = 4000;
+    const uint32_t Window = 32;
+    const int WaitTime = 2000; // ms
+
+    // RFC 2131 section 2, as offsets in the message, the options follow the magic cookie.
+    const uint16_t OffsetXid = 4;
+    const uint16_t OffsetYiaddr = 16;
+    const uint16_t OffsetGiaddr = 24;
+    const uint16_t OffsetChaddr = 28;
+    const uint16_t OffsetCookie = 236;
+    const uint16_t OffsetOptions = 240;
+
+    const uint8_t MagicCookie[] = { 99, 130, 83, 99 };
+
+    const uint8_t DISCOVER = 1;
+    const uint8_t OFFER = 2;
+    const uint8_t REQUEST = 3;
+    const uint8_t ACK = 5;
+    const uint8_t NAK = 6;
+
+    class Client {
+    public:
+        Client(const Client&) = delete;
+        Client& operator=(const Client&) = delete;
+
+        Client()
+            : _socket(::socket(AF_INET, SOCK_DGRAM, 0))
+        {
+            sockaddr_in address = {};
+            const int enable = 1;
+
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_ANY);
+            address.sin_port = htons(ClientPort);
+
+            ::setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+            ::setsockopt(_socket, SOL_SOCKET, SO_BROADCAST, &enable, sizeof(enable));
+            ::setsockopt(_socket, SOL_SOCKET, SO_BINDTODEVICE, "lo", 3);
+            ::bind(_socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+        }
+        ~Client()
+        {
+            ::close(_socket);
+        }
+
+    public:
+        void Discover(const uint32_t client)
+        {
+            uint8_t options[] = { 53, 1, DISCOVER };
+
+            Send(client, options, sizeof(options));
+        }
+        void Request(const uint32_t client, const uint32_t address, const uint32_t server)
+        {
+            uint8_t options[] = { 53, 1, REQUEST, 50, 4, 0, 0, 0, 0, 54, 4, 0, 0, 0, 0 };
+
+            ::memcpy(&options[5], &address, 4);
+            ::memcpy(&options[11], &server, 4);
+
+            Send(client, options, sizeof(options));
+        }
+        // Returns the message type of the reply, 0 if there was none in time. Addresses in network order.
+        uint8_t Receive(uint32_t& client, uint32_t& address, uint32_t& server)
+        {
+            pollfd descriptor = { _socket, POLLIN, 0 };
+            uint8_t result = 0;
+
+            if (::poll(&descriptor, 1, WaitTime) == 1) {
+                uint8_t message[1024];
+                const ssize_t length = ::recv(_socket, message, sizeof(message), 0);
+
+                if ((length > OffsetOptions) && (::memcmp(&message[OffsetCookie], MagicCookie, sizeof(MagicCookie)) == 0)) {
+                    uint16_t index = OffsetOptions;
+
+                    ::memcpy(&client, &message[OffsetXid], 4);
+                    ::memcpy(&address, &message[OffsetYiaddr], 4);
+
+                    while (((index + 1) < length) && (message[index] != 255)) {
+                        if ((message[index] == 53) && (message[index + 1] == 1)) {
+                            result = message[index + 2];
+                        } else if ((message[index] == 54) && (message[index + 1] == 4)) {
+                            ::memcpy(&server, &message[index + 2], 4);
+                        }
+                        index += (message[index] == 0 ? 1 : message[index + 1] + 2);
+                    }
+                }
+            }
+
+            return (result);
+        }
+
+    private:
+        void Send(const uint32_t client, const uint8_t options[], const uint8_t length)
+        {
+            uint8_t message[OffsetOptions + 64] = {};
+            const uint32_t relay = htonl(INADDR_LOOPBACK);
+            sockaddr_in address = {};
+
+            message[0] = 1; // BOOTREQUEST
+            message[1] = 1; // Ethernet
+            message[2] = 6;
+            ::memcpy(&message[OffsetXid], &client, 4);
+            ::memcpy(&message[OffsetGiaddr], &relay, 4);
+
+            // A MAC address per client.
+            message[OffsetChaddr] = 0x02;
+            message[OffsetChaddr + 2] = static_cast<uint8_t>(client >> 24);
+            message[OffsetChaddr + 3] = static_cast<uint8_t>(client >> 16);
+            message[OffsetChaddr + 4] = static_cast<uint8_t>(client >> 8);
+            message[OffsetChaddr + 5] = static_cast<uint8_t>(client);
+
+            ::memcpy(&message[OffsetCookie], MagicCookie, sizeof(MagicCookie));
+            ::memcpy(&message[OffsetOptions], options, length);
+            message[OffsetOptions + length] = 255;
+
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+            address.sin_port = htons(ServerPort);
+
+            ::sendto(_socket, message, OffsetOptions + length + 1, 0, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+        }
+
+    private:
+        int _socket;
+    };
+
+    std::atomic<uint32_t> Granted(0);
+
+    void TestLoad(DHCPServerImplementation& server)
+    {
+        Client client;
+        std::vector<uint32_t> acknowledged(Clients, 0);
+        uint32_t sent = 0;
+        uint32_t done = 0;
+        uint32_t refused = 0;
+        bool timedOut = false;
+
+        const auto start = std::chrono::steady_clock::now();
+
+        while ((done < Clients) && (timedOut == false)) {
+            while (((sent - done) < Window) && (sent < Clients)) {
+                client.Discover(sent++);
+            }
+
+            uint32_t id = 0;
+            uint32_t address = 0;
+            uint32_t identifier = 0;
+            const uint8_t type = client.Receive(id, address, identifier);
+
+            if (type == 0) {
+                timedOut = true;
+            } else if (id >= Clients) {
+                refused++;
+            } else if (type == OFFER) {
+                client.Request(id, address, identifier);
+            } else if (type == ACK) {
+                acknowledged[id] = ntohl(address);
+                done++;
+            } else if (type == NAK) {
+                refused++;
+                done++;
+            }
+        }
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        printf("%u clients in %.2f s: %.0f leases/s\n", done, seconds, done / seconds);
+
+        CHECK(timedOut == false);
+        CHECK(refused == 0);
+        CHECK(Granted == Clients);
+
+        // Every client got an address of its own, out of the pool.
+        const uint32_t first = ntohl(static_cast<const Core::NodeId::SocketInfo&>(server.BeginPool()).IPV4Socket.sin_addr.s_addr);
+        const uint32_t last = ntohl(static_cast<const Core::NodeId::SocketInfo&>(server.EndPool()).IPV4Socket.sin_addr.s_addr);
+        std::set<uint32_t> unique;
+
+        for (const uint32_t address : acknowledged) {
+            CHECK((address >= first) && (address <= last));
+            unique.insert(address);
+        }
+
+        CHECK(unique.size() == Clients);
+
+        uint32_t leases = 0;
+        DHCPServerImplementation::Iterator index(server.Leases());
+
+        while (index.Next() == true) {
+            leases++;
+        }
+
+        CHECK(leases == Clients);
+
+        // The pool is exhausted and no lease expired, one more client gets no offer.
+        uint32_t id = 0;
+        uint32_t address = 0;
+        uint32_t identifier = 0;
+
+        client.Discover(Clients);
+
+        CHECK(client.Receive(id, address, identifier) == 0);
+    }
+}
+
+int main()
+{
+    {
+        // The pool runs from PoolStart up to and including PoolStart + pool size.
+        DHCPServerImplementation server(_T("LoadTest"), _T("lo"), PoolStart, Clients - 1, ~0, Core::NodeId(),
+            [](const string&, DHCPServerImplementation::Lease*) { Granted++; },
+            ServerPort, ClientPort);
+
+        CHECK(server.Open() == Core::ERROR_NONE);
+
+        if (server.IsActive() == true) {
+            TestLoad(server);
+        }
+
+        server.Close();
+    }
+
+    Core::Singleton::Dispose();
+
+    return (UnitTest::Result());
+}
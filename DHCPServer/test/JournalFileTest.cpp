@@ -0,0 +1,222 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../../helpers/JournalFile.h"
+#include "../../helpers/UnitTest.h"
+
+#include <cstdlib>
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+namespace {
+
+    // Records of the test start with their length, header included, in a single byte, followed by a tag.
+    const uint16_t HeaderSize = 2;
+
+    uint64_t Measure(const uint8_t header[])
+    {
+        return (header[0]);
+    }
+
+    // A sealed record with the tag and the given number of payload bytes.
+    void Append(std::vector<uint8_t>& journal, const uint8_t tag, const uint8_t payload)
+    {
+        const uint32_t length = HeaderSize + payload;
+        const size_t start = journal.size();
+
+        journal.resize(start + length + sizeof(uint32_t));
+        journal[start] = static_cast<uint8_t>(length);
+        journal[start + 1] = tag;
+        for (uint8_t index = 0; index < payload; index++) {
+            journal[start + HeaderSize + index] = static_cast<uint8_t>(tag + index);
+        }
+
+        CHECK(JournalFile::Seal(&journal[start], length) == (length + sizeof(uint32_t)));
+    }
+
+    // The tags of the records replayed, the Apply returns false on the one given.
+    uint32_t Replay(const std::vector<uint8_t>& journal, std::vector<uint8_t>& tags, const uint8_t refuse = 0)
+    {
+        tags.clear();
+
+        return (JournalFile::Replay(journal.data(), static_cast<uint32_t>(journal.size()), HeaderSize, Measure,
+            [&tags, refuse](const uint8_t record[], const uint32_t length) {
+                bool result = false;
+
+                if (record[1] != refuse) {
+                    CHECK(length == record[0]);
+                    tags.push_back(record[1]);
+                    result = true;
+                }
+                return (result);
+            }));
+    }
+
+    std::vector<uint8_t> Contents(const std::string& fileName)
+    {
+        std::vector<uint8_t> result;
+
+        JournalFile::Read(fileName, [&result](const uint8_t data[], const uint32_t size) {
+            result.assign(data, data + size);
+        });
+
+        return (result);
+    }
+
+    void TestReplay()
+    {
+        std::vector<uint8_t> journal;
+        std::vector<uint8_t> tags;
+
+        Append(journal, 1, 3);
+        Append(journal, 2, 0);
+        Append(journal, 3, 10);
+
+        CHECK(Replay(journal, tags) == journal.size());
+        CHECK(tags == std::vector<uint8_t>({ 1, 2, 3 }));
+    }
+
+    void TestTornTail()
+    {
+        std::vector<uint8_t> journal;
+        std::vector<uint8_t> tags;
+
+        Append(journal, 1, 3);
+        Append(journal, 2, 5);
+
+        const size_t complete = journal.size();
+
+        Append(journal, 3, 10);
+
+        // Cut off in the checksum, in the payload and in the header.
+        for (const size_t torn : { journal.size() - 1, complete + HeaderSize + 4, complete + 1 }) {
+            const std::vector<uint8_t> part(journal.begin(), journal.begin() + torn);
+
+            CHECK(Replay(part, tags) == complete);
+            CHECK(tags == std::vector<uint8_t>({ 1, 2 }));
+        }
+    }
+
+    void TestCorrupt()
+    {
+        std::vector<uint8_t> journal;
+        std::vector<uint8_t> tags;
+
+        Append(journal, 1, 3);
+
+        const size_t first = journal.size();
+
+        Append(journal, 2, 5);
+        Append(journal, 3, 1);
+
+        // A flipped bit in the payload of the second, nothing from there on is to be trusted.
+        journal[first + HeaderSize + 2] ^= 0x10;
+
+        CHECK(Replay(journal, tags) == first);
+        CHECK(tags == std::vector<uint8_t>({ 1 }));
+
+        // A length that does not even cover the header.
+        journal[first + HeaderSize + 2] ^= 0x10;
+        journal[first] = 1;
+
+        CHECK(Replay(journal, tags) == first);
+        CHECK(tags == std::vector<uint8_t>({ 1 }));
+    }
+
+    void TestRefused()
+    {
+        std::vector<uint8_t> journal;
+        std::vector<uint8_t> tags;
+
+        Append(journal, 1, 3);
+
+        const size_t first = journal.size();
+
+        Append(journal, 2, 5);
+        Append(journal, 3, 1);
+
+        CHECK(Replay(journal, tags, 2) == first);
+        CHECK(tags == std::vector<uint8_t>({ 1 }));
+    }
+
+    void TestFiles(const std::string& directory)
+    {
+        const std::string snapshot(directory + "/snapshot");
+        const std::string journal(directory + "/journal");
+        const std::string rotated(journal + ".old");
+        std::vector<uint8_t> first;
+        std::vector<uint8_t> second;
+        std::vector<uint8_t> tags;
+
+        Append(first, 1, 3);
+        Append(first, 2, 5);
+        Append(second, 3, 1);
+
+        CHECK(JournalFile::Exists(snapshot) == false);
+        CHECK(JournalFile::Read(snapshot, [](const uint8_t[], const uint32_t) {}) == false);
+
+        // Nothing is left behind next to the snapshot.
+        CHECK(JournalFile::Store(snapshot, first.data(), static_cast<uint32_t>(first.size())) == true);
+        CHECK(Contents(snapshot) == first);
+        CHECK(JournalFile::Exists(snapshot + ".tmp") == false);
+
+        CHECK(JournalFile::Store(snapshot, second.data(), static_cast<uint32_t>(second.size())) == true);
+        CHECK(Contents(snapshot) == second);
+
+        // Without a rotated file, the journal is just renamed.
+        CHECK(JournalFile::Store(journal, first.data(), static_cast<uint32_t>(first.size())) == true);
+        CHECK(JournalFile::Rotate(journal, rotated) == true);
+        CHECK(JournalFile::Exists(journal) == false);
+        CHECK(Contents(rotated) == first);
+
+        // The compaction did not complete, the next journal goes after the records still in there.
+        CHECK(JournalFile::Store(journal, second.data(), static_cast<uint32_t>(second.size())) == true);
+        CHECK(JournalFile::Rotate(journal, rotated) == true);
+        CHECK(JournalFile::Exists(journal) == false);
+
+        const std::vector<uint8_t> records(Contents(rotated));
+
+        CHECK(Replay(records, tags) == records.size());
+        CHECK(tags == std::vector<uint8_t>({ 1, 2, 3 }));
+
+        ::remove(snapshot.c_str());
+        ::remove(rotated.c_str());
+    }
+}
+
+int main()
+{
+    char directory[] = "/tmp/JournalFileTest.XXXXXX";
+
+    TestReplay();
+    TestTornTail();
+    TestCorrupt();
+    TestRefused();
+
+    if (::mkdtemp(directory) == nullptr) {
+        fprintf(stderr, "Could not create a directory to test the files in\n");
+        UnitTest::Failures()++;
+    } else {
+        TestFiles(directory);
+        ::rmdir(directory);
+    }
+
+    return (UnitTest::Result());
+}
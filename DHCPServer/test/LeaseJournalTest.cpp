@@ -0,0 +1,185 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../LeaseJournal.h"
+#include "../../helpers/UnitTest.h"
+
+#include <chrono>
+#include <cstdlib>
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+// Grants per second, with the compactions they cause, and the time a restart takes to load them all
+// back, for a growing number of leases.
+
+namespace {
+
+    const uint32_t Counts[] = { 100, 1000, 10000, 50000 };
+    const uint32_t Renewals = 3; // every lease is granted this many times
+    const uint32_t FirstAddress = 0x0A000000; // 10.0.0.0
+
+    class Dispatcher : public Core::ThreadPool::IDispatcher {
+    public:
+        Dispatcher(const Dispatcher&) = delete;
+        Dispatcher& operator=(const Dispatcher&) = delete;
+
+        Dispatcher() = default;
+        ~Dispatcher() override = default;
+
+    private:
+        void Initialize() override
+        {
+        }
+        void Deinitialize() override
+        {
+        }
+        void Dispatch(Core::IDispatch* job) override
+        {
+            job->Dispatch();
+        }
+    };
+
+    class WorkerPool : public Core::WorkerPool {
+    public:
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        WorkerPool()
+            : Core::WorkerPool(2, Core::Thread::DefaultStackSize(), 16, &_dispatcher)
+            , _dispatcher()
+        {
+            Core::IWorkerPool::Assign(this);
+            Run();
+        }
+        ~WorkerPool()
+        {
+            Stop();
+            Core::IWorkerPool::Assign(nullptr);
+        }
+
+    private:
+        Dispatcher _dispatcher;
+    };
+
+    // The server is never opened, only its lease list is used.
+    class Server : public DHCPServerImplementation {
+    public:
+        Server(const Server&) = delete;
+        Server& operator=(const Server&) = delete;
+
+        Server()
+            : DHCPServerImplementation(_T("Benchmark"), _T("lo"), 0, 0, ~0, Core::NodeId(), [](const string&, Lease*) {})
+        {
+        }
+        ~Server() override = default;
+
+    public:
+        uint32_t Count() const
+        {
+            uint32_t result = 0;
+            Iterator index(Leases());
+
+            while (index.Next() == true) {
+                result++;
+            }
+
+            return (result);
+        }
+    };
+
+    DHCPServerImplementation::Lease Grant(const uint32_t client, const uint64_t expiration)
+    {
+        const uint8_t mac[] = { 0x02, 0x00, static_cast<uint8_t>(client >> 24), static_cast<uint8_t>(client >> 16), static_cast<uint8_t>(client >> 8), static_cast<uint8_t>(client) };
+
+        return (DHCPServerImplementation::Lease(DHCPServerImplementation::Identifier(mac, sizeof(mac)), FirstAddress + client, expiration));
+    }
+
+    void Benchmark(const string& directory, const uint32_t count)
+    {
+        const string baseName(directory + _T("/eth0"));
+        const uint64_t expiration = Core::Time::Now().Add(24 * 60 * 60 * 1000).Ticks();
+        double granting = 0;
+        double loading = 0;
+
+        {
+            Server server;
+            LeaseJournal journal(baseName, server);
+
+            CHECK(journal.Load() == false);
+
+            const auto start = std::chrono::steady_clock::now();
+
+            // As after a power cut: every client comes back, and renews a few times after that.
+            for (uint32_t renewal = 0; renewal < Renewals; renewal++) {
+                for (uint32_t client = 0; client < count; client++) {
+                    const DHCPServerImplementation::Lease lease(Grant(client, expiration + renewal));
+
+                    server.AddLease(lease);
+                    journal.Append(lease);
+                }
+            }
+
+            granting = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        {
+            Server server;
+            LeaseJournal journal(baseName, server);
+
+            const auto start = std::chrono::steady_clock::now();
+
+            CHECK(journal.Load() == true);
+
+            loading = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            CHECK(server.Count() == count);
+        }
+
+        printf("%6u leases: %9.0f grants/s, restart in %7.2f ms\n", count, (count * Renewals) / granting, loading * 1000);
+
+        ::remove((baseName + _T(".leases")).c_str());
+        ::remove((baseName + _T(".journal")).c_str());
+        ::remove((baseName + _T(".journal.old")).c_str());
+    }
+}
+
+int main()
+{
+    char directory[] = "/tmp/LeaseJournalTest.XXXXXX";
+
+    {
+        WorkerPool workerPool;
+
+        if (::mkdtemp(directory) == nullptr) {
+            fprintf(stderr, "Could not create a directory to test the files in\n");
+            UnitTest::Failures()++;
+        } else {
+            for (const uint32_t count : Counts) {
+                Benchmark(directory, count);
+            }
+
+            ::rmdir(directory);
+        }
+    }
+
+    Core::Singleton::Dispose();
+
+    return (UnitTest::Result());
+}
@@ -46,7 +46,6 @@ namespace Plugin {
         bool correctStructure(true);
         Core::JSON::ArrayType<NameSpace::Entry>::ConstIterator keyIndex(current.Dictionary.Elements());
         Core::JSON::ArrayType<NameSpace>::ConstIterator spaceIndex(current.Spaces.Elements());
-        std::list<RuntimeEntry>* currentList = NULL;
 
         // Fill in the keys from this name space...
         while ((correctStructure == true) && (keyIndex.Next() == true)) {
@@ -55,13 +54,7 @@ namespace Plugin {
             correctStructure = IsValidName(key);
 
             if (correctStructure == true) {
-                if (currentList == NULL) {
-                    currentList = &(_dictionary[currentSpace]);
-
-                    ASSERT(currentList != NULL);
-                }
-
-                currentList->push_back(RuntimeEntry(key, keyIndex.Current().Value.Value(), keyIndex.Current().Type.Value()));
+                Store(currentSpace, key, keyIndex.Current().Value.Value(), keyIndex.Current().Type.Value());
             }
         }
 
@@ -74,52 +67,11 @@ namespace Plugin {
         return (correctStructure);
     }
 
-    void Dictionary::CreateExternalDictionary(const string& currentSpace, NameSpace& current) const
-    {
-        Core::TextFragment requiredSpace(currentSpace);
-        DictionaryMap::const_iterator index(_dictionary.begin());
-
-        while (index != _dictionary.end()) {
-            // Vallidate if the given path does include this namespace..
-            if ((currentSpace.empty() == true) || (requiredSpace.EqualText(index->first.c_str(), 0, requiredSpace.Length(), true) == true)) {
-                // Seems like we need to report this space, build it up
-                NameSpace& blockToFill(current[index->first]);
-
-                // No we got the namespace bloc, fill in the keys..
-                const std::list<RuntimeEntry>& keyList(index->second);
-                std::list<RuntimeEntry>::const_iterator keyIndex(keyList.begin());
-
-                while (keyIndex != keyList.end()) {
-                    NameSpace::Entry& entry(blockToFill.Dictionary.Add(NameSpace::Entry()));
-                    entry.Key = keyIndex->Key();
-                    entry.Value = keyIndex->Value();
-
-                    if (keyIndex->Type() != entry.Type.Default()) {
-                        entry.Type = keyIndex->Type();
-                    }
-
-                    keyIndex++;
-                }
-            }
-            index++;
-        }
-    }
-
     /* virtual */ const string Dictionary::Initialize(PluginHost::IShell* service)
     {
         _config.FromString(service->ConfigLine());
 
-        Core::File dictionaryFile(service->PersistentPath() + _config.Storage.Value());
-
-        if (dictionaryFile.Open(true) == true) {
-            NameSpace dictionary;
-            Core::OptionalType<Core::JSON::Error> error;
-            dictionary.IElement::FromFile(dictionaryFile, error);
-            if (error.IsSet() == true) {
-                SYSLOG(Logging::ParsingError, (_T("Parsing failed with %s"), ErrorDisplayMessage(error.Value()).c_str()));
-            }
-            CreateInternalDictionary(EMPTY_STRING, dictionary);
-        }
+        Open(service->PersistentPath() + _config.Storage.Value());
 
         _skipURL = static_cast<uint8_t>(service->WebPrefix().length());
 
@@ -129,13 +81,52 @@ namespace Plugin {
 
     /* virtual */ void Dictionary::Deinitialize(PluginHost::IShell* service)
     {
+        Close();
+    }
+
+    void Dictionary::Open(const string& storage)
+    {
+        string baseName(storage);
+
+        if ((baseName.length() > 5) && (baseName.compare(baseName.length() - 5, 5, _T(".json")) == 0)) {
+            baseName.resize(baseName.length() - 5);
+        }
+
+        _journal = Core::ProxyType<Journal>::Create(this, baseName);
+
+        if (_journal->Open() == false) {
+            // Nothing stored in the binary format yet, take over the JSON dictionary, if there is one.
+            Core::File dictionaryFile(storage);
+
+            if (dictionaryFile.Open(true) == true) {
+                NameSpace dictionary;
+                Core::OptionalType<Core::JSON::Error> error;
+                dictionary.IElement::FromFile(dictionaryFile, error);
+                if (error.IsSet() == true) {
+                    SYSLOG(Logging::ParsingError, (_T("Parsing failed with %s"), ErrorDisplayMessage(error.Value()).c_str()));
+                }
+                _adminLock.Lock();
+                CreateInternalDictionary(EMPTY_STRING, dictionary);
+                _adminLock.Unlock();
 
-        Core::File dictionaryFile(service->PersistentPath() + _config.Storage.Value());
+                _journal->Compact();
+            }
+        }
+    }
+
+    void Dictionary::Close()
+    {
+        // Detach the journal first, so Set() stops appending to it. It can not be closed with the
+        // dictionary locked, closing waits for a pending compaction, which locks the dictionary.
+        _adminLock.Lock();
+        Core::ProxyType<Journal> journal(_journal);
+        _journal.Release();
+        _adminLock.Unlock();
 
-        if (dictionaryFile.Open(true) == true) {
-            NameSpace dictionary;
-            CreateExternalDictionary(EMPTY_STRING, dictionary);
-            dictionary.IElement::ToFile(dictionaryFile);
+        // Everything is in the journal already, closing it folds it into the snapshot.
+        if (journal.IsValid() == true) {
+            journal->Close();
+            journal.Release();
         }
     }
 
@@ -147,12 +138,18 @@ namespace Plugin {
 
     /* virtual */ void Dictionary::Inbound(Web::Request& request)
     {
-        // There are no requests coming in with a body that require a JSON body. So continue without action here.
-        request.Body(Core::ProxyType<Web::IBody>(textBodyDataFactory.Element()));
+        // Only a batch of keys comes in as a JSON body, a single value is plain text.
+        if (request.Verb == Web::Request::HTTP_PUT) {
+            request.Body(Core::ProxyType<Web::IBody>(jsonBodyDataFactory.Element()));
+        } else {
+            request.Body(Core::ProxyType<Web::IBody>(textBodyDataFactory.Element()));
+        }
     }
 
     // <GET> ../[namespace/]{Key}
+    // <GET> ../[namespace/]
     // <PUT> ../[namespace/]{Key}?Type=[persistent|volatile|closure]
+    // <PUT> ../[namespace/]
     /* virtual */ Core::ProxyType<Web::Response> Dictionary::Process(const Web::Request& request)
     {
         ASSERT(_skipURL <= request.Path.length());
@@ -178,7 +175,41 @@ namespace Plugin {
             key = index.Current().Text();
         }
 
-        if (request.Verb == Web::Request::HTTP_GET) {
+        if ((request.Verb == Web::Request::HTTP_GET) && (key.empty() == true)) {
+            // All keys of the namespace in one go.
+            Core::ProxyType<Web::JSONBodyType<NameSpace>> response(jsonBodyDataFactory.Element());
+
+            _adminLock.Lock();
+
+            DictionaryMap::const_iterator space(_dictionary.find(nameSpace));
+
+            if (space != _dictionary.end()) {
+                for (const RuntimeEntry& entry : space->second.Entries) {
+                    response->Dictionary.Add(NameSpace::Entry(entry.Key(), entry.Value(), entry.Type()));
+                }
+            }
+
+            _adminLock.Unlock();
+
+            result->Body(Core::proxy_cast<Web::IBody>(response));
+            result->ContentType = Web::MIMETypes::MIME_JSON;
+        } else if ((request.Verb == Web::Request::HTTP_PUT) && (key.empty() == true) && (request.HasBody() == true)) {
+            Core::ProxyType<const Web::JSONBodyType<NameSpace>> body(request.Body<Web::JSONBodyType<NameSpace>>());
+            std::list<RuntimeEntry> values;
+
+            if (body.IsValid() == true) {
+                Core::JSON::ArrayType<NameSpace::Entry>::ConstIterator entries(body->Dictionary.Elements());
+
+                while (entries.Next() == true) {
+                    if (IsValidName(entries.Current().Key.Value()) == true) {
+                        values.push_back(RuntimeEntry(entries.Current().Key.Value(), entries.Current().Value.Value(), entries.Current().Type.Value()));
+                    }
+                }
+            }
+
+            TRACE(Trace::Information, (_T("SetKeys ( %s, %d)"), nameSpace.c_str(), static_cast<uint32_t>(values.size())));
+            Set(nameSpace, values);
+        } else if (request.Verb == Web::Request::HTTP_GET) {
             string value;
             Core::ProxyType<Web::TextBody> valueBody(textBodyDataFactory.Element());
 
@@ -218,20 +249,11 @@ namespace Plugin {
 
         _adminLock.Lock();
 
-        DictionaryMap::const_iterator index(_dictionary.find(nameSpace));
+        const RuntimeEntry* entry = Find(nameSpace, key);
 
-        if (index != _dictionary.end()) {
-            const std::list<RuntimeEntry>& container(index->second);
-            std::list<RuntimeEntry>::const_iterator listIndex(container.begin());
-
-            while ((listIndex != container.end()) && (listIndex->Key() != key)) {
-                listIndex++;
-            }
-
-            if (listIndex != container.end()) {
-                result = true;
-                value = listIndex->Value();
-            }
+        if (entry != nullptr) {
+            result = true;
+            value = entry->Value();
         }
 
         _adminLock.Unlock();
@@ -252,8 +274,19 @@ namespace Plugin {
 
         if (index != _dictionary.end()) {
             Core::ProxyType<Iterator> entries(iterators.Element());
+            const Space& space(index->second);
+
+            if (space.View == nullptr) {
+                std::shared_ptr<Snapshot> view(std::make_shared<Snapshot>());
 
-            entries->Load(InternalIterator(index->second));
+                view->reserve(space.Entries.size());
+                for (const RuntimeEntry& entry : space.Entries) {
+                    view->push_back(std::pair<string, string>(entry.Key(), entry.Value()));
+                }
+                space.View = view;
+            }
+
+            entries->Load(space.View);
 
             result = &(*entries);
             result->AddRef();
@@ -273,31 +306,46 @@ namespace Plugin {
 
         _adminLock.Lock();
 
-        std::list<RuntimeEntry>& container(_dictionary[nameSpace]);
-        std::list<RuntimeEntry>::iterator listIndex(container.begin());
+        // A new key is volatile, an existing one keeps its type.
+        const RuntimeEntry* existing = Find(nameSpace, key);
+        RuntimeEntry* entry = Store(nameSpace, key, value, (existing != nullptr ? existing->Type() : VOLATILE));
 
-        while ((listIndex != container.end()) && (listIndex->Key() != key)) {
-            listIndex++;
-        }
-
-        if (listIndex == container.end()) {
-            result = true;
-            container.push_back(RuntimeEntry(key, value, VOLATILE));
-        } else if (listIndex->Value() != value) {
+        if (entry != nullptr) {
             result = true;
-            listIndex->Value(value);
+
+            if (_journal.IsValid() == true) {
+                _journal->Append(nameSpace, *entry);
+            }
+
+            Notify(nameSpace, key, value);
         }
 
-        if (result == true) {
-            ObserverMap::iterator index(_observers.begin());
+        _adminLock.Unlock();
+
+        return (result);
+    }
+
+    uint32_t Dictionary::Set(const string& nameSpace, const std::list<RuntimeEntry>& values)
+    {
+        uint32_t result = 0;
+
+        _adminLock.Lock();
+
+        std::list<RuntimeEntry>::const_iterator index(values.begin());
 
-            // Right, we updated send out the modification !!!
-            while (index != _observers.end()) {
-                if (index->first == nameSpace) {
-                    index->second->Modified(nameSpace, key, value);
+        while (index != values.end()) {
+            RuntimeEntry* entry = Store(nameSpace, index->Key(), index->Value(), index->Type());
+
+            if (entry != nullptr) {
+                result++;
+
+                if (_journal.IsValid() == true) {
+                    _journal->Append(nameSpace, *entry);
                 }
-                index++;
+
+                Notify(nameSpace, index->Key(), index->Value());
             }
+            index++;
         }
 
         _adminLock.Unlock();
@@ -305,6 +353,287 @@ namespace Plugin {
         return (result);
     }
 
+    const Dictionary::RuntimeEntry* Dictionary::Find(const string& nameSpace, const string& key) const
+    {
+        const RuntimeEntry* result = nullptr;
+
+        DictionaryMap::const_iterator space(_dictionary.find(nameSpace));
+
+        if (space != _dictionary.end()) {
+            const Location location = { &(space->first), &key };
+            IndexMap::const_iterator index(_index.find(location));
+
+            if (index != _index.end()) {
+                result = index->second;
+            }
+        }
+
+        return (result);
+    }
+
+    // Returns the entry if it was added or its value or type changed, nullptr if nothing changed.
+    Dictionary::RuntimeEntry* Dictionary::Store(const string& nameSpace, const string& key, const string& value, const enumType type)
+    {
+        RuntimeEntry* result = nullptr;
+
+        DictionaryMap::iterator space(_dictionary.find(nameSpace));
+
+        if (space == _dictionary.end()) {
+            space = _dictionary.insert(std::pair<string, Space>(nameSpace, Space())).first;
+        }
+
+        const Location location = { &(space->first), &key };
+        IndexMap::iterator index(_index.find(location));
+
+        if (index == _index.end()) {
+            space->second.Entries.push_back(RuntimeEntry(key, value, type));
+            result = &(space->second.Entries.back());
+
+            const Location stored = { &(space->first), &(result->Key()) };
+            _index.insert(std::pair<Location, RuntimeEntry*>(stored, result));
+        } else if ((index->second->Value() != value) || (index->second->Type() != type)) {
+            result = index->second;
+            result->Value(value);
+            result->Type(type);
+        }
+
+        if (result != nullptr) {
+            space->second.View.reset();
+        }
+
+        return (result);
+    }
+
+    void Dictionary::Notify(const string& nameSpace, const string& key, const string& value)
+    {
+        ObserverMap::iterator index(_observers.begin());
+
+        // Right, we updated send out the modification !!!
+        while (index != _observers.end()) {
+            if (index->first == nameSpace) {
+                index->second->Modified(nameSpace, key, value);
+            }
+            index++;
+        }
+    }
+
+    bool Dictionary::Journal::Open()
+    {
+        _parent._adminLock.Lock();
+
+        _records = 0;
+
+        // A rotated journal is left behind if we went down during a compaction.
+        const bool snapshot = Read(_snapshotName, true);
+        const bool rotated = Read(_journalName + _T(".old"), false);
+        const bool journal = Read(_journalName, false) || rotated;
+
+        _entries = static_cast<uint32_t>(_parent._index.size());
+
+        _parent._adminLock.Unlock();
+
+        if (journal == true) {
+            // Fold the journal into the snapshot, this also gets rid of a torn record at its end,
+            // which would otherwise hide everything appended after it.
+            Compact();
+        }
+
+        if (_journal.IsOpen() == false) {
+            if ((_journal.Exists() == true ? _journal.Open(false) : _journal.Create()) == true) {
+                _journal.Position(false, _journal.Size());
+            } else {
+                TRACE_L1("Could not open the dictionary journal %s.", _journalName.c_str());
+            }
+        }
+
+        return (snapshot || journal);
+    }
+
+    void Dictionary::Journal::Close()
+    {
+        Core::IWorkerPool::Instance().Revoke(Core::ProxyType<Core::IDispatch>(*this));
+        _scheduled = false;
+
+        if (_records > 0) {
+            Compact();
+        }
+        _journal.Close();
+    }
+
+    void Dictionary::Journal::Append(const string& nameSpace, const RuntimeEntry& entry)
+    {
+        std::vector<uint8_t> record;
+
+        Serialize(nameSpace, entry, record);
+
+        if ((_journal.IsOpen() == true) && (_journal.Write(record.data(), static_cast<uint32_t>(record.size())) == record.size())) {
+            _records++;
+        } else {
+            TRACE_L1("Could not append %s to the dictionary journal.", entry.Key().c_str());
+        }
+
+        if ((_records > std::max(static_cast<uint32_t>(MinimumCompaction), 2 * _entries)) && (_scheduled.exchange(true) == false)) {
+            Core::IWorkerPool::Instance().Submit(Core::ProxyType<Core::IDispatch>(*this));
+        }
+    }
+
+    void Dictionary::Journal::Compact()
+    {
+        std::vector<uint8_t> buffer;
+        const uint32_t magic = SnapshotMagic;
+        const string rotated(_journalName + _T(".old"));
+
+        _compactLock.Lock();
+
+        // The dictionary is only locked while serializing and rotating the journal, as Set() appends
+        // to the journal with the dictionary locked. The snapshot is written without it.
+        _parent._adminLock.Lock();
+
+        uint32_t count = 0;
+
+        buffer.insert(buffer.end(), reinterpret_cast<const uint8_t*>(&magic), reinterpret_cast<const uint8_t*>(&magic) + sizeof(magic));
+        buffer.push_back(static_cast<uint8_t>(SnapshotVersion));
+
+        for (const std::pair<const string, Space>& space : _parent._dictionary) {
+            for (const RuntimeEntry& entry : space.second.Entries) {
+                Serialize(space.first, entry, buffer);
+                count++;
+            }
+        }
+
+        // Everything in the journal is in the buffer now. Keep the journal around until the
+        // snapshot is in place, new modifications go to a fresh journal.
+        _journal.Close();
+
+        if (JournalFile::Rotate(_journalName, rotated) == true) {
+            _records = 0;
+            if (_journal.Create() == false) {
+                TRACE_L1("Could not restart the dictionary journal %s.", _journalName.c_str());
+            }
+        } else if (_journal.Open(false) == true) {
+            // Keep on appending, the next compaction tries again.
+            _journal.Position(false, _journal.Size());
+            TRACE_L1("Could not rotate the dictionary journal %s.", _journalName.c_str());
+        }
+        _entries = count;
+
+        _parent._adminLock.Unlock();
+
+        if (JournalFile::Store(_snapshotName, buffer.data(), static_cast<uint32_t>(buffer.size())) == true) {
+            // Whatever the rotated journal held, is in the snapshot now.
+            Core::File(rotated).Destroy();
+        } else {
+            TRACE_L1("Could not write the dictionary snapshot %s.", _snapshotName.c_str());
+        }
+
+        _compactLock.Unlock();
+    }
+
+    void Dictionary::Journal::Dispatch()
+    {
+        _scheduled = false;
+        Compact();
+    }
+
+    /* static */ void Dictionary::Journal::Serialize(const string& nameSpace, const RuntimeEntry& entry, std::vector<uint8_t>& buffer)
+    {
+        const string& spaceText(nameSpace);
+        const string& keyText(entry.Key());
+        const string& valueText(entry.Value());
+
+        ASSERT((spaceText.length() <= 0xFFFF) && (keyText.length() <= 0xFFFF));
+
+        const uint8_t type = static_cast<uint8_t>(entry.Type());
+        const uint16_t spaceLength = static_cast<uint16_t>(spaceText.length());
+        const uint16_t keyLength = static_cast<uint16_t>(keyText.length());
+        const uint32_t valueLength = static_cast<uint32_t>(valueText.length());
+        const size_t offset = buffer.size();
+        const uint32_t length = HeaderSize + spaceLength + keyLength + valueLength;
+
+        buffer.resize(offset + length + sizeof(uint32_t));
+
+        uint8_t* data = &(buffer[offset]);
+        data[0] = type;
+        ::memcpy(&data[1], &spaceLength, sizeof(spaceLength));
+        ::memcpy(&data[3], &keyLength, sizeof(keyLength));
+        ::memcpy(&data[5], &valueLength, sizeof(valueLength));
+        ::memcpy(&data[HeaderSize], spaceText.c_str(), spaceLength);
+        ::memcpy(&data[HeaderSize + spaceLength], keyText.c_str(), keyLength);
+        ::memcpy(&data[HeaderSize + spaceLength + keyLength], valueText.c_str(), valueLength);
+
+        JournalFile::Seal(data, length);
+    }
+
+    // Returns true if the file existed and was recognized. Needs to be called with the dictionary locked.
+    bool Dictionary::Journal::Read(const string& fileName, const bool snapshot)
+    {
+        bool result = false;
+
+        JournalFile::Read(fileName, [&](const uint8_t data[], const uint32_t size) {
+            result = Replay(fileName, data, size, snapshot);
+        });
+
+        return (result);
+    }
+
+    bool Dictionary::Journal::Replay(const string& fileName, const uint8_t data[], const uint32_t size, const bool snapshot)
+    {
+        bool result = true;
+        uint32_t offset = 0;
+
+        if (snapshot == true) {
+            uint32_t magic = 0;
+            if (size >= (sizeof(magic) + sizeof(SnapshotVersion))) {
+                ::memcpy(&magic, data, sizeof(magic));
+            }
+            result = ((magic == SnapshotMagic) && (data[sizeof(magic)] == SnapshotVersion));
+            offset = (result == true ? sizeof(magic) + sizeof(SnapshotVersion) : size);
+        }
+
+        // A torn write at the end of the journal is expected after a power cut, stop there.
+        offset += JournalFile::Replay(&data[offset], size - offset, HeaderSize,
+            [](const uint8_t header[]) -> uint64_t {
+                uint16_t spaceLength;
+                uint16_t keyLength;
+                uint32_t valueLength;
+
+                ::memcpy(&spaceLength, &header[1], sizeof(spaceLength));
+                ::memcpy(&keyLength, &header[3], sizeof(keyLength));
+                ::memcpy(&valueLength, &header[5], sizeof(valueLength));
+
+                return (static_cast<uint64_t>(HeaderSize) + spaceLength + keyLength + valueLength);
+            },
+            [&](const uint8_t record[], const uint32_t) -> bool {
+                bool valid = (record[0] <= CLOSURE);
+
+                if (valid == true) {
+                    uint16_t spaceLength;
+                    uint16_t keyLength;
+                    uint32_t valueLength;
+
+                    ::memcpy(&spaceLength, &record[1], sizeof(spaceLength));
+                    ::memcpy(&keyLength, &record[3], sizeof(keyLength));
+                    ::memcpy(&valueLength, &record[5], sizeof(valueLength));
+
+                    const string nameSpace(reinterpret_cast<const TCHAR*>(&record[HeaderSize]), spaceLength);
+                    const string key(reinterpret_cast<const TCHAR*>(&record[HeaderSize + spaceLength]), keyLength);
+                    const string value(reinterpret_cast<const TCHAR*>(&record[HeaderSize + spaceLength + keyLength]), valueLength);
+
+                    _parent.Store(nameSpace, key, value, static_cast<enumType>(record[0]));
+
+                    _records += (snapshot == false ? 1 : 0);
+                }
+
+                return (valid);
+            });
+
+        if (offset < size) {
+            TRACE_L1("Dropped %d trailing bytes of %s.", size - offset, fileName.c_str());
+        }
+
+        return (result);
+    }
+
     /* virtual */ void Dictionary::Register(const string& nameSpace, struct Exchange::IDictionary::INotification* sink)
     {
         _adminLock.Lock();
@@ -23,6 +23,12 @@
 #include "Module.h"
 #include <interfaces/IDictionary.h>
 
+#include "../helpers/JournalFile.h"
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+
 namespace WPEFramework {
 namespace Plugin {
 
@@ -93,6 +99,11 @@ namespace Plugin {
             {
                 return (_type);
             }
+            inline void Type(const enumType type)
+            {
+                _dirty = true;
+                _type = type;
+            }
 
         private:
             string _key;
@@ -101,11 +112,116 @@ namespace Plugin {
             bool _dirty;
         };
 
-        typedef std::map<const string, std::list<RuntimeEntry>> DictionaryMap;
+        typedef std::vector<std::pair<string, string>> Snapshot;
+
+        class Space {
+        public:
+            Space()
+                : Entries()
+                , View()
+            {
+            }
+            ~Space()
+            {
+            }
+
+        public:
+            std::list<RuntimeEntry> Entries;
+            // Shared with the iterators handed out, dropped as soon as the namespace is modified.
+            mutable std::shared_ptr<const Snapshot> View;
+        };
+
+        // Namespaces are interned, they are only stored as the key of the dictionary map. The index
+        // refers to the namespace and the key by address, so a lookup does not copy any string.
+        struct Location {
+            const string* NameSpace;
+            const string* Key;
+        };
+        struct LocationHash {
+            size_t operator()(const Location& location) const
+            {
+                const size_t hash = std::hash<string>()(*location.Key);
+                return (hash ^ (std::hash<const string*>()(location.NameSpace) + 0x9e3779b9 + (hash << 6) + (hash >> 2)));
+            }
+        };
+        struct LocationEqual {
+            bool operator()(const Location& lhs, const Location& rhs) const
+            {
+                return ((lhs.NameSpace == rhs.NameSpace) && (*lhs.Key == *rhs.Key));
+            }
+        };
+
+        typedef std::unordered_map<string, Space> DictionaryMap;
+        typedef std::unordered_map<Location, RuntimeEntry*, LocationHash, LocationEqual> IndexMap;
         typedef std::list<std::pair<const string, struct Exchange::IDictionary::INotification*>> ObserverMap;
-        typedef Core::IteratorType<const std::list<RuntimeEntry>, const RuntimeEntry&, std::list<RuntimeEntry>::const_iterator> InternalIterator;
+
+        // Every modification is appended, as a small checksummed binary record, to a journal, so
+        // nothing is lost if we go down unexpectedly. Once the journal outgrows the dictionary it is
+        // folded, on a worker pool thread, into a binary snapshot. At startup the snapshot is mapped
+        // and the journal is replayed on top of it, in one pass, no JSON parsing involved.
+        //
+        // Record layout (native byte order, the files never leave the device):
+        //   uint8_t type | uint16_t namespace | uint16_t key | uint32_t value | bytes | uint32_t checksum
+        class Journal : public Core::IDispatch {
+        private:
+            static constexpr uint32_t SnapshotMagic = 0x54434944; // "DICT"
+            static constexpr uint8_t SnapshotVersion = 1;
+            static constexpr uint16_t MinimumCompaction = 64;
+            static constexpr uint16_t HeaderSize = sizeof(uint8_t) + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t);
+
+        public:
+            Journal() = delete;
+            Journal(const Journal&) = delete;
+            Journal& operator=(const Journal&) = delete;
+
+            Journal(Dictionary* parent, const string& baseName)
+                : _parent(*parent)
+                , _compactLock()
+                , _snapshotName(baseName + _T(".snapshot"))
+                , _journalName(baseName + _T(".journal"))
+                , _journal(_journalName)
+                , _records(0)
+                , _entries(0)
+                , _scheduled(false)
+            {
+            }
+            ~Journal() override
+            {
+                ASSERT(_journal.IsOpen() == false);
+            }
+
+        public:
+            // Returns false if there was no binary dictionary stored at all.
+            bool Open();
+            void Close();
+
+            // Needs to be called with the dictionary locked.
+            void Append(const string& nameSpace, const RuntimeEntry& entry);
+
+            // Write the complete dictionary into a new snapshot and restart the journal.
+            void Compact();
+
+        private:
+            void Dispatch() override;
+
+            static void Serialize(const string& nameSpace, const RuntimeEntry& entry, std::vector<uint8_t>& buffer);
+            bool Read(const string& fileName, const bool snapshot);
+            bool Replay(const string& fileName, const uint8_t data[], const uint32_t size, const bool snapshot);
+
+        private:
+            Dictionary& _parent;
+            Core::CriticalSection _compactLock;
+            const string _snapshotName;
+            const string _journalName;
+            Core::File _journal;
+            uint32_t _records;
+            uint32_t _entries;
+            std::atomic<bool> _scheduled;
+        };
 
     public:
+        // Iterates over a snapshot of the namespace, taken when the iterator was requested. The snapshot
+        // is shared by all iterators on an unmodified namespace, so handing out an iterator is cheap.
         class Iterator : public Exchange::IDictionary::IIterator {
         private:
             Iterator(const Iterator&) = delete;
@@ -113,7 +229,8 @@ namespace Plugin {
 
         public:
             Iterator()
-                : _iterator()
+                : _snapshot()
+                , _index(0)
                 , _lifeTime(nullptr)
             {
             }
@@ -127,10 +244,12 @@ namespace Plugin {
             }
 
         public:
-            void Load(const InternalIterator& iterator)
+            void Load(const std::shared_ptr<const Snapshot>& snapshot)
             {
                 ASSERT(_lifeTime != nullptr);
-                _iterator = iterator;
+                ASSERT(snapshot != nullptr);
+                _snapshot = snapshot;
+                _index = 0;
             }
             // IUnknown implementation
             // -----------------------------------------------
@@ -152,29 +271,35 @@ namespace Plugin {
             // -----------------------------------------------
             virtual void Reset()
             {
-                _iterator.Reset(0);
+                _index = 0;
             }
             virtual bool IsValid() const
             {
-                return (_iterator.IsValid());
+                return ((_index > 0) && (_index <= _snapshot->size()));
             }
             virtual bool Next()
             {
-                return (_iterator.Next());
+                if (_index <= _snapshot->size()) {
+                    _index++;
+                }
+                return (IsValid());
             }
 
             // Signal changes on the subscribed namespace..
             virtual const string Key() const
             {
-                return ((*_iterator).Key());
+                ASSERT(IsValid() == true);
+                return ((*_snapshot)[_index - 1].first);
             }
             virtual const string Value() const
             {
-                return ((*_iterator).Value());
+                ASSERT(IsValid() == true);
+                return ((*_snapshot)[_index - 1].second);
             }
 
         private:
-            InternalIterator _iterator;
+            std::shared_ptr<const Snapshot> _snapshot;
+            size_t _index;
             Core::IReferenceCounted* _lifeTime;
         };
 
@@ -347,6 +472,9 @@ namespace Plugin {
             , _skipURL(0)
             , _config()
             , _dictionary()
+            , _index()
+            , _observers()
+            , _journal()
         {
         }
         virtual ~Dictionary()
@@ -406,16 +534,31 @@ namespace Plugin {
         virtual void Register(const string& nameSpace, struct Exchange::IDictionary::INotification* sink);
         virtual void Unregister(const string& nameSpace, struct Exchange::IDictionary::INotification* sink);
 
+        // Batched variant, all keys of one namespace are set, with their type, under a single lock.
+        // Returns the number of keys that were modified.
+        uint32_t Set(const string& nameSpace, const std::list<RuntimeEntry>& values);
+
+        // Loads the dictionary from the snapshot and journal next to the storage file, or, if there are
+        // none yet, from the JSON storage file itself. Close() folds the journal into the snapshot.
+        void Open(const string& storage);
+        void Close();
+
     private:
         bool CreateInternalDictionary(const string& currentSpace, const NameSpace& data);
-        void CreateExternalDictionary(const string& currentSpace, NameSpace& data) const;
+
+        // Need to be called with the dictionary locked.
+        const RuntimeEntry* Find(const string& nameSpace, const string& key) const;
+        RuntimeEntry* Store(const string& nameSpace, const string& key, const string& value, const enumType type);
+        void Notify(const string& nameSpace, const string& key, const string& value);
 
     private:
         mutable Core::CriticalSection _adminLock;
         uint8_t _skipURL;
         Config _config;
         DictionaryMap _dictionary;
+        IndexMap _index;
         ObserverMap _observers;
+        Core::ProxyType<Journal> _journal;
     };
 }
 }
@@ -0,0 +1,172 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../Dictionary.h"
+#include "../../helpers/UnitTest.h"
+
+#include <chrono>
+#include <cstdlib>
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+// Loads 100k keys, once from the JSON file, as the first start after an upgrade does, and once from
+// the binary snapshot that leaves behind.
+
+namespace {
+
+    const uint32_t Spaces = 100;
+    const uint32_t Keys = 1000; // per namespace
+
+    class Dispatcher : public Core::ThreadPool::IDispatcher {
+    public:
+        Dispatcher(const Dispatcher&) = delete;
+        Dispatcher& operator=(const Dispatcher&) = delete;
+
+        Dispatcher() = default;
+        ~Dispatcher() override = default;
+
+    private:
+        void Initialize() override
+        {
+        }
+        void Deinitialize() override
+        {
+        }
+        void Dispatch(Core::IDispatch* job) override
+        {
+            job->Dispatch();
+        }
+    };
+
+    class WorkerPool : public Core::WorkerPool {
+    public:
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        WorkerPool()
+            : Core::WorkerPool(2, Core::Thread::DefaultStackSize(), 16, &_dispatcher)
+            , _dispatcher()
+        {
+            Core::IWorkerPool::Assign(this);
+            Run();
+        }
+        ~WorkerPool()
+        {
+            Stop();
+            Core::IWorkerPool::Assign(nullptr);
+        }
+
+    private:
+        Dispatcher _dispatcher;
+    };
+
+    string Text(const TCHAR prefix[], const uint32_t index)
+    {
+        return (prefix + Core::NumberType<uint32_t>(index).Text());
+    }
+
+    // As the plugin used to store it: a namespace per "spaces" entry, with its keys in "dictionary".
+    bool WriteJSON(const string& storage)
+    {
+        string json(_T("{\"spaces\":["));
+
+        for (uint32_t space = 0; space < Spaces; space++) {
+            json += (space == 0 ? _T("") : _T(","));
+            json += _T("{\"name\":\"") + Text(_T("space"), space) + _T("\",\"dictionary\":[");
+
+            for (uint32_t key = 0; key < Keys; key++) {
+                json += (key == 0 ? _T("") : _T(","));
+                json += _T("{\"key\":\"") + Text(_T("key"), key) + _T("\",\"value\":\"") + Text(_T("value"), (space * Keys) + key) + _T("\",\"type\":\"persistent\"}");
+            }
+
+            json += _T("]}");
+        }
+
+        json += _T("]}");
+
+        Core::File file(storage);
+        bool result = false;
+
+        if (file.Create() == true) {
+            result = (file.Write(reinterpret_cast<const uint8_t*>(json.c_str()), static_cast<uint32_t>(json.length())) == json.length());
+            file.Close();
+        }
+
+        return (result);
+    }
+
+    // Returns the seconds it took to open, and checks a few of the keys.
+    double Load(const string& storage)
+    {
+        Dictionary* dictionary = Core::Service<Dictionary>::Create<Dictionary>();
+        string value;
+
+        const auto start = std::chrono::steady_clock::now();
+
+        dictionary->Open(storage);
+
+        const double result = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        CHECK(dictionary->Get(_T("/space0"), _T("key0"), value) == true);
+        CHECK(value == _T("value0"));
+        CHECK(dictionary->Get(_T("/space42"), _T("key123"), value) == true);
+        CHECK(value == Text(_T("value"), (42 * Keys) + 123));
+        CHECK(dictionary->Get(Text(_T("/space"), Spaces - 1), Text(_T("key"), Keys - 1), value) == true);
+        CHECK(value == Text(_T("value"), (Spaces * Keys) - 1));
+
+        dictionary->Close();
+        dictionary->Release();
+
+        return (result);
+    }
+}
+
+int main()
+{
+    char directory[] = "/tmp/DictionaryLoad.XXXXXX";
+
+    {
+        WorkerPool workerPool;
+
+        if (::mkdtemp(directory) == nullptr) {
+            fprintf(stderr, "Could not create a directory to test the files in\n");
+            UnitTest::Failures()++;
+        } else {
+            const string storage(string(directory) + _T("/dictionary.json"));
+
+            CHECK(WriteJSON(storage) == true);
+
+            // The first load parses the JSON, and writes the snapshot the second one loads.
+            const double json = Load(storage);
+            const double snapshot = Load(storage);
+
+            printf("%u keys: from JSON %.1f ms (snapshot written included), from the snapshot %.1f ms\n", Spaces * Keys, json * 1000, snapshot * 1000);
+
+            ::remove(storage.c_str());
+            ::remove((string(directory) + _T("/dictionary.snapshot")).c_str());
+            ::remove((string(directory) + _T("/dictionary.journal")).c_str());
+            ::rmdir(directory);
+        }
+    }
+
+    Core::Singleton::Dispose();
+
+    return (UnitTest::Result());
+}
@@ -21,36 +21,476 @@
 
 #include "Module.h"
 
+#include <fcntl.h>
+#include <strings.h>
+#include <unistd.h>
+
 namespace WPEFramework {
 
 struct INotifier {
     virtual ~INotifier() {}
     virtual void NotifyDownloadStatus(const uint32_t status) = 0;
+    virtual void NotifyDownloadProgress(const uint64_t /* downloaded */, const uint64_t /* total */, const uint32_t /* rate */, const uint32_t /* eta */) {}
 };
 
 namespace PluginHost {
 
-    class DownloadEngine : public Web::ClientTransferType<Core::SocketStream, Web::SignedFileBodyType<Crypto::SHA256>> {
+    // Downloads an image over HTTP with Range requests, optionally split up in several segments that
+    // are fetched in parallel. The progress is persisted next to the image, so a download that was
+    // interrupted, or suspended, continues where it left off, the next time it is started for the same
+    // image. One that is aborted is removed. The image is hashed while it comes in. What was downloaded
+    // before a resume is hashed from disk on the worker pool, what arrived out of order once the download
+    // completes.
+    class DownloadEngine {
     private:
-        typedef Web::ClientTransferType<Core::SocketStream, Web::SignedFileBodyType<Crypto::SHA256>> BaseClass;
+        static constexpr uint64_t Unknown = ~0ULL;
+        static constexpr uint16_t BufferSize = 32 * 1024;
+        static constexpr uint16_t MaxHeaderSize = 8 * 1024;
+        static constexpr uint32_t PersistInterval = 1024 * 1024; // bytes received between progress updates on disk
+        static constexpr uint32_t MinimumSegment = 1024 * 1024; // bytes, smaller images are not split up
+        static constexpr uint64_t ReportInterval = 1000 * 1000; // microseconds
+
+        struct Segment {
+            uint64_t Start;
+            uint64_t Offset; // next byte to be written
+            uint64_t End; // exclusive, Unknown until the size is known
+        };
+
+        struct Response {
+            uint16_t Code;
+            uint64_t Length;
+            uint64_t RangeStart;
+            uint64_t RangeTotal;
+            bool Chunked;
+            string Validator;
+        };
+
+        class Progress : public Core::JSON::Container {
+        public:
+            class Part : public Core::JSON::Container {
+            public:
+                Part& operator=(const Part&) = delete;
+
+                Part()
+                    : Core::JSON::Container()
+                    , Start(0)
+                    , Offset(0)
+                    , End(0)
+                {
+                    Add(_T("start"), &Start);
+                    Add(_T("offset"), &Offset);
+                    Add(_T("end"), &End);
+                }
+                Part(const Part& copy)
+                    : Core::JSON::Container()
+                    , Start(copy.Start)
+                    , Offset(copy.Offset)
+                    , End(copy.End)
+                {
+                    Add(_T("start"), &Start);
+                    Add(_T("offset"), &Offset);
+                    Add(_T("end"), &End);
+                }
+                ~Part()
+                {
+                }
+
+            public:
+                Core::JSON::DecUInt64 Start;
+                Core::JSON::DecUInt64 Offset;
+                Core::JSON::DecUInt64 End;
+            };
+
+        public:
+            Progress(const Progress&) = delete;
+            Progress& operator=(const Progress&) = delete;
+
+            Progress()
+                : Core::JSON::Container()
+                , Locator()
+                , Hash()
+                , Validator()
+                , Size(0)
+                , Parts()
+            {
+                Add(_T("locator"), &Locator);
+                Add(_T("hash"), &Hash);
+                Add(_T("validator"), &Validator);
+                Add(_T("size"), &Size);
+                Add(_T("parts"), &Parts);
+            }
+            ~Progress()
+            {
+            }
+
+        public:
+            Core::JSON::String Locator;
+            Core::JSON::String Hash;
+            Core::JSON::String Validator; // ETag or Last-Modified, to make sure a resume continues the same image
+            Core::JSON::DecUInt64 Size;
+            Core::JSON::ArrayType<Part> Parts;
+        };
+
+        // One HTTP GET of one segment, on its own connection.
+        class Fetcher : public Core::SocketStream {
+        private:
+            enum state {
+                HEADER,
+                IDENTITY,
+                CHUNK_SIZE,
+                CHUNK_DATA,
+                CHUNK_END,
+                TRAILER,
+                DONE
+            };
+
+        public:
+            Fetcher() = delete;
+            Fetcher(const Fetcher&) = delete;
+            Fetcher& operator=(const Fetcher&) = delete;
+
+            Fetcher(DownloadEngine& parent, const uint8_t index, const Core::NodeId& remote, const string& request)
+                : Core::SocketStream(false, remote.AnyInterface(), remote, 1024, BufferSize)
+                , _parent(parent)
+                , _index(index)
+                , _request(request)
+                , _sent(0)
+                , _header()
+                , _state(HEADER)
+                , _remaining(Unknown)
+            {
+            }
+            ~Fetcher() override
+            {
+                Close(Core::infinite);
+            }
+
+        private:
+            uint16_t SendData(uint8_t* dataFrame, const uint16_t maxSendSize) override
+            {
+                const uint16_t result = static_cast<uint16_t>(std::min(static_cast<size_t>(maxSendSize), _request.length() - _sent));
+
+                ::memcpy(dataFrame, &(_request[_sent]), result);
+                _sent += result;
 
+                return (result);
+            }
+            uint16_t ReceiveData(uint8_t* dataFrame, const uint16_t receivedSize) override
+            {
+                uint16_t offset = 0;
+
+                if (_state == HEADER) {
+                    const size_t before = _header.length();
+
+                    offset = receivedSize;
+
+                    _header.append(reinterpret_cast<const char*>(dataFrame), receivedSize);
+
+                    const size_t end = _header.find(_T("\r\n\r\n"));
+
+                    if (end != string::npos) {
+                        // Keep the CRLF of the last header line, the body starts after the empty line.
+                        offset = static_cast<uint16_t>((end + 4) - before);
+                        _header.resize(end + 2);
+
+                        Response response;
+                        if (Parse(response) == false) {
+                            Stop();
+                            _parent.Failed(_index, Core::ERROR_UNAVAILABLE);
+                        } else if (_parent.Headers(_index, response) == false) {
+                            Stop();
+                        } else {
+                            _state = (response.Chunked == true ? CHUNK_SIZE : IDENTITY);
+                            _remaining = (response.Chunked == true ? 0 : response.Length);
+
+                            if ((_state == IDENTITY) && (_remaining == 0)) {
+                                Finish();
+                            }
+                        }
+                        _header.clear();
+                    } else if (_header.length() > MaxHeaderSize) {
+                        Stop();
+                        _parent.Failed(_index, Core::ERROR_UNAVAILABLE);
+                    }
+                }
+
+                Body(&dataFrame[offset], receivedSize - offset);
+
+                return (receivedSize);
+            }
+            void StateChange() override
+            {
+                if (IsOpen() == true) {
+                    Trigger();
+                } else if (_state != DONE) {
+                    // Without a length, the body ends with the connection.
+                    if ((_state == IDENTITY) && (_remaining == Unknown)) {
+                        Finish();
+                    } else {
+                        _state = DONE;
+                        _parent.Failed(_index, Core::ERROR_UNAVAILABLE);
+                    }
+                }
+            }
+
+            void Stop()
+            {
+                _state = DONE;
+                Close(0);
+            }
+            void Finish()
+            {
+                _state = DONE;
+                _parent.Completed(_index);
+                Close(0);
+            }
+            void Body(const uint8_t data[], uint32_t length)
+            {
+                while ((length > 0) && (_state != DONE)) {
+                    if ((_state == IDENTITY) || (_state == CHUNK_DATA)) {
+                        const uint32_t size = static_cast<uint32_t>(std::min(static_cast<uint64_t>(length), _remaining));
+
+                        if (_parent.Write(_index, data, size) == false) {
+                            // Nothing more needed from this connection.
+                            Stop();
+                        } else {
+                            data += size;
+                            length -= size;
+                            _remaining -= (_remaining != Unknown ? size : 0);
+
+                            if (_remaining == 0) {
+                                if (_state == IDENTITY) {
+                                    Finish();
+                                } else {
+                                    _state = CHUNK_END;
+                                }
+                            }
+                        }
+                    } else {
+                        // Chunk sizes and trailers are lines, collect them one character at a time.
+                        const char character = static_cast<char>(*data++);
+                        length--;
+
+                        if (character != '\n') {
+                            _header += character;
+                        } else {
+                            if (_state == CHUNK_SIZE) {
+                                _remaining = ::strtoull(_header.c_str(), nullptr, 16);
+                                _state = (_remaining == 0 ? TRAILER : CHUNK_DATA);
+                            } else if (_state == CHUNK_END) {
+                                _state = CHUNK_SIZE;
+                            } else if ((_header.empty() == true) || (_header == _T("\r"))) {
+                                Finish();
+                            }
+                            _header.clear();
+                        }
+                    }
+                }
+            }
+            bool Parse(Response& response) const
+            {
+                size_t start = _header.find("\r\n");
+                bool result = ((_header.compare(0, 5, _T("HTTP/")) == 0) && (start != string::npos));
+
+                response.Code = 0;
+                response.Length = Unknown;
+                response.RangeStart = 0;
+                response.RangeTotal = Unknown;
+                response.Chunked = false;
+
+                if (result == true) {
+                    const size_t code = _header.find(' ');
+                    response.Code = static_cast<uint16_t>(code < start ? ::atoi(&(_header[code + 1])) : 0);
+                    start += 2;
+                }
+
+                while ((result == true) && (start < _header.length())) {
+                    const size_t end = _header.find("\r\n", start);
+                    const size_t colon = _header.find(':', start);
+
+                    if ((colon != string::npos) && (colon < end)) {
+                        size_t value = colon + 1;
+                        while ((value < end) && (_header[value] == ' ')) {
+                            value++;
+                        }
+                        const string field(_header, value, end - value);
+
+                        if (Is(start, colon, _T("content-length")) == true) {
+                            response.Length = ::strtoull(field.c_str(), nullptr, 10);
+                        } else if (Is(start, colon, _T("content-range")) == true) {
+                            // bytes <first>-<last>/<total>
+                            const size_t space = field.find(' ');
+                            const size_t slash = field.find('/');
+                            if ((space != string::npos) && (slash != string::npos)) {
+                                response.RangeStart = ::strtoull(&(field[space + 1]), nullptr, 10);
+                                response.RangeTotal = (field[slash + 1] != '*' ? ::strtoull(&(field[slash + 1]), nullptr, 10) : Unknown);
+                            }
+                        } else if (Is(start, colon, _T("transfer-encoding")) == true) {
+                            response.Chunked = (field.find(_T("chunked")) != string::npos);
+                        } else if (Is(start, colon, _T("etag")) == true) {
+                            // A weak validator can not be used for a range.
+                            if (field.compare(0, 2, _T("W/")) != 0) {
+                                response.Validator = field;
+                            }
+                        } else if ((Is(start, colon, _T("last-modified")) == true) && (response.Validator.empty() == true)) {
+                            response.Validator = field;
+                        }
+                    }
+                    start = end + 2;
+                }
+
+                return (result);
+            }
+            bool Is(const size_t start, const size_t end, const TCHAR name[]) const
+            {
+                return (((end - start) == ::strlen(name)) && (::strncasecmp(&(_header[start]), name, end - start) == 0));
+            }
+
+        private:
+            DownloadEngine& _parent;
+            const uint8_t _index;
+            const string _request;
+            size_t _sent;
+            string _header;
+            state _state;
+            uint64_t _remaining;
+        };
+
+        // Hashing what is not hashed yet, and verifying, is done on the worker pool, not on a socket thread.
+        // So is starting over, that takes down the connections.
+        class Completion : public Core::IDispatch {
+        public:
+            Completion() = delete;
+            Completion(const Completion&) = delete;
+            Completion& operator=(const Completion&) = delete;
+
+            Completion(DownloadEngine* parent)
+                : _parent(*parent)
+            {
+            }
+            ~Completion() override = default;
+
+        public:
+            void Schedule()
+            {
+                Core::IWorkerPool::Instance().Submit(Core::ProxyType<Core::IDispatch>(*this));
+            }
+            void Revoke()
+            {
+                Core::IWorkerPool::Instance().Revoke(Core::ProxyType<Core::IDispatch>(*this));
+            }
+
+        private:
+            void Dispatch() override
+            {
+                _parent.Finish();
+            }
+
+        private:
+            DownloadEngine& _parent;
+        };
+
+        // Hashes what was downloaded before a resume, on the worker pool, while the rest comes in.
+        class CatchUp : public Core::IDispatch {
+        public:
+            CatchUp() = delete;
+            CatchUp(const CatchUp&) = delete;
+            CatchUp& operator=(const CatchUp&) = delete;
+
+            CatchUp(DownloadEngine* parent)
+                : _parent(*parent)
+            {
+            }
+            ~CatchUp() override = default;
+
+        public:
+            void Schedule()
+            {
+                Core::IWorkerPool::Instance().Submit(Core::ProxyType<Core::IDispatch>(*this));
+            }
+            void Revoke()
+            {
+                Core::IWorkerPool::Instance().Revoke(Core::ProxyType<Core::IDispatch>(*this));
+            }
+
+        private:
+            void Dispatch() override
+            {
+                _parent.Resumed();
+            }
+
+        private:
+            DownloadEngine& _parent;
+        };
+
+    public:
         DownloadEngine() = delete;
         DownloadEngine(const DownloadEngine&) = delete;
         DownloadEngine& operator=(const DownloadEngine&) = delete;
 
-    public:
-        DownloadEngine(INotifier* notifier, const string& downloadStorage)
-            : BaseClass(false, Core::NodeId(_T("0.0.0.0")), Core::NodeId(), 1024, 1024)
+        DownloadEngine(INotifier* notifier, const string& downloadStorage, const uint8_t segments = 1)
+            : _adminLock()
             , _notifier(notifier)
-            , _storage(downloadStorage.c_str(), false)
+            , _storage(downloadStorage)
+            , _descriptor(-1)
+            , _segmentCount(segments > 0 ? segments : 1)
+            , _remote()
+            , _target()
+            , _host()
+            , _locator()
+            , _hash()
+            , _validator()
+            , _size(Unknown)
+            , _resumable(false)
+            , _finished(false)
+            , _restart(false)
+            , _segments()
+            , _fetchers()
+            , _hasher()
+            , _hashed(0)
+            , _received(0)
+            , _persisted(0)
+            , _reported(0)
+            , _reportedReceived(0)
+            , _completion(Core::ProxyType<Completion>::Create(this))
+            , _catchUp(Core::ProxyType<CatchUp>::Create(this))
+            , _notifyLock()
         {
         }
-        virtual ~DownloadEngine()
+        ~DownloadEngine()
         {
+            _notifyLock.Lock();
+            _notifier = nullptr;
+            _notifyLock.Unlock();
+
+            _adminLock.Lock();
+            const bool persist = ((_finished == false) && (_resumable == true));
+            _finished = true;
+            _adminLock.Unlock();
+
+            _completion->Revoke();
+            _catchUp->Revoke();
+
+            for (Fetcher* fetcher : _fetchers) {
+                delete fetcher;
+            }
+
+            // Interrupted, continue from here next time.
+            if (persist == true) {
+                Persist();
+            }
+            if (_descriptor != -1) {
+                ::close(_descriptor);
+            }
         }
 
     public:
-        uint32_t Start(const string& locator, const string& destination, const string& hash)
+        static string ProgressFile(const string& storage)
+        {
+            return (storage + _T(".progress"));
+        }
+
+        uint32_t Start(const string& locator, const string& /* destination */, const string& hash)
         {
             Core::URL url(locator);
             uint32_t result = (url.IsValid() == true ? Core::ERROR_INPROGRESS : Core::ERROR_INCORRECT_URL);
@@ -59,17 +499,45 @@ namespace PluginHost {
 
                 _adminLock.Lock();
 
-                CleanupStorage();
+                if (_descriptor == -1) {
 
-                if (_storage.IsOpen() == false) {
+                    result = Core::ERROR_INCORRECT_URL;
 
-                    result = Core::ERROR_OPENING_FAILED;
+                    if (Setup(url) == true) {
 
-                    if (_storage.Create() == true) {
+                        result = Core::ERROR_OPENING_FAILED;
 
+                        _locator = locator;
                         _hash = hash;
 
-                        result = BaseClass::Download(url, _storage);
+                        if (Load() == false) {
+                            // Start from scratch, with one segment, its response tells if it can be split up.
+                            CleanupStorage();
+                            _segments.assign(1, { 0, 0, Unknown });
+                        }
+
+                        _descriptor = ::open(_storage.c_str(), O_RDWR | O_CREAT, 0644);
+
+                        if (_descriptor != -1) {
+                            // What was downloaded before is hashed on the side, no need to hold up
+                            // the connections for it.
+                            if (_segments.front().Offset > 0) {
+                                _catchUp->Schedule();
+                            }
+                            _received = 0;
+                            _fetchers.assign(_segments.size(), nullptr);
+
+                            for (uint8_t index = 0; index < _segments.size(); index++) {
+                                if (_segments[index].Offset != _segments[index].End) {
+                                    Launch(index);
+                                }
+                            }
+
+                            // It could be there was nothing left to download.
+                            Done();
+
+                            result = Core::ERROR_INPROGRESS;
+                        }
                     }
                 }
 
@@ -79,55 +547,548 @@ namespace PluginHost {
             return (result);
         }
 
+        // Gives up on the download, nothing of it is kept for a next time. For when it is cancelled, or
+        // the image turned out to be wrong.
+        void Abort()
+        {
+            _notifyLock.Lock();
+            _notifier = nullptr;
+            _notifyLock.Unlock();
+
+            _adminLock.Lock();
+            _finished = true;
+            _resumable = false;
+            _adminLock.Unlock();
+
+            _completion->Revoke();
+            _catchUp->Revoke();
+
+            Close();
+
+            _adminLock.Lock();
+            CleanupStorage();
+            _adminLock.Unlock();
+        }
+        // Stops the download for now, on a failure that might be gone the next time. Only the connections
+        // are taken down, the image and its progress are kept, to continue from.
+        void Suspend()
+        {
+            _notifyLock.Lock();
+            _notifier = nullptr;
+            _notifyLock.Unlock();
+
+            _adminLock.Lock();
+            const bool persist = ((_finished == false) && (_resumable == true));
+            _finished = true;
+            _adminLock.Unlock();
+
+            _completion->Revoke();
+            _catchUp->Revoke();
+
+            Close();
+
+            if (persist == true) {
+                _adminLock.Lock();
+                Persist();
+                _adminLock.Unlock();
+            }
+        }
+
         inline void CleanupStorage()
         {
-            if (_storage.Exists()) {
-                _storage.Destroy();
+            Core::File storage(_storage);
+            Core::File progress(ProgressFile(_storage));
+
+            if (storage.Exists()) {
+                storage.Destroy();
+            }
+            if (progress.Exists()) {
+                progress.Destroy();
             }
         }
+
     private:
-        virtual void Transfered(const uint32_t result, const Web::SignedFileBodyType<Crypto::SHA256>& destination) override
-        {
-            uint32_t status = result;
-            if (status == Core::ERROR_NONE) {
-                if (_hash.empty() != true) {
-                    uint8_t hashHex[Crypto::HASH_SHA256];
-                    if (HashStringToBytes(_hash, hashHex) == true) {
-
-                        const uint8_t* downloadedHash = destination.SerializedHashValue();
-                        if (downloadedHash != nullptr) {
-                            for (uint16_t i = 0; i < Crypto::HASH_SHA256; i++) {
-                                if (downloadedHash[i] != hashHex[i]) {
-                                    status = Core::ERROR_INCORRECT_HASH;
-                                    break;
-                                }
-                            }
-                        }
+        bool Setup(const Core::URL& remote)
+        {
+            bool result = false;
+
+            // Plain HTTP only, there is no TLS on these connections.
+            if ((remote.Type() == Core::URL::SCHEME_HTTP) && (remote.Host().IsSet() == true)) {
+                uint16_t portNumber(remote.Port().IsSet() ? remote.Port().Value() : 80);
+
+                _remote = Core::NodeId(remote.Host().Value().c_str(), portNumber);
+                _host = remote.Host().Value() + (remote.Port().IsSet() ? _T(":") + Core::NumberType<uint16_t>(portNumber).Text() : string());
+                _target = (remote.Path().IsSet() ? remote.Path().Value() : string());
+                if ((_target.empty() == true) || (_target[0] != '/')) {
+                    _target.insert(0, 1, '/');
+                }
+                if (remote.Query().IsSet() == true) {
+                    _target += '?' + remote.Query().Value();
+                }
+
+                result = _remote.IsValid();
+            }
+            return (result);
+        }
+
+        // Picks up the persisted progress, if it is for this image.
+        bool Load()
+        {
+            bool result = false;
+            Core::File file(ProgressFile(_storage));
+            Progress progress;
+
+            if ((Core::File(_storage).Exists() == true) && (file.Open(true) == true)) {
+                progress.IElement::FromFile(file);
+                file.Close();
+
+                result = ((progress.Locator.Value() == _locator) && (progress.Hash.Value() == _hash) && (progress.Parts.Length() > 0));
+
+                _segments.clear();
+
+                Core::JSON::ArrayType<Progress::Part>::Iterator index(progress.Parts.Elements());
+                while ((result == true) && (index.Next() == true)) {
+                    const Segment segment = { index.Current().Start.Value(), index.Current().Offset.Value(), index.Current().End.Value() };
+
+                    result = ((segment.Start <= segment.Offset) && (segment.Offset <= segment.End) && (segment.End <= progress.Size.Value())
+                        && ((_segments.empty() == true) ? (segment.Start == 0) : (segment.Start == _segments.back().End)));
+
+                    _segments.push_back(segment);
+                }
+
+                result = result && (_segments.back().End == progress.Size.Value());
+
+                if (result == true) {
+                    _size = progress.Size.Value();
+                    _validator = progress.Validator.Value();
+                    _resumable = true;
+
+                    TRACE(Trace::Information, (_T("Resuming download of %s"), _locator.c_str()));
+                }
+            }
+
+            return (result);
+        }
+        // Needs to be called within the lock.
+        void Persist()
+        {
+            if (_resumable == true) {
+                const string name(ProgressFile(_storage));
+                Core::File file(name + _T(".tmp"));
+                Progress progress;
+
+                progress.Locator = _locator;
+                progress.Hash = _hash;
+                progress.Validator = _validator;
+                progress.Size = _size;
+
+                for (const Segment& segment : _segments) {
+                    Progress::Part& part(progress.Parts.Add());
+                    part.Start = segment.Start;
+                    part.Offset = segment.Offset;
+                    part.End = segment.End;
+                }
+
+                // The image data goes out before the progress claiming it.
+                ::fdatasync(_descriptor);
+
+                if ((file.Create() == true) && (progress.IElement::ToFile(file) == true)) {
+                    file.Close();
+                    ::rename(file.Name().c_str(), name.c_str());
+                } else {
+                    TRACE_L1("Could not persist the download progress in %s", name.c_str());
+                }
+
+                _persisted = _received;
+            }
+        }
+        // Needs to be called within the lock.
+        void Launch(const uint8_t index)
+        {
+            const Segment& segment(_segments[index]);
+            string request(_T("GET ") + _target + _T(" HTTP/1.1\r\nHost: ") + _host + _T("\r\nRange: bytes=") + Core::NumberType<uint64_t>(segment.Offset).Text() + '-');
+
+            if (segment.End != Unknown) {
+                request += Core::NumberType<uint64_t>(segment.End - 1).Text();
+            }
+            if ((segment.Offset > 0) && (_validator.empty() == false)) {
+                // If the image changed in the meantime, the server sends all of it instead.
+                request += _T("\r\nIf-Range: ") + _validator;
+            }
+            request += _T("\r\nConnection: close\r\n\r\n");
+
+            _fetchers[index] = new Fetcher(*this, index, _remote, request);
+            _fetchers[index]->Open(0);
+        }
+        // Needs to be called within the lock, hashes the image from disk, from where it is up to "end".
+        void Hash(const uint64_t end)
+        {
+            uint8_t buffer[BufferSize];
+
+            while (_hashed < end) {
+                const ssize_t length = ::pread(_descriptor, buffer, static_cast<size_t>(std::min(static_cast<uint64_t>(sizeof(buffer)), end - _hashed)), _hashed);
+
+                if (length <= 0) {
+                    break;
+                }
+                _hasher.Input(buffer, static_cast<uint16_t>(length));
+                _hashed += length;
+            }
+        }
+        // Runs on the worker pool, hashes the image from disk, up to where the first segment is, one buffer
+        // at a time. The reading is done outside of the lock, on a descriptor of its own, the download
+        // carries on meanwhile. Once it is caught up, Write() hashes along again.
+        void Resumed()
+        {
+            uint8_t buffer[BufferSize];
+            const int descriptor = ::open(_storage.c_str(), O_RDONLY);
+            bool more = (descriptor != -1);
+
+            while (more == true) {
+                _adminLock.Lock();
+                const uint64_t start = _hashed;
+                const uint64_t end = ((_finished == false) && (_restart == false) ? _segments.front().Offset : start);
+                _adminLock.Unlock();
+
+                const ssize_t length = (start < end ? ::pread(descriptor, buffer, static_cast<size_t>(std::min(static_cast<uint64_t>(sizeof(buffer)), end - start)), start) : 0);
+
+                more = (length > 0);
+
+                if (more == true) {
+                    _adminLock.Lock();
+
+                    // Unless something else hashed it meanwhile.
+                    if ((_hashed == start) && (_finished == false)) {
+                        _hasher.Input(buffer, static_cast<uint16_t>(length));
+                        _hashed += length;
                     }
+
+                    _adminLock.Unlock();
                 }
             }
+
+            if (descriptor != -1) {
+                ::close(descriptor);
+            }
+        }
+        // Needs to be called within the lock. Returns true if the failure is to be reported, which is done
+        // once the lock is released.
+        bool Fail()
+        {
+            bool result = (_finished == false);
+
+            if (result == true) {
+                _finished = true;
+
+                Persist();
+            }
+
+            return (result);
+        }
+        // Needs to be called outside of the lock, the notifier might call back in.
+        void Notify(const uint32_t status)
+        {
+            _notifyLock.Lock();
             if (_notifier != nullptr) {
                 _notifier->NotifyDownloadStatus(status);
             }
-
+            _notifyLock.Unlock();
+        }
+        // Needs to be called outside of the lock, takes all connections down.
+        void Close()
+        {
             _adminLock.Lock();
-            _storage.Close();
+            std::vector<Fetcher*> fetchers(_fetchers.size(), nullptr);
+            fetchers.swap(_fetchers);
             _adminLock.Unlock();
+
+            // They are all done, whatever they still report is dropped.
+            for (Fetcher* fetcher : fetchers) {
+                delete fetcher;
+            }
         }
+        // Needs to be called within the lock.
+        void Done()
+        {
+            bool complete = (_finished == false);
+
+            for (const Segment& segment : _segments) {
+                complete = complete && (segment.End != Unknown) && (segment.Offset == segment.End);
+            }
 
-        virtual bool Setup(const Core::URL& remote) override
+            if (complete == true) {
+                _finished = true;
+                _completion->Schedule();
+            }
+        }
+        // Needs to be called within the lock, splits the rest of the first segment up, for the others to fetch.
+        void Split()
+        {
+            const uint64_t part = _size / _segmentCount;
+
+            _segments.front().End = part;
+
+            for (uint8_t index = 1; index < _segmentCount; index++) {
+                _segments.push_back({ index * part, index * part, (index == (_segmentCount - 1) ? _size : (index + 1) * part) });
+            }
+
+            _fetchers.resize(_segments.size(), nullptr);
+
+            for (uint8_t index = 1; index < _segments.size(); index++) {
+                Launch(index);
+            }
+        }
+
+        bool Headers(const uint8_t index, const Response& response)
         {
             bool result = false;
+            bool failed = false;
 
-            if (remote.Host().IsSet() == true) {
-                uint16_t portNumber(remote.Port().IsSet() ? remote.Port().Value() : 80);
+            _adminLock.Lock();
+
+            if (_finished == true) {
+                // Too late.
+            } else if ((response.Code == Web::STATUS_PARTIAL_CONTENT) && (response.RangeStart == _segments[index].Offset)
+                && (_size != Unknown) && (response.RangeTotal != Unknown) && (response.RangeTotal != _size)) {
+                // Same validator, or none, but another size, so not the image that is on disk. Start over.
+                TRACE(Trace::Information, (_T("%s is %llu bytes now, instead of %llu, the download is restarted"), _locator.c_str(), static_cast<unsigned long long>(response.RangeTotal), static_cast<unsigned long long>(_size)));
+                _finished = true;
+                _restart = true;
+                _completion->Schedule();
+            } else if ((response.Code == Web::STATUS_PARTIAL_CONTENT) && (response.RangeStart == _segments[index].Offset)) {
+                Segment& segment(_segments[index]);
 
-                BaseClass::Link().RemoteNode(Core::NodeId(remote.Host().Value().c_str(), portNumber));
+                if (_size == Unknown) {
+                    _size = response.RangeTotal;
+                    _validator = response.Validator;
+                    _resumable = (_size != Unknown);
+                    segment.End = _size;
 
+                    if ((_segmentCount > 1) && (_size != Unknown) && (_size >= (static_cast<uint64_t>(MinimumSegment) * _segmentCount))) {
+                        Split();
+                    }
+                    Persist();
+                }
+                result = true;
+            } else if ((response.Code == Web::STATUS_OK) && (_segments[index].Offset == 0) && (_segments.size() == 1)) {
+                // No ranges, all of it in one go, it can not be resumed.
+                _size = response.Length;
+                _resumable = false;
+                _segments[index].End = _size;
                 result = true;
+            } else {
+                if (response.Code == Web::STATUS_OK) {
+                    // The image changed since this download started, start over next time.
+                    TRACE(Trace::Information, (_T("%s changed, the download is restarted next time"), _locator.c_str()));
+                    _resumable = false;
+                    ::close(_descriptor);
+                    _descriptor = -1;
+                    CleanupStorage();
+                } else {
+                    TRACE_L1("Unexpected response %d to a request for %s", response.Code, _locator.c_str());
+                }
+                failed = Fail();
+            }
+
+            _adminLock.Unlock();
+
+            if (failed == true) {
+                Notify(Core::ERROR_UNAVAILABLE);
+            }
+
+            return (result);
+        }
+        bool Write(const uint8_t index, const uint8_t data[], const uint32_t length)
+        {
+            bool result = false;
+            uint64_t downloaded = 0;
+            uint32_t rate = 0;
+            uint32_t eta = 0;
+            bool report = false;
+            bool failed = false;
+
+            _adminLock.Lock();
+
+            if (_finished == false) {
+                Segment& segment(_segments[index]);
+                const uint32_t size = (segment.End == Unknown ? length : static_cast<uint32_t>(std::min(static_cast<uint64_t>(length), segment.End - segment.Offset)));
+
+                if (::pwrite(_descriptor, data, size, segment.Offset) != static_cast<ssize_t>(size)) {
+                    TRACE_L1("Could not write to %s, error: %d", _storage.c_str(), errno);
+                    failed = Fail();
+                } else {
+                    // Hash along, as long as it follows what is hashed already.
+                    if (segment.Offset == _hashed) {
+                        for (uint32_t offset = 0; offset < size; offset += BufferSize) {
+                            _hasher.Input(&data[offset], static_cast<uint16_t>(std::min(static_cast<uint32_t>(BufferSize), size - offset)));
+                        }
+                        _hashed += size;
+                    }
+
+                    segment.Offset += size;
+                    _received += size;
+
+                    if ((_received - _persisted) >= PersistInterval) {
+                        Persist();
+                    }
+
+                    result = ((segment.End == Unknown) || (segment.Offset < segment.End));
+
+                    if (result == false) {
+                        Done();
+                    }
+
+                    const uint64_t now = Core::Time::Now().Ticks();
+
+                    if (_reported == 0) {
+                        _reported = now;
+                    } else if ((now - _reported) >= ReportInterval) {
+                        for (const Segment& entry : _segments) {
+                            downloaded += (entry.Offset - entry.Start);
+                        }
+                        rate = static_cast<uint32_t>(((_received - _reportedReceived) * 1000 * 1000) / (now - _reported));
+                        eta = (((rate > 0) && (_size != Unknown)) ? static_cast<uint32_t>((_size - downloaded) / rate) : 0);
+                        report = true;
+
+                        _reported = now;
+                        _reportedReceived = _received;
+                    }
+                }
             }
+
+            const uint64_t size = _size;
+
+            _adminLock.Unlock();
+
+            if (failed == true) {
+                Notify(Core::ERROR_WRITE_ERROR);
+            } else if (report == true) {
+                _notifyLock.Lock();
+                if (_notifier != nullptr) {
+                    _notifier->NotifyDownloadProgress(downloaded, size, rate, eta);
+                }
+                _notifyLock.Unlock();
+            }
+
             return (result);
         }
+        void Completed(const uint8_t index)
+        {
+            bool failed = false;
+
+            _adminLock.Lock();
+
+            if (_finished == false) {
+                Segment& segment(_segments[index]);
+
+                if (segment.End == Unknown) {
+                    // Its length was not known upfront.
+                    segment.End = segment.Offset;
+                    _size = segment.Offset;
+                }
+
+                if (segment.Offset == segment.End) {
+                    Done();
+                } else {
+                    failed = Fail();
+                }
+            }
+
+            _adminLock.Unlock();
+
+            if (failed == true) {
+                Notify(Core::ERROR_UNAVAILABLE);
+            }
+        }
+        void Failed(const uint8_t /* index */, const uint32_t status)
+        {
+            _adminLock.Lock();
+            const bool failed = Fail();
+            _adminLock.Unlock();
+
+            if (failed == true) {
+                Notify(status);
+            }
+        }
+        void Finish()
+        {
+            _adminLock.Lock();
+            const bool restart = _restart;
+            _adminLock.Unlock();
+
+            if (restart == true) {
+                Restart();
+            } else {
+                Verify();
+            }
+        }
+        // The image on the server is not the one on disk, drop what is on disk and download it from the start.
+        void Restart()
+        {
+            _catchUp->Revoke();
+
+            Close();
+
+            _adminLock.Lock();
+
+            Core::File(ProgressFile(_storage)).Destroy();
+
+            if (::ftruncate(_descriptor, 0) != 0) {
+                TRACE_L1("Could not truncate %s, error: %d", _storage.c_str(), errno);
+            }
+
+            _size = Unknown;
+            _validator.clear();
+            _resumable = false;
+            _restart = false;
+            _finished = false;
+            _segments.assign(1, { 0, 0, Unknown });
+            _fetchers.assign(1, nullptr);
+            _hasher.Reset();
+            _hashed = 0;
+            _received = 0;
+            _persisted = 0;
+            _reported = 0;
+            _reportedReceived = 0;
+
+            Launch(0);
+
+            _adminLock.Unlock();
+        }
+        void Verify()
+        {
+            uint32_t status = Core::ERROR_NONE;
+
+            _adminLock.Lock();
+
+            Hash(_size);
+
+            if ((_hashed != _size) && (_size != Unknown)) {
+                TRACE_L1("Could not read back all of %s", _storage.c_str());
+                status = Core::ERROR_READ_ERROR;
+            } else if (_hash.empty() != true) {
+                uint8_t hashHex[Crypto::HASH_SHA256];
+                if (HashStringToBytes(_hash, hashHex) == true) {
+
+                    const uint8_t* downloadedHash = _hasher.Result();
+                    if (downloadedHash != nullptr) {
+                        for (uint16_t i = 0; i < Crypto::HASH_SHA256; i++) {
+                            if (downloadedHash[i] != hashHex[i]) {
+                                status = Core::ERROR_INCORRECT_HASH;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+
+            // Done with, one way or the other.
+            Core::File(ProgressFile(_storage)).Destroy();
+
+            _adminLock.Unlock();
+
+            Notify(status);
+        }
 
         inline bool HashStringToBytes(const std::string& hash, uint8_t (&hashHex)[Crypto::HASH_SHA256])
         {
@@ -150,10 +1111,32 @@ namespace PluginHost {
 
 
     private:
-        string _hash;
         Core::CriticalSection _adminLock;
         INotifier* _notifier;
-        Core::File _storage;
+        const string _storage;
+        int _descriptor;
+        const uint8_t _segmentCount;
+        Core::NodeId _remote;
+        string _target;
+        string _host;
+        string _locator;
+        string _hash;
+        string _validator;
+        uint64_t _size;
+        bool _resumable;
+        bool _finished;
+        bool _restart;
+        std::vector<Segment> _segments;
+        std::vector<Fetcher*> _fetchers;
+        Crypto::SHA256 _hasher;
+        uint64_t _hashed;
+        uint64_t _received;
+        uint64_t _persisted;
+        uint64_t _reported;
+        uint64_t _reportedReceived;
+        Core::ProxyType<Completion> _completion;
+        Core::ProxyType<CatchUp> _catchUp;
+        Core::CriticalSection _notifyLock; // guards _notifier, taken without the admin lock
     };
 }
 }
@@ -40,6 +40,7 @@ namespace Plugin {
         if (config.WaitTime.IsSet() == true) {
             _waitTime = config.WaitTime.Value();
         }
+        _segments = std::max(config.Segments.Value(), static_cast<uint8_t>(1));
 
         string message;
         uint32_t status = ConvertMfrStatusToCore(mfrFWUpgradeInit());
@@ -63,8 +64,16 @@ namespace Plugin {
 
     /* virtual */ string FirmwareControl::Information() const
     {
-        // No additional info to report.
-        return (string());
+        string information;
+
+        _adminLock.Lock();
+        if (_upgradeStatus == UpgradeStatus::DOWNLOAD_STARTED) {
+            information = _T("Downloaded ") + Core::NumberType<uint64_t>(_downloaded).Text() + _T(" of ") + Core::NumberType<uint64_t>(_total).Text()
+                + _T(" bytes at ") + Core::NumberType<uint32_t>(_rate).Text() + _T(" bytes/s, ") + Core::NumberType<uint32_t>(_eta).Text() + _T(" s to go");
+        }
+        _adminLock.Unlock();
+
+        return (information);
     }
 
     uint32_t FirmwareControl::Schedule(const std::string& name, const std::string& path, const FirmwareControl::Type& type, const uint16_t& interval, const std::string& hash)
@@ -126,7 +135,14 @@ namespace Plugin {
         TRACE(Trace::Information, (string(__FUNCTION__)));
         Notifier notifier(this);
 
-        PluginHost::DownloadEngine downloadEngine(&notifier, _destination + Name);
+        PluginHost::DownloadEngine downloadEngine(&notifier, _destination + Name, _segments);
+
+        _adminLock.Lock();
+        _downloaded = 0;
+        _total = 0;
+        _rate = 0;
+        _eta = 0;
+        _adminLock.Unlock();
 
         uint32_t status = downloadEngine.Start(_source, _destination, _hash);
         if ((status == Core::ERROR_NONE) || (status == Core::ERROR_INPROGRESS)) {
@@ -137,6 +153,13 @@ namespace Plugin {
                  Status(UpgradeStatus::DOWNLOAD_COMPLETED, ErrorType::ERROR_NONE, 0);
             } else {
                 status = ((status != Core::ERROR_NONE)? status: DownloadStatus());
+                if ((Status() == UpgradeStatus::UPGRADE_CANCELLED) || (status == Core::ERROR_INCORRECT_HASH)) {
+                    // Not to be continued, nothing of it is kept.
+                    downloadEngine.Abort();
+                } else {
+                    // Timed out, or the server or the network failed, the next upgrade resumes from here.
+                    downloadEngine.Suspend();
+                }
                 Status(UpgradeStatus::DOWNLOAD_ABORTED, status, 0);
             }
         } else {
@@ -80,10 +80,12 @@ namespace Plugin {
                 , Source()
                 , Download()
                 , WaitTime()
+                , Segments(1)
             {
                 Add(_T("source"), &Source);
                 Add(_T("download"), &Download);
                 Add(_T("waittime"), &WaitTime);
+                Add(_T("segments"), &Segments);
             }
 
             ~Config() {}
@@ -92,6 +94,7 @@ namespace Plugin {
             Core::JSON::String Source;
             Core::JSON::String Download;
             Core::JSON::DecSInt32 WaitTime;
+            Core::JSON::DecUInt8 Segments; // parallel connections a download is split up over
         };
 
         class Notifier : public INotifier {
@@ -113,6 +116,10 @@ namespace Plugin {
             {
                 _parent.NotifyDownloadStatus(status);
             }
+            virtual void NotifyDownloadProgress(const uint64_t downloaded, const uint64_t total, const uint32_t rate, const uint32_t eta) override
+            {
+                _parent.NotifyDownloadProgress(downloaded, total, rate, eta);
+            }
 
         private:
             FirmwareControl& _parent;
@@ -160,6 +167,11 @@ namespace Plugin {
             , _hash()
             , _interval(0)
             , _waitTime(WaitTime)
+            , _segments(1)
+            , _downloaded(0)
+            , _total(0)
+            , _rate(0)
+            , _eta(0)
             , _downloadStatus(Core::ERROR_NONE)
             , _upgradeStatus(UpgradeStatus::NONE)
             , _installStatus()
@@ -202,6 +214,19 @@ namespace Plugin {
             _signal.SetEvent();
         }
 
+        inline void NotifyDownloadProgress(const uint64_t downloaded, const uint64_t total, const uint32_t rate, const uint32_t eta)
+        {
+            _adminLock.Lock();
+            _downloaded = downloaded;
+            _total = total;
+            _rate = rate;
+            _eta = eta;
+            _adminLock.Unlock();
+
+            const bool known = ((total != 0) && (total != static_cast<uint64_t>(~0)));
+            NotifyProgress(DOWNLOAD_STARTED, ErrorType::ERROR_NONE, static_cast<uint16_t>(known == true ? (downloaded * 100) / total : 0));
+        }
+
         static void Callback(mfrUpgradeStatus_t mfrStatus, void *cbData)
         {
             FirmwareControl* control = static_cast<FirmwareControl*>(cbData);
@@ -234,7 +259,10 @@ namespace Plugin {
                 event_upgradeprogress(static_cast<JsonData::FirmwareControl::StatusType>(upgradeStatus),
                                       static_cast<JsonData::FirmwareControl::UpgradeprogressParamsData::ErrorType>(errorType), percentage);
                 ResetStatus();
-                RemoveDownloadedFile();
+                // An aborted download leaves to the engine what is kept, to be resumed.
+                if (upgradeStatus != DOWNLOAD_ABORTED) {
+                    RemoveDownloadedFile();
+                }
             } else if (_interval) { // Send intermediate staus/progress of upgrade
                 event_upgradeprogress(static_cast<JsonData::FirmwareControl::StatusType>(upgradeStatus),
                                       static_cast<JsonData::FirmwareControl::UpgradeprogressParamsData::ErrorType>(errorType), percentage);
@@ -269,6 +297,10 @@ namespace Plugin {
             if (_storage.Exists()) {
                 _storage.Destroy();
             }
+            Core::File _progress(PluginHost::DownloadEngine::ProgressFile(_destination + Name));
+            if (_progress.Exists()) {
+                _progress.Destroy();
+            }
         }
         inline void ResetStatus()
         {
@@ -407,6 +439,11 @@ namespace Plugin {
         uint16_t _interval;
 
         int32_t _waitTime;
+        uint8_t _segments;
+        uint64_t _downloaded;
+        uint64_t _total;
+        uint32_t _rate;
+        uint32_t _eta;
         uint32_t _downloadStatus;
         UpgradeStatus _upgradeStatus;
         mfrUpgradeStatus_t _installStatus;
@@ -0,0 +1,466 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../DownloadEngine.h"
+#include "../../helpers/UnitTest.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace WPEFramework;
+
+// Downloads from a stand-in HTTP server on the loopback, that serves one image with an ETag, honours
+// Range and If-Range, and can cut a connection halfway, to have something to resume.
+
+namespace {
+
+    const char Storage[] = "DownloadEngineTest.image";
+    const uint32_t ImageSize = 3 * 1024 * 1024;
+    const uint32_t WaitTime = 10000; // ms
+
+    class Server {
+    public:
+        Server(const Server&) = delete;
+        Server& operator=(const Server&) = delete;
+
+        Server()
+            : _lock()
+            , _image()
+            , _etag()
+            , _cut(0)
+            , _ranges()
+            , _validators()
+            , _listener(::socket(AF_INET, SOCK_STREAM, 0))
+            , _port(0)
+            , _thread()
+        {
+            sockaddr_in address = {};
+            socklen_t length = sizeof(address);
+            const int reuse = 1;
+
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+            ::setsockopt(_listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            ::bind(_listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+            ::listen(_listener, 8);
+            ::getsockname(_listener, reinterpret_cast<sockaddr*>(&address), &length);
+
+            _port = ntohs(address.sin_port);
+            _thread = std::thread([this]() { Serve(); });
+        }
+        ~Server()
+        {
+            ::shutdown(_listener, SHUT_RDWR);
+            ::close(_listener);
+            _thread.join();
+        }
+
+    public:
+        string Locator() const
+        {
+            return (_T("http://127.0.0.1:") + Core::NumberType<uint16_t>(_port).Text() + _T("/image.bin"));
+        }
+        // A new version of the image, with its own ETag.
+        void Image(const uint8_t seed, const string& etag)
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+
+            _image.resize(ImageSize);
+            for (uint32_t index = 0; index < ImageSize; index++) {
+                _image[index] = static_cast<uint8_t>((index * 7) + (index >> 11) + seed);
+            }
+            _etag = etag;
+        }
+        // The next response ends after this many bytes of body.
+        void Cut(const uint32_t bytes)
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            _cut = bytes;
+        }
+        string Hash() const
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            Crypto::SHA256 hasher;
+            string result;
+
+            for (uint32_t offset = 0; offset < _image.size(); offset += 0x8000) {
+                hasher.Input(&(_image[offset]), static_cast<uint16_t>(std::min(static_cast<size_t>(0x8000), _image.size() - offset)));
+            }
+
+            const uint8_t* hash = hasher.Result();
+            for (uint8_t index = 0; index < Crypto::HASH_SHA256; index++) {
+                char hex[3];
+                ::snprintf(hex, sizeof(hex), "%02x", hash[index]);
+                result += hex;
+            }
+
+            return (result);
+        }
+        // The Range and If-Range headers of the requests so far, an empty string if there was none.
+        std::vector<string> Ranges() const
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            return (_ranges);
+        }
+        std::vector<string> Validators() const
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            return (_validators);
+        }
+        void Clear()
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            _ranges.clear();
+            _validators.clear();
+        }
+
+    private:
+        static string Field(const string& request, const string& name)
+        {
+            const size_t start = request.find(_T("\r\n") + name + _T(": "));
+            string result;
+
+            if (start != string::npos) {
+                const size_t value = start + name.length() + 4;
+                result = request.substr(value, request.find(_T("\r\n"), value) - value);
+            }
+
+            return (result);
+        }
+        void Serve()
+        {
+            int connection;
+
+            while ((connection = ::accept(_listener, nullptr, nullptr)) != -1) {
+                string request;
+                char buffer[1024];
+                ssize_t length;
+
+                while ((request.find(_T("\r\n\r\n")) == string::npos) && ((length = ::recv(connection, buffer, sizeof(buffer), 0)) > 0)) {
+                    request.append(buffer, length);
+                }
+
+                Respond(connection, request);
+
+                ::close(connection);
+            }
+        }
+        void Respond(const int connection, const string& request)
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+
+            const string range(Field(request, _T("Range")));
+            const string validator(Field(request, _T("If-Range")));
+            uint64_t first = 0;
+            uint64_t last = _image.size() - 1;
+            bool partial = false;
+
+            _ranges.push_back(range);
+            _validators.push_back(validator);
+
+            // bytes=<first>-[<last>], only while the image is the one the validator is of.
+            if ((range.compare(0, 6, _T("bytes=")) == 0) && ((validator.empty() == true) || (validator == _etag))) {
+                const size_t dash = range.find('-');
+                first = ::strtoull(&(range[6]), nullptr, 10);
+                if ((dash + 1) < range.length()) {
+                    last = std::min(last, static_cast<uint64_t>(::strtoull(&(range[dash + 1]), nullptr, 10)));
+                }
+                partial = true;
+            }
+
+            string header(partial == true ? _T("HTTP/1.1 206 Partial Content\r\n") : _T("HTTP/1.1 200 OK\r\n"));
+            header += _T("ETag: ") + _etag + _T("\r\nContent-Length: ") + Core::NumberType<uint64_t>(last - first + 1).Text() + _T("\r\n");
+            if (partial == true) {
+                header += _T("Content-Range: bytes ") + Core::NumberType<uint64_t>(first).Text() + '-' + Core::NumberType<uint64_t>(last).Text() + '/' + Core::NumberType<uint64_t>(_image.size()).Text() + _T("\r\n");
+            }
+            header += _T("Connection: close\r\n\r\n");
+
+            uint64_t end = last + 1;
+            if (_cut != 0) {
+                end = std::min(end, first + _cut);
+                _cut = 0;
+            }
+
+            const std::vector<uint8_t> body(_image.begin() + first, _image.begin() + end);
+
+            lock.unlock();
+
+            Send(connection, reinterpret_cast<const uint8_t*>(header.c_str()), header.length());
+            Send(connection, body.data(), body.size());
+        }
+        static void Send(const int connection, const uint8_t data[], size_t length)
+        {
+            ssize_t sent = 0;
+
+            while ((length > 0) && ((sent = ::send(connection, data, length, MSG_NOSIGNAL)) > 0)) {
+                data += sent;
+                length -= sent;
+            }
+        }
+
+    private:
+        mutable std::mutex _lock;
+        std::vector<uint8_t> _image;
+        string _etag;
+        uint32_t _cut;
+        std::vector<string> _ranges;
+        std::vector<string> _validators;
+        int _listener;
+        uint16_t _port;
+        std::thread _thread;
+    };
+
+    class Notifier : public INotifier {
+    public:
+        Notifier(const Notifier&) = delete;
+        Notifier& operator=(const Notifier&) = delete;
+
+        Notifier()
+            : _lock()
+            , _signal()
+            , _status(~0)
+        {
+        }
+        ~Notifier() override = default;
+
+    public:
+        void NotifyDownloadStatus(const uint32_t status) override
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            _status = status;
+            _signal.notify_all();
+        }
+        uint32_t Wait()
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            _signal.wait_for(lock, std::chrono::milliseconds(WaitTime), [this]() { return (_status != static_cast<uint32_t>(~0)); });
+            const uint32_t result = _status;
+            _status = ~0;
+            return (result);
+        }
+
+    private:
+        std::mutex _lock;
+        std::condition_variable _signal;
+        uint32_t _status;
+    };
+
+    class Dispatcher : public Core::ThreadPool::IDispatcher {
+    public:
+        Dispatcher(const Dispatcher&) = delete;
+        Dispatcher& operator=(const Dispatcher&) = delete;
+
+        Dispatcher() = default;
+        ~Dispatcher() override = default;
+
+    private:
+        void Initialize() override
+        {
+        }
+        void Deinitialize() override
+        {
+        }
+        void Dispatch(Core::IDispatch* job) override
+        {
+            job->Dispatch();
+        }
+    };
+
+    class WorkerPool : public Core::WorkerPool {
+    public:
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        WorkerPool()
+            : Core::WorkerPool(2, Core::Thread::DefaultStackSize(), 16, &_dispatcher)
+            , _dispatcher()
+        {
+            Core::IWorkerPool::Assign(this);
+            Run();
+        }
+        ~WorkerPool()
+        {
+            Stop();
+            Core::IWorkerPool::Assign(nullptr);
+        }
+
+    private:
+        Dispatcher _dispatcher;
+    };
+
+    bool Exists(const string& name)
+    {
+        return (Core::File(name).Exists());
+    }
+
+    uint64_t Offset(const string& range)
+    {
+        return (::strtoull(&(range[6]), nullptr, 10));
+    }
+
+    // Interrupted halfway, suspended, and started again: the rest is asked for with a Range from where it
+    // was, and an If-Range with the ETag, and the image still hashes right.
+    void TestResume(Server& server)
+    {
+        Notifier notifier;
+
+        server.Image(1, _T("\"v1\""));
+        server.Clear();
+        server.Cut(ImageSize / 3);
+
+        {
+            PluginHost::DownloadEngine engine(&notifier, Storage);
+
+            CHECK(engine.Start(server.Locator(), string(), server.Hash()) == Core::ERROR_INPROGRESS);
+            CHECK(notifier.Wait() == Core::ERROR_UNAVAILABLE);
+
+            engine.Suspend();
+        }
+
+        // A transient failure keeps the image and the progress.
+        CHECK(Exists(Storage) == true);
+        CHECK(Exists(PluginHost::DownloadEngine::ProgressFile(Storage)) == true);
+
+        {
+            PluginHost::DownloadEngine engine(&notifier, Storage);
+
+            CHECK(engine.Start(server.Locator(), string(), server.Hash()) == Core::ERROR_INPROGRESS);
+            CHECK(notifier.Wait() == Core::ERROR_NONE);
+        }
+
+        const std::vector<string> ranges(server.Ranges());
+        const std::vector<string> validators(server.Validators());
+
+        CHECK(ranges.size() == 2);
+
+        if (ranges.size() == 2) {
+            CHECK(ranges[0] == _T("bytes=0-"));
+            CHECK(validators[0].empty() == true);
+            CHECK(Offset(ranges[1]) == (ImageSize / 3));
+            CHECK(ranges[1] == _T("bytes=") + Core::NumberType<uint32_t>(ImageSize / 3).Text() + _T("-") + Core::NumberType<uint32_t>(ImageSize - 1).Text());
+            CHECK(validators[1] == _T("\"v1\""));
+        }
+
+        // Completed, there is nothing left to resume.
+        CHECK(Exists(PluginHost::DownloadEngine::ProgressFile(Storage)) == false);
+        CHECK(Core::File(Storage).Size() == ImageSize);
+
+        Core::File(Storage).Destroy();
+    }
+
+    // The image changed on the server while the download was suspended: the If-Range does not match, the
+    // server sends all of it, and what was on disk is dropped. The next start is from scratch.
+    void TestChanged(Server& server)
+    {
+        Notifier notifier;
+
+        server.Image(1, _T("\"v1\""));
+        server.Clear();
+        server.Cut(ImageSize / 2);
+
+        {
+            PluginHost::DownloadEngine engine(&notifier, Storage);
+
+            CHECK(engine.Start(server.Locator(), string(), server.Hash()) == Core::ERROR_INPROGRESS);
+            CHECK(notifier.Wait() == Core::ERROR_UNAVAILABLE);
+
+            engine.Suspend();
+        }
+
+        server.Image(2, _T("\"v2\""));
+
+        {
+            PluginHost::DownloadEngine engine(&notifier, Storage);
+
+            CHECK(engine.Start(server.Locator(), string(), server.Hash()) == Core::ERROR_INPROGRESS);
+            CHECK(notifier.Wait() == Core::ERROR_UNAVAILABLE);
+        }
+
+        CHECK(Exists(Storage) == false);
+        CHECK(Exists(PluginHost::DownloadEngine::ProgressFile(Storage)) == false);
+
+        {
+            PluginHost::DownloadEngine engine(&notifier, Storage);
+
+            CHECK(engine.Start(server.Locator(), string(), server.Hash()) == Core::ERROR_INPROGRESS);
+            CHECK(notifier.Wait() == Core::ERROR_NONE);
+        }
+
+        const std::vector<string> ranges(server.Ranges());
+        const std::vector<string> validators(server.Validators());
+
+        CHECK(ranges.size() == 3);
+
+        if (ranges.size() == 3) {
+            CHECK(Offset(ranges[1]) == (ImageSize / 2));
+            CHECK(validators[1] == _T("\"v1\""));
+            CHECK(ranges[2] == _T("bytes=0-"));
+            CHECK(validators[2].empty() == true);
+        }
+
+        Core::File(Storage).Destroy();
+    }
+
+    // A wrong hash, or a cancel, aborts: nothing is kept.
+    void TestAbort(Server& server)
+    {
+        Notifier notifier;
+
+        server.Image(3, _T("\"v3\""));
+        server.Clear();
+
+        {
+            PluginHost::DownloadEngine engine(&notifier, Storage);
+            const string wrong(Crypto::HASH_SHA256 * 2, '0');
+
+            CHECK(engine.Start(server.Locator(), string(), wrong) == Core::ERROR_INPROGRESS);
+            CHECK(notifier.Wait() == Core::ERROR_INCORRECT_HASH);
+
+            engine.Abort();
+        }
+
+        CHECK(Exists(Storage) == false);
+        CHECK(Exists(PluginHost::DownloadEngine::ProgressFile(Storage)) == false);
+    }
+}
+
+int main()
+{
+    {
+        WorkerPool workerPool;
+        Server server;
+
+        Core::File(Storage).Destroy();
+        Core::File(PluginHost::DownloadEngine::ProgressFile(Storage)).Destroy();
+
+        TestResume(server);
+        TestChanged(server);
+        TestAbort(server);
+    }
+
+    Core::Singleton::Dispose();
+
+    return (UnitTest::Result());
+}
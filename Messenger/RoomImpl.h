@@ -38,17 +38,13 @@ namespace Plugin {
             , _userId(userId)
             , _roomAdmin(admin)
             , _callback(nullptr)
-            , _messageSink(messageSink)
+            , _mailbox(Core::ProxyType<RoomMaintainer::Mailbox>::Create(messageSink))
             , _adminLock()
         {
             ASSERT(admin != nullptr);
 
             _roomAdmin->AddRef();
 
-            if (_messageSink) {
-                _messageSink->AddRef();
-            }
-
             if (userId.size() == 0) {
                 TRACE(Trace::Warning, (_T("Created a user with empty userId")));
             }
@@ -63,9 +59,8 @@ namespace Plugin {
             // Release the callback if necessary.
             SetCallback(nullptr);
 
-            if (_messageSink) {
-                _messageSink->Release();
-            }
+            // Messages still pending for this user are no longer delivered.
+            _mailbox->Close();
 
             _roomAdmin->Release();
         }
@@ -135,13 +130,7 @@ namespace Plugin {
             _adminLock.Unlock();
         }
 
-        void MessageReceived(const string& userId, const string& message)
-        {
-            if (_messageSink != nullptr) {
-                _messageSink->Message(userId, message);
-            }
-        }
-
+        const Core::ProxyType<RoomMaintainer::Mailbox>& Mailbox() const { return _mailbox; }
         const string& UserId() const { return _userId; }
         const string& RoomId() const { return _roomId; }
 
@@ -155,7 +144,7 @@ namespace Plugin {
         string _userId;
         RoomMaintainer* _roomAdmin;
         Exchange::IRoomAdministrator::IRoom::ICallback* _callback;
-        Exchange::IRoomAdministrator::IRoom::IMsgNotification* _messageSink;
+        Core::ProxyType<RoomMaintainer::Mailbox> _mailbox;
         mutable Core::CriticalSection _adminLock;
     };
 
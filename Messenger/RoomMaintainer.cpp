@@ -41,7 +41,9 @@ namespace Plugin {
         if (it == _roomMap.end()) {
             // Room not found, so create one, already emplacing the first user.
             newRoomUser = Core::Service<RoomImpl>::Create<RoomImpl>(this, roomId, userId, messageSink);
-            it = _roomMap.emplace(roomId, std::list<RoomImpl*>({newRoomUser})).first;
+            it = _roomMap.emplace(roomId, Room()).first;
+            (*it).second.Users.push_back(newRoomUser);
+            Snapshot((*it).second);
 
             TRACE(Trace::Information, (_T("Room Maintainer: Room '%s' created"), roomId.c_str()));
             if (roomId.size() == 0) {
@@ -55,7 +57,7 @@ namespace Plugin {
         }
         else {
             // Room already created; try to add another user.
-            std::list<RoomImpl*>& users = (*it).second;
+            std::list<RoomImpl*>& users = (*it).second.Users;
 
             if (std::find_if(users.begin(), users.end(), [&userId](const RoomImpl* user) { return (user->UserId() == userId);}) == users.end()) {
                 newRoomUser = Core::Service<RoomImpl>::Create<RoomImpl>(this, roomId, userId, messageSink);
@@ -67,6 +69,7 @@ namespace Plugin {
                 }
 
                 users.push_back(newRoomUser);
+                Snapshot((*it).second);
             }
             else {
                 TRACE(Trace::Error, (_T("Room Maintainer: User '%s' has already joined room '%s'"),
@@ -95,7 +98,7 @@ namespace Plugin {
         ASSERT(it != _roomMap.end());
 
         if (it != _roomMap.end()) {
-            std::list<RoomImpl*>& users = (*it).second;
+            std::list<RoomImpl*>& users = (*it).second.Users;
 
             auto uit(std::find(users.begin(), users.end(), roomUser));
             ASSERT(uit != users.end());
@@ -110,6 +113,7 @@ namespace Plugin {
                 }
 
                 users.erase(uit);
+                Snapshot((*it).second);
 
                 // Was it the last user?
                 if (users.size() == 0) {
@@ -138,7 +142,7 @@ namespace Plugin {
         ASSERT(it != _roomMap.end());
 
         if (it != _roomMap.end()) {
-            for (auto& user : (*it).second) {
+            for (auto& user : (*it).second.Users) {
                 roomUser->UserJoined(user->UserId());
             }
         }
@@ -150,18 +154,39 @@ namespace Plugin {
     {
         ASSERT(roomUser != nullptr);
 
+        std::shared_ptr<const Recipients> recipients;
+
         _adminLock.Lock();
 
         auto it(_roomMap.find(roomUser->RoomId()));
         ASSERT(it != _roomMap.end());
 
         if (it != _roomMap.end()) {
-            for (RoomImpl* user : (*it).second) {
-                user->MessageReceived(roomUser->UserId(), message);
-            }
+            recipients = (*it).second.Mailboxes;
         }
 
         _adminLock.Unlock();
+
+        // Members that left in the mean time, have their mailbox closed, so they will not get it.
+        if (recipients != nullptr) {
+            for (const Core::ProxyType<Mailbox>& mailbox : *recipients) {
+                mailbox->Post(roomUser->UserId(), message);
+            }
+        }
+    }
+
+    // Needs to be called with the lock taken.
+    void RoomMaintainer::Snapshot(Room& room)
+    {
+        std::shared_ptr<Recipients> recipients(std::make_shared<Recipients>());
+
+        recipients->reserve(room.Users.size());
+
+        for (const RoomImpl* user : room.Users) {
+            recipients->push_back(user->Mailbox());
+        }
+
+        room.Mailboxes = recipients;
     }
 
     /* virtual */ void RoomMaintainer::Register(INotification* sink)
@@ -22,6 +22,9 @@
 #include "Module.h"
 #include <interfaces/IMessenger.h>
 
+#include <deque>
+#include <memory>
+
 namespace WPEFramework {
 
 namespace Plugin {
@@ -29,6 +32,156 @@ namespace Plugin {
     class RoomImpl;
 
     class RoomMaintainer : public Exchange::IRoomAdministrator {
+    public:
+        // Messages are delivered asynchronously, every member has its own mailbox, drained by a job
+        // on the worker pool. A slow (out-of-process) member only delays its own messages. If a
+        // member can not keep up, the oldest pending messages are dropped.
+        class Mailbox : public Core::IDispatch {
+        public:
+            static constexpr uint16_t MaxPending = 256;
+
+            Mailbox() = delete;
+            Mailbox(const Mailbox&) = delete;
+            Mailbox& operator=(const Mailbox&) = delete;
+
+            Mailbox(IRoom::IMsgNotification* messageSink)
+                : _adminLock()
+                , _messageSink(messageSink)
+                , _pending()
+                , _scheduled(false)
+                , _dropped(0)
+                , _dispatching(false)
+                , _dispatcher()
+            {
+                if (_messageSink != nullptr) {
+                    _messageSink->AddRef();
+                }
+            }
+            ~Mailbox() override
+            {
+                ASSERT(_messageSink == nullptr);
+            }
+
+        public:
+            void Post(const string& userId, const string& message)
+            {
+                bool schedule = false;
+
+                _adminLock.Lock();
+
+                if (_messageSink != nullptr) {
+                    if (_pending.size() >= MaxPending) {
+                        _pending.pop_front();
+                        _dropped++;
+                    }
+
+                    _pending.emplace_back(userId, message);
+
+                    schedule = (_scheduled == false);
+                    _scheduled = true;
+                }
+
+                _adminLock.Unlock();
+
+                if (schedule == true) {
+                    Core::IWorkerPool::Instance().Submit(Core::ProxyType<Core::IDispatch>(*this));
+                }
+            }
+            // Nothing is delivered anymore once the mailbox is closed.
+            void Close()
+            {
+                _adminLock.Lock();
+
+                // A member might leave while a message is delivered to it, so from within our own job.
+                // Revoking would wait for that job to complete, forever. The job stops by itself, once
+                // the sink is gone.
+                const bool revoke = ((_dispatching == false) || (_dispatcher != Core::Thread::ThreadId()));
+
+                _adminLock.Unlock();
+
+                if (revoke == true) {
+                    Core::IWorkerPool::Instance().Revoke(Core::ProxyType<Core::IDispatch>(*this));
+                }
+
+                _adminLock.Lock();
+
+                _pending.clear();
+
+                if (_messageSink != nullptr) {
+                    _messageSink->Release();
+                    _messageSink = nullptr;
+                }
+
+                _adminLock.Unlock();
+            }
+
+        private:
+            void Dispatch() override
+            {
+                std::deque<std::pair<string, string>> batch;
+                IRoom::IMsgNotification* sink = nullptr;
+                uint32_t dropped = 0;
+
+                _adminLock.Lock();
+                _dispatching = true;
+                _dispatcher = Core::Thread::ThreadId();
+                _adminLock.Unlock();
+
+                do {
+                    _adminLock.Lock();
+
+                    batch.clear();
+                    batch.swap(_pending);
+
+                    sink = (batch.empty() == false ? _messageSink : nullptr);
+                    _scheduled = (sink != nullptr);
+                    // Cleared together with _scheduled, a next job might be started right after this.
+                    _dispatching = _scheduled;
+
+                    if (sink != nullptr) {
+                        sink->AddRef();
+                    }
+
+                    dropped = _dropped;
+                    _dropped = 0;
+
+                    _adminLock.Unlock();
+
+                    if (dropped != 0) {
+                        TRACE(Trace::Warning, (_T("Room Maintainer: Dropped %d messages for a member that can not keep up"), dropped));
+                    }
+
+                    if (sink != nullptr) {
+                        // Everything that queued up while the previous batch was delivered, goes out in one go.
+                        for (const std::pair<string, string>& message : batch) {
+                            sink->Message(message.first, message.second);
+                        }
+
+                        sink->Release();
+                    }
+
+                } while (sink != nullptr);
+            }
+
+        private:
+            Core::CriticalSection _adminLock;
+            IRoom::IMsgNotification* _messageSink;
+            std::deque<std::pair<string, string>> _pending;
+            bool _scheduled;
+            uint32_t _dropped;
+            bool _dispatching;
+            ::ThreadId _dispatcher;
+        };
+
+    private:
+        typedef std::vector<Core::ProxyType<Mailbox>> Recipients;
+
+        struct Room {
+            std::list<RoomImpl*> Users;
+            // Copy on write, replaced on every join and exit, so messages are sent without holding the lock.
+            std::shared_ptr<const Recipients> Mailboxes;
+        };
+
     public:
         RoomMaintainer(const RoomMaintainer&) = delete;
         RoomMaintainer& operator=(const RoomMaintainer&) = delete;
@@ -54,9 +207,12 @@ namespace Plugin {
             INTERFACE_ENTRY(Exchange::IRoomAdministrator)
         END_INTERFACE_MAP
 
+    private:
+        void Snapshot(Room& room);
+
     private:
         std::list<INotification*> _observers;
-        std::map<string, std::list<RoomImpl*>> _roomMap;
+        std::map<string, Room> _roomMap;
         mutable Core::CriticalSection _adminLock;
     };
 
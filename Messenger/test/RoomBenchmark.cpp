@@ -0,0 +1,242 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../Module.h"
+#include "../RoomMaintainer.h"
+#include "../../helpers/UnitTest.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+// Messages per second, delivered to every member of rooms of 10 up to 1000 members. The messages go out
+// in bursts that stay below what a mailbox holds, so none are dropped and all of them can be counted.
+
+namespace {
+
+    const uint16_t Members[] = { 10, 100, 1000 };
+    const uint32_t Messages = 2000;
+    const uint16_t Burst = 100;
+    const uint32_t WaitTime = 10000; // ms
+
+    class Dispatcher : public Core::ThreadPool::IDispatcher {
+    public:
+        Dispatcher(const Dispatcher&) = delete;
+        Dispatcher& operator=(const Dispatcher&) = delete;
+
+        Dispatcher() = default;
+        ~Dispatcher() override = default;
+
+    private:
+        void Initialize() override
+        {
+        }
+        void Deinitialize() override
+        {
+        }
+        void Dispatch(Core::IDispatch* job) override
+        {
+            job->Dispatch();
+        }
+    };
+
+    class WorkerPool : public Core::WorkerPool {
+    public:
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        WorkerPool()
+            : Core::WorkerPool(4, Core::Thread::DefaultStackSize(), 64, &_dispatcher)
+            , _dispatcher()
+        {
+            Core::IWorkerPool::Assign(this);
+            Run();
+        }
+        ~WorkerPool()
+        {
+            Stop();
+            Core::IWorkerPool::Assign(nullptr);
+        }
+
+    private:
+        Dispatcher _dispatcher;
+    };
+
+    // Counts what all members of a room received.
+    class Delivery {
+    public:
+        Delivery(const Delivery&) = delete;
+        Delivery& operator=(const Delivery&) = delete;
+
+        Delivery()
+            : _lock()
+            , _signal()
+            , _count(0)
+        {
+        }
+
+    public:
+        void Received()
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            _count++;
+            _signal.notify_all();
+        }
+        bool Wait(const uint64_t count)
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            return (_signal.wait_for(lock, std::chrono::milliseconds(WaitTime), [this, count]() { return (_count >= count); }));
+        }
+        uint64_t Count() const
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            return (_count);
+        }
+
+    private:
+        mutable std::mutex _lock;
+        std::condition_variable _signal;
+        uint64_t _count;
+    };
+
+    // Stands in for the notification sink of a member, as the Messenger plugin or a client hands it in.
+    class Sink : public Exchange::IRoomAdministrator::IRoom::IMsgNotification {
+    public:
+        Sink(const Sink&) = delete;
+        Sink& operator=(const Sink&) = delete;
+
+        Sink(Delivery& delivery, const uint32_t delay)
+            : _delivery(delivery)
+            , _delay(delay)
+        {
+        }
+
+    public:
+        void Message(const string&, const string&) override
+        {
+            if (_delay != 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(_delay));
+            }
+            _delivery.Received();
+        }
+
+        BEGIN_INTERFACE_MAP(Sink)
+            INTERFACE_ENTRY(Exchange::IRoomAdministrator::IRoom::IMsgNotification)
+        END_INTERFACE_MAP
+
+    private:
+        Delivery& _delivery;
+        const uint32_t _delay;
+    };
+
+    std::vector<Exchange::IRoomAdministrator::IRoom*> Join(Exchange::IRoomAdministrator* admin, const TCHAR prefix[], const uint16_t members, Delivery& delivery, const uint32_t delay = 0)
+    {
+        std::vector<Exchange::IRoomAdministrator::IRoom*> result;
+
+        for (uint16_t index = 0; index < members; index++) {
+            Sink* sink = Core::Service<Sink>::Create<Sink>(delivery, delay);
+
+            result.push_back(admin->Join(_T("room"), prefix + Core::NumberType<uint16_t>(index).Text(), sink));
+
+            sink->Release();
+        }
+
+        return (result);
+    }
+
+    void Leave(std::vector<Exchange::IRoomAdministrator::IRoom*>& rooms)
+    {
+        for (Exchange::IRoomAdministrator::IRoom* room : rooms) {
+            room->Release();
+        }
+        rooms.clear();
+    }
+
+    void Benchmark(Exchange::IRoomAdministrator* admin, const uint16_t members)
+    {
+        Delivery delivery;
+        std::vector<Exchange::IRoomAdministrator::IRoom*> rooms(Join(admin, _T("user"), members, delivery));
+        bool delivered = true;
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (uint32_t sent = 0; (sent < Messages) && (delivered == true); sent += Burst) {
+            for (uint16_t index = 0; index < Burst; index++) {
+                rooms[index % members]->SendMessage(_T("Hello, room"));
+            }
+
+            delivered = delivery.Wait(static_cast<uint64_t>(sent + Burst) * members);
+        }
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        CHECK(delivered == true);
+        CHECK(delivery.Count() == (static_cast<uint64_t>(Messages) * members));
+
+        printf("%4u members: %8.0f messages/s, %10.0f deliveries/s\n", members, Messages / seconds, (static_cast<double>(Messages) * members) / seconds);
+
+        Leave(rooms);
+    }
+
+    // A member that takes its time, only delays its own messages.
+    void TestSlowMember(Exchange::IRoomAdministrator* admin)
+    {
+        Delivery fast;
+        Delivery slow;
+        std::vector<Exchange::IRoomAdministrator::IRoom*> rooms(Join(admin, _T("fast"), 20, fast));
+        std::vector<Exchange::IRoomAdministrator::IRoom*> lagging(Join(admin, _T("slow"), 1, slow, 20 * 1000));
+
+        for (uint16_t index = 0; index < 10; index++) {
+            rooms[index]->SendMessage(_T("Hello, room"));
+        }
+
+        // The others have it all long before the slow one got through a few.
+        CHECK(fast.Wait(10 * 20) == true);
+        CHECK(slow.Count() < 10);
+
+        CHECK(slow.Wait(10) == true);
+
+        Leave(lagging);
+        Leave(rooms);
+    }
+}
+
+int main()
+{
+    {
+        WorkerPool workerPool;
+        Exchange::IRoomAdministrator* admin = Core::Service<RoomMaintainer>::Create<Exchange::IRoomAdministrator>();
+
+        TestSlowMember(admin);
+
+        for (const uint16_t members : Members) {
+            Benchmark(admin, members);
+        }
+
+        admin->Release();
+    }
+
+    Core::Singleton::Dispose();
+
+    return (UnitTest::Result());
+}
@@ -0,0 +1,228 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ADDRESSPROBE__H
+#define ADDRESSPROBE__H
+
+#include "Module.h"
+
+#ifdef __LINUX__
+#include <net/ethernet.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <netpacket/packet.h>
+#include <poll.h>
+#endif
+
+namespace WPEFramework {
+
+namespace Plugin {
+
+    // Checks that no other host uses an address before it is taken, by probing for it with ARP (RFC 5227).
+    // The probe runs on its own thread, next to the DHCP exchange, so it hardly adds to the time it takes
+    // to get an address.
+    class AddressProbe : public Core::Thread {
+    public:
+        typedef std::function<void(const Core::NodeId&, const bool)> Callback;
+
+    private:
+        AddressProbe() = delete;
+        AddressProbe(const AddressProbe&) = delete;
+        AddressProbe& operator=(const AddressProbe&) = delete;
+
+        // Far shorter than RFC 5227 asks for, but this has to fit in a reconnect.
+        static constexpr uint8_t Probes = 3;
+        static constexpr uint32_t ProbeInterval = 100; // ms
+        static constexpr uint32_t ProbeWait = 200; // ms, after the last probe
+
+#pragma pack(push, 1)
+        struct Packet {
+            uint16_t hardwareType;
+            uint16_t protocolType;
+            uint8_t hardwareLength;
+            uint8_t protocolLength;
+            uint16_t operation;
+            uint8_t senderMAC[6];
+            uint8_t senderIP[4];
+            uint8_t targetMAC[6];
+            uint8_t targetIP[4];
+        };
+#pragma pack(pop)
+
+    public:
+        AddressProbe(const string& interfaceName, Callback callback)
+            : Core::Thread(Core::Thread::DefaultStackSize(), _T("AddressProbe"))
+            , _adminLock()
+            , _interfaceName(interfaceName)
+            , _callback(callback)
+            , _address()
+            , _generation(0)
+        {
+            Core::AdapterIterator adapter(_interfaceName);
+
+            ::memset(_MAC, 0, sizeof(_MAC));
+
+            if (adapter.IsValid() == true) {
+                adapter.MACAddress(_MAC, sizeof(_MAC));
+            } else {
+                TRACE_L1("Could not read mac address of %s\n", _interfaceName.c_str());
+            }
+        }
+        ~AddressProbe()
+        {
+            Abort();
+            Wait(Core::Thread::BLOCKED | Core::Thread::STOPPED, Core::infinite);
+        }
+
+    public:
+        // Reports through the callback, unless another probe is started or it is aborted first.
+        void Probe(const Core::NodeId& address)
+        {
+            _adminLock.Lock();
+            _address = address;
+            _generation++;
+            Run();
+            _adminLock.Unlock();
+        }
+        void Abort()
+        {
+            _adminLock.Lock();
+            _generation++;
+            Block();
+            _adminLock.Unlock();
+        }
+
+    private:
+        uint32_t Worker() override
+        {
+            _adminLock.Lock();
+            const Core::NodeId address(_address);
+            const uint32_t generation = _generation;
+            _adminLock.Unlock();
+
+            const bool conflict = Conflict(address);
+
+            _adminLock.Lock();
+            const bool current = (generation == _generation);
+            if (current == true) {
+                Block();
+            }
+            _adminLock.Unlock();
+
+            if (current == true) {
+                _callback(address, conflict);
+            }
+
+            return (current == true ? Core::infinite : 0);
+        }
+
+        // Anyone that answers for the address, uses it or probes for it at the same time, is a conflict.
+        bool Conflict(const Core::NodeId& address) const
+        {
+            bool conflict = false;
+
+#ifdef __LINUX__
+            const unsigned int index = ::if_nametoindex(_interfaceName.c_str());
+            const int descriptor = (((index != 0) && (address.Type() == Core::NodeId::TYPE_IPV4)) ? ::socket(AF_PACKET, SOCK_DGRAM | SOCK_CLOEXEC, htons(ETH_P_ARP)) : -1);
+
+            if (descriptor == -1) {
+                TRACE_L1("Could not probe for %s on %s, error: %d", address.HostAddress().c_str(), _interfaceName.c_str(), errno);
+            } else {
+                struct sockaddr_ll link;
+
+                ::memset(&link, 0, sizeof(link));
+                link.sll_family = AF_PACKET;
+                link.sll_protocol = htons(ETH_P_ARP);
+                link.sll_ifindex = index;
+
+                if (::bind(descriptor, reinterpret_cast<const struct sockaddr*>(&link), sizeof(link)) != 0) {
+                    TRACE_L1("Could not bind the probe for %s on %s, error: %d", address.HostAddress().c_str(), _interfaceName.c_str(), errno);
+                } else {
+                    const uint8_t* target = reinterpret_cast<const uint8_t*>(&(reinterpret_cast<const sockaddr_in*>(static_cast<const struct sockaddr*>(address))->sin_addr));
+                    struct sockaddr_ll broadcast(link);
+                    Packet probe;
+
+                    broadcast.sll_halen = ETH_ALEN;
+                    ::memset(broadcast.sll_addr, 0xFF, ETH_ALEN);
+
+                    // The sender address is left zero, the probe should not pollute the ARP caches of others.
+                    ::memset(&probe, 0, sizeof(probe));
+                    probe.hardwareType = htons(ARPHRD_ETHER);
+                    probe.protocolType = htons(ETHERTYPE_IP);
+                    probe.hardwareLength = sizeof(probe.senderMAC);
+                    probe.protocolLength = sizeof(probe.senderIP);
+                    probe.operation = htons(ARPOP_REQUEST);
+                    ::memcpy(probe.senderMAC, _MAC, sizeof(probe.senderMAC));
+                    ::memcpy(probe.targetIP, target, sizeof(probe.targetIP));
+
+                    uint64_t now = Core::Time::Now().Ticks() / 1000;
+                    const uint64_t end = now + ((Probes - 1) * ProbeInterval) + ProbeWait;
+                    uint64_t next = now;
+                    uint8_t sent = 0;
+
+                    while ((conflict == false) && (now < end)) {
+                        if ((sent < Probes) && (now >= next)) {
+                            if (::sendto(descriptor, &probe, sizeof(probe), 0, reinterpret_cast<const struct sockaddr*>(&broadcast), sizeof(broadcast)) != sizeof(probe)) {
+                                TRACE_L1("Could not send a probe for %s, error: %d", address.HostAddress().c_str(), errno);
+                            }
+                            sent++;
+                            next += ProbeInterval;
+                        }
+
+                        struct pollfd slot = { descriptor, POLLIN, 0 };
+                        const uint64_t wake = (sent < Probes ? next : end);
+
+                        if ((wake > now) && (::poll(&slot, 1, static_cast<int>(wake - now)) > 0)) {
+                            Packet reply;
+
+                            if ((::recv(descriptor, &reply, sizeof(reply), 0) == sizeof(reply)) && (reply.protocolType == htons(ETHERTYPE_IP)) && (::memcmp(reply.senderMAC, _MAC, sizeof(_MAC)) != 0)) {
+                                static const uint8_t unspecified[4] = { 0, 0, 0, 0 };
+
+                                conflict = ((::memcmp(reply.senderIP, target, sizeof(reply.senderIP)) == 0)
+                                    || ((reply.operation == htons(ARPOP_REQUEST)) && (::memcmp(reply.targetIP, target, sizeof(reply.targetIP)) == 0) && (::memcmp(reply.senderIP, unspecified, sizeof(unspecified)) == 0)));
+                            }
+                        }
+
+                        now = Core::Time::Now().Ticks() / 1000;
+                    }
+
+                    if (conflict == true) {
+                        TRACE(Trace::Information, (_T("Address %s is in use on %s"), address.HostAddress().c_str(), _interfaceName.c_str()));
+                    }
+                }
+
+                ::close(descriptor);
+            }
+#endif
+
+            return (conflict);
+        }
+
+    private:
+        Core::CriticalSection _adminLock;
+        const string _interfaceName;
+        Callback _callback;
+        uint8_t _MAC[6];
+        Core::NodeId _address;
+        uint32_t _generation;
+    };
+}
+} // namespace WPEFramework::Plugin
+
+#endif // ADDRESSPROBE__H
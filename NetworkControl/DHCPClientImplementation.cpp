@@ -25,25 +25,34 @@ namespace Plugin {
 
     /* static */ constexpr uint8_t DHCPClientImplementation::MagicCookie[];
 
-    static Core::NodeId RemoteAddress()
+    static Core::NodeId RemoteAddress(const Core::NodeId& server)
     {
-        struct sockaddr_in sockaddr_broadcast;
+        Core::NodeId result(server);
 
-        /* send the DHCPDISCOVER packet to broadcast address */
-        sockaddr_broadcast.sin_family = AF_INET;
-        sockaddr_broadcast.sin_port = htons(DHCPClientImplementation::DefaultDHCPServerPort);
-        sockaddr_broadcast.sin_addr.s_addr = INADDR_BROADCAST;
+        if (result.IsValid() == false) {
+            struct sockaddr_in sockaddr_broadcast;
 
-        return (Core::NodeId(sockaddr_broadcast));
+            /* send the DHCPDISCOVER packet to broadcast address */
+            sockaddr_broadcast.sin_family = AF_INET;
+            sockaddr_broadcast.sin_port = htons(DHCPClientImplementation::DefaultDHCPServerPort);
+            sockaddr_broadcast.sin_addr.s_addr = INADDR_BROADCAST;
+
+            result = Core::NodeId(sockaddr_broadcast);
+        }
+
+        return (result);
     }
 
-    DHCPClientImplementation::DHCPClientImplementation(const string& interfaceName, DiscoverCallback discoverCallback, RequestCallback claimCallback)
-        : Core::SocketDatagram(false, Core::NodeId(_T("0.0.0.0"), DefaultDHCPClientPort, Core::NodeId::TYPE_IPV4), RemoteAddress(), 1024, 2048)
+    DHCPClientImplementation::DHCPClientImplementation(const string& interfaceName, DiscoverCallback discoverCallback, RequestCallback claimCallback, const uint16_t clientPort, const Core::NodeId& server)
+        : Core::SocketDatagram(false, Core::NodeId(_T("0.0.0.0"), clientPort, Core::NodeId::TYPE_IPV4), RemoteAddress(server), 1024, 2048)
         , _adminLock()
         , _interfaceName(interfaceName)
         , _state(IDLE)
+        , _modus(CLASSIFICATION_INVALID)
+        , _rebooting(false)
         , _serverIdentifier(0)
         , _xid(0)
+        , _discoverXID(0)
         , _preferred()
         , _discoverCallback(discoverCallback)
         , _claimCallback(claimCallback)
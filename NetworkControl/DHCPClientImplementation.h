@@ -76,6 +76,7 @@ namespace Plugin {
             OPTION_RENEWALTIME = 58,
             OPTION_REBINDINGTIME = 59,
             OPTION_CLIENTIDENTIFIER = 61,
+            OPTION_RAPIDCOMMIT = 80, // RFC 4039
             OPTION_END = 255,
         };
 
@@ -173,6 +174,7 @@ namespace Plugin {
                 , leaseTime()
                 , renewalTime()
                 , rebindingTime()
+                , rapidCommit(false)
             {
             }
 
@@ -185,6 +187,7 @@ namespace Plugin {
                 , leaseTime()
                 , renewalTime()
                 , rebindingTime()
+                , rapidCommit(false)
             {
                 FromRAW(optionsData, length);    
             }
@@ -263,6 +266,9 @@ namespace Plugin {
                         ::memcpy(&rebindingTime, &optionsData[used], sizeof(rebindingTime));
                         rebindingTime = ntohl(rebindingTime);
                         break;
+                    case OPTION_RAPIDCOMMIT:
+                        rapidCommit = true;
+                        break;
                     }
 
                     /* move on to the next option. */
@@ -280,6 +286,7 @@ namespace Plugin {
             Core::OptionalType<uint32_t> leaseTime; /* lease time in seconds */
             Core::OptionalType<uint32_t> renewalTime; /* renewal time in seconds */
             Core::OptionalType<uint32_t> rebindingTime; /* rebinding time in seconds */
+            bool rapidCommit; /* an ACK committed without an offer and request (RFC 4039) */
         };
 
         class Offer {
@@ -300,6 +307,7 @@ namespace Plugin {
                     , leaseTime()
                     , renewalTime()
                     , rebindingTime()
+                    , expires()
                 {
                     Add("source", &source);
                     Add("offer", &offer);
@@ -310,6 +318,7 @@ namespace Plugin {
                     Add("leaseTime", &leaseTime);
                     Add("renewalTime", &renewalTime);
                     Add("rebindingTime", &rebindingTime);
+                    Add("expires", &expires);
                 }
 
                 JSON(Offer& object) 
@@ -323,6 +332,7 @@ namespace Plugin {
                     Add("leaseTime", &leaseTime);
                     Add("renewalTime", &renewalTime);
                     Add("rebindingTime", &rebindingTime);
+                    Add("expires", &expires);
 
                     Set(object);
                 }
@@ -337,6 +347,7 @@ namespace Plugin {
                     , leaseTime(copy.leaseTime)
                     , renewalTime(copy.renewalTime)
                     , rebindingTime(copy.rebindingTime)
+                    , expires(copy.expires)
                 {
                     Add("source", &source);
                     Add("offer", &offer);
@@ -347,6 +358,7 @@ namespace Plugin {
                     Add("leaseTime", &leaseTime);
                     Add("renewalTime", &renewalTime);
                     Add("rebindingTime", &rebindingTime);
+                    Add("expires", &expires);
                 }
 
                 void Set(Offer& object) {
@@ -386,6 +398,14 @@ namespace Plugin {
 
                     return result;
                 }
+
+                // Seconds since the epoch the lease expires, 0 if unknown.
+                uint64_t Expires() const {
+                    return (expires.Value());
+                }
+                void Expires(const uint64_t value) {
+                    expires = value;
+                }
             private:
                 Core::JSON::String source;
                 Core::JSON::String offer;
@@ -398,6 +418,7 @@ namespace Plugin {
                 Core::JSON::DecUInt32 leaseTime;
                 Core::JSON::DecUInt32 renewalTime;
                 Core::JSON::DecUInt32 rebindingTime;
+                Core::JSON::DecUInt64 expires;
             };
         public:
             Offer()
@@ -579,7 +600,8 @@ namespace Plugin {
         typedef std::function<void(Offer&, bool)> RequestCallback;
 
     public:
-        DHCPClientImplementation(const string& interfaceName, DiscoverCallback discoverCallback, RequestCallback claimCallback);
+        // Without a server, the messages are broadcast to the DHCP server port.
+        DHCPClientImplementation(const string& interfaceName, DiscoverCallback discoverCallback, RequestCallback claimCallback, const uint16_t clientPort = DefaultDHCPClientPort, const Core::NodeId& server = Core::NodeId());
         virtual ~DHCPClientImplementation();
 
     public:
@@ -623,6 +645,7 @@ namespace Plugin {
                     Crypto::Random(_discoverXID);
                     _state = SENDING;
                     _modus = CLASSIFICATION_DISCOVER;
+                    _rebooting = false;
                     _preferred = preferredAddres;
                     _xid = _discoverXID;
                     result = Core::ERROR_NONE;
@@ -655,6 +678,7 @@ namespace Plugin {
                     TRACE(Trace::Information, ("Sending REQUEST for %s", offer.Address().HostAddress().c_str()));
                     _state = SENDING;
                     _modus = CLASSIFICATION_REQUEST;
+                    _rebooting = false;
                     _preferred = offer.Address();
                     // Use offer id as transaction id to pair request with correct response
                     _xid = offer.Id(); 
@@ -677,7 +701,44 @@ namespace Plugin {
             return (result);
         }
 
-        inline uint32_t Decline(const Core::NodeId& acknowledged)
+        /* Reclaim the address of an earlier lease, from the INIT-REBOOT state (RFC 2131 section 4.3.2). */
+        uint32_t Reboot(const Offer& lease)
+        {
+            uint32_t result = Core::ERROR_INPROGRESS;
+
+            _adminLock.Lock();
+            if (_state == RECEIVING || _state == IDLE) {
+                result = Core::ERROR_OPENING_FAILED;
+
+                if (SocketDatagram::IsOpen() == true
+                    || SocketDatagram::Open(Core::infinite, _interfaceName) == Core::ERROR_NONE) {
+
+                    SocketDatagram::Broadcast(true);
+
+                    // The answer is paired with the lease, as with any requested offer.
+                    _unleasedOffers.remove_if([lease] (Offer& o) {return o.Id() == lease.Id();});
+                    _unleasedOffers.push_back(lease);
+
+                    TRACE(Trace::Information, ("Sending INIT-REBOOT REQUEST for %s", lease.Address().HostAddress().c_str()));
+                    _state = SENDING;
+                    _modus = CLASSIFICATION_REQUEST;
+                    _rebooting = true;
+                    _preferred = lease.Address();
+                    _xid = lease.Id();
+                    result = Core::ERROR_NONE;
+
+                    SocketDatagram::Trigger();
+                } else {
+                    TRACE_L1("Failed to open socket whilte trying to reboot ip %s\n", lease.Address().HostAddress().c_str());
+                }
+            }
+            _adminLock.Unlock();
+
+            return (result);
+        }
+
+        /* Tell the server the acknowledged address is in use by another host (RFC 2131 section 4.4.1). */
+        inline uint32_t Decline(const Offer& acknowledged)
         {
 
             uint32_t result = Core::ERROR_INPROGRESS;
@@ -685,11 +746,21 @@ namespace Plugin {
             _adminLock.Lock();
 
             if (_state == RECEIVING) {
+                TRACE(Trace::Information, ("Sending DECLINE for %s", acknowledged.Address().HostAddress().c_str()));
                 _state = SENDING;
-                _modus = CLASSIFICATION_NAK;
+                _modus = CLASSIFICATION_DECLINE;
+                _rebooting = false;
                 Crypto::Random(_xid);
-                _preferred = acknowledged;
+                _preferred = acknowledged.Address();
+
+                if (acknowledged.Source().IsEmpty() == false) {
+                    auto addr = reinterpret_cast<const sockaddr_in*>(static_cast<const struct sockaddr*>(acknowledged.Source()));
+
+                    memcpy(&_serverIdentifier, &(addr->sin_addr), 4);
+                }
+
                 result = Core::ERROR_NONE;
+                SocketDatagram::Trigger();
             }
 
             _adminLock.Unlock();
@@ -854,16 +925,22 @@ namespace Plugin {
             ::memcpy(&(options[index]), _MAC, frame.hlen);
             index += frame.hlen;
 
-            /* Ask for extended informations in offer */
-            if (_modus == CLASSIFICATION_DISCOVER) {
+            /* Ask for extended informations in offer, and in the ACK, as an INIT-REBOOT has seen no offer */
+            if ((_modus == CLASSIFICATION_DISCOVER) || (_modus == CLASSIFICATION_REQUEST)) {
                 options[index++] = OPTION_REQUESTLIST;
                 options[index++] = 4;
                 options[index++] = OPTION_SUBNETMASK;
                 options[index++] = OPTION_ROUTER;
                 options[index++] = OPTION_DNS;
                 options[index++] = OPTION_BROADCASTADDRESS;
-            } else if (_modus == CLASSIFICATION_REQUEST) {
-                // required for usage in bridged networks
+            }
+
+            if (_modus == CLASSIFICATION_DISCOVER) {
+                /* Take an ACK straight away, if the server supports it */
+                options[index++] = OPTION_RAPIDCOMMIT;
+                options[index++] = 0;
+            } else if (((_modus == CLASSIFICATION_REQUEST) && (_rebooting == false)) || (_modus == CLASSIFICATION_DECLINE)) {
+                // required for usage in bridged networks, and not allowed in an INIT-REBOOT request
                 if (_serverIdentifier != 0) {
                     options[index++] = OPTION_SERVERIDENTIFIER;
                     options[index++] = sizeof(_serverIdentifier);
@@ -911,7 +988,12 @@ namespace Plugin {
                         {
                             Iterator offer = FindUnleasedOffer(xid);
                                         
-                            if (offer.IsValid()) {
+                            if ((xid == _discoverXID) && (_modus == CLASSIFICATION_DISCOVER) && (options.rapidCommit == true)) {
+                                // There was no offer to request, the server committed the address to us right away.
+                                TRACE(Trace::Information, ("Received a Rapid Commit ACK from: %s", source.HostAddress().c_str()));
+                                Offer& leased = MakeLeased(Offer(source, frame, options));
+                                _claimCallback(leased, true);
+                            } else if (offer.IsValid()) {
                                 offer.Current().Update(options); // Update if informations changed since offering
                                 
                                 Offer& leased = MakeLeased(offer.Current());
@@ -944,6 +1026,7 @@ namespace Plugin {
         string _interfaceName;
         state _state;
         classifications _modus;
+        bool _rebooting;
         uint8_t _MAC[6];
         mutable uint32_t _serverIdentifier;
         mutable uint32_t _xid;
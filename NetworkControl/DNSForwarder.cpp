@@ -0,0 +1,545 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DNSForwarder.h"
+#include "DNSMessage.h"
+
+#include <algorithm>
+
+namespace WPEFramework {
+
+namespace Plugin {
+
+#ifdef __WINDOWS__
+#pragma warning(disable : 4355)
+#endif
+    DNSForwarder::DNSForwarder(const Config& config)
+        : _adminLock()
+        , _address(config.Listen.Value().c_str(), config.Port.Value(), Core::NodeId::TYPE_IPV4)
+        , _capacity(std::max(config.Entries.Value(), static_cast<uint16_t>(1)))
+        , _maxTTL(config.MaxTTL.Value())
+        , _prefetch(config.Prefetch.Value())
+        , _servers()
+        , _cache()
+        , _lru()
+        , _pending()
+        , _transactions()
+        , _listener(*this, _address)
+        , _upstream()
+        , _activity(Core::ProxyType<Activity>::Create(this))
+        , _scheduled(false)
+        , _queries(0)
+        , _hits(0)
+        , _misses(0)
+        , _coalesced(0)
+        , _prefetches(0)
+        , _failures(0)
+        , _evictions(0)
+        , _answered(0)
+        , _latency(0)
+        , _maxLatency(0)
+    {
+    }
+#ifdef __WINDOWS__
+#pragma warning(default : 4355)
+#endif
+
+    DNSForwarder::~DNSForwarder()
+    {
+        Close();
+    }
+
+    uint32_t DNSForwarder::Open()
+    {
+        // UDP should open by definition directly...
+        uint32_t result = _listener.Open(100);
+
+        if ((result == Core::ERROR_NONE) || (result == Core::ERROR_INPROGRESS)) {
+            std::vector<Channel*> pool;
+
+            for (uint8_t index = 0; index < Sockets; index++) {
+                Channel* channel = nullptr;
+                uint8_t attempt = 0;
+
+                while ((channel == nullptr) && (attempt < PortAttempts)) {
+                    uint16_t port;
+
+                    Crypto::Random(port);
+                    port = static_cast<uint16_t>(LowestPort + (port % (0x10000 - LowestPort)));
+
+                    channel = new Channel(*this, Core::NodeId(_T("0.0.0.0"), port, Core::NodeId::TYPE_IPV4));
+                    const uint32_t opened = channel->Open(100);
+
+                    if ((opened != Core::ERROR_NONE) && (opened != Core::ERROR_INPROGRESS)) {
+                        // Most likely in use already, try another one.
+                        delete channel;
+                        channel = nullptr;
+                    }
+
+                    attempt++;
+                }
+
+                if (channel != nullptr) {
+                    pool.push_back(channel);
+                }
+            }
+
+            if (pool.empty() == true) {
+                _listener.Close(Core::infinite);
+                result = Core::ERROR_UNAVAILABLE;
+            } else {
+                _adminLock.Lock();
+                _upstream.swap(pool);
+                _adminLock.Unlock();
+
+                result = Core::ERROR_NONE;
+            }
+        }
+
+        return (result);
+    }
+
+    void DNSForwarder::Close()
+    {
+        Core::IWorkerPool::Instance().Revoke(_activity);
+
+        _listener.Close(Core::infinite);
+
+        std::vector<Channel*> pool;
+
+        _adminLock.Lock();
+        pool.swap(_upstream);
+        _pending.clear();
+        _transactions.clear();
+        _scheduled = false;
+        _adminLock.Unlock();
+
+        // Outside of the lock, an answer that is still coming in on them needs it.
+        for (Channel* channel : pool) {
+            delete channel;
+        }
+    }
+
+    void DNSForwarder::Servers(const std::list<Core::NodeId>& servers)
+    {
+        std::vector<Core::NodeId> list;
+
+        for (const Core::NodeId& server : servers) {
+            const Core::NodeId node(server.HostAddress().c_str(), (server.PortNumber() == 0 ? static_cast<uint16_t>(DefaultPort) : server.PortNumber()), Core::NodeId::TYPE_IPV4);
+
+            // The upstream socket is IPv4 only, and questions should never come back to ourselves.
+            if ((server.Type() == Core::NodeId::TYPE_IPV4) && (node.IsValid() == true) && (node != _address)) {
+                list.push_back(node);
+            }
+        }
+
+        _adminLock.Lock();
+
+        if (list != _servers) {
+            _servers = list;
+            _cache.clear();
+            _lru.clear();
+        }
+
+        _adminLock.Unlock();
+    }
+
+    void DNSForwarder::Metrics(Statistics& info) const
+    {
+        _adminLock.Lock();
+
+        info.Queries = _queries;
+        info.Hits = _hits;
+        info.Misses = _misses;
+        info.Coalesced = _coalesced;
+        info.Prefetches = _prefetches;
+        info.Failures = _failures;
+        info.Evictions = _evictions;
+        info.Entries = static_cast<uint32_t>(_cache.size());
+        info.HitRate = static_cast<uint8_t>(_queries > 0 ? ((static_cast<uint64_t>(_hits) * 100) / _queries) : 0);
+        info.Latency = static_cast<uint32_t>(_answered > 0 ? (_latency / _answered) : 0);
+        info.MaxLatency = _maxLatency;
+
+        for (const Core::NodeId& server : _servers) {
+            Core::JSON::String name;
+            name = server.HostAddress() + ':' + Core::NumberType<uint16_t>(server.PortNumber()).Text();
+            info.Servers.Add(name);
+        }
+
+        _adminLock.Unlock();
+    }
+
+    /* virtual */ uint16_t DNSForwarder::Channel::SendData(uint8_t* dataFrame, const uint16_t maxSendSize)
+    {
+        uint16_t result = 0;
+
+        _adminLock.Lock();
+
+        if (_queue.empty() == false) {
+            const std::vector<uint8_t>& message(_queue.front().second);
+
+            ASSERT(message.size() <= maxSendSize);
+
+            // The frame goes out to the remote node after we return.
+            RemoteNode(_queue.front().first);
+
+            result = std::min(static_cast<uint16_t>(message.size()), maxSendSize);
+            ::memcpy(dataFrame, message.data(), result);
+
+            _queue.pop_front();
+
+            if (_queue.empty() == false) {
+                Trigger();
+            }
+        }
+
+        _adminLock.Unlock();
+
+        return (result);
+    }
+
+    /* virtual */ uint16_t DNSForwarder::Channel::ReceiveData(uint8_t* dataFrame, const uint16_t receivedSize)
+    {
+        _parent.Received(*this, ReceivedNode(), dataFrame, receivedSize);
+
+        return (receivedSize);
+    }
+
+    void DNSForwarder::Received(const Channel& channel, const Core::NodeId& source, const uint8_t message[], const uint16_t length)
+    {
+        if (length >= DNSMessage::HeaderSize) {
+            if (&channel == &_listener) {
+                Question(source, message, length);
+            } else {
+                Answer(channel, source, message, length);
+            }
+        }
+    }
+
+    void DNSForwarder::Question(const Core::NodeId& source, const uint8_t message[], const uint16_t length)
+    {
+        const uint16_t flags = DNSMessage::Get16(&message[2]);
+
+        if ((flags & DNSMessage::FlagResponse) == 0) {
+            const uint64_t now = Core::Time::Now().Ticks();
+            Client client;
+            string key;
+
+            client.Node = source;
+            client.Id = DNSMessage::Get16(&message[0]);
+
+            _adminLock.Lock();
+
+            _queries++;
+
+            if ((flags & DNSMessage::MaskOpcode) != 0) {
+                Fail(client, DNSMessage::CodeNotImplemented);
+            } else if ((DNSMessage::Get16(&message[4]) != 1) || (DNSMessage::Parse(message, length, client.Question, key) == 0)) {
+                Fail(client, DNSMessage::CodeFormatError);
+            } else if (Hit(key, client, now) == false) {
+                std::unordered_map<string, Query>::iterator pending(_pending.find(key));
+
+                if (pending != _pending.end()) {
+                    // Already asked, all get the same answer.
+                    pending->second.Clients.push_back(client);
+                    _coalesced++;
+                } else if (_servers.empty() == true) {
+                    Fail(client, DNSMessage::CodeServerFailure);
+                    _failures++;
+                } else {
+                    Query& query(_pending[key]);
+
+                    query.Question = client.Question;
+                    query.Clients.push_back(client);
+                    query.Server = 0;
+                    query.Attempt = 0;
+                    query.Started = now;
+
+                    _misses++;
+                    Ask(key, query, now);
+                }
+            }
+
+            _adminLock.Unlock();
+        }
+    }
+
+    void DNSForwarder::Answer(const Channel& channel, const Core::NodeId& source, const uint8_t message[], const uint16_t length)
+    {
+        const uint64_t now = Core::Time::Now().Ticks();
+        const uint16_t flags = DNSMessage::Get16(&message[2]);
+
+        _adminLock.Lock();
+
+        std::unordered_map<uint16_t, string>::iterator transaction(_transactions.find(DNSMessage::Get16(&message[0])));
+        string question;
+        string key;
+        uint16_t offset;
+
+        // Only an answer to a question we asked, from a server we asked it.
+        if ((transaction != _transactions.end()) && ((flags & DNSMessage::FlagResponse) != 0) && (DNSMessage::Get16(&message[4]) == 1) && ((offset = DNSMessage::Parse(message, length, question, key)) != 0) && (key == transaction->second) && (std::find(_servers.begin(), _servers.end(), source) != _servers.end())) {
+
+            std::unordered_map<string, Query>::iterator pending(_pending.find(key));
+
+            ASSERT(pending != _pending.end());
+
+            Query& query(pending->second);
+
+            // And it came in on the socket it was asked from.
+            if (query.Upstream == &channel) {
+                const uint8_t code = (flags & DNSMessage::MaskCode);
+
+                if (((code == DNSMessage::CodeServerFailure) || (code == DNSMessage::CodeNotImplemented) || (code == DNSMessage::CodeRefused)) && (query.Attempt < Attempts) && (_servers.size() > 1)) {
+                    // This server can not help, the next one might.
+                    query.Server++;
+                    Ask(key, query, now);
+                } else {
+                    Store(key, message, length, offset, now);
+
+                    for (const Client& client : query.Clients) {
+                        Reply(client, message, length);
+                    }
+
+                    if (query.Clients.empty() == false) {
+                        const uint32_t latency = static_cast<uint32_t>(now - query.Started);
+
+                        _answered++;
+                        _latency += latency;
+                        _maxLatency = std::max(_maxLatency, latency);
+                    }
+
+                    _transactions.erase(transaction);
+                    _pending.erase(pending);
+                }
+            }
+        }
+
+        _adminLock.Unlock();
+    }
+
+    bool DNSForwarder::Hit(const string& key, const Client& client, const uint64_t now)
+    {
+        bool result = false;
+        std::unordered_map<string, Entry>::iterator index(_cache.find(key));
+
+        if (index != _cache.end()) {
+            Entry& entry(index->second);
+            const uint64_t lifetime = static_cast<uint64_t>(entry.TTL) * 1000 /* MilliSeconds */;
+            const uint64_t age = (now - entry.Stored) / 1000 /* MicroSeconds */;
+
+            if (age >= lifetime) {
+                _lru.erase(entry.Position);
+                _cache.erase(index);
+            } else {
+                const uint32_t seconds = static_cast<uint32_t>(age / 1000);
+                const uint16_t length = static_cast<uint16_t>(entry.Response.size());
+                uint8_t message[MaxMessageSize];
+
+                result = true;
+                _hits++;
+                entry.Hits++;
+                _lru.splice(_lru.begin(), _lru, entry.Position);
+
+                // The TTLs count down, as the answer ages.
+                ::memcpy(message, entry.Response.data(), length);
+                DNSMessage::Age(message, entry.TTLs, seconds);
+
+                Reply(client, message, length);
+
+                // Popular, and about to expire, so ask again before it does.
+                if ((_prefetch == true) && (entry.Hits >= PrefetchHits) && (((lifetime - age) * 100) <= (lifetime * PrefetchWindow)) && (_servers.empty() == false) && (_pending.find(key) == _pending.end())) {
+                    Query& query(_pending[key]);
+
+                    query.Question = client.Question;
+                    query.Server = 0;
+                    query.Attempt = 0;
+                    query.Started = now;
+
+                    _prefetches++;
+                    Ask(key, query, now);
+                }
+            }
+        }
+
+        return (result);
+    }
+
+    void DNSForwarder::Ask(const string& key, Query& query, const uint64_t now)
+    {
+        uint8_t message[MaxMessageSize];
+        const uint16_t length = static_cast<uint16_t>(DNSMessage::HeaderSize + query.Question.length());
+
+        ASSERT(length <= MaxMessageSize);
+
+        if (query.Attempt == 0) {
+            // The id stays the same for every attempt, a late answer from an earlier server is just as good.
+            do {
+                Crypto::Random(query.Id);
+            } while (_transactions.find(query.Id) != _transactions.end());
+
+            _transactions.emplace(query.Id, key);
+
+            if (_upstream.empty() == true) {
+                query.Upstream = nullptr;
+            } else {
+                uint8_t socket;
+
+                Crypto::Random(socket);
+                query.Upstream = _upstream[socket % _upstream.size()];
+            }
+        }
+
+        DNSMessage::Set16(&message[0], query.Id);
+        DNSMessage::Set16(&message[2], DNSMessage::FlagRecursionDesired);
+        DNSMessage::Set16(&message[4], 1);
+        DNSMessage::Set16(&message[6], 0);
+        DNSMessage::Set16(&message[8], 0);
+        DNSMessage::Set16(&message[10], 0);
+        ::memcpy(&message[DNSMessage::HeaderSize], query.Question.data(), query.Question.length());
+
+        query.Attempt++;
+        query.Sent = now;
+
+        if ((_servers.empty() == false) && (query.Upstream != nullptr)) {
+            query.Upstream->Send(_servers[query.Server % _servers.size()], message, length);
+        }
+
+        Schedule(now + (Timeout * 1000 /* MicroSeconds */));
+    }
+
+    void DNSForwarder::Store(const string& key, const uint8_t message[], const uint16_t length, const uint16_t offset, const uint64_t now)
+    {
+        std::vector<uint16_t> fields;
+        uint32_t ttl;
+
+        if (DNSMessage::Lifetime(message, length, offset, fields, ttl) == true) {
+            std::unordered_map<string, Entry>::iterator index(_cache.find(key));
+
+            if (index == _cache.end()) {
+                if (_cache.size() >= _capacity) {
+                    _cache.erase(_lru.back());
+                    _lru.pop_back();
+                    _evictions++;
+                }
+
+                _lru.push_front(key);
+                index = _cache.emplace(key, Entry()).first;
+                index->second.Hits = 0;
+                index->second.Position = _lru.begin();
+            }
+
+            Entry& entry(index->second);
+
+            entry.Response.assign(message, message + length);
+            entry.TTLs.swap(fields);
+            entry.Stored = now;
+            entry.TTL = std::min(ttl, _maxTTL);
+
+            for (const uint16_t field : entry.TTLs) {
+                if ((entry.Response[field] & 0x80) != 0) {
+                    DNSMessage::Set32(&entry.Response[field], 0);
+                }
+            }
+        }
+    }
+
+    void DNSForwarder::Reply(const Client& client, const uint8_t message[], const uint16_t length)
+    {
+        uint8_t answer[MaxMessageSize];
+
+        ASSERT(length <= MaxMessageSize);
+
+        ::memcpy(answer, message, length);
+        DNSMessage::Set16(&answer[0], client.Id);
+
+        // The question as it was asked, the name might have come in another case.
+        ::memcpy(&answer[DNSMessage::HeaderSize], client.Question.data(), client.Question.length());
+
+        _listener.Send(client.Node, answer, length);
+    }
+
+    void DNSForwarder::Fail(const Client& client, const uint8_t code)
+    {
+        uint8_t answer[MaxMessageSize];
+        const uint16_t length = static_cast<uint16_t>(DNSMessage::HeaderSize + client.Question.length());
+
+        DNSMessage::Set16(&answer[0], client.Id);
+        DNSMessage::Set16(&answer[2], DNSMessage::FlagResponse | DNSMessage::FlagRecursionDesired | DNSMessage::FlagRecursionAvailable | code);
+        DNSMessage::Set16(&answer[4], (client.Question.empty() == true ? 0 : 1));
+        DNSMessage::Set16(&answer[6], 0);
+        DNSMessage::Set16(&answer[8], 0);
+        DNSMessage::Set16(&answer[10], 0);
+        ::memcpy(&answer[DNSMessage::HeaderSize], client.Question.data(), client.Question.length());
+
+        _listener.Send(client.Node, answer, length);
+    }
+
+    void DNSForwarder::Schedule(const uint64_t time)
+    {
+        if (_scheduled == false) {
+            _scheduled = true;
+            Core::IWorkerPool::Instance().Schedule(Core::Time(time), _activity);
+        }
+    }
+
+    void DNSForwarder::Dispatch()
+    {
+        const uint64_t now = Core::Time::Now().Ticks();
+        const uint64_t timeout = Timeout * 1000 /* MicroSeconds */;
+        uint64_t next = ~0;
+
+        _adminLock.Lock();
+
+        // Still flagged as scheduled, so the retries below do not schedule, the earliest one is picked after.
+        std::unordered_map<string, Query>::iterator index(_pending.begin());
+
+        while (index != _pending.end()) {
+            Query& query(index->second);
+
+            if ((now - query.Sent) < timeout) {
+                next = std::min(next, query.Sent + timeout);
+                index++;
+            } else if (query.Attempt < Attempts) {
+                query.Server++;
+                Ask(index->first, query, now);
+                next = std::min(next, query.Sent + timeout);
+                index++;
+            } else {
+                // No one answered.
+                for (const Client& client : query.Clients) {
+                    Fail(client, DNSMessage::CodeServerFailure);
+                }
+
+                _failures += static_cast<uint32_t>(query.Clients.size());
+                _transactions.erase(query.Id);
+                index = _pending.erase(index);
+            }
+        }
+
+        _scheduled = false;
+
+        if (next != static_cast<uint64_t>(~0)) {
+            Schedule(next);
+        }
+
+        _adminLock.Unlock();
+    }
+
+}
+} // namespace WPEFramework::Plugin
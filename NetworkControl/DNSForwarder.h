@@ -0,0 +1,301 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DNSFORWARDER__H
+#define DNSFORWARDER__H
+
+#include "Module.h"
+
+#include <unordered_map>
+
+namespace WPEFramework {
+
+namespace Plugin {
+
+    // A caching DNS forwarder, for everyone on the box to use as their name server. Answers are kept for
+    // as long as their TTL allows (RFC 1035, negative answers RFC 2308), identical questions that are
+    // still underway upstream are asked only once, and names that are asked for often are refreshed just
+    // before they expire, so they never have to wait for the upstream servers again.
+    class DNSForwarder {
+    public:
+        class Config : public Core::JSON::Container {
+        private:
+            Config(const Config&) = delete;
+            Config& operator=(const Config&) = delete;
+
+        public:
+            Config()
+                : Core::JSON::Container()
+                , Enabled(false)
+                , Listen(_T("127.0.0.1"))
+                , Port(53)
+                , Entries(256)
+                , MaxTTL(3600)
+                , Prefetch(true)
+            {
+                Add(_T("enabled"), &Enabled);
+                Add(_T("listen"), &Listen);
+                Add(_T("port"), &Port);
+                Add(_T("entries"), &Entries);
+                Add(_T("maxttl"), &MaxTTL);
+                Add(_T("prefetch"), &Prefetch);
+            }
+            ~Config()
+            {
+            }
+
+        public:
+            Core::JSON::Boolean Enabled;
+            Core::JSON::String Listen; // the address the resolv.conf points to
+            Core::JSON::DecUInt16 Port; // only listed in the resolv.conf on 53, resolvers can not ask elsewhere
+            Core::JSON::DecUInt16 Entries; // answers kept, the least recently used go first
+            Core::JSON::DecUInt32 MaxTTL; // s, no answer is kept longer than this
+            Core::JSON::Boolean Prefetch;
+        };
+
+        class Statistics : public Core::JSON::Container {
+        private:
+            Statistics(const Statistics&) = delete;
+            Statistics& operator=(const Statistics&) = delete;
+
+        public:
+            Statistics()
+                : Core::JSON::Container()
+                , Queries(0)
+                , Hits(0)
+                , Misses(0)
+                , Coalesced(0)
+                , Prefetches(0)
+                , Failures(0)
+                , Evictions(0)
+                , Entries(0)
+                , HitRate(0)
+                , Latency(0)
+                , MaxLatency(0)
+                , Servers()
+            {
+                Add(_T("queries"), &Queries);
+                Add(_T("hits"), &Hits);
+                Add(_T("misses"), &Misses);
+                Add(_T("coalesced"), &Coalesced);
+                Add(_T("prefetches"), &Prefetches);
+                Add(_T("failures"), &Failures);
+                Add(_T("evictions"), &Evictions);
+                Add(_T("entries"), &Entries);
+                Add(_T("hitrate"), &HitRate);
+                Add(_T("latency"), &Latency);
+                Add(_T("maxlatency"), &MaxLatency);
+                Add(_T("servers"), &Servers);
+            }
+            ~Statistics()
+            {
+            }
+
+        public:
+            Core::JSON::DecUInt32 Queries; // from clients
+            Core::JSON::DecUInt32 Hits; // answered from the cache
+            Core::JSON::DecUInt32 Misses; // asked upstream
+            Core::JSON::DecUInt32 Coalesced; // joined a question that was already asked upstream
+            Core::JSON::DecUInt32 Prefetches; // refreshed before they expired
+            Core::JSON::DecUInt32 Failures; // answered with a SERVFAIL, no upstream server answered
+            Core::JSON::DecUInt32 Evictions; // pushed out of the cache before they expired
+            Core::JSON::DecUInt32 Entries; // in the cache
+            Core::JSON::DecUInt8 HitRate; // %
+            Core::JSON::DecUInt32 Latency; // us, on average, of the upstream servers
+            Core::JSON::DecUInt32 MaxLatency; // us
+            Core::JSON::ArrayType<Core::JSON::String> Servers;
+        };
+
+    private:
+        DNSForwarder() = delete;
+        DNSForwarder(const DNSForwarder&) = delete;
+        DNSForwarder& operator=(const DNSForwarder&) = delete;
+
+        // RFC 1035 section 4.2.1, no EDNS, so nothing larger ever passes.
+        static constexpr uint16_t MaxMessageSize = 512;
+        static constexpr uint16_t DefaultPort = 53;
+
+        static constexpr uint32_t Timeout = 1000; // ms, before the next upstream server is asked
+        static constexpr uint8_t Attempts = 3;
+        static constexpr uint32_t PrefetchHits = 2; // before a name counts as popular
+        static constexpr uint8_t PrefetchWindow = 10; // %, of the TTL that is left
+
+        // Questions go upstream from a socket picked at random out of a pool, each on a random port, so an
+        // answer can not be spoofed by guessing the id alone (RFC 5452).
+        static constexpr uint8_t Sockets = 16;
+        static constexpr uint16_t LowestPort = 1024;
+        static constexpr uint8_t PortAttempts = 8; // per socket, before we settle for the ones we have
+
+        // One socket, towards the clients or towards the upstream servers. Datagrams go out in order.
+        class Channel : public Core::SocketDatagram {
+        private:
+            Channel() = delete;
+            Channel(const Channel&) = delete;
+            Channel& operator=(const Channel&) = delete;
+
+        public:
+            Channel(DNSForwarder& parent, const Core::NodeId& local)
+                : Core::SocketDatagram(false, local, local, MaxMessageSize, MaxMessageSize)
+                , _parent(parent)
+                , _adminLock()
+                , _queue()
+            {
+            }
+            ~Channel() override
+            {
+                Close(Core::infinite);
+            }
+
+        public:
+            void Send(const Core::NodeId& node, const uint8_t message[], const uint16_t length)
+            {
+                _adminLock.Lock();
+                _queue.emplace_back(std::piecewise_construct, std::forward_as_tuple(node), std::forward_as_tuple(message, message + length));
+                _adminLock.Unlock();
+
+                Trigger();
+            }
+
+        private:
+            uint16_t SendData(uint8_t* dataFrame, const uint16_t maxSendSize) override;
+            uint16_t ReceiveData(uint8_t* dataFrame, const uint16_t receivedSize) override;
+            void StateChange() override
+            {
+            }
+
+        private:
+            DNSForwarder& _parent;
+            Core::CriticalSection _adminLock;
+            std::list<std::pair<Core::NodeId, std::vector<uint8_t>>> _queue;
+        };
+
+        class Activity : public Core::IDispatchType<void> {
+        private:
+            Activity() = delete;
+            Activity(const Activity&) = delete;
+            Activity& operator=(const Activity&) = delete;
+
+        public:
+            Activity(DNSForwarder* parent)
+                : _parent(*parent)
+            {
+                ASSERT(parent != nullptr);
+            }
+            ~Activity()
+            {
+            }
+
+        public:
+            virtual void Dispatch() override
+            {
+                _parent.Dispatch();
+            }
+
+        private:
+            DNSForwarder& _parent;
+        };
+
+        struct Client {
+            Core::NodeId Node;
+            uint16_t Id;
+            string Question; // as asked, the case of the name might differ between clients
+        };
+
+        // A question underway to the upstream servers, for all clients that asked it.
+        struct Query {
+            string Question;
+            std::vector<Client> Clients; // none if it is a prefetch
+            Channel* Upstream; // the answer has to come in on the socket the question went out on
+            uint16_t Id;
+            uint8_t Server;
+            uint8_t Attempt;
+            uint64_t Started; // ticks
+            uint64_t Sent; // ticks
+        };
+
+        struct Entry {
+            std::vector<uint8_t> Response;
+            std::vector<uint16_t> TTLs; // offsets of the TTL fields in the response
+            uint64_t Stored; // ticks
+            uint32_t TTL; // s
+            uint32_t Hits;
+            std::list<string>::iterator Position; // in the LRU list
+        };
+
+    public:
+        DNSForwarder(const Config& config);
+        ~DNSForwarder();
+
+    public:
+        uint32_t Open();
+        void Close();
+
+        const Core::NodeId& Address() const
+        {
+            return (_address);
+        }
+        // The servers the questions go to. The cache starts over when they change, other servers might
+        // give other answers.
+        void Servers(const std::list<Core::NodeId>& servers);
+        void Metrics(Statistics& info) const;
+
+    private:
+        void Received(const Channel& channel, const Core::NodeId& source, const uint8_t message[], const uint16_t length);
+        void Question(const Core::NodeId& source, const uint8_t message[], const uint16_t length);
+        void Answer(const Channel& channel, const Core::NodeId& source, const uint8_t message[], const uint16_t length);
+        void Dispatch();
+
+        bool Hit(const string& key, const Client& client, const uint64_t now);
+        void Ask(const string& key, Query& query, const uint64_t now);
+        void Store(const string& key, const uint8_t message[], const uint16_t length, const uint16_t offset, const uint64_t now);
+        void Reply(const Client& client, const uint8_t message[], const uint16_t length);
+        void Fail(const Client& client, const uint8_t code);
+        void Schedule(const uint64_t time);
+
+    private:
+        mutable Core::CriticalSection _adminLock;
+        const Core::NodeId _address;
+        const uint16_t _capacity;
+        const uint32_t _maxTTL;
+        const bool _prefetch;
+        std::vector<Core::NodeId> _servers;
+        std::unordered_map<string, Entry> _cache; // keyed by the question, the name in lower case
+        std::list<string> _lru; // most recently used first
+        std::unordered_map<string, Query> _pending; // keyed as the cache
+        std::unordered_map<uint16_t, string> _transactions; // upstream id to the pending question
+        Channel _listener;
+        std::vector<Channel*> _upstream;
+        Core::ProxyType<Activity> _activity;
+        bool _scheduled;
+
+        uint32_t _queries;
+        uint32_t _hits;
+        uint32_t _misses;
+        uint32_t _coalesced;
+        uint32_t _prefetches;
+        uint32_t _failures;
+        uint32_t _evictions;
+        uint32_t _answered;
+        uint64_t _latency; // us, in total, over the answered questions
+        uint32_t _maxLatency;
+    };
+}
+} // namespace WPEFramework::Plugin
+
+#endif // DNSFORWARDER__H
@@ -0,0 +1,202 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // What the DNS forwarder needs to know of a message (RFC 1035 section 4.1): the question it is about,
+    // and how long the answer to it can be kept. No framework dependencies, it is checked on its own.
+    class DNSMessage {
+    public:
+        static constexpr uint16_t HeaderSize = 12;
+
+        static constexpr uint16_t FlagResponse = 0x8000;
+        static constexpr uint16_t FlagTruncated = 0x0200;
+        static constexpr uint16_t FlagRecursionDesired = 0x0100;
+        static constexpr uint16_t FlagRecursionAvailable = 0x0080;
+        static constexpr uint16_t MaskOpcode = 0x7800;
+        static constexpr uint16_t MaskCode = 0x000F;
+
+        static constexpr uint8_t CodeNoError = 0;
+        static constexpr uint8_t CodeFormatError = 1;
+        static constexpr uint8_t CodeServerFailure = 2;
+        static constexpr uint8_t CodeNameError = 3;
+        static constexpr uint8_t CodeNotImplemented = 4;
+        static constexpr uint8_t CodeRefused = 5;
+
+        static constexpr uint16_t TypeSOA = 6;
+        static constexpr uint16_t TypeOPT = 41;
+
+    public:
+        DNSMessage() = delete;
+        DNSMessage(const DNSMessage&) = delete;
+        DNSMessage& operator=(const DNSMessage&) = delete;
+
+        static inline uint16_t Get16(const uint8_t data[])
+        {
+            return (static_cast<uint16_t>((data[0] << 8) | data[1]));
+        }
+        static inline uint32_t Get32(const uint8_t data[])
+        {
+            return ((static_cast<uint32_t>(data[0]) << 24) | (data[1] << 16) | (data[2] << 8) | data[3]);
+        }
+        static inline void Set16(uint8_t data[], const uint16_t value)
+        {
+            data[0] = static_cast<uint8_t>(value >> 8);
+            data[1] = static_cast<uint8_t>(value);
+        }
+        static inline void Set32(uint8_t data[], const uint32_t value)
+        {
+            data[0] = static_cast<uint8_t>(value >> 24);
+            data[1] = static_cast<uint8_t>(value >> 16);
+            data[2] = static_cast<uint8_t>(value >> 8);
+            data[3] = static_cast<uint8_t>(value);
+        }
+
+        // Offset past the name at the given offset, 0 if it does not fit in the message.
+        static uint32_t SkipName(const uint8_t message[], const uint16_t length, uint32_t offset)
+        {
+            uint32_t result = 0;
+            bool done = false;
+
+            while ((done == false) && (offset < length)) {
+                const uint8_t label = message[offset];
+
+                if (label == 0) {
+                    result = offset + 1;
+                    done = true;
+                } else if ((label & 0xC0) == 0xC0) {
+                    // A compression pointer ends the name.
+                    result = ((offset + 2) <= length ? offset + 2 : 0);
+                    done = true;
+                } else if ((label & 0xC0) != 0) {
+                    done = true;
+                } else {
+                    offset += label + 1;
+                }
+            }
+
+            return (result);
+        }
+
+        // The question of a message, as it is, and the key it is cached under, with the name in lower case.
+        // Returns the offset past the question, 0 if it is not a question we can handle.
+        static uint16_t Parse(const uint8_t message[], const uint16_t length, std::string& question, std::string& key)
+        {
+            uint16_t result = 0;
+            uint32_t offset = HeaderSize;
+
+            // The question comes first, there is nothing to point to yet, so the name is never compressed.
+            while ((offset < length) && (message[offset] != 0) && (message[offset] < 64)) {
+                offset += message[offset] + 1;
+            }
+
+            if (((offset + 5) <= length) && (message[offset] == 0)) {
+                const uint16_t name = static_cast<uint16_t>(offset - HeaderSize);
+
+                result = static_cast<uint16_t>(offset + 5);
+                question.assign(reinterpret_cast<const char*>(&message[HeaderSize]), result - HeaderSize);
+                key = question;
+
+                // Names are case insensitive (RFC 4343), the length octets are never in the letter range.
+                for (uint16_t index = 0; index < name; index++) {
+                    if ((key[index] >= 'A') && (key[index] <= 'Z')) {
+                        key[index] += ('a' - 'A');
+                    }
+                }
+            }
+
+            return (result);
+        }
+
+        // How long an answer can be kept, and where its TTL fields are, so they can count down as it ages.
+        // Returns false if it is not to be kept at all.
+        static bool Lifetime(const uint8_t message[], const uint16_t length, const uint16_t offset, std::vector<uint16_t>& fields, uint32_t& ttl)
+        {
+            const uint16_t flags = Get16(&message[2]);
+            const uint8_t code = (flags & MaskCode);
+            const uint16_t answers = Get16(&message[6]);
+            const uint16_t authorities = Get16(&message[8]);
+            const uint32_t records = answers + authorities + Get16(&message[10]);
+            const bool negative = ((code == CodeNameError) || (answers == 0));
+            bool result = (((flags & FlagTruncated) == 0) && ((code == CodeNoError) || (code == CodeNameError)));
+            uint32_t lowest = ~0;
+            uint32_t absent = 0;
+            uint32_t position = offset;
+            uint32_t index = 0;
+
+            while ((result == true) && (index < records)) {
+                position = SkipName(message, length, position);
+
+                if ((position == 0) || ((position + 10) > length)) {
+                    result = false;
+                } else {
+                    const uint16_t type = Get16(&message[position]);
+                    const uint16_t size = Get16(&message[position + 8]);
+                    uint32_t value = Get32(&message[position + 4]);
+
+                    // RFC 2181 section 8, a TTL with the most significant bit set counts as 0.
+                    if ((value & 0x80000000) != 0) {
+                        value = 0;
+                    }
+
+                    // The OPT pseudo record has no TTL, that field holds the extended flags (RFC 6891).
+                    if (type != TypeOPT) {
+                        fields.push_back(static_cast<uint16_t>(position + 4));
+                        lowest = std::min(lowest, value);
+                    }
+
+                    // RFC 2308 section 5, a negative answer lasts the lower of the SOA TTL and its MINIMUM.
+                    if ((negative == true) && (type == TypeSOA) && (index >= answers) && (index < static_cast<uint32_t>(answers + authorities)) && (size >= 22) && ((position + 10 + size) <= length)) {
+                        absent = std::min(value, Get32(&message[position + 10 + size - 4]));
+                    }
+
+                    position += 10 + size;
+                    result = (position <= length);
+                    index++;
+                }
+            }
+
+            if (result == true) {
+                ttl = (negative == true ? absent : lowest);
+                result = (ttl != 0);
+            }
+
+            return (result);
+        }
+
+        // Counts the TTL fields down by the seconds an answer has been kept, none goes below 0.
+        static void Age(uint8_t message[], const std::vector<uint16_t>& fields, const uint32_t seconds)
+        {
+            for (const uint16_t field : fields) {
+                const uint32_t ttl = Get32(&message[field]);
+                Set32(&message[field], (ttl > seconds ? ttl - seconds : 0));
+            }
+        }
+    };
+
+} // namespace Plugin
+} // namespace WPEFramework
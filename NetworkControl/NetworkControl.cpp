@@ -86,6 +86,7 @@ namespace Plugin
         , _interfaces()
         , _dhcpInterfaces()
         , _observer(Core::ProxyType<AdapterObserver>::Create(this))
+        , _forwarder(nullptr)
     {
         RegisterAll();
     }
@@ -210,6 +211,19 @@ namespace Plugin
             }
         }
 
+        if (config.Forwarder.Enabled.Value() == true) {
+            _forwarder = new DNSForwarder(config.Forwarder);
+
+            if (_forwarder->Open() != Core::ERROR_NONE) {
+                SYSLOG(Logging::Startup, (_T("Could not start the DNS forwarder on [%s]"), _forwarder->Address().HostAddress().c_str()));
+                delete _forwarder;
+                _forwarder = nullptr;
+            } else if (_forwarder->Address().PortNumber() != 53) {
+                // A resolv.conf has no room for a port, the forwarder is only there for those who ask it directly.
+                SYSLOG(Logging::Startup, (_T("The DNS forwarder on port [%d] is not listed in [%s]"), _forwarder->Address().PortNumber(), _dnsFile.c_str()));
+            }
+        }
+
         // Update the DNS information, before we set the new IP, Do not know who triggers
         // the re-read of this file....
         RefreshDNS();
@@ -234,6 +248,12 @@ namespace Plugin
             index++;
         }
 
+        if (_forwarder != nullptr) {
+            _forwarder->Close();
+            delete _forwarder;
+            _forwarder = nullptr;
+        }
+
         _dns.clear();
         _dhcpInterfaces.clear();
         _interfaces.clear();
@@ -459,6 +479,10 @@ namespace Plugin
 
                 lease.Set(offer);
 
+                _adminLock.Lock();
+                lease.Expires(_expires);
+                _adminLock.Unlock();
+
                 if (lease.IElement::ToFile(leaseFile) == false) {
                     TRACE(Trace::Warning, ("Error occured while trying to save dhcp lease to file!"));
                 } 
@@ -487,8 +511,17 @@ namespace Plugin
                 DHCPClientImplementation::Offer::JSON lease;
                 Core::OptionalType<Core::JSON::Error> error;
                 if (lease.IElement::FromFile(leaseFile, error) == true) {
-
-                    _client.AddUnleasedOffer(lease.Get());
+                    const uint64_t now = Core::Time::Now().Ticks() / (1000 /* MilliSeconds */ * 1000 /* MicroSeconds */);
+
+                    if (lease.Expires() > now) {
+                        // Still valid, reclaim it with an INIT-REBOOT, without a discovery.
+                        _adminLock.Lock();
+                        _lease = lease.Get();
+                        _expires = lease.Expires();
+                        _adminLock.Unlock();
+                    } else {
+                        _client.AddUnleasedOffer(lease.Get());
+                    }
                 }
 
                 if (error.IsSet() == true) {
@@ -818,12 +851,28 @@ namespace Plugin
             _adminLock.Lock();
 
             std::list<std::pair<uint16_t, Core::NodeId>>::const_iterator pointer(_dns.begin());
+            std::list<Core::NodeId> servers;
+
+            // Everyone asks the forwarder first, the servers behind it are still there if it does not answer.
+            // Resolvers always ask on port 53, so it can only be listed if it listens there.
+            if ((_forwarder != nullptr) && (_forwarder->Address().PortNumber() == 53)) {
+                data += string(NAMESERVER, sizeof(NAMESERVER) - 1) + _forwarder->Address().HostAddress() + '\n';
+            }
 
             while (pointer != _dns.end()) {
                 data += string(NAMESERVER, sizeof(NAMESERVER) - 1) + pointer->second.HostAddress() + '\n';
+
+                // The forwarder might be configured as a server too, it should not forward to itself.
+                if ((_forwarder == nullptr) || (pointer->second.HostAddress() != _forwarder->Address().HostAddress())) {
+                    servers.push_back(pointer->second);
+                }
                 pointer++;
             }
 
+            if (_forwarder != nullptr) {
+                _forwarder->Servers(servers);
+            }
+
             _adminLock.Unlock();
 
             data += endMarker;
@@ -20,7 +20,9 @@
 #ifndef PLUGIN_NETWORKCONTROL_H
 #define PLUGIN_NETWORKCONTROL_H
 
+#include "AddressProbe.h"
 #include "DHCPClientImplementation.h"
+#include "DNSForwarder.h"
 #include "Module.h"
 
 #include <interfaces/IIPNetwork.h>
@@ -211,6 +213,7 @@ namespace Plugin {
                 , TimeOut(5)
                 , Retries(4)
                 , Open(true)
+                , Forwarder()
             {
                 Add(_T("dnsfile"), &DNSFile);
                 Add(_T("interfaces"), &Interfaces);
@@ -218,6 +221,7 @@ namespace Plugin {
                 Add(_T("retries"), &Retries);
                 Add(_T("open"), &Open);
                 Add(_T("dns"), &DNS);
+                Add(_T("forwarder"), &Forwarder);
             }
             ~Config()
             {
@@ -230,6 +234,7 @@ namespace Plugin {
             Core::JSON::DecUInt8 TimeOut;
             Core::JSON::DecUInt8 Retries;
             Core::JSON::Boolean Open;
+            DNSForwarder::Config Forwarder;
         };
 
         class StaticInfo {
@@ -309,16 +314,36 @@ namespace Plugin {
             DHCPEngine(const DHCPEngine&) = delete;
             DHCPEngine& operator=(const DHCPEngine&) = delete;
 
+            // RFC 2131 section 3.1.5, wait before starting over after a DECLINE
+            static constexpr uint32_t DeclineBackoff = 10000; // ms
+
+            enum probe {
+                PROBE_IDLE,
+                PROBE_RUNNING,
+                PROBE_CLEAR,
+                PROBE_CONFLICT
+            };
+
         public:
 #ifdef __WINDOWS__
 #pragma warning(disable : 4355)
 #endif
             DHCPEngine(NetworkControl* parent, const string& interfaceName, const string& persistentStoragePath)
                 : _parent(*parent)
+                , _adminLock()
                 , _retries(0)
                 , _client(interfaceName, std::bind(&DHCPEngine::NewOffer, this, std::placeholders::_1), 
                           std::bind(&DHCPEngine::RequestResult, this, std::placeholders::_1, std::placeholders::_2))
                 , _leaseFilePath((persistentStoragePath.empty()) ? "" :  (persistentStoragePath + _client.Interface() + ".json"))
+                , _lease()
+                , _expires(0)
+                , _started(0)
+                , _restart(false)
+                , _probeState(PROBE_IDLE)
+                , _probed()
+                , _acknowledged()
+                , _deferred(false)
+                , _probe(interfaceName, std::bind(&DHCPEngine::ProbeResult, this, std::placeholders::_1, std::placeholders::_2))
             {
 
             }
@@ -357,12 +382,33 @@ namespace Plugin {
 
             void GetIP(const Core::NodeId& preferred)
             {
+                _adminLock.Lock();
+
+                if (_started == 0) {
+                    _started = Core::Time::Now().Ticks();
+                }
+
+                // A lease that has not expired yet is reclaimed without a discovery, but only once,
+                // if that fails the full exchange follows.
+                const bool reboot = ((preferred.IsValid() == false) && (_lease.IsValid() == true) && (_expires > (Core::Time::Now().Ticks() / (1000 /* MilliSeconds */ * 1000 /* MicroSeconds */))));
+                _expires = 0;
+
+                // The lease is replaced by whatever the server answers, which might be before we are done with it.
+                const DHCPClientImplementation::Offer lease(reboot == true ? _lease : DHCPClientImplementation::Offer());
+
+                _adminLock.Unlock();
 
-                auto offerIterator = _client.UnleasedOffers();
-                if (offerIterator.Next() == true) {
-                    Request(offerIterator.Current());
+                if (reboot == true) {
+                    SetupWatchdog();
+                    Probe(lease.Address());
+                    _client.Reboot(lease);
                 } else {
-                    Discover(preferred);
+                    auto offerIterator = _client.UnleasedOffers();
+                    if (offerIterator.Next() == true) {
+                        Request(offerIterator.Current());
+                    } else {
+                        Discover(preferred);
+                    }
                 }
             }
 
@@ -376,21 +422,46 @@ namespace Plugin {
             void RequestResult(const DHCPClientImplementation::Offer& offer, const bool result) {
                 StopWatchdog();
 
-                JsonData::NetworkControl::ConnectionchangeParamsData::StatusType status;
                 if (result == true) {
-                    _parent.RequestAccepted(_client.Interface(), offer);
-                    status = JsonData::NetworkControl::ConnectionchangeParamsData::StatusType::CONNECTED;
+                    bool probe = false;
+                    bool wait = false;
+
+                    _adminLock.Lock();
+
+                    // An ACK to a Rapid Commit has not been probed for yet.
+                    if ((_probeState == PROBE_IDLE) || (_probed.HostAddress() != offer.Address().HostAddress())) {
+                        _probed = offer.Address();
+                        _probeState = PROBE_RUNNING;
+                        probe = true;
+                    }
+
+                    // The address is only used once no one else turned out to use it.
+                    if (_probeState == PROBE_RUNNING) {
+                        _acknowledged = offer;
+                        _deferred = true;
+                        wait = true;
+                    }
+
+                    const bool conflict = (_probeState == PROBE_CONFLICT);
+
+                    _adminLock.Unlock();
+
+                    if (probe == true) {
+                        _probe.Probe(offer.Address());
+                    }
+                    if (wait == false) {
+                        Acknowledged(offer, conflict);
+                    }
                 } else {
                     _parent.RequestFailed(_client.Interface(), offer);
-                    status = JsonData::NetworkControl::ConnectionchangeParamsData::StatusType::CONNECTIONFAILED;
+                    _parent.event_connectionchange(_client.Interface().c_str(), offer.Address().HostAddress().c_str(), JsonData::NetworkControl::ConnectionchangeParamsData::StatusType::CONNECTIONFAILED);
                 }
-
-                _parent.event_connectionchange(_client.Interface().c_str(), offer.Address().HostAddress().c_str(), status);
             }
 
             inline void Request(const DHCPClientImplementation::Offer& offer) {
 
                 SetupWatchdog();
+                Probe(offer.Address());
                 _client.Request(offer);
             }
 
@@ -427,12 +498,21 @@ namespace Plugin {
             void CleanUp() 
             {
                 StopWatchdog();
+                _probe.Abort();
                 _client.Completed();
             }
 
             virtual void Dispatch() override
             {
-                if (_retries > 0) {
+                _adminLock.Lock();
+                const bool restart = _restart;
+                _restart = false;
+                _adminLock.Unlock();
+
+                if (restart == true) {
+                    // Start over, after an address was declined.
+                    Discover();
+                } else if (_retries > 0) {
                     const uint16_t responseMS = _parent.ResponseTime() * 1000;
                     Core::Time entry(Core::Time::Now().Add(responseMS));
                     Core::ProxyType<Core::IDispatch> job(*this);
@@ -445,6 +525,10 @@ namespace Plugin {
                 } else {
                     if (_client.Classification() == DHCPClientImplementation::CLASSIFICATION_DISCOVER) {
 
+                        _adminLock.Lock();
+                        _started = 0;
+                        _adminLock.Unlock();
+
                         // No acceptable offer found
                         _parent.NoOffers(_client.Interface());
                     } else if (_client.Classification() == DHCPClientImplementation::CLASSIFICATION_REQUEST) {
@@ -461,11 +545,94 @@ namespace Plugin {
                 }
             }
 
+        private:
+            // The address is probed for while it is being requested, so the ACK hardly waits for it.
+            void Probe(const Core::NodeId& address)
+            {
+                _adminLock.Lock();
+                _probed = address;
+                _probeState = PROBE_RUNNING;
+                _deferred = false;
+                _adminLock.Unlock();
+
+                _probe.Probe(address);
+            }
+
+            void ProbeResult(const Core::NodeId& address, const bool conflict)
+            {
+                bool proceed = false;
+                DHCPClientImplementation::Offer offer;
+
+                _adminLock.Lock();
+
+                if ((_probeState == PROBE_RUNNING) && (_probed.HostAddress() == address.HostAddress())) {
+                    _probeState = (conflict == true ? PROBE_CONFLICT : PROBE_CLEAR);
+
+                    if (_deferred == true) {
+                        _deferred = false;
+                        offer = _acknowledged;
+                        proceed = true;
+                    }
+                }
+
+                _adminLock.Unlock();
+
+                if (proceed == true) {
+                    Acknowledged(offer, conflict);
+                }
+            }
+
+            void Acknowledged(const DHCPClientImplementation::Offer& offer, const bool conflict)
+            {
+                JsonData::NetworkControl::ConnectionchangeParamsData::StatusType status;
+
+                if (conflict == false) {
+                    const uint64_t now = Core::Time::Now().Ticks();
+
+                    _adminLock.Lock();
+                    TRACE(Trace::Information, (_T("Address %s on %s after %d ms"), offer.Address().HostAddress().c_str(), _client.Interface().c_str(), static_cast<uint32_t>((now - _started) / 1000)));
+                    _lease = offer;
+                    _expires = (offer.LeaseTime() == static_cast<uint32_t>(~0) ? static_cast<uint64_t>(~0) : ((now / (1000 /* MilliSeconds */ * 1000 /* MicroSeconds */)) + offer.LeaseTime()));
+                    _started = 0;
+                    _probeState = PROBE_IDLE;
+                    _adminLock.Unlock();
+
+                    _parent.RequestAccepted(_client.Interface(), offer);
+                    status = JsonData::NetworkControl::ConnectionchangeParamsData::StatusType::CONNECTED;
+                } else {
+                    const Core::Time entry(Core::Time::Now().Add(DeclineBackoff));
+
+                    _adminLock.Lock();
+                    _lease = DHCPClientImplementation::Offer();
+                    _restart = true;
+                    _probeState = PROBE_IDLE;
+                    _adminLock.Unlock();
+
+                    _client.Decline(offer);
+
+                    // Start over, but not right away, in case the conflict is there to stay.
+                    Core::IWorkerPool::Instance().Schedule(entry, Core::ProxyType<Core::IDispatch>(*this));
+                    status = JsonData::NetworkControl::ConnectionchangeParamsData::StatusType::CONNECTIONFAILED;
+                }
+
+                _parent.event_connectionchange(_client.Interface().c_str(), offer.Address().HostAddress().c_str(), status);
+            }
+
         private:
             NetworkControl& _parent;
+            Core::CriticalSection _adminLock;
             uint8_t _retries;
             DHCPClientImplementation _client;
             string _leaseFilePath;
+            DHCPClientImplementation::Offer _lease; // the last lease, to reclaim with an INIT-REBOOT
+            uint64_t _expires; // seconds since the epoch, 0 if the lease can not be reclaimed
+            uint64_t _started; // ticks, when getting an address started
+            bool _restart;
+            probe _probeState;
+            Core::NodeId _probed;
+            DHCPClientImplementation::Offer _acknowledged; // waiting for the probe to finish
+            bool _deferred;
+            AddressProbe _probe;
         };
 
     private:
@@ -534,6 +701,7 @@ namespace Plugin {
         uint32_t get_network(const string& index, Core::JSON::ArrayType<JsonData::NetworkControl::NetworkData>& response) const;
         uint32_t get_up(const string& index, Core::JSON::Boolean& response) const;
         uint32_t set_up(const string& index, const Core::JSON::Boolean& param);
+        uint32_t get_dnscache(DNSForwarder::Statistics& response) const;
         void event_connectionchange(const string& name, const string& address, const JsonData::NetworkControl::ConnectionchangeParamsData::StatusType& status);
 
     private:
@@ -548,6 +716,7 @@ namespace Plugin {
         std::map<const string, StaticInfo> _interfaces;
         std::map<const string, Core::ProxyType<DHCPEngine>> _dhcpInterfaces;
         Core::ProxyType<AdapterObserver> _observer;
+        DNSForwarder* _forwarder;
     };
 
 } // namespace Plugin
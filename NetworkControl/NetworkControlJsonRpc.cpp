@@ -38,6 +38,7 @@ namespace Plugin {
         Register<ReloadParamsInfo,void>(_T("flush"), &NetworkControl::endpoint_flush, this);
         Property<Core::JSON::ArrayType<NetworkData>>(_T("network"), &NetworkControl::get_network, nullptr, this);
         Property<Core::JSON::Boolean>(_T("up"), &NetworkControl::get_up, &NetworkControl::set_up, this);
+        Property<DNSForwarder::Statistics>(_T("dnscache"), &NetworkControl::get_dnscache, nullptr, this);
     }
 
     void NetworkControl::UnregisterAll()
@@ -46,6 +47,7 @@ namespace Plugin {
         Unregister(_T("assign"));
         Unregister(_T("request"));
         Unregister(_T("reload"));
+        Unregister(_T("dnscache"));
         Unregister(_T("up"));
         Unregister(_T("network"));
     }
@@ -240,6 +242,22 @@ namespace Plugin {
         return result;
     }
 
+    // Property: dnscache - Statistics of the caching DNS forwarder
+    // Return codes:
+    //  - ERROR_NONE: Success
+    //  - ERROR_UNAVAILABLE: The DNS forwarder is not enabled
+    uint32_t NetworkControl::get_dnscache(DNSForwarder::Statistics& response) const
+    {
+        uint32_t result = Core::ERROR_UNAVAILABLE;
+
+        if (_forwarder != nullptr) {
+            _forwarder->Metrics(response);
+            result = Core::ERROR_NONE;
+        }
+
+        return result;
+    }
+
     // Event: connectionchange - Notifies about connection status (update, connected or connectionfailed)
     void NetworkControl::event_connectionchange(const string& name, const string& address, const ConnectionchangeParamsData::StatusType& status)
     {
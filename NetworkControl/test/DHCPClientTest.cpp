@@ -0,0 +1,254 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../Module.h"
+#include "../DHCPClientImplementation.h"
+#include "../../helpers/UnitTest.h"
+#include "DHCPServer.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+// Time to address against a stand-in server on the loopback, that takes a while to answer: the full
+// DISCOVER, OFFER, REQUEST and ACK exchange, the same with Rapid Commit, and an INIT-REBOOT from the
+// lease the first exchange got. An INIT-REBOOT for an address the server does not know is refused, after
+// which a discovery still gets one. The ARP probe that runs next to it needs a raw socket, it is left out.
+
+namespace {
+
+    const TCHAR Lease[] = _T("192.168.100.23");
+    const uint32_t Delay = 20; // ms, for every answer of the server
+    const uint32_t Rounds = 10;
+    const uint32_t WaitTime = 3000; // ms
+
+    // A port for the client, as the DHCP client port is privileged.
+    uint16_t FreePort()
+    {
+        uint16_t result = 0;
+        struct sockaddr_in address {};
+        socklen_t length = sizeof(address);
+        const int descriptor = ::socket(AF_INET, SOCK_DGRAM, 0);
+
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+
+        if (descriptor != -1) {
+            if ((::bind(descriptor, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0)
+                && (::getsockname(descriptor, reinterpret_cast<struct sockaddr*>(&address), &length) == 0)) {
+                result = ntohs(address.sin_port);
+            }
+            ::close(descriptor);
+        }
+
+        return (result);
+    }
+
+    // Stands in for the DHCP engine of the plugin: the first offer is requested, and the answer to the
+    // request is waited for.
+    class Engine {
+    public:
+        Engine(const Engine&) = delete;
+        Engine& operator=(const Engine&) = delete;
+
+        Engine(const uint16_t clientPort, const Core::NodeId& server)
+            : _lock()
+            , _signal()
+            , _answered(false)
+            , _acknowledged(false)
+            , _address()
+            , _client(_T("lo"), std::bind(&Engine::NewOffer, this, std::placeholders::_1), std::bind(&Engine::Claimed, this, std::placeholders::_1, std::placeholders::_2), clientPort, server)
+        {
+        }
+        ~Engine()
+        {
+            _client.Completed();
+        }
+
+    public:
+        DHCPClientImplementation& Client()
+        {
+            return (_client);
+        }
+
+        // Returns the time it took to get an answer, in ms, or WaitTime if none came.
+        template <typename ACTION>
+        double Claim(ACTION&& action, bool& acknowledged, string& address)
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            double result = WaitTime;
+
+            _answered = false;
+            lock.unlock();
+
+            const auto start = std::chrono::steady_clock::now();
+
+            CHECK(action() == Core::ERROR_NONE);
+
+            lock.lock();
+            if (_signal.wait_for(lock, std::chrono::milliseconds(WaitTime), [this]() { return (_answered == true); }) == true) {
+                result = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000;
+            }
+            acknowledged = _acknowledged;
+            address = _address;
+
+            return (result);
+        }
+
+    private:
+        void NewOffer(DHCPClientImplementation::Offer& offer)
+        {
+            _client.Request(offer);
+        }
+        void Claimed(DHCPClientImplementation::Offer& offer, const bool acknowledged)
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            _acknowledged = acknowledged;
+            _address = offer.Address().HostAddress();
+            _answered = true;
+            _signal.notify_all();
+        }
+
+    private:
+        std::mutex _lock;
+        std::condition_variable _signal;
+        bool _answered;
+        bool _acknowledged;
+        string _address;
+        DHCPClientImplementation _client;
+    };
+
+    template <typename ACTION>
+    void Measure(Engine& engine, const TCHAR label[], const uint32_t answers, ACTION&& action)
+    {
+        double total = 0;
+        double most = 0;
+
+        for (uint32_t round = 0; round < Rounds; round++) {
+            bool acknowledged = false;
+            string address;
+
+            const double elapsed = engine.Claim(action, acknowledged, address);
+
+            CHECK(acknowledged == true);
+            CHECK(address == Lease);
+            CHECK(elapsed >= (answers * Delay));
+            CHECK(elapsed < WaitTime);
+
+            total += elapsed;
+            most = std::max(most, elapsed);
+        }
+
+        printf("%-14s %u answers of %u ms: %6.1f ms average, %6.1f ms at most\n", label, answers, Delay, total / Rounds, most);
+    }
+
+    void TestDiscover(Engine& engine, DHCPLoopback::Server& server)
+    {
+        DHCPClientImplementation& client(engine.Client());
+
+        server.Configure({ Delay, false });
+
+        Measure(engine, _T("DISCOVER"), 2, [&]() { return (client.Discover(Core::NodeId())); });
+
+        CHECK(server.Discovers() == Rounds);
+        CHECK(server.Requests() == Rounds);
+    }
+
+    void TestRapidCommit(Engine& engine, DHCPLoopback::Server& server)
+    {
+        DHCPClientImplementation& client(engine.Client());
+        const uint32_t requests = server.Requests();
+
+        server.Configure({ Delay, true });
+
+        Measure(engine, _T("Rapid Commit"), 1, [&]() { return (client.Discover(Core::NodeId())); });
+
+        // The ACK came straight away, there was nothing to request.
+        CHECK(server.Requests() == requests);
+    }
+
+    void TestReboot(Engine& engine, DHCPLoopback::Server& server)
+    {
+        DHCPClientImplementation& client(engine.Client());
+        const DHCPClientImplementation::Offer lease(client.LeasedOffer());
+        const uint32_t discovers = server.Discovers();
+
+        server.Configure({ Delay, false });
+
+        CHECK(lease.IsValid() == true);
+
+        Measure(engine, _T("INIT-REBOOT"), 1, [&]() { return (client.Reboot(lease)); });
+
+        CHECK(server.Reboots() == Rounds);
+        CHECK(server.Discovers() == discovers);
+    }
+
+    // A lease from another network is refused, the engine starts a discovery then.
+    void TestStaleLease(Engine& engine, DHCPLoopback::Server& server)
+    {
+        DHCPClientImplementation& client(engine.Client());
+        DHCPClientImplementation::Offer::JSON stored;
+        bool acknowledged = true;
+        string address;
+
+        stored.FromString(_T("{\"source\":\"127.0.0.1\",\"offer\":\"10.1.1.7\",\"netmask\":24,\"leaseTime\":3600}"));
+
+        const DHCPClientImplementation::Offer stale(stored.Get());
+
+        server.Configure({ 0, true });
+
+        CHECK(engine.Claim([&]() { return (client.Reboot(stale)); }, acknowledged, address) < WaitTime);
+        CHECK(acknowledged == false);
+        CHECK(address == _T("10.1.1.7"));
+        CHECK(server.Naks() == 1);
+
+        CHECK(engine.Claim([&]() { return (client.Discover(Core::NodeId())); }, acknowledged, address) < WaitTime);
+        CHECK(acknowledged == true);
+        CHECK(address == Lease);
+    }
+}
+
+int main()
+{
+    {
+        DHCPLoopback::Server server(Lease);
+        const uint16_t clientPort = FreePort();
+
+        CHECK(server.Start() == true);
+        CHECK(clientPort != 0);
+
+        if ((server.Port() != 0) && (clientPort != 0)) {
+            Engine engine(clientPort, Core::NodeId(_T("127.0.0.1"), server.Port(), Core::NodeId::TYPE_IPV4));
+
+            TestDiscover(engine, server);
+            TestRapidCommit(engine, server);
+            TestReboot(engine, server);
+            TestStaleLease(engine, server);
+        }
+
+        server.Stop();
+    }
+
+    Core::Singleton::Dispose();
+
+    return (UnitTest::Result());
+}
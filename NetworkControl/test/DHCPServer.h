@@ -0,0 +1,305 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace WPEFramework {
+namespace DHCPLoopback {
+
+    // A stand-in DHCP server on the loopback, with one address to lease. It answers every message after
+    // the delay it is given, as a server a few hops away would, with or without Rapid Commit (RFC 4039).
+    // An INIT-REBOOT REQUEST for the address it leases is acknowledged, one for another address is not.
+    // No framework dependencies, it is checked on its own.
+    class Server {
+    private:
+        static constexpr uint16_t FixedSize = 240; // up to and including the magic cookie
+
+        enum types : uint8_t {
+            DISCOVER = 1,
+            OFFER = 2,
+            REQUEST = 3,
+            DECLINE = 4,
+            ACK = 5,
+            NAK = 6
+        };
+
+        struct Outgoing {
+            std::chrono::steady_clock::time_point Due;
+            struct sockaddr_in Destination;
+            std::vector<uint8_t> Data;
+        };
+
+    public:
+        struct Policy {
+            uint32_t Delay; // ms
+            bool RapidCommit;
+        };
+
+    public:
+        Server(const Server&) = delete;
+        Server& operator=(const Server&) = delete;
+
+        explicit Server(const char lease[])
+            : _lock()
+            , _policy({ 0, false })
+            , _lease()
+            , _socket(-1)
+            , _port(0)
+            , _running(false)
+            , _thread()
+            , _discovers(0)
+            , _requests(0)
+            , _reboots(0)
+            , _declines(0)
+            , _naks(0)
+        {
+            ::inet_pton(AF_INET, lease, &_lease);
+        }
+        ~Server()
+        {
+            Stop();
+        }
+
+    public:
+        bool Start()
+        {
+            struct sockaddr_in address {};
+            socklen_t length = sizeof(address);
+
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port = 0;
+
+            _socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+
+            if ((_socket != -1)
+                && (::bind(_socket, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0)
+                && (::getsockname(_socket, reinterpret_cast<struct sockaddr*>(&address), &length) == 0)) {
+
+                _port = ntohs(address.sin_port);
+                _running = true;
+                _thread = std::thread(&Server::Run, this);
+            } else if (_socket != -1) {
+                ::close(_socket);
+                _socket = -1;
+            }
+
+            return (_running == true);
+        }
+        void Stop()
+        {
+            if (_running == true) {
+                _running = false;
+                _thread.join();
+            }
+            if (_socket != -1) {
+                ::close(_socket);
+                _socket = -1;
+            }
+        }
+        uint16_t Port() const
+        {
+            return (_port);
+        }
+        void Configure(const Policy& policy)
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _policy = policy;
+        }
+
+        uint32_t Discovers() const
+        {
+            return (_discovers);
+        }
+        // REQUESTs for an offer, that name this server.
+        uint32_t Requests() const
+        {
+            return (_requests);
+        }
+        // REQUESTs from the INIT-REBOOT state, that name no server.
+        uint32_t Reboots() const
+        {
+            return (_reboots);
+        }
+        uint32_t Declines() const
+        {
+            return (_declines);
+        }
+        uint32_t Naks() const
+        {
+            return (_naks);
+        }
+
+    private:
+        void Run()
+        {
+            std::deque<Outgoing> outgoing;
+
+            while (_running == true) {
+                struct pollfd slot = { _socket, POLLIN, 0 };
+
+                if ((::poll(&slot, 1, 1) > 0) && ((slot.revents & POLLIN) != 0)) {
+                    uint8_t buffer[1500];
+                    struct sockaddr_in source {};
+                    socklen_t length = sizeof(source);
+                    const ssize_t size = ::recvfrom(_socket, buffer, sizeof(buffer), 0, reinterpret_cast<struct sockaddr*>(&source), &length);
+
+                    if (size > FixedSize) {
+                        Handle(buffer, static_cast<uint16_t>(size), source, outgoing);
+                    }
+                }
+
+                const auto now = std::chrono::steady_clock::now();
+
+                while ((outgoing.empty() == false) && (outgoing.front().Due <= now)) {
+                    const Outgoing& entry(outgoing.front());
+                    ::sendto(_socket, entry.Data.data(), entry.Data.size(), 0, reinterpret_cast<const struct sockaddr*>(&entry.Destination), sizeof(entry.Destination));
+                    outgoing.pop_front();
+                }
+            }
+        }
+
+        void Handle(const uint8_t message[], const uint16_t length, const struct sockaddr_in& source, std::deque<Outgoing>& outgoing)
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+
+            uint8_t type = 0;
+            bool rapidCommit = false;
+            bool serverIdentifier = false;
+            struct in_addr requested {};
+            uint16_t index = FixedSize;
+
+            while ((index < length) && (message[index] != 255)) {
+                if (message[index] == 0) {
+                    index++;
+                } else if ((index + 1) < length) {
+                    const uint8_t option = message[index];
+                    const uint8_t size = message[index + 1];
+                    const uint8_t* value = &(message[index + 2]);
+
+                    if ((index + 2 + size) <= length) {
+                        if ((option == 53) && (size == 1)) {
+                            type = value[0];
+                        } else if ((option == 50) && (size == 4)) {
+                            ::memcpy(&requested, value, 4);
+                        } else if (option == 54) {
+                            serverIdentifier = true;
+                        } else if (option == 80) {
+                            rapidCommit = true;
+                        }
+                    }
+                    index += 2 + size;
+                } else {
+                    index = length;
+                }
+            }
+
+            uint8_t answer = 0;
+
+            if (type == DISCOVER) {
+                _discovers++;
+                answer = (((rapidCommit == true) && (_policy.RapidCommit == true)) ? ACK : OFFER);
+                rapidCommit = (answer == ACK);
+            } else if (type == REQUEST) {
+                if (serverIdentifier == true) {
+                    _requests++;
+                } else {
+                    _reboots++;
+                }
+                answer = (requested.s_addr == _lease.s_addr ? ACK : NAK);
+                _naks += (answer == NAK ? 1 : 0);
+                rapidCommit = false;
+            } else if (type == DECLINE) {
+                _declines++;
+            }
+
+            if (answer != 0) {
+                outgoing.push_back({ std::chrono::steady_clock::now() + std::chrono::milliseconds(_policy.Delay), source, Reply(message, answer, rapidCommit) });
+            }
+        }
+
+        std::vector<uint8_t> Reply(const uint8_t request[], const uint8_t type, const bool rapidCommit) const
+        {
+            std::vector<uint8_t> result(request, request + FixedSize);
+            const struct in_addr server = { htonl(INADDR_LOOPBACK) };
+            const uint8_t netmask[] = { 255, 255, 255, 0 };
+            const uint8_t leaseTime[] = { 0, 0, 0x0E, 0x10 }; // 3600 s
+
+            result[0] = 2; // BOOTREPLY
+            ::memset(&(result[12]), 0, 16); // ciaddr, yiaddr, siaddr and giaddr
+            if (type != NAK) {
+                ::memcpy(&(result[16]), &_lease, 4); // yiaddr
+            }
+            ::memcpy(&(result[20]), &server, 4); // siaddr
+
+            Option(result, 53, &type, 1);
+            Option(result, 54, reinterpret_cast<const uint8_t*>(&server), 4);
+            if (type != NAK) {
+                Option(result, 51, leaseTime, sizeof(leaseTime));
+                Option(result, 1, netmask, sizeof(netmask));
+                Option(result, 3, reinterpret_cast<const uint8_t*>(&server), 4);
+                Option(result, 6, reinterpret_cast<const uint8_t*>(&server), 4);
+            }
+            if (rapidCommit == true) {
+                Option(result, 80, nullptr, 0);
+            }
+            result.push_back(255);
+
+            return (result);
+        }
+
+        static void Option(std::vector<uint8_t>& message, const uint8_t option, const uint8_t value[], const uint8_t size)
+        {
+            message.push_back(option);
+            message.push_back(size);
+            message.insert(message.end(), value, value + size);
+        }
+
+    private:
+        std::mutex _lock;
+        Policy _policy;
+        struct in_addr _lease;
+        int _socket;
+        uint16_t _port;
+        std::atomic<bool> _running;
+        std::thread _thread;
+        std::atomic<uint32_t> _discovers;
+        std::atomic<uint32_t> _requests;
+        std::atomic<uint32_t> _reboots;
+        std::atomic<uint32_t> _declines;
+        std::atomic<uint32_t> _naks;
+    };
+
+} // namespace DHCPLoopback
+} // namespace WPEFramework
@@ -0,0 +1,340 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../Module.h"
+#include "../DNSForwarder.h"
+#include "../../helpers/UnitTest.h"
+#include "Resolver.h"
+
+#include <chrono>
+#include <thread>
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+// The forwarder in front of a stand-in upstream resolver on the loopback: questions go out from the
+// sockets of the pool with random ids, identical questions that are underway are asked once for all that
+// ask them, and a popular name is asked again before it expires, where one that is not, just expires.
+
+namespace {
+
+    const uint32_t WaitTime = 2000; // ms
+
+    class Dispatcher : public Core::ThreadPool::IDispatcher {
+    public:
+        Dispatcher(const Dispatcher&) = delete;
+        Dispatcher& operator=(const Dispatcher&) = delete;
+
+        Dispatcher() = default;
+        ~Dispatcher() override = default;
+
+    private:
+        void Initialize() override
+        {
+        }
+        void Deinitialize() override
+        {
+        }
+        void Dispatch(Core::IDispatch* job) override
+        {
+            job->Dispatch();
+        }
+    };
+
+    class WorkerPool : public Core::WorkerPool {
+    public:
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        WorkerPool()
+            : Core::WorkerPool(2, Core::Thread::DefaultStackSize(), 16, &_dispatcher)
+            , _dispatcher()
+        {
+            Core::IWorkerPool::Assign(this);
+            Run();
+        }
+        ~WorkerPool()
+        {
+            Stop();
+            Core::IWorkerPool::Assign(nullptr);
+        }
+
+    private:
+        Dispatcher _dispatcher;
+    };
+
+    // A client of the forwarder, as a resolver on the box is, with a socket of its own.
+    class Client {
+    public:
+        Client(const Client&) = delete;
+        Client& operator=(const Client&) = delete;
+
+        Client()
+            : _socket(::socket(AF_INET, SOCK_DGRAM, 0))
+        {
+            struct sockaddr_in address {};
+
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+            if ((_socket != -1) && (::bind(_socket, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0)) {
+                ::close(_socket);
+                _socket = -1;
+            }
+        }
+        ~Client()
+        {
+            if (_socket != -1) {
+                ::close(_socket);
+            }
+        }
+
+    public:
+        bool Ask(const uint16_t port, const uint16_t id, const string& name)
+        {
+            const std::vector<uint8_t> query(DNSLoopback::Resolver::Query(id, name));
+            struct sockaddr_in address {};
+
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port = htons(port);
+
+            _query = query;
+
+            return (::sendto(_socket, query.data(), query.size(), 0, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == static_cast<ssize_t>(query.size()));
+        }
+        // The address answered to the last question, with the id and question as asked, empty if none came.
+        string Answer(uint32_t& ttl)
+        {
+            string result;
+            struct pollfd slot = { _socket, POLLIN, 0 };
+            uint8_t answer[512];
+            ssize_t length = 0;
+
+            if ((::poll(&slot, 1, WaitTime) > 0) && ((length = ::recv(_socket, answer, sizeof(answer), 0)) > 0)) {
+                const size_t size = static_cast<size_t>(length);
+
+                CHECK(size == (_query.size() + 16));
+                CHECK((size >= _query.size()) && (::memcmp(answer, _query.data(), 2) == 0));
+                CHECK((size >= _query.size()) && (::memcmp(&answer[DNSMessage::HeaderSize], &_query[DNSMessage::HeaderSize], _query.size() - DNSMessage::HeaderSize) == 0));
+
+                if ((size == (_query.size() + 16)) && (DNSMessage::Get16(&answer[6]) == 1)) {
+                    const uint8_t* record = &answer[_query.size()];
+
+                    ttl = DNSMessage::Get32(&record[6]);
+                    result = Core::NumberType<uint8_t>(record[12]).Text() + '.' + Core::NumberType<uint8_t>(record[13]).Text() + '.' + Core::NumberType<uint8_t>(record[14]).Text() + '.' + Core::NumberType<uint8_t>(record[15]).Text();
+                }
+            }
+
+            return (result);
+        }
+        string Resolve(const uint16_t port, const uint16_t id, const string& name)
+        {
+            uint32_t ttl;
+            return (Ask(port, id, name) == true ? Answer(ttl) : string());
+        }
+
+    private:
+        int _socket;
+        std::vector<uint8_t> _query;
+    };
+
+    uint16_t FreePort()
+    {
+        uint16_t result = 0;
+        struct sockaddr_in address {};
+        socklen_t length = sizeof(address);
+        const int descriptor = ::socket(AF_INET, SOCK_DGRAM, 0);
+
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if (descriptor != -1) {
+            if ((::bind(descriptor, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0)
+                && (::getsockname(descriptor, reinterpret_cast<struct sockaddr*>(&address), &length) == 0)) {
+                result = ntohs(address.sin_port);
+            }
+            ::close(descriptor);
+        }
+
+        return (result);
+    }
+
+    struct Counters {
+        uint32_t Hits;
+        uint32_t Misses;
+        uint32_t Coalesced;
+        uint32_t Prefetches;
+        uint32_t MaxLatency;
+    };
+
+    Counters Metrics(const DNSForwarder& forwarder)
+    {
+        DNSForwarder::Statistics info;
+
+        forwarder.Metrics(info);
+
+        return (Counters { info.Hits.Value(), info.Misses.Value(), info.Coalesced.Value(), info.Prefetches.Value(), info.MaxLatency.Value() });
+    }
+
+    // 64 names, each asked upstream once, from the sockets of the pool, each with an id of its own.
+    void TestSocketPool(const DNSForwarder& forwarder, DNSLoopback::Resolver& resolver)
+    {
+        const uint16_t port = forwarder.Address().PortNumber();
+        Client client;
+
+        resolver.Configure({ 0, 60 });
+
+        for (uint16_t index = 0; index < 64; index++) {
+            const string name(_T("host") + Core::NumberType<uint16_t>(index).Text() + _T(".pool.test"));
+
+            CHECK(client.Resolve(port, index, name) == (_T("10.0.0.") + Core::NumberType<uint16_t>(index + 1).Text()));
+        }
+
+        CHECK(resolver.Questions() == 64);
+        CHECK(resolver.Ports() > 8);
+        CHECK(resolver.Ports() <= 16);
+        CHECK(resolver.LowestPort() >= 1024);
+        CHECK(resolver.Ids() >= 60);
+
+        // From the cache now, with the question in the case it was asked in.
+        CHECK(client.Resolve(port, 1000, _T("HOST7.Pool.Test")) == _T("10.0.0.8"));
+        CHECK(resolver.Questions(_T("host7.pool.test")) == 1);
+
+        printf("64 questions upstream from %u ports, with %u ids\n", resolver.Ports(), resolver.Ids());
+    }
+
+    // 16 clients ask the same name, in different cases, while the upstream resolver takes its time.
+    void TestCoalescing(const DNSForwarder& forwarder, DNSLoopback::Resolver& resolver)
+    {
+        const uint16_t port = forwarder.Address().PortNumber();
+        const Counters before(Metrics(forwarder));
+        Client clients[16];
+
+        resolver.Configure({ 100, 60 });
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (uint16_t index = 0; index < 16; index++) {
+            CHECK(clients[index].Ask(port, static_cast<uint16_t>(2000 + index), ((index % 2) == 0 ? _T("same.coalesce.test") : _T("Same.Coalesce.TEST"))) == true);
+        }
+
+        string first;
+
+        for (uint16_t index = 0; index < 16; index++) {
+            uint32_t ttl = 0;
+            const string address(clients[index].Answer(ttl));
+
+            CHECK(address.empty() == false);
+            CHECK((index == 0) || (address == first));
+            first = (index == 0 ? address : first);
+        }
+
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000;
+        const Counters after(Metrics(forwarder));
+
+        CHECK(resolver.Questions(_T("same.coalesce.test")) == 1);
+        CHECK((after.Misses - before.Misses) == 1);
+        CHECK((after.Coalesced - before.Coalesced) == 15);
+        CHECK(after.MaxLatency >= 100000);
+
+        printf("16 clients, 1 question upstream, answered in %.1f ms\n", elapsed);
+    }
+
+    // A popular name is asked again in the last 10% of its TTL, so it never expires. A name asked just
+    // once, does.
+    void TestPrefetch(const DNSForwarder& forwarder, DNSLoopback::Resolver& resolver)
+    {
+        const uint16_t port = forwarder.Address().PortNumber();
+        const Counters before(Metrics(forwarder));
+        Client client;
+        uint32_t ttl = 0;
+
+        resolver.Configure({ 0, 2 });
+
+        CHECK(client.Resolve(port, 1, _T("popular.prefetch.test")).empty() == false);
+        CHECK(client.Resolve(port, 2, _T("once.prefetch.test")).empty() == false);
+
+        const auto start = std::chrono::steady_clock::now();
+
+        CHECK(client.Resolve(port, 3, _T("popular.prefetch.test")).empty() == false);
+        CHECK(client.Resolve(port, 4, _T("popular.prefetch.test")).empty() == false);
+
+        // 150 ms before it expires.
+        std::this_thread::sleep_until(start + std::chrono::milliseconds(1850));
+
+        CHECK(client.Resolve(port, 5, _T("popular.prefetch.test")).empty() == false);
+        CHECK(client.Resolve(port, 6, _T("once.prefetch.test")).empty() == false);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        CHECK(resolver.Questions(_T("popular.prefetch.test")) == 2);
+        CHECK(resolver.Questions(_T("once.prefetch.test")) == 1);
+
+        // Past the first TTL: the popular name is still in the cache, the other one is asked again.
+        std::this_thread::sleep_until(start + std::chrono::milliseconds(2300));
+
+        CHECK(client.Ask(port, 7, _T("popular.prefetch.test")) == true);
+        CHECK(client.Answer(ttl).empty() == false);
+        CHECK((ttl >= 1) && (ttl <= 2));
+        CHECK(client.Resolve(port, 8, _T("once.prefetch.test")).empty() == false);
+
+        const Counters after(Metrics(forwarder));
+
+        CHECK(resolver.Questions(_T("popular.prefetch.test")) == 2);
+        CHECK(resolver.Questions(_T("once.prefetch.test")) == 2);
+        CHECK((after.Prefetches - before.Prefetches) == 1);
+        CHECK((after.Hits - before.Hits) == 5);
+    }
+}
+
+int main()
+{
+    {
+        WorkerPool workerPool;
+        DNSLoopback::Resolver resolver;
+        DNSForwarder::Config config;
+
+        config.Port = FreePort();
+        config.Prefetch = true;
+
+        CHECK(resolver.Start() == true);
+        CHECK(config.Port.Value() != 0);
+
+        DNSForwarder forwarder(config);
+
+        if ((resolver.Port() != 0) && (forwarder.Open() == Core::ERROR_NONE)) {
+            forwarder.Servers({ Core::NodeId(_T("127.0.0.1"), resolver.Port(), Core::NodeId::TYPE_IPV4) });
+
+            TestSocketPool(forwarder, resolver);
+            TestCoalescing(forwarder, resolver);
+            TestPrefetch(forwarder, resolver);
+
+            forwarder.Close();
+        } else {
+            CHECK(false);
+        }
+
+        resolver.Stop();
+    }
+
+    Core::Singleton::Dispose();
+
+    return (UnitTest::Result());
+}
@@ -0,0 +1,219 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../DNSMessage.h"
+#include "../../helpers/UnitTest.h"
+
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+namespace {
+
+    const uint16_t TypeA = 1;
+
+    void Add16(std::vector<uint8_t>& message, const uint16_t value)
+    {
+        message.push_back(static_cast<uint8_t>(value >> 8));
+        message.push_back(static_cast<uint8_t>(value));
+    }
+    void Add32(std::vector<uint8_t>& message, const uint32_t value)
+    {
+        Add16(message, static_cast<uint16_t>(value >> 16));
+        Add16(message, static_cast<uint16_t>(value));
+    }
+
+    // A response to "Example.COM IN A", the records are to be added, in the counted order.
+    std::vector<uint8_t> Response(const uint16_t flags, const uint16_t answers, const uint16_t authorities, const uint16_t additionals)
+    {
+        static const uint8_t question[] = { 7, 'E', 'x', 'a', 'm', 'p', 'l', 'e', 3, 'C', 'O', 'M', 0, 0, 1, 0, 1 };
+        std::vector<uint8_t> message;
+
+        Add16(message, 0x1234);
+        Add16(message, DNSMessage::FlagResponse | flags);
+        Add16(message, 1);
+        Add16(message, answers);
+        Add16(message, authorities);
+        Add16(message, additionals);
+        message.insert(message.end(), question, question + sizeof(question));
+
+        return (message);
+    }
+
+    // A record for the name in the question, through a compression pointer.
+    void Record(std::vector<uint8_t>& message, const uint16_t type, const uint32_t ttl, const std::vector<uint8_t>& data)
+    {
+        Add16(message, 0xC00C);
+        Add16(message, type);
+        Add16(message, 1);
+        Add32(message, ttl);
+        Add16(message, static_cast<uint16_t>(data.size()));
+        message.insert(message.end(), data.begin(), data.end());
+    }
+
+    std::vector<uint8_t> SOA(const uint32_t minimum)
+    {
+        // Root names for the primary and the mailbox, then serial, refresh, retry, expire and minimum.
+        std::vector<uint8_t> data = { 0, 0 };
+
+        Add32(data, 1);
+        Add32(data, 7200);
+        Add32(data, 3600);
+        Add32(data, 1209600);
+        Add32(data, minimum);
+
+        return (data);
+    }
+
+    const std::vector<uint8_t> Address = { 192, 168, 1, 1 };
+
+    // Offset past the question, where the records start.
+    uint16_t Records(const std::vector<uint8_t>& message)
+    {
+        std::string question;
+        std::string key;
+
+        return (DNSMessage::Parse(message.data(), static_cast<uint16_t>(message.size()), question, key));
+    }
+
+    bool Lifetime(const std::vector<uint8_t>& message, std::vector<uint16_t>& fields, uint32_t& ttl)
+    {
+        return (DNSMessage::Lifetime(message.data(), static_cast<uint16_t>(message.size()), Records(message), fields, ttl));
+    }
+
+    void TestParse()
+    {
+        const std::vector<uint8_t> message(Response(0, 0, 0, 0));
+        std::string question;
+        std::string key;
+
+        CHECK(DNSMessage::Parse(message.data(), static_cast<uint16_t>(message.size()), question, key) == message.size());
+        CHECK(question.size() == 17);
+        CHECK(question.compare(0, 13, std::string("\x07" "Example" "\x03" "COM", 13)) == 0);
+        CHECK(key.compare(0, 13, std::string("\x07" "example" "\x03" "com", 13)) == 0);
+        CHECK(question.compare(13, 4, key, 13, 4) == 0);
+
+        // Cut off in the type and class.
+        CHECK(DNSMessage::Parse(message.data(), static_cast<uint16_t>(message.size() - 1), question, key) == 0);
+    }
+
+    void TestPositive()
+    {
+        std::vector<uint8_t> message(Response(DNSMessage::FlagRecursionAvailable, 2, 0, 1));
+        std::vector<uint16_t> fields;
+        uint32_t ttl = 0;
+
+        // The lowest TTL counts, the OPT record has none.
+        Record(message, TypeA, 300, Address);
+        Record(message, TypeA, 120, Address);
+        Record(message, DNSMessage::TypeOPT, 0x00008000, {});
+
+        CHECK(Lifetime(message, fields, ttl) == true);
+        CHECK(ttl == 120);
+        CHECK(fields.size() == 2);
+        CHECK(DNSMessage::Get32(&message[fields[0]]) == 300);
+        CHECK(DNSMessage::Get32(&message[fields[1]]) == 120);
+    }
+
+    void TestNotKept()
+    {
+        std::vector<uint16_t> fields;
+        uint32_t ttl = 0;
+
+        // RFC 2181, the most significant bit set is a TTL of 0, which is not to be kept.
+        std::vector<uint8_t> message(Response(0, 2, 0, 0));
+        Record(message, TypeA, 300, Address);
+        Record(message, TypeA, 0x80000010, Address);
+        CHECK(Lifetime(message, fields, ttl) == false);
+
+        std::vector<uint8_t> truncated(Response(DNSMessage::FlagTruncated, 1, 0, 0));
+        Record(truncated, TypeA, 300, Address);
+        CHECK(Lifetime(truncated, fields, ttl) == false);
+
+        std::vector<uint8_t> failure(Response(DNSMessage::CodeServerFailure, 1, 0, 0));
+        Record(failure, TypeA, 300, Address);
+        CHECK(Lifetime(failure, fields, ttl) == false);
+
+        // A record that runs past the end of the message.
+        std::vector<uint8_t> cut(Response(0, 1, 0, 0));
+        Record(cut, TypeA, 300, Address);
+        cut.pop_back();
+        CHECK(Lifetime(cut, fields, ttl) == false);
+    }
+
+    void TestNegative()
+    {
+        std::vector<uint16_t> fields;
+        uint32_t ttl = 0;
+
+        // RFC 2308, the lower of the SOA TTL and its MINIMUM.
+        std::vector<uint8_t> absent(Response(DNSMessage::CodeNameError, 0, 1, 0));
+        Record(absent, DNSMessage::TypeSOA, 900, SOA(60));
+        CHECK(Lifetime(absent, fields, ttl) == true);
+        CHECK(ttl == 60);
+
+        std::vector<uint8_t> young(Response(DNSMessage::CodeNameError, 0, 1, 0));
+        Record(young, DNSMessage::TypeSOA, 30, SOA(600));
+        CHECK(Lifetime(young, fields, ttl) == true);
+        CHECK(ttl == 30);
+
+        // No data for this type is negative as well.
+        std::vector<uint8_t> empty(Response(DNSMessage::CodeNoError, 0, 1, 0));
+        Record(empty, DNSMessage::TypeSOA, 900, SOA(120));
+        CHECK(Lifetime(empty, fields, ttl) == true);
+        CHECK(ttl == 120);
+
+        // Without an SOA there is nothing to say how long it lasts, so it is not kept.
+        std::vector<uint8_t> bare(Response(DNSMessage::CodeNameError, 0, 0, 0));
+        CHECK(Lifetime(bare, fields, ttl) == false);
+
+        // An SOA in the additional section does not count.
+        std::vector<uint8_t> elsewhere(Response(DNSMessage::CodeNameError, 0, 0, 1));
+        Record(elsewhere, DNSMessage::TypeSOA, 900, SOA(60));
+        CHECK(Lifetime(elsewhere, fields, ttl) == false);
+    }
+
+    void TestAge()
+    {
+        std::vector<uint8_t> message(Response(0, 2, 0, 0));
+        std::vector<uint16_t> fields;
+        uint32_t ttl = 0;
+
+        Record(message, TypeA, 300, Address);
+        Record(message, TypeA, 30, Address);
+
+        CHECK(Lifetime(message, fields, ttl) == true);
+
+        DNSMessage::Age(message.data(), fields, 50);
+
+        CHECK(DNSMessage::Get32(&message[fields[0]]) == 250);
+        CHECK(DNSMessage::Get32(&message[fields[1]]) == 0);
+    }
+}
+
+int main()
+{
+    TestParse();
+    TestPositive();
+    TestNotKept();
+    TestNegative();
+    TestAge();
+
+    return (UnitTest::Result());
+}
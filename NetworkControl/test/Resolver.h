@@ -0,0 +1,288 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "../DNSMessage.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace WPEFramework {
+namespace DNSLoopback {
+
+    // A stand-in upstream resolver on the loopback. Every name gets an A record of its own, 10.0.0.<n>
+    // for the n-th name it was asked for, with the TTL it is given, after the delay it is given. It keeps
+    // track of what it was asked, how often, and from which ports with which ids. No framework
+    // dependencies, it is checked on its own.
+    class Resolver {
+    private:
+        struct Outgoing {
+            std::chrono::steady_clock::time_point Due;
+            struct sockaddr_in Destination;
+            std::vector<uint8_t> Data;
+        };
+
+    public:
+        struct Policy {
+            uint32_t Delay; // ms
+            uint32_t TTL; // s
+        };
+
+    public:
+        Resolver(const Resolver&) = delete;
+        Resolver& operator=(const Resolver&) = delete;
+
+        Resolver()
+            : _lock()
+            , _policy({ 0, 60 })
+            , _socket(-1)
+            , _port(0)
+            , _running(false)
+            , _thread()
+            , _questions()
+            , _addresses()
+            , _ports()
+            , _ids()
+            , _total(0)
+        {
+        }
+        ~Resolver()
+        {
+            Stop();
+        }
+
+    public:
+        bool Start()
+        {
+            struct sockaddr_in address {};
+            socklen_t length = sizeof(address);
+
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port = 0;
+
+            _socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+
+            if ((_socket != -1)
+                && (::bind(_socket, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0)
+                && (::getsockname(_socket, reinterpret_cast<struct sockaddr*>(&address), &length) == 0)) {
+
+                _port = ntohs(address.sin_port);
+                _running = true;
+                _thread = std::thread(&Resolver::Run, this);
+            } else if (_socket != -1) {
+                ::close(_socket);
+                _socket = -1;
+            }
+
+            return (_running == true);
+        }
+        void Stop()
+        {
+            if (_running == true) {
+                _running = false;
+                _thread.join();
+            }
+            if (_socket != -1) {
+                ::close(_socket);
+                _socket = -1;
+            }
+        }
+        uint16_t Port() const
+        {
+            return (_port);
+        }
+        void Configure(const Policy& policy)
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _policy = policy;
+        }
+
+        // Questions for a name, in any case.
+        uint32_t Questions(const std::string& name) const
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            const std::map<std::string, uint32_t>::const_iterator index(_questions.find(Lower(name)));
+            return (index != _questions.end() ? index->second : 0);
+        }
+        uint32_t Questions() const
+        {
+            return (_total);
+        }
+        // The different source ports and ids the questions came with.
+        uint32_t Ports() const
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            return (static_cast<uint32_t>(_ports.size()));
+        }
+        uint16_t LowestPort() const
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            return (_ports.empty() == true ? 0 : *(_ports.begin()));
+        }
+        uint32_t Ids() const
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            return (static_cast<uint32_t>(_ids.size()));
+        }
+
+        // The question as a client sends it, for an A record.
+        static std::vector<uint8_t> Query(const uint16_t id, const std::string& name)
+        {
+            std::vector<uint8_t> result(Plugin::DNSMessage::HeaderSize, 0);
+            size_t start = 0;
+
+            Plugin::DNSMessage::Set16(&result[0], id);
+            Plugin::DNSMessage::Set16(&result[2], Plugin::DNSMessage::FlagRecursionDesired);
+            Plugin::DNSMessage::Set16(&result[4], 1);
+
+            while (start < name.size()) {
+                size_t end = name.find('.', start);
+
+                if (end == std::string::npos) {
+                    end = name.size();
+                }
+
+                result.push_back(static_cast<uint8_t>(end - start));
+                result.insert(result.end(), name.begin() + start, name.begin() + end);
+                start = end + 1;
+            }
+
+            result.push_back(0);
+            result.push_back(0);
+            result.push_back(1); // A
+            result.push_back(0);
+            result.push_back(1); // IN
+
+            return (result);
+        }
+
+        static std::string Lower(const std::string& name)
+        {
+            std::string result(name);
+
+            for (char& letter : result) {
+                if ((letter >= 'A') && (letter <= 'Z')) {
+                    letter = static_cast<char>(letter - 'A' + 'a');
+                }
+            }
+
+            return (result);
+        }
+
+    private:
+        void Run()
+        {
+            std::deque<Outgoing> outgoing;
+
+            while (_running == true) {
+                struct pollfd slot = { _socket, POLLIN, 0 };
+
+                if ((::poll(&slot, 1, 1) > 0) && ((slot.revents & POLLIN) != 0)) {
+                    uint8_t buffer[512];
+                    struct sockaddr_in source {};
+                    socklen_t length = sizeof(source);
+                    const ssize_t size = ::recvfrom(_socket, buffer, sizeof(buffer), 0, reinterpret_cast<struct sockaddr*>(&source), &length);
+
+                    if (size >= Plugin::DNSMessage::HeaderSize) {
+                        Handle(buffer, static_cast<uint16_t>(size), source, outgoing);
+                    }
+                }
+
+                const auto now = std::chrono::steady_clock::now();
+
+                while ((outgoing.empty() == false) && (outgoing.front().Due <= now)) {
+                    const Outgoing& entry(outgoing.front());
+                    ::sendto(_socket, entry.Data.data(), entry.Data.size(), 0, reinterpret_cast<const struct sockaddr*>(&entry.Destination), sizeof(entry.Destination));
+                    outgoing.pop_front();
+                }
+            }
+        }
+
+        void Handle(const uint8_t message[], const uint16_t length, const struct sockaddr_in& source, std::deque<Outgoing>& outgoing)
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            std::string question;
+            std::string key;
+            const uint16_t offset = Plugin::DNSMessage::Parse(message, length, question, key);
+
+            if (offset != 0) {
+                std::string name;
+                size_t index = 0;
+
+                // The name in dotted form, out of its labels.
+                while ((index < key.size()) && (key[index] != 0)) {
+                    const uint8_t size = static_cast<uint8_t>(key[index]);
+                    name += (name.empty() == true ? "" : ".") + key.substr(index + 1, size);
+                    index += 1 + size;
+                }
+
+                _total++;
+                _questions[name]++;
+                _ports.insert(ntohs(source.sin_port));
+                _ids.insert(Plugin::DNSMessage::Get16(&message[0]));
+
+                if (_addresses.find(name) == _addresses.end()) {
+                    _addresses[name] = static_cast<uint8_t>(_addresses.size() + 1);
+                }
+
+                std::vector<uint8_t> answer(message, message + offset);
+
+                Plugin::DNSMessage::Set16(&answer[2], Plugin::DNSMessage::FlagResponse | Plugin::DNSMessage::FlagRecursionDesired | Plugin::DNSMessage::FlagRecursionAvailable);
+                Plugin::DNSMessage::Set16(&answer[6], 1);
+
+                const uint8_t record[] = { 0xC0, 0x0C, 0, 1, 0, 1, 0, 0, 0, 0, 0, 4, 10, 0, 0, _addresses[name] };
+                answer.insert(answer.end(), record, record + sizeof(record));
+                Plugin::DNSMessage::Set32(&answer[offset + 6], _policy.TTL);
+
+                outgoing.push_back({ std::chrono::steady_clock::now() + std::chrono::milliseconds(_policy.Delay), source, answer });
+            }
+        }
+
+    private:
+        mutable std::mutex _lock;
+        Policy _policy;
+        int _socket;
+        uint16_t _port;
+        std::atomic<bool> _running;
+        std::thread _thread;
+        std::map<std::string, uint32_t> _questions;
+        std::map<std::string, uint8_t> _addresses;
+        std::set<uint16_t> _ports;
+        std::set<uint16_t> _ids;
+        std::atomic<uint32_t> _total;
+    };
+
+} // namespace DNSLoopback
+} // namespace WPEFramework
@@ -27,11 +27,18 @@ namespace WPEFramework {
 namespace Plugin {
 
     //This class is not Thread Safe. The user of this class must ensure thread saftey (single thread access) !!!!
+    //
+    // The init data is scanned in place, in a single pass, without intermediate copies. The key ids found
+    // are kept in the order they were found, with a small open addressing hash index on top of them, as
+    // they are looked up for every key status update and every session lookup.
     class CommonEncryptionData {
     private:
         CommonEncryptionData() = delete;
         CommonEncryptionData& operator=(const CommonEncryptionData&) = delete;
 
+        static constexpr uint8_t PSSHMinimumSize = 4 /* size */ + 4 /* type */ + 4 /* version, flags */ + 16 /* system */ + 4 /* count */;
+        static constexpr uint8_t MinimumSlots = 8;
+
         static const uint8_t PSSHeader[];
         static const uint8_t CommonEncryption[];
         static const uint8_t PlayReady[];
@@ -110,16 +117,18 @@ namespace Plugin {
             uint32_t _systems;
         };
 
-        typedef Core::IteratorType<const std::list<KeyId>, const KeyId&, std::list<KeyId>::const_iterator> Iterator;
+        typedef Core::IteratorType<const std::vector<KeyId>, const KeyId&, std::vector<KeyId>::const_iterator> Iterator;
 
     public:
         CommonEncryptionData(const uint8_t data[], const uint16_t length)
             : _keyIds()
+            , _index()
         {
             Parse(data, length);
         }
         CommonEncryptionData(const CommonEncryptionData& copy)
             : _keyIds(copy._keyIds)
+            , _index(copy._index)
         {
         }
         ~CommonEncryptionData()
@@ -135,9 +144,9 @@ namespace Plugin {
         {
             ::OCDM::ISession::KeyStatus result(::OCDM::ISession::StatusPending);
             if (key.IsValid() == true) {
-                std::list<KeyId>::const_iterator index(std::find(_keyIds.begin(), _keyIds.end(), key));
-                if (index != _keyIds.end()) {
-                    result = index->Status();
+                const uint16_t index = Find(key);
+                if (index < _keyIds.size()) {
+                    result = _keyIds[index].Status();
                 }
             }
             return (result);
@@ -148,53 +157,43 @@ namespace Plugin {
         }
         inline bool HasKeyId(const OCDM::KeyId& keyId) const
         {
-            return (std::find(_keyIds.begin(), _keyIds.end(), keyId) != _keyIds.end());
+            return (Find(keyId) < _keyIds.size());
         }
         inline void AddKeyId(const KeyId& key)
         {
-            std::list<KeyId>::iterator index(std::find(_keyIds.begin(), _keyIds.end(), key));
+            const uint16_t index = Find(key);
 
-            if (index == _keyIds.end()) {
+            if (index == _keyIds.size()) {
                 TRACE_L1("Added key: %s for system: %02X\n", key.ToString().c_str(), key.Systems());
-                _keyIds.emplace_back(key);
+                Insert(key);
             } else {
                 TRACE_L1("Updated key: %s for system: %02X\n", key.ToString().c_str(), key.Systems());
-                index->Flag(key.Systems());
+                _keyIds[index].Flag(key.Systems());
             }
         }
+        // The entry returned is valid until the next key id is added.
         inline const KeyId* UpdateKeyStatus(::OCDM::ISession::KeyStatus status, const KeyId& key)
         {
-            KeyId* entry = nullptr;
-
             ASSERT(key.IsValid() == true);
 
-            std::list<KeyId>::iterator index(std::find(_keyIds.begin(), _keyIds.end(), key));
+            const uint16_t index = Find(key);
 
-            if (index == _keyIds.end()) {
-                _keyIds.emplace_back(key);
-                entry = &(_keyIds.back());
-            } else {
-                entry = &(*index);
+            if (index == _keyIds.size()) {
+                Insert(key);
             }
+
+            KeyId* entry = &(_keyIds[index]);
             entry->Status(status);
 
             return (entry);
         }
         inline bool IsSupported(const CommonEncryptionData& keys) const
         {
-
             bool result = true;
-            std::list<KeyId>::const_iterator requested(keys._keyIds.begin());
+            std::vector<KeyId>::const_iterator requested(keys._keyIds.begin());
 
             while ((requested != keys._keyIds.end()) && (result == true)) {
-                std::list<KeyId>::const_iterator index(_keyIds.begin());
-
-                while ((index != _keyIds.end()) && (*index != *requested)) {
-                    index++;
-                }
-
-                result = (index != _keyIds.end());
-
+                result = (Find(*requested) < _keyIds.size());
                 requested++;
             }
 
@@ -204,7 +203,91 @@ namespace Plugin {
             return _keyIds.empty();
         }
     private:
-        uint8_t Base64(const uint8_t value[], const uint8_t sourceLength, uint8_t object[], const uint8_t length)
+        static uint32_t Hash(const OCDM::KeyId& key)
+        {
+            // FNV-1a, key ids are (supposed to be) random already.
+            const uint8_t* id = key.Id();
+            uint32_t hash = 2166136261;
+
+            for (uint8_t index = 0; index < key.Length(); index++) {
+                hash = (hash ^ id[index]) * 16777619;
+            }
+            return (hash);
+        }
+        // Returns the position of the key id, or the number of key ids if it is not there.
+        uint16_t Find(const OCDM::KeyId& key) const
+        {
+            uint16_t result = static_cast<uint16_t>(_keyIds.size());
+
+            if (_index.empty() == false) {
+                const uint32_t mask = static_cast<uint32_t>(_index.size() - 1);
+                uint32_t slot = Hash(key) & mask;
+
+                // The index is at most half full, so there is always a free slot to stop at.
+                while ((_index[slot] != 0) && (result == _keyIds.size())) {
+                    if (_keyIds[_index[slot] - 1] == key) {
+                        result = _index[slot] - 1;
+                    } else {
+                        slot = (slot + 1) & mask;
+                    }
+                }
+            }
+
+            return (result);
+        }
+        void Insert(const KeyId& key)
+        {
+            _keyIds.push_back(key);
+
+            if ((_keyIds.size() * 2) > _index.size()) {
+                // Key ids are never removed, so a rehash is all the maintenance the index needs.
+                _index.assign(std::max(static_cast<size_t>(MinimumSlots), _index.size() * 2), 0);
+
+                for (uint16_t position = 0; position < _keyIds.size(); position++) {
+                    Place(position);
+                }
+            } else {
+                Place(static_cast<uint16_t>(_keyIds.size() - 1));
+            }
+        }
+        void Place(const uint16_t position)
+        {
+            const uint32_t mask = static_cast<uint32_t>(_index.size() - 1);
+            uint32_t slot = Hash(_keyIds[position]) & mask;
+
+            while (_index[slot] != 0) {
+                slot = (slot + 1) & mask;
+            }
+            _index[slot] = position + 1;
+        }
+        // Returns the offset of the pattern in the data, or the length of the data if it is not in there.
+        static uint16_t Search(const uint8_t data[], const uint16_t length, const char pattern[])
+        {
+            const uint16_t size = static_cast<uint16_t>(::strlen(pattern));
+            uint16_t result = length;
+
+            if (size <= length) {
+                const uint8_t* start = data;
+                const uint8_t* last = &(data[length - size]);
+
+                while ((start <= last) && (result == length)) {
+                    start = static_cast<const uint8_t*>(::memchr(start, pattern[0], (last - start) + 1));
+
+                    if (start == nullptr) {
+                        start = last + 1;
+                    } else if (::memcmp(start, pattern, size) == 0) {
+                        result = static_cast<uint16_t>(start - data);
+                    } else {
+                        start++;
+                    }
+                }
+            }
+
+            return (result);
+        }
+        // The XML init data is UTF-16, so it is decoded with a stride of 2, JSON init data with a stride of 1.
+        // Both the standard and the URL safe alphabet are accepted, ClearKey key ids use the latter.
+        uint8_t Base64(const uint8_t value[], const uint8_t sourceLength, uint8_t object[], const uint8_t length, const uint8_t stride = 2)
         {
             uint8_t state = 0;
             uint8_t index = 0;
@@ -221,9 +304,9 @@ namespace Plugin {
                     converted = static_cast<uint8_t>(current - 'a' + 26);
                 } else if ((current >= '0') && (current <= '9')) {
                     converted = static_cast<uint8_t>(current - '0' + 52);
-                } else if (current == '+') {
+                } else if ((current == '+') || (current == '-')) {
                     converted = 62;
-                } else if (current == '/') {
+                } else if ((current == '/') || (current == '_')) {
                     converted = 63;
                 } else {
                     break;
@@ -244,8 +327,7 @@ namespace Plugin {
                     object[filler++] = ((converted & 0x3F) | lastStuff);
                     state = 0;
                 }
-                index++;
-                index++;
+                index += stride;
             }
 
             return (filler);
@@ -253,52 +335,65 @@ namespace Plugin {
 
         void Parse(const uint8_t data[], const uint16_t length)
         {
-            uint16_t offset = 0;
+            uint32_t offset = 0;
+
+            while ((offset + 8) <= length) {
+                const uint8_t* box = &(data[offset]);
+                const uint32_t available = length - offset;
 
-            do {
                 // Check if this is a PSSH box...
-                uint32_t size = (data[offset] << 24) | (data[offset + 1] << 16) | (data[offset + 2] << 8) | data[offset + 3];
+                uint32_t size = (box[0] << 24) | (box[1] << 16) | (box[2] << 8) | box[3];
                 if (size == 0) {
                     TRACE_L1("While parsing CENC, found chunk of size 0, are you sure the data is valid? %d\n", __LINE__);
                     break;
                 }
 
-                if ((size <= static_cast<uint32_t>(length - offset)) && (memcmp(&(data[offset + 4]), PSSHeader, 4) == 0)) {
-                    ParsePSSHBox(&(data[offset + 4 + 4]), size - 4 - 4);
+                if ((size <= available) && (memcmp(&(box[4]), PSSHeader, 4) == 0)) {
+                    if (size >= PSSHMinimumSize) {
+                        ParsePSSHBox(&(box[4 + 4]), static_cast<uint16_t>(size - 4 - 4));
+                    }
                 } else {
-                    uint32_t XMLSize = (data[offset] | (data[offset + 1] << 8) | (data[offset + 2] << 16) | (data[offset + 3] << 24));
+                    uint32_t XMLSize = (box[0] | (box[1] << 8) | (box[2] << 16) | (box[3] << 24));
 
-                    if (XMLSize <= static_cast<uint32_t>(length - offset)) {
+                    if ((XMLSize <= available) && (XMLSize >= 10)) {
 
-                        uint16_t stringLength = (data[offset + 8] | (data[offset + 9] << 8));
+                        uint16_t stringLength = (box[8] | (box[9] << 8));
                         if (stringLength <= (XMLSize - 10)) {
 
                             // Seems like it is an XMLBlob, without PSSH header, we have seen that on PlayReady only..
-                            ParseXMLBox(&(data[offset + 10]), stringLength);
+                            ParseXMLBox(&(box[10]), stringLength);
                         }
 
                         offset += XMLSize;
 
                     } else if ((offset == 0) && (data[0] == '<') && (data[2] == 'W') && (data[4] == 'R') && (data[6] == 'M')) {
-                        ParseXMLBox(data, size);
+                        ParseXMLBox(data, length);
                         offset = length;
-                    } else if (std::string(reinterpret_cast<const char*>(data), length).find(JSONKeyIds) != std::string::npos) {
-                        /* keyids initdata type */
-                        TRACE_L1("Initdata contains clearkey's key ids");
-
-                        ParseJSONInitData(reinterpret_cast<const char*>(data), length);
                     } else {
-                        TRACE_L1("Have no clue what this is!!! %d\n", __LINE__);
+                        const uint16_t marker = Search(box, static_cast<uint16_t>(available), JSONKeyIds);
+
+                        if (marker < available) {
+                            /* keyids initdata type */
+                            TRACE_L1("Initdata contains clearkey's key ids");
+
+                            const uint16_t begin = static_cast<uint16_t>(marker + ::strlen(JSONKeyIds));
+                            ParseJSONInitData(&(box[begin]), static_cast<uint16_t>(available - begin));
+                            offset = length;
+                        } else {
+                            TRACE_L1("Have no clue what this is!!! %d\n", __LINE__);
+                        }
                     }
                 }
-                offset += size;
 
-            } while (offset < length);
+                // Whatever does not fit, is the end of it.
+                offset = (size <= (length - offset) ? offset + size : length);
+            }
         }
 
         void ParsePSSHBox(const uint8_t data[], const uint16_t length)
         {
             systemType system(COMMON);
+            const uint8_t* end(&(data[length]));
             const uint8_t* psshData(&(data[KeyId::Length() + 4 /* flags */]));
             uint32_t count((psshData[0] << 24) | (psshData[1] << 16) | (psshData[2] << 8) | psshData[3]);
             uint16_t stringLength = (data[8] | (data[9] << 8));
@@ -308,7 +403,9 @@ namespace Plugin {
                 TRACE_L1("Common detected [%d]\n", __LINE__);
             } else if (::memcmp(&(data[4]), PlayReady, KeyId::Length()) == 0) {
                 if (stringLength <= (length - 10)) {
-                    ParseXMLBox(&(psshData[10]), count);
+                    if (&(psshData[10]) < end) {
+                        ParseXMLBox(&(psshData[10]), static_cast<uint16_t>(std::min(count, static_cast<uint32_t>(end - &(psshData[10])))));
+                    }
                     TRACE_L1("PlayReady XML detected [%d]\n", __LINE__);
                     count = 0;
                 } else {
@@ -335,18 +432,21 @@ namespace Plugin {
 
             TRACE_L1("Adding %d keys from PSSH box\n", count);
 
-            while (count-- != 0) {
+            // Never trust the count, there should be room for the key ids as well.
+            while ((count-- != 0) && ((end - psshData) >= KeyId::Length())) {
                 AddKeyId(KeyId(system, psshData, KeyId::Length()));
                 psshData += KeyId::Length();
             }
         }
 
+        // Returns the offset of the UTF-16 key in the data, or the length of the data if it is not in there.
+        // A key that is in there, is in there as a whole, its last character cut in half does not count.
         uint16_t FindInXML(const uint8_t data[], const uint16_t length, const char key[], const uint8_t keyLength)
         {
             uint8_t index = 0;
             uint16_t result = 0;
 
-            while ((result <= length) && (index < keyLength)) {
+            while ((result < length) && (index < keyLength)) {
                 if (static_cast<uint8_t>(key[index]) == data[result]) {
                     index++;
                     result += 2;
@@ -357,7 +457,7 @@ namespace Plugin {
                     result += 2;
                 }
             }
-            return ((index == keyLength) ? (result - (keyLength * 2)) : result);
+            return (((index == keyLength) && (result <= length)) ? (result - (keyLength * 2)) : length);
         }
 
         void ParseXMLBox(const uint8_t data[], const uint16_t length)
@@ -414,15 +514,22 @@ namespace Plugin {
                 while ((size > 0) && ((begin = FindInXML(slot, size, "<KID ", 5)) < size)) {
                     uint16_t end = FindInXML(&(slot[begin + 10]), size - begin - 10, "</KID>", 6);
 
-                    uint16_t keyValue = FindInXML(&(slot[begin + 10]), end, "VALUE", 5);  
-                    uint16_t keyStart = FindInXML(&(slot[begin + 10 + keyValue + 10]), end - keyValue - 10, "\"", 1) + 2;
-                    uint16_t keyLength = FindInXML(&(slot[begin + 10 + keyValue + 10 + keyStart]), end - keyValue - 10 - keyStart - 2, "\"", 1) - 2;
-                    
                     if (end < (size - begin - 10)) {
                         uint8_t byteArray[32];
+                        uint16_t keyValue = FindInXML(&(slot[begin + 10]), end, "VALUE", 5);
+                        uint16_t keyStart = end;
+                        uint16_t keyLength = 0;
+
+                        if (keyValue < end) {
+                            keyStart = FindInXML(&(slot[begin + 10 + keyValue + 10]), end - keyValue - 10, "\"", 1) + 2;
+                        }
+                        if ((keyStart + 2) <= (end - keyValue - 10)) {
+                            keyLength = FindInXML(&(slot[begin + 10 + keyValue + 10 + keyStart]), end - keyValue - 10 - keyStart - 2, "\"", 1);
+                            keyLength = (keyLength >= 2 ? keyLength - 2 : 0);
+                        }
 
                         // We got a KID, translate its
-                        if (Base64(&(slot[begin + 10 + keyValue + 10 + keyStart]), static_cast<uint8_t>(keyLength), byteArray, sizeof(byteArray)) == KeyId::Length()) {
+                        if ((keyLength > 0) && Base64(&(slot[begin + 10 + keyValue + 10 + keyStart]), static_cast<uint8_t>(keyLength), byteArray, sizeof(byteArray)) == KeyId::Length()) {
                             // Pass it the microsoft way :-(
                             uint32_t a = byteArray[0];
                             a = (a << 8) | byteArray[1];
@@ -445,40 +552,48 @@ namespace Plugin {
                 }
         }
 
-        using JSONStringArray = Core::JSON::ArrayType<Core::JSON::String>;
+        // The key ids of the "keyids" init data type, what follows the {"kids": marker, looks like:
+        // ["LwVHf8JLtPrv2GUXFW2v_A", "0DdtU9od-Bh5L3xbv0Xf_A"]}
+        void ParseJSONInitData(const uint8_t data[], const uint16_t length)
+        {
+            uint16_t index = 0;
 
-        void ParseJSONInitData(const char data[], uint16_t length) {
-            systemType system(CLEARKEY);
+            while ((index < length) && (::isspace(data[index]) != 0)) {
+                index++;
+            }
 
-            class InitData : public Core::JSON::Container {
-            public:
-                InitData() : Core::JSON::Container() , KeyIds() {
-                    Add(_T("kids"), &KeyIds);
-                }
-                virtual ~InitData() {
-                }
+            if ((index < length) && (data[index] == '[')) {
+                index++;
 
-            public:
-                JSONStringArray KeyIds;
-            } initData;
+                while ((index < length) && (data[index] != ']')) {
+                    if (data[index] != '"') {
+                        index++;
+                    } else {
+                        const uint16_t begin = ++index;
 
-            initData.FromString(std::string(data, length));
+                        while ((index < length) && (data[index] != '"')) {
+                            index++;
+                        }
 
-            JSONStringArray::ConstIterator index(static_cast<const InitData&>(initData).KeyIds.Elements());
+                        if (index < length) {
+                            uint8_t keyID[32];
+                            const uint16_t keyLength = index - begin;
 
-            uint16_t decodeLength = KeyId::Length();
+                            TRACE_L1("clearkey: keyID %.*s, length %d", keyLength, reinterpret_cast<const char*>(&data[begin]), keyLength);
 
-            while(index.Next()) {
-                uint8_t keyID[KeyId::KEY_LENGTH];
-                std::string keyID64 = index.Current().Value();
-                TRACE_L1("clearkey: keyID %s, length %d", keyID64.c_str(), static_cast<int>(keyID64.length()));
-                Core::FromString(keyID64, keyID, decodeLength);
-                AddKeyId(KeyId(system, keyID, static_cast<uint8_t>(sizeof(keyID))));
+                            if ((keyLength <= 0xFF) && (Base64(&(data[begin]), static_cast<uint8_t>(keyLength), keyID, sizeof(keyID), 1) == KeyId::Length())) {
+                                AddKeyId(KeyId(CLEARKEY, keyID, KeyId::Length()));
+                            }
+                            index++;
+                        }
+                    }
+                }
             }
         }
 
     private:
-        std::list<KeyId> _keyIds;
+        std::vector<KeyId> _keyIds;
+        std::vector<uint16_t> _index;
     };
 }
 } // namespace WPEFramework::Plugin
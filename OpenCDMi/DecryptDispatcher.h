@@ -0,0 +1,189 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // Serves the decrypt requests of the shared buffers of all sessions on a small, fixed, number of
+    // decrypter threads. A client signals a request on the semaphore of its own buffer, there is nothing
+    // to wait on for all buffers at once. So every buffer has a watcher that blocks on that semaphore, and
+    // when it is signalled, queues the buffer and wakes a decrypter. Nothing runs while there are no
+    // requests, and no more decrypts run at the same time than there are decrypters. No framework
+    // dependencies, it is checked on its own. A BUFFER has:
+    //     bool Wait();       blocks until a request comes in, true, or Interrupt() is called
+    //     void Serve();      decrypts the request and hands the buffer back to the client
+    //     void Interrupt();  makes a Wait() in progress, or the next one, return
+    template <typename BUFFER>
+    class DecryptDispatcher {
+    private:
+        DecryptDispatcher() = delete;
+        DecryptDispatcher(const DecryptDispatcher&) = delete;
+        DecryptDispatcher& operator=(const DecryptDispatcher&) = delete;
+
+        struct Entry {
+            Entry(BUFFER* buffer)
+                : Buffer(buffer)
+                , Watcher()
+                , Detaching(false)
+                , Serving(false)
+            {
+            }
+
+            BUFFER* Buffer;
+            std::thread Watcher;
+            bool Detaching;
+            bool Serving;
+        };
+
+    public:
+        DecryptDispatcher(const uint8_t threads)
+            : _adminLock()
+            , _work()
+            , _served()
+            , _entries()
+            , _queue()
+            , _decrypters()
+            , _stopping(false)
+        {
+            const uint8_t count = (threads > 0 ? threads : 1);
+
+            for (uint8_t index = 0; index < count; index++) {
+                _decrypters.emplace_back([this]() { Decrypt(); });
+            }
+        }
+        ~DecryptDispatcher()
+        {
+            std::unique_lock<std::mutex> lock(_adminLock);
+
+            _stopping = true;
+            _work.notify_all();
+
+            lock.unlock();
+
+            for (std::thread& decrypter : _decrypters) {
+                decrypter.join();
+            }
+        }
+
+    public:
+        void Attach(BUFFER* buffer)
+        {
+            std::unique_lock<std::mutex> lock(_adminLock);
+
+            _entries.emplace_back(buffer);
+
+            Entry& entry(_entries.back());
+
+            entry.Watcher = std::thread([this, &entry]() { Watch(entry); });
+        }
+        // Once this returns, no thread of the dispatcher uses the buffer anymore. A request that was still
+        // queued is dropped, the session is going away.
+        void Detach(BUFFER* buffer)
+        {
+            std::unique_lock<std::mutex> lock(_adminLock);
+
+            typename std::list<Entry>::iterator index(std::find_if(_entries.begin(), _entries.end(), [buffer](const Entry& entry) { return (entry.Buffer == buffer); }));
+
+            if (index != _entries.end()) {
+                index->Detaching = true;
+                _queue.erase(std::remove(_queue.begin(), _queue.end(), &(*index)), _queue.end());
+
+                lock.unlock();
+
+                buffer->Interrupt();
+                index->Watcher.join();
+
+                lock.lock();
+
+                _served.wait(lock, [index]() { return (index->Serving == false); });
+
+                _entries.erase(index);
+            }
+        }
+
+    private:
+        void Watch(Entry& entry)
+        {
+            bool detaching = false;
+
+            while (detaching == false) {
+                const bool request = entry.Buffer->Wait();
+
+                std::unique_lock<std::mutex> lock(_adminLock);
+
+                detaching = entry.Detaching;
+
+                // The client does not signal again before its request is served, the watcher can go
+                // back to waiting right away.
+                if ((detaching == false) && (request == true)) {
+                    _queue.push_back(&entry);
+                    _work.notify_one();
+                }
+            }
+        }
+        void Decrypt()
+        {
+            std::unique_lock<std::mutex> lock(_adminLock);
+
+            while (_stopping == false) {
+                if (_queue.empty() == true) {
+                    _work.wait(lock);
+                } else {
+                    Entry* entry = _queue.front();
+
+                    _queue.erase(_queue.begin());
+                    entry->Serving = true;
+
+                    lock.unlock();
+
+                    entry->Buffer->Serve();
+
+                    lock.lock();
+
+                    entry->Serving = false;
+
+                    if (entry->Detaching == true) {
+                        _served.notify_all();
+                    }
+                }
+            }
+        }
+
+    private:
+        std::mutex _adminLock;
+        std::condition_variable _work; // a buffer is queued, or the dispatcher stops
+        std::condition_variable _served; // a buffer being detached, is served
+        std::list<Entry> _entries;
+        std::vector<Entry*> _queue;
+        std::vector<std::thread> _decrypters;
+        bool _stopping;
+    };
+
+} // namespace Plugin
+} // namespace WPEFramework
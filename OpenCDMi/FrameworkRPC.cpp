@@ -17,6 +17,7 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <regex>
 #include <string>
 #include <vector>
@@ -35,6 +36,8 @@
 #include <interfaces/IContentDecryption.h>
 
 #include "CENCParser.h"
+#include "DecryptDispatcher.h"
+#include "SampleRing.h"
 
 #include <ocdm/open_cdm.h>
 
@@ -157,6 +160,169 @@ namespace Plugin {
             AccessorOCDM(const AccessorOCDM&) = delete;
             AccessorOCDM& operator=(const AccessorOCDM&) = delete;
 
+            // The shared buffer of one session. A buffer is created for a single session and destroyed with it,
+            // a segment is never handed to a next session. Decrypt requests in it are served by the Dispatcher.
+            class DataExchange : public ::OCDM::DataExchange {
+            private:
+                DataExchange() = delete;
+                DataExchange(const DataExchange&) = delete;
+                DataExchange& operator=(const DataExchange&) = delete;
+
+            public:
+                DataExchange(const string& name, const uint32_t defaultSize)
+                    : ::OCDM::DataExchange(name, defaultSize)
+                    , _mediaKeys(nullptr)
+                    , _mediaKeysExt(nullptr)
+                    , _sessionKey(nullptr)
+                    , _sessionKeyLength(0)
+                    , _requests(0)
+                    , _samples(0)
+                    , _bytes(0)
+                    , _duration(0)
+                    , _maxLatency(0)
+                {
+                    TRACE_L1("Constructing buffer server side: %p - %s", this, name.c_str());
+                }
+                ~DataExchange()
+                {
+                    TRACE_L1("Destructing buffer server side: %p - %s", this, ::OCDM::DataExchange::Name().c_str());
+
+                    if (_requests > 0) {
+                        TRACE(Trace::Information, (_T("Decrypted %llu samples (%llu bytes) in %llu requests, taking %llu us, longest request %llu us"),
+                            static_cast<unsigned long long>(_samples), static_cast<unsigned long long>(_bytes),
+                            static_cast<unsigned long long>(_requests), static_cast<unsigned long long>(_duration),
+                            static_cast<unsigned long long>(_maxLatency)));
+                    }
+                }
+
+            public:
+                // Only once, before the buffer is handed to the Dispatcher.
+                void Attach(CDMi::IMediaKeySession* mediaKeys)
+                {
+                    ASSERT((mediaKeys != nullptr) && (_mediaKeys == nullptr));
+
+                    _mediaKeys = mediaKeys;
+                    _mediaKeysExt = dynamic_cast<CDMi::IMediaKeySessionExt*>(mediaKeys);
+                }
+                // Blocks until the client signals a decrypt request, or Interrupt() is called.
+                bool Wait()
+                {
+                    return (RequestConsume(Core::infinite) == Core::ERROR_NONE);
+                }
+                // Signals the semaphore the client would, the Dispatcher knows it is no request.
+                void Interrupt()
+                {
+                    Produced();
+                }
+                // A request came in, Wait() returned true.
+                void Serve()
+                {
+                    const uint64_t start = Core::Time::Now().Ticks();
+                    const uint32_t size = BytesWritten();
+                    uint16_t samples = SampleRing::Pending(Buffer(), size);
+
+                    // Store the status we have for the other side.
+                    if (samples == 0) {
+                        samples = 1;
+                        Status(Decrypt());
+                    } else {
+                        Status(Decrypt(size));
+                    }
+
+                    const uint64_t duration = Core::Time::Now().Ticks() - start;
+
+                    // Whatever the result, we are done with the buffer..
+                    Consumed();
+
+                    _requests++;
+                    _samples += samples;
+                    _bytes += size;
+                    _duration += duration;
+                    _maxLatency = std::max(_maxLatency, duration);
+                }
+
+            private:
+                // The buffer holds a single sample. The administration of the buffer has no room for a
+                // subsample map, a client with one uses the ring.
+                uint32_t Decrypt()
+                {
+                    uint32_t clearContentSize = 0;
+                    uint8_t* clearContent = nullptr;
+                    uint8_t keyIdLength = 0;
+                    const uint8_t* keyIdData = KeyId(keyIdLength);
+
+                    int cr = _mediaKeys->Decrypt(
+                        _sessionKey,
+                        _sessionKeyLength,
+                        nullptr, //subsamples
+                        0, //number of subsamples
+                        IVKey(),
+                        IVKeyLength(),
+                        Buffer(),
+                        BytesWritten(),
+                        &clearContentSize,
+                        &clearContent,
+                        keyIdLength,
+                        keyIdData,
+                        InitWithLast15());
+                    if ((cr == 0) && (clearContentSize != 0)) {
+                        if (clearContentSize != BytesWritten()) {
+                            TRACE_L1("Returned clear sample size (%d) differs from encrypted buffer size (%d)", clearContentSize, BytesWritten());
+                            Size(clearContentSize);
+                        }
+
+                        // Adjust the buffer on our sied (this process) on what we will write back, unless
+                        // the DRM system decrypted straight into the shared buffer.
+                        if (clearContent != Buffer()) {
+                            SetBuffer(0, clearContentSize, clearContent);
+                        }
+                    }
+
+                    return (static_cast<uint32_t>(cr));
+                }
+                // The buffer holds a ring of samples, see SampleRing.h. The result is the first failure,
+                // if any, the status of each sample is in its slot.
+                uint32_t Decrypt(const uint32_t size)
+                {
+                    static_assert(SampleRing::Invalid == static_cast<uint32_t>(CDMi::CDMi_S_FALSE), "A slot that can not be decrypted must fail as any other request");
+
+                    return (SampleRing::Process(Buffer(), size, [this](const SampleRing::Slot& slot, const uint32_t subSamples[], const uint32_t entries, const uint8_t sample[], uint32_t& clearContentSize, uint8_t*& clearContent) -> uint32_t {
+                        return (static_cast<uint32_t>(_mediaKeys->Decrypt(
+                            _sessionKey,
+                            _sessionKeyLength,
+                            subSamples,
+                            entries,
+                            slot.IV,
+                            slot.IVLength,
+                            sample,
+                            slot.Length,
+                            &clearContentSize,
+                            &clearContent,
+                            slot.KeyIdLength,
+                            slot.KeyId,
+                            (slot.InitWithLast15 != 0))));
+                    }));
+                }
+
+            private:
+                CDMi::IMediaKeySession* _mediaKeys;
+                CDMi::IMediaKeySessionExt* _mediaKeysExt;
+                uint8_t* _sessionKey;
+                uint32_t _sessionKeyLength;
+
+                // Statistics, only touched while a decrypter holds the decrypt request.
+                uint64_t _requests;
+                uint64_t _samples;
+                uint64_t _bytes;
+                uint64_t _duration;
+                uint64_t _maxLatency;
+            };
+
+            typedef DecryptDispatcher<DataExchange> Dispatcher;
+
+            // Hands out a fresh shared buffer to every session, and destroys it when the session is done, so no
+            // session ever sees a segment another session used. A number of fresh buffers is kept ready, so
+            // creating a session does not pay for creating the segment.
             class BufferAdministrator {
             private:
                 BufferAdministrator() = delete;
@@ -164,77 +330,103 @@ namespace Plugin {
                 BufferAdministrator& operator=(const BufferAdministrator&) = delete;
 
             public:
-                BufferAdministrator(const string pathName)
+                BufferAdministrator(const string pathName, const uint32_t bufferSize, const uint16_t preallocate, const uint16_t maximum, const uint8_t threads)
                     : _adminLock()
                     , _basePath(Core::Directory::Normalize(pathName))
-                    , _occupation(0)
+                    , _bufferSize(bufferSize)
+                    , _preallocate(preallocate)
+                    , _maximum(std::max(maximum, preallocate))
+                    , _sequence(0)
+                    , _inUse(0)
+                    , _fresh()
+                    , _dispatcher(threads)
                 {
+                    _adminLock.Lock();
+
+                    while (_fresh.size() < _preallocate) {
+                        _fresh.push_back(Create());
+                    }
+
+                    _adminLock.Unlock();
                 }
                 ~BufferAdministrator()
                 {
+                    // All sessions should have returned their buffer by now.
+                    ASSERT(_inUse == 0);
+
+                    for (DataExchange* buffer : _fresh) {
+                        delete buffer;
+                    }
                 }
 
             public:
-                bool AquireBuffer(string& locator)
+                DataExchange* AquireBuffer(CDMi::IMediaKeySession* mediaKeys)
                 {
-                    uint8_t index = 0;
-
-                    locator.clear();
+                    DataExchange* result = nullptr;
 
                     _adminLock.Lock();
 
-                    while ((index < (sizeof(_occupation) * 8)) && ((_occupation & (1 << index)) != 0)) {
-                        index++;
+                    if (_fresh.empty() == false) {
+                        result = _fresh.back();
+                        _fresh.pop_back();
+                        _inUse++;
+                    } else if (_inUse < _maximum) {
+                        result = Create();
+                        _inUse++;
                     }
 
-                    // We do not expect more that 4 buffers to be allocated concurrently,
-                    // so more than X would be dramatic
-                    ASSERT(index < (sizeof(_occupation) * 8));
+                    _adminLock.Unlock();
 
-                    if (index < (sizeof(_occupation) * 8)) {
-                        _occupation |= (1 << index);
-                        locator = _basePath + BufferFileName + Core::NumberType<uint8_t>(index).Text();
+                    if (result != nullptr) {
+                        result->Attach(mediaKeys);
+                        _dispatcher.Attach(result);
+                    } else {
+                        TRACE_L1("All %d shared buffers are in use.", _maximum);
                     }
 
-                    _adminLock.Unlock();
-
-                    return (locator.empty() == false);
+                    return (result);
                 }
-                bool ReleaseBuffer(const string& locator)
+                void ReleaseBuffer(DataExchange* buffer)
                 {
+                    ASSERT(buffer != nullptr);
 
-                    bool released = false;
+                    // Wait for a decrypt in progress, the session is about to go.
+                    _dispatcher.Detach(buffer);
 
-                    if (locator.compare(0, _basePath.length(), _basePath) == 0) {
-                        string actualFile(locator.substr(_basePath.length()));
-                        uint8_t baseLength((sizeof(BufferFileName) / sizeof(TCHAR)) - 1);
+                    delete buffer;
 
-                        if (actualFile.compare(0, baseLength, BufferFileName) == 0) {
-                            // Than the last part is the number..
-                            uint8_t number(Core::NumberType<uint8_t>(&(actualFile.c_str()[baseLength]), static_cast<uint32_t>(actualFile.length() - baseLength)).Value());
+                    _adminLock.Lock();
 
-                            if (number <= (sizeof(_occupation) * 8)) {
-                                _adminLock.Lock();
+                    ASSERT(_inUse > 0);
 
-                                if ((_occupation & (1 << number)) != 0) {
-                                    _occupation ^= (1 << number);
-                                    released = true;
-                                } else {
-                                    // Freeing a buffer that is already free sounds dangerous !!!
-                                    ASSERT(false);
-                                }
+                    _inUse--;
 
-                                _adminLock.Unlock();
-                            }
-                        }
+                    // Replace it with a fresh one, for the next session.
+                    if ((_fresh.size() < _preallocate) && ((_inUse + _fresh.size()) < _maximum)) {
+                        _fresh.push_back(Create());
                     }
-                    return (released);
+
+                    _adminLock.Unlock();
+                }
+
+            private:
+                // Needs to be called within the lock. Every buffer gets a name of its own, a client can not
+                // end up on the segment of an earlier session by its name either.
+                DataExchange* Create()
+                {
+                    return (new DataExchange(_basePath + BufferFileName + Core::NumberType<uint32_t>(_sequence++).Text(), _bufferSize));
                 }
 
             private:
                 Core::CriticalSection _adminLock;
                 string _basePath;
-                uint16_t _occupation;
+                const uint32_t _bufferSize;
+                const uint16_t _preallocate;
+                const uint16_t _maximum;
+                uint32_t _sequence;
+                uint16_t _inUse;
+                std::vector<DataExchange*> _fresh;
+                Dispatcher _dispatcher;
             };
 
             // IMediaKeys defines the MediaKeys interface.
@@ -244,93 +436,6 @@ namespace Plugin {
                 SessionImplementation(const SessionImplementation&) = delete;
                 SessionImplementation& operator=(const SessionImplementation&) = delete;
 
-                class DataExchange : public ::OCDM::DataExchange, public Core::Thread {
-                private:
-                    DataExchange() = delete;
-                    DataExchange(const DataExchange&) = delete;
-                    DataExchange& operator=(const DataExchange&) = delete;
-
-                public:
-                    DataExchange(CDMi::IMediaKeySession* mediaKeys, const string& name, const uint32_t defaultSize)
-                        : ::OCDM::DataExchange(name, defaultSize)
-                        , Core::Thread(Core::Thread::DefaultStackSize(), _T("DRMSessionThread"))
-                        , _mediaKeys(mediaKeys)
-                        , _mediaKeysExt(dynamic_cast<CDMi::IMediaKeySessionExt*>(mediaKeys))
-                        , _sessionKey(nullptr)
-                        , _sessionKeyLength(0)
-                    {
-                        Core::Thread::Run();
-                        TRACE_L1("Constructing buffer server side: %p - %s", this, name.c_str());
-                    }
-                    ~DataExchange()
-                    {
-                        TRACE_L1("Destructing buffer server side: %p - %s", this, ::OCDM::DataExchange::Name().c_str());
-                        // Make sure the thread reaches a HALT.. We are done.
-                        Core::Thread::Stop();
-
-                        // If the thread is waiting for a semaphore, fake a signal :-)
-                        Produced();
-
-                        Core::Thread::Wait(Core::Thread::STOPPED, Core::infinite);
-                    }
-
-                private:
-                    virtual uint32_t Worker() override
-                    {
-
-                        while (IsRunning() == true) {
-
-                            uint32_t clearContentSize = 0;
-                            uint8_t* clearContent = nullptr;
-
-                            RequestConsume(Core::infinite);
-
-                            if (IsRunning() == true) {
-                                uint8_t keyIdLength = 0;
-                                const uint8_t* keyIdData = KeyId(keyIdLength);
-
-                                int cr = _mediaKeys->Decrypt(
-                                    _sessionKey,
-                                    _sessionKeyLength,
-                                    nullptr, //subsamples
-                                    0, //number of subsamples
-                                    IVKey(),
-                                    IVKeyLength(),
-                                    Buffer(),
-                                    BytesWritten(),
-                                    &clearContentSize,
-                                    &clearContent,
-                                    keyIdLength,
-                                    keyIdData,
-                                    InitWithLast15());
-                                if ((cr == 0) && (clearContentSize != 0)) {
-                                    if (clearContentSize != BytesWritten()) {
-                                        TRACE_L1("Returned clear sample size (%d) differs from encrypted buffer size (%d)", clearContentSize, BytesWritten());
-                                        Size(clearContentSize);
-                                    }
-
-                                    // Adjust the buffer on our sied (this process) on what we will write back
-                                    SetBuffer(0, clearContentSize, clearContent);
-                                }
-
-                                // Store the status we have for the other side.
-                                Status(static_cast<uint32_t>(cr));
-
-                                // Whatever the result, we are done with the buffer..
-                                Consumed();
-                            }
-                        }
-
-                        return (Core::infinite);
-                    }
-
-                private:
-                    CDMi::IMediaKeySession* _mediaKeys;
-                    CDMi::IMediaKeySessionExt* _mediaKeysExt;
-                    uint8_t* _sessionKey;
-                    uint32_t _sessionKeyLength;
-                };
-
                 // IMediaKeys defines the MediaKeys interface.
                 class Sink : public CDMi::IMediaKeySessionCallback {
                 private:
@@ -445,8 +550,7 @@ namespace Plugin {
                     const std::string keySystem,
                     CDMi::IMediaKeySession* mediaKeySession,
                     ::OCDM::ISession::ICallback* callback,
-                    const string bufferName,
-                    const uint32_t defaultSize,
+                    DataExchange* buffer,
                     const CommonEncryptionData* sessionData)
                     : _parent(*parent)
                     , _refCount(1)
@@ -455,15 +559,16 @@ namespace Plugin {
                     , _mediaKeySession(mediaKeySession)
                     , _mediaKeySessionExt(dynamic_cast<CDMi::IMediaKeySessionExt*>(mediaKeySession))
                     , _sink(this, callback)
-                    , _buffer(new DataExchange(mediaKeySession, bufferName, defaultSize))
+                    , _buffer(buffer)
                     , _cencData(*sessionData)
                 {
                     ASSERT(parent != nullptr);
                     ASSERT(sessionData != nullptr);
                     ASSERT(_mediaKeySession != nullptr);
+                    ASSERT(_buffer != nullptr);
 
                     _mediaKeySession->Run(&_sink);
-                    TRACE(Trace::Information, ("Server::Session::Session(%s,%s,%s) => %p", _keySystem.c_str(), _sessionId.c_str(), bufferName.c_str(), this));
+                    TRACE(Trace::Information, ("Server::Session::Session(%s,%s,%s) => %p", _keySystem.c_str(), _sessionId.c_str(), _buffer->Name().c_str(), this));
                     TRACE_L1("Constructed the Session Server side: %p", this);
                 }
 
@@ -472,8 +577,7 @@ namespace Plugin {
                     const std::string keySystem,
                     CDMi::IMediaKeySessionExt* mediaKeySession,
                     ::OCDM::ISession::ICallback* callback,
-                    const string bufferName,
-                    const uint32_t defaultSize,
+                    DataExchange* buffer,
                     const CommonEncryptionData* sessionData)
                     : _parent(*parent)
                     , _refCount(1)
@@ -482,13 +586,15 @@ namespace Plugin {
                     , _mediaKeySession(dynamic_cast<CDMi::IMediaKeySession*>(mediaKeySession))
                     , _mediaKeySessionExt(mediaKeySession)
                     , _sink(this, callback)
-                    , _buffer(new DataExchange(dynamic_cast<CDMi::IMediaKeySession*>(mediaKeySession), bufferName, defaultSize))
+                    , _buffer(buffer)
                     , _cencData(*sessionData)
                 {
                     ASSERT(parent != nullptr);
                     ASSERT(sessionData != nullptr);
                     ASSERT(_mediaKeySession != nullptr);
 
+                    ASSERT(_buffer != nullptr);
+
                     // This constructor can only be used for extended OCDM sessions.
                     ASSERT(_mediaKeySessionExt != nullptr);
 
@@ -508,8 +614,6 @@ namespace Plugin {
                     // the parent to lock handing out new entries before we clear.
                     _parent.Remove(this, _keySystem, _mediaKeySession);
 
-                    delete _buffer;
-
                     TRACE(Trace::Information, ("Server::Session::~Session(%s,%s) => %p", _keySystem.c_str(), _sessionId.c_str(), this));
                     TRACE_L1("Destructed the Session Server side: %p", this);
                 }
@@ -543,6 +647,10 @@ namespace Plugin {
                     return (_cencData.Status(CommonEncryptionData::KeyId(static_cast<CommonEncryptionData::systemType>(0), keyId, length)));
                 }
 
+                inline DataExchange* Buffer() const
+                {
+                    return (_buffer);
+                }
                 virtual std::string BufferId() const override
                 {
                     return (_buffer->Name());
@@ -647,11 +755,10 @@ namespace Plugin {
             };
 
         public:
-            AccessorOCDM(OCDMImplementation* parent, const string& name, const uint32_t defaultSize)
+            AccessorOCDM(OCDMImplementation* parent, const string& name, const uint32_t defaultSize, const uint16_t preallocate, const uint16_t maximum, const uint8_t threads)
                 : _parent(*parent)
                 , _adminLock()
-                , _administrator(name)
-                , _defaultSize(defaultSize)
+                , _administrator(name, defaultSize, preallocate, maximum, threads)
                 , _sessionList()
             {
                 ASSERT(parent != nullptr);
@@ -715,16 +822,16 @@ namespace Plugin {
                      {
                          if (sessionInterface != nullptr)
                          {
-                             std::string bufferId;
-
                              // See if there is a buffer available we can use..
-                             if (_administrator.AquireBuffer(bufferId) == true)
+                             DataExchange* buffer = _administrator.AquireBuffer(sessionInterface);
+
+                             if (buffer != nullptr)
                              {
 
                                  SessionImplementation *newEntry = 
                                     Core::Service<SessionImplementation>::Create<SessionImplementation>(this,
                                                  keySystem, sessionInterface,
-                                                 callback, bufferId, _defaultSize, &keyIds);
+                                                 callback, buffer, &keyIds);
 
                                  session = newEntry;
                                  sessionId = newEntry->SessionId();
@@ -743,9 +850,10 @@ namespace Plugin {
                                 }
                                 _adminLock.Unlock();
                              } else {
-                                 TRACE_L1("Could not allocate a buffer for session: %s", sessionId.c_str());
+                                 TRACE_L1("Could not allocate a buffer for a %s session", keySystem.c_str());
 
-                                 // TODO: We need to drop the session somehow...
+                                 // Without a buffer the session is of no use, do not leave it behind in the DRM system.
+                                 system->DestroyMediaKeySession(sessionInterface);
                              }
                          }
                      }
@@ -943,6 +1051,11 @@ namespace Plugin {
 
                 ASSERT(session != nullptr);
 
+                if (session != nullptr) {
+                    // The decrypt thread should be done with the session before it is destroyed.
+                    _administrator.ReleaseBuffer(session->Buffer());
+                }
+
                 if (mediaKeySession != nullptr) {
 
                     mediaKeySession->Run(nullptr);
@@ -957,8 +1070,6 @@ namespace Plugin {
 
                 if (session != nullptr) {
 
-                    _administrator.ReleaseBuffer(session->BufferId());
-
                     std::list<SessionImplementation*>::iterator index(_sessionList.begin());
 
                     while ((index != _sessionList.end()) && (session != (*index))) {
@@ -981,7 +1092,6 @@ namespace Plugin {
             OCDMImplementation& _parent;
             mutable Core::CriticalSection _adminLock;
             BufferAdministrator _administrator;
-            uint32_t _defaultSize;
             std::list<SessionImplementation*> _sessionList;
         };
 
@@ -1036,12 +1146,18 @@ namespace Plugin {
                 , Connector(_T("/tmp/ocdm"))
                 , SharePath(_T("/tmp"))
                 , ShareSize(8 * 1024)
+                , SharePool(2)
+                , ShareMaximum(64)
+                , DecryptThreads(2)
                 , KeySystems()
             {
                 Add(_T("location"), &Location);
                 Add(_T("connector"), &Connector);
                 Add(_T("sharepath"), &SharePath);
                 Add(_T("sharesize"), &ShareSize);
+                Add(_T("sharepool"), &SharePool);
+                Add(_T("sharemaximum"), &ShareMaximum);
+                Add(_T("decryptthreads"), &DecryptThreads);
                 Add(_T("systems"), &KeySystems);
             }
             ~Config()
@@ -1053,6 +1169,9 @@ namespace Plugin {
             Core::JSON::String Connector;
             Core::JSON::String SharePath;
             Core::JSON::DecUInt32 ShareSize;
+            Core::JSON::DecUInt16 SharePool;
+            Core::JSON::DecUInt16 ShareMaximum;
+            Core::JSON::DecUInt8 DecryptThreads;
             Core::JSON::ArrayType<Systems> KeySystems;
         };
 
@@ -1168,7 +1287,7 @@ namespace Plugin {
                 SYSLOG(Logging::Startup, (_T("No DRM factories specified. OCDM can not service any DRM requests.")));
             }
 
-            _entryPoint = Core::Service<AccessorOCDM>::Create<::OCDM::IAccessorOCDM>(this, config.SharePath.Value(), config.ShareSize.Value());
+            _entryPoint = Core::Service<AccessorOCDM>::Create<::OCDM::IAccessorOCDM>(this, config.SharePath.Value(), config.ShareSize.Value(), config.SharePool.Value(), config.ShareMaximum.Value(), config.DecryptThreads.Value());
             Core::ProxyType<RPC::InvokeServer> server = Core::ProxyType<RPC::InvokeServer>::Create(&Core::IWorkerPool::Instance());
             _service = new ExternalAccess(Core::NodeId(config.Connector.Value().c_str()), _entryPoint, server);
 
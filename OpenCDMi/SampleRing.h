@@ -0,0 +1,343 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // Batched decryption over the shared buffer of a session. A client with more than one sample ready
+    // enqueues them in a ring of slots at the start of the buffer and hands them all over with a single
+    // RequestConsume/Consumed handshake:
+    //
+    //   Header | Slot[Slots] | subsample maps and sample data, at the offsets in the slots
+    //
+    // A slot holds where its sample is, the IV and the key id to decrypt it with, and where its subsample
+    // map is. A map is 4 byte aligned and holds (clear bytes, encrypted bytes) pairs that add up to the
+    // sample. The decrypting side decrypts the pending slots, from Head on, in place and reports the
+    // status and clear length back in each slot. Head then moves past them, their results stay until the client wraps around to the same
+    // slots again. A buffer that does not start with a valid header holds a single sample, as it always
+    // did. No framework dependencies, it is checked on its own.
+    class SampleRing {
+    public:
+        static constexpr uint32_t MagicHigh = 0x4D44434F; // "OCDM"
+        static constexpr uint32_t MagicLow = 0x474E4952; // "RING"
+        static constexpr uint16_t Version = 1;
+        static constexpr uint16_t Slots = 64;
+        static constexpr uint8_t MaxIVLength = 16;
+        static constexpr uint8_t MaxKeyIdLength = 16;
+
+        // Status of a slot that can not be decrypted, the value of CDMi::CDMi_S_FALSE.
+        static constexpr uint32_t Invalid = 1;
+
+        struct Header {
+            uint32_t MagicHigh;
+            uint32_t MagicLow;
+            uint16_t Version;
+            uint16_t Slots;
+            uint16_t Head; // first pending slot
+            uint16_t Pending; // slots to decrypt, from Head on
+        };
+
+        struct SubSample {
+            uint32_t Clear;
+            uint32_t Encrypted;
+        };
+
+        struct Slot {
+            // Filled in by the client
+            uint32_t Offset;
+            uint32_t Length;
+            uint32_t SubSampleOffset;
+            uint32_t SubSamples; // pairs, 0 if the whole sample is encrypted
+            uint8_t IV[MaxIVLength];
+            uint8_t KeyId[MaxKeyIdLength];
+            uint8_t IVLength;
+            uint8_t KeyIdLength;
+            uint8_t InitWithLast15;
+            uint8_t Reserved;
+
+            // Filled in by the decrypting side
+            uint32_t Status;
+            uint32_t ClearLength;
+        };
+
+        // The client side, enqueues samples in the ring of a buffer. After the handshake, the clear samples
+        // are where they were written and Result() tells how they went.
+        class Writer {
+        private:
+            Writer() = delete;
+            Writer(const Writer&) = delete;
+            Writer& operator=(const Writer&) = delete;
+
+        public:
+            Writer(uint8_t buffer[], const uint32_t size)
+                : _buffer(buffer)
+                , _size(size)
+                , _used(DataOffset())
+            {
+                const Header header = { MagicHigh, MagicLow, Version, Slots, 0, 0 };
+
+                // A buffer that can not even hold the slots, takes no samples.
+                if (_size >= DataOffset()) {
+                    ::memcpy(_buffer, &header, sizeof(header));
+                }
+            }
+            ~Writer() = default;
+
+        public:
+            // Returns false if the ring is full, or the sample does not fit in the buffer anymore.
+            bool Add(const uint8_t sample[], const uint32_t length, const uint8_t iv[], const uint8_t ivLength, const uint8_t keyId[], const uint8_t keyIdLength, const bool initWithLast15, uint16_t& slot)
+            {
+                return (Add(sample, length, nullptr, 0, iv, ivLength, keyId, keyIdLength, initWithLast15, slot));
+            }
+            bool Add(const uint8_t sample[], const uint32_t length, const SubSample subSamples[], const uint16_t count, const uint8_t iv[], const uint8_t ivLength, const uint8_t keyId[], const uint8_t keyIdLength, const bool initWithLast15, uint16_t& slot)
+            {
+                bool result = false;
+
+                if ((_size >= DataOffset()) && (ivLength <= MaxIVLength) && (keyIdLength <= MaxKeyIdLength)) {
+                    Header header;
+
+                    ::memcpy(&header, _buffer, sizeof(header));
+
+                    // Everything before was handed over, the data starts at the beginning again.
+                    if (header.Pending == 0) {
+                        _used = DataOffset();
+                    }
+
+                    const uint32_t map = ((_used + 3) & ~3);
+                    const uint64_t end = static_cast<uint64_t>(map) + (count * sizeof(SubSample)) + length;
+
+                    if ((header.Pending < Slots) && (end <= _size)) {
+                        Slot entry;
+
+                        ::memset(&entry, 0, sizeof(entry));
+
+                        entry.SubSampleOffset = map;
+                        entry.SubSamples = count;
+                        entry.Offset = static_cast<uint32_t>(map + (count * sizeof(SubSample)));
+                        entry.Length = length;
+                        entry.IVLength = ivLength;
+                        entry.KeyIdLength = keyIdLength;
+                        entry.InitWithLast15 = (initWithLast15 == true ? 1 : 0);
+                        entry.Status = Invalid;
+                        ::memcpy(entry.IV, iv, ivLength);
+                        ::memcpy(entry.KeyId, keyId, keyIdLength);
+                        if (count > 0) {
+                            ::memcpy(&_buffer[map], subSamples, count * sizeof(SubSample));
+                        }
+                        ::memcpy(&_buffer[entry.Offset], sample, length);
+
+                        slot = static_cast<uint16_t>((header.Head + header.Pending) % Slots);
+                        ::memcpy(&_buffer[SlotOffset(slot)], &entry, sizeof(entry));
+
+                        header.Pending++;
+                        ::memcpy(_buffer, &header, sizeof(header));
+
+                        _used = static_cast<uint32_t>(end);
+                        result = true;
+                    }
+                }
+
+                return (result);
+            }
+            // The number of bytes to hand over.
+            uint32_t Size() const
+            {
+                return (_used);
+            }
+            Slot Result(const uint16_t slot) const
+            {
+                Slot result;
+
+                ::memcpy(&result, &_buffer[SlotOffset(slot)], sizeof(result));
+
+                return (result);
+            }
+
+        private:
+            uint8_t* _buffer;
+            const uint32_t _size;
+            uint32_t _used;
+        };
+
+    public:
+        SampleRing() = delete;
+        SampleRing(const SampleRing&) = delete;
+        SampleRing& operator=(const SampleRing&) = delete;
+
+        static constexpr uint32_t SlotOffset(const uint16_t slot)
+        {
+            return (static_cast<uint32_t>(sizeof(Header) + (slot * sizeof(Slot))));
+        }
+        static constexpr uint32_t DataOffset()
+        {
+            return (SlotOffset(Slots));
+        }
+
+        // Returns the number of samples waiting in the ring, 0 if the buffer does not hold a ring.
+        static uint16_t Pending(const uint8_t buffer[], const uint32_t size)
+        {
+            uint16_t result = 0;
+
+            if (size >= DataOffset()) {
+                Header header;
+
+                ::memcpy(&header, buffer, sizeof(header));
+
+                if ((header.MagicHigh == MagicHigh) && (header.MagicLow == MagicLow) && (header.Version == Version) && (header.Slots == Slots) && (header.Head < Slots) && (header.Pending <= Slots)) {
+                    result = header.Pending;
+                }
+            }
+
+            return (result);
+        }
+
+        // Decrypts the pending samples of the ring in a buffer of the given size, and empties the ring.
+        // The decrypt is called as:
+        //     uint32_t decrypt(const Slot& slot, const uint32_t subSamples[], const uint32_t entries,
+        //                      const uint8_t sample[], uint32_t& clearLength, uint8_t*& clear)
+        // with the map as CDMi takes it, a number of uint32_t entries rather than pairs. It returns 0 on
+        // success, with the clear sample in clear, which may be the sample itself. A sample with nothing
+        // encrypted in it, is not decrypted at all. Returns the status of the first sample that failed, 0
+        // if none did.
+        template <typename DECRYPT>
+        static uint32_t Process(uint8_t buffer[], const uint32_t size, DECRYPT&& decrypt)
+        {
+            uint32_t result = 0;
+            const uint16_t pending = Pending(buffer, size);
+
+            if (pending > 0) {
+                Header header;
+
+                ::memcpy(&header, buffer, sizeof(header));
+
+                for (uint16_t index = 0; index < pending; index++) {
+                    const uint32_t offset = SlotOffset(static_cast<uint16_t>((header.Head + index) % Slots));
+                    Slot slot;
+
+                    ::memcpy(&slot, &buffer[offset], sizeof(slot));
+
+                    slot.Status = Invalid;
+                    slot.ClearLength = 0;
+
+                    // Everything must be there, and the map must match the sample.
+                    const bool valid = IsValid(slot, size);
+                    const SubSample* map = ((valid == true) && (slot.SubSamples > 0) ? reinterpret_cast<const SubSample*>(&buffer[slot.SubSampleOffset]) : nullptr);
+
+                    if ((valid == true) && ((map == nullptr) || (Covers(map, slot.SubSamples) == slot.Length))) {
+                        if ((map != nullptr) && (Encrypted(map, slot.SubSamples) == 0)) {
+                            slot.Status = 0;
+                            slot.ClearLength = slot.Length;
+                        } else {
+                            uint32_t clearLength = 0;
+                            uint8_t* clear = nullptr;
+
+                            slot.Status = decrypt(slot, reinterpret_cast<const uint32_t*>(map), slot.SubSamples * 2, &buffer[slot.Offset], clearLength, clear);
+
+                            if ((slot.Status == 0) && (clearLength > slot.Length)) {
+                                slot.Status = Invalid;
+                            } else if (slot.Status == 0) {
+                                if ((clearLength > 0) && (clear != &buffer[slot.Offset])) {
+                                    Store(&buffer[slot.Offset], slot.Length, map, slot.SubSamples, clear, clearLength);
+                                }
+                                slot.ClearLength = clearLength;
+                            }
+                        }
+                    }
+
+                    ::memcpy(&buffer[offset], &slot, sizeof(slot));
+
+                    if ((result == 0) && (slot.Status != 0)) {
+                        result = slot.Status;
+                    }
+                }
+
+                header.Head = static_cast<uint16_t>((header.Head + pending) % Slots);
+                header.Pending = 0;
+
+                ::memcpy(buffer, &header, sizeof(header));
+            }
+
+            return (result);
+        }
+
+    private:
+        // Everything the slot refers to must lie in the data part of the buffer.
+        static bool IsValid(const Slot& slot, const uint32_t size)
+        {
+            bool result = ((slot.IVLength <= MaxIVLength) && (slot.KeyIdLength <= MaxKeyIdLength) && (slot.Offset >= DataOffset()) && ((static_cast<uint64_t>(slot.Offset) + slot.Length) <= size));
+
+            if ((result == true) && (slot.SubSamples > 0)) {
+                result = (((slot.SubSampleOffset & 3) == 0) && (slot.SubSampleOffset >= DataOffset()) && ((static_cast<uint64_t>(slot.SubSampleOffset) + (static_cast<uint64_t>(slot.SubSamples) * sizeof(SubSample))) <= size));
+            }
+
+            return (result);
+        }
+        static uint64_t Covers(const SubSample map[], const uint32_t count)
+        {
+            uint64_t result = 0;
+
+            for (uint32_t index = 0; index < count; index++) {
+                result += static_cast<uint64_t>(map[index].Clear) + map[index].Encrypted;
+            }
+
+            return (result);
+        }
+        static uint64_t Encrypted(const SubSample map[], const uint32_t count)
+        {
+            uint64_t result = 0;
+
+            for (uint32_t index = 0; index < count; index++) {
+                result += map[index].Encrypted;
+            }
+
+            return (result);
+        }
+        // Writes the clear sample back where the encrypted one was. The clear ranges of a sample with a
+        // subsample map are in there already, so only the encrypted ranges are copied. The map is in the
+        // shared buffer, so it is not trusted to still add up to the sample.
+        static void Store(uint8_t sample[], const uint32_t length, const SubSample map[], const uint32_t count, const uint8_t clear[], const uint32_t clearLength)
+        {
+            if ((map == nullptr) || (clearLength != length)) {
+                ::memcpy(sample, clear, clearLength);
+            } else {
+                uint32_t position = 0;
+
+                for (uint32_t index = 0; (index < count) && (position < length); index++) {
+                    const SubSample entry = map[index];
+
+                    position += std::min(entry.Clear, length - position);
+
+                    const uint32_t encrypted = std::min(entry.Encrypted, length - position);
+
+                    ::memcpy(&sample[position], &clear[position], encrypted);
+
+                    position += encrypted;
+                }
+            }
+        }
+    };
+
+} // namespace Plugin
+} // namespace WPEFramework
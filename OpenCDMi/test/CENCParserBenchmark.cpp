@@ -0,0 +1,99 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../CENCParser.h"
+#include "../../helpers/UnitTest.h"
+#include "InitData.h"
+
+#include <chrono>
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+using namespace WPEFramework::Plugin::InitData;
+
+// Parses per second for every entry of the corpus, as a session does for the init data it is created
+// with, and key id lookups per second, as a session lookup and a key status update do.
+
+namespace {
+
+    const uint32_t Parses = 200000;
+    const uint32_t Lookups = 2000000;
+    const uint16_t Sizes[] = { 1, 4, 16, 64 };
+
+    void Parse(const Entry& entry)
+    {
+        uint32_t found = 0;
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (uint32_t round = 0; round < Parses; round++) {
+            const CommonEncryptionData parsed(entry.Data.data(), static_cast<uint16_t>(entry.Data.size()));
+            found += (parsed.IsEmpty() == false ? 1 : 0);
+        }
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        CHECK(found == Parses);
+
+        printf("%-20s %5u bytes: %10.0f parses/s\n", entry.Name, static_cast<uint32_t>(entry.Data.size()), Parses / seconds);
+    }
+
+    // Half of the lookups are for key ids that are there, half for ones that are not.
+    void Lookup(const uint16_t size)
+    {
+        std::vector<CommonEncryptionData::KeyId> keys;
+        uint32_t found = 0;
+
+        CommonEncryptionData data(nullptr, 0);
+
+        for (uint16_t index = 0; index < (2 * size); index++) {
+            keys.push_back(Corpus::Key(CommonEncryptionData::COMMON, index));
+            if (index < size) {
+                data.AddKeyId(keys.back());
+            }
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (uint32_t round = 0; round < Lookups; round++) {
+            found += (data.HasKeyId(keys[round % keys.size()]) == true ? 1 : 0);
+        }
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        CHECK(found == (Lookups / 2));
+
+        printf("%3u key ids: %10.0f lookups/s\n", size, Lookups / seconds);
+    }
+}
+
+int main()
+{
+    const Corpus corpus;
+
+    for (const Entry& entry : corpus.Entries()) {
+        Parse(entry);
+    }
+
+    for (const uint16_t size : Sizes) {
+        Lookup(size);
+    }
+
+    return (UnitTest::Result());
+}
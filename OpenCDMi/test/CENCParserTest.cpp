@@ -0,0 +1,157 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../CENCParser.h"
+#include "../../helpers/UnitTest.h"
+#include "InitData.h"
+
+#include <cstdlib>
+#include <memory>
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+using namespace WPEFramework::Plugin::InitData;
+
+// The key ids of every kind of init data in the corpus are found, and mutations of all of it, flipped
+// bytes, counts and sizes that lie and data that is cut short, are parsed without reading past the end.
+// The mutated data is copied into a buffer of exactly its length, run it with -fsanitize=address.
+
+namespace {
+
+    const uint32_t Mutations = 20000; // per entry of the corpus
+
+    bool Has(const CommonEncryptionData& parsed, const CommonEncryptionData::KeyId& key)
+    {
+        return (parsed.HasKeyId(key) == true);
+    }
+
+    uint32_t Count(const CommonEncryptionData& parsed)
+    {
+        CommonEncryptionData::Iterator keys(parsed.Keys());
+        uint32_t result = 0;
+
+        while (keys.Next() == true) {
+            result++;
+        }
+
+        return (result);
+    }
+
+    void TestCorpus()
+    {
+        const Corpus corpus;
+
+        for (const Entry& entry : corpus.Entries()) {
+            const CommonEncryptionData parsed(entry.Data.data(), static_cast<uint16_t>(entry.Data.size()));
+
+            if (Count(parsed) != entry.Keys.size()) {
+                fprintf(stderr, "%s: %u key ids, expected %u\n", entry.Name, Count(parsed), static_cast<uint32_t>(entry.Keys.size()));
+            }
+            CHECK(Count(parsed) == entry.Keys.size());
+
+            for (const CommonEncryptionData::KeyId& key : entry.Keys) {
+                CHECK(Has(parsed, key) == true);
+            }
+
+            CHECK(Has(parsed, Corpus::Key(CommonEncryptionData::COMMON, 0xFFFF)) == false);
+        }
+    }
+
+    // The key id found in more than one box, is there once, flagged for all systems it was found for.
+    void TestDuplicates()
+    {
+        const Corpus corpus;
+        std::vector<uint8_t> data(corpus.Find(_T("cenc-v1-4")).Data);
+        const std::vector<uint8_t>& clearKey(corpus.Find(_T("clearkey-v1-2")).Data);
+
+        data.insert(data.end(), clearKey.begin(), clearKey.end());
+
+        const CommonEncryptionData parsed(data.data(), static_cast<uint16_t>(data.size()));
+        CommonEncryptionData::Iterator keys(parsed.Keys());
+
+        CHECK(Count(parsed) == 4);
+
+        while (keys.Next() == true) {
+            const uint32_t expected = (Corpus::Index(keys.Current()) < 2 ? (CommonEncryptionData::COMMON | CommonEncryptionData::CLEARKEY) : CommonEncryptionData::COMMON);
+            CHECK(keys.Current().Systems() == expected);
+        }
+    }
+
+    // The cases the scanner is bounded for, each on its own.
+    void TestBounds()
+    {
+        const Corpus corpus;
+
+        // A key id count way larger than what the box holds.
+        std::vector<uint8_t> data(corpus.Find(_T("cenc-v1-4")).Data);
+        data[28] = 0x7F;
+        Parse(data);
+
+        // A box size larger than the data.
+        data = corpus.Find(_T("cenc-v1-4")).Data;
+        data[0] = 0x7F;
+        Parse(data);
+
+        // Key ids cut off in the middle.
+        data = corpus.Find(_T("keyids-3")).Data;
+        data.resize(data.size() / 2);
+        Parse(data);
+
+        // The XML, cut at every possible length, <KID> and VALUE=" right up to the end of it included.
+        for (const TCHAR* name : { _T("playready-xml-v4.0"), _T("playready-xml-v4.2"), _T("playready-object") }) {
+            const std::vector<uint8_t>& xml(corpus.Find(name).Data);
+
+            for (uint32_t length = 1; length < xml.size(); length++) {
+                Parse(std::vector<uint8_t>(xml.begin(), xml.begin() + length));
+            }
+        }
+    }
+
+    void TestMutations()
+    {
+        const Corpus corpus;
+        Mutator mutator(11);
+
+        for (const Entry& entry : corpus.Entries()) {
+            for (uint32_t round = 0; round < Mutations; round++) {
+                const std::vector<uint8_t> data(mutator.Mutate(entry.Data));
+                const std::unique_ptr<CommonEncryptionData> parsed(Parse(data));
+                CommonEncryptionData::Iterator keys(parsed->Keys());
+
+                // Whatever it found, it finds again.
+                while (keys.Next() == true) {
+                    CHECK(Has(*parsed, keys.Current()) == true);
+                }
+
+                CHECK(parsed->IsEmpty() == (Count(*parsed) == 0));
+                CHECK(Count(*parsed) <= (data.size() / 4));
+            }
+        }
+    }
+}
+
+int main()
+{
+    TestCorpus();
+    TestDuplicates();
+    TestBounds();
+    TestMutations();
+
+    return (UnitTest::Result());
+}
@@ -0,0 +1,322 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../DecryptDispatcher.h"
+#include "../../helpers/UnitTest.h"
+
+#include <openssl/evp.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+namespace {
+
+    const uint8_t Key[16] = { 0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF };
+
+    const uint8_t Threads = 4;
+    const uint16_t Sessions = 64;
+    const uint32_t Requests = 200;
+    const uint32_t SampleSize = 2048;
+
+    void Crypt(const uint8_t iv[], uint8_t data[], const uint32_t length)
+    {
+        uint8_t counter[16] = {};
+        EVP_CIPHER_CTX* context = EVP_CIPHER_CTX_new();
+        int size = 0;
+
+        ::memcpy(counter, iv, 8);
+
+        EVP_EncryptInit_ex(context, EVP_aes_128_ctr(), nullptr, Key, counter);
+        EVP_EncryptUpdate(context, data, &size, data, static_cast<int>(length));
+        EVP_CIPHER_CTX_free(context);
+    }
+
+    class Semaphore {
+    public:
+        Semaphore()
+            : _lock()
+            , _signal()
+            , _count(0)
+        {
+        }
+
+    public:
+        void Post()
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            _count++;
+            _signal.notify_one();
+        }
+        void Wait()
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            _signal.wait(lock, [this]() { return (_count > 0); });
+            _count--;
+        }
+
+    private:
+        std::mutex _lock;
+        std::condition_variable _signal;
+        uint32_t _count;
+    };
+
+    // Decrypts in flight over all buffers, and the most there have been at once.
+    std::atomic<uint32_t> Active(0);
+    std::atomic<uint32_t> Highest(0);
+
+    // Stands in for the shared buffer of a ClearKey session: the client produces a request and waits for
+    // it to be consumed, with a semaphore for either side, as the shared buffer does between processes.
+    class Buffer {
+    public:
+        Buffer()
+            : _consumer()
+            , _producer()
+            , _data(SampleSize)
+            , _iv()
+            , _waits(0)
+            , _served(0)
+            , _serving(false)
+            , _overlap(false)
+            , _gate(nullptr)
+        {
+        }
+
+    public:
+        // The client side: decrypt a sample.
+        void Decrypt(std::vector<uint8_t>& sample, const uint8_t iv[])
+        {
+            ::memcpy(_data.data(), sample.data(), sample.size());
+            ::memcpy(_iv, iv, sizeof(_iv));
+
+            _consumer.Post();
+            _producer.Wait();
+
+            ::memcpy(sample.data(), _data.data(), sample.size());
+        }
+
+        // The side of the dispatcher.
+        bool Wait()
+        {
+            _consumer.Wait();
+            _waits++;
+            return (true);
+        }
+        void Interrupt()
+        {
+            _consumer.Post();
+        }
+        void Serve()
+        {
+            _overlap = (_overlap || _serving.exchange(true));
+
+            const uint32_t active = ++Active;
+            uint32_t highest = Highest;
+
+            while ((active > highest) && (Highest.compare_exchange_weak(highest, active) == false)) {
+            }
+
+            if (_gate != nullptr) {
+                _gate->Wait();
+            }
+
+            Crypt(_iv, _data.data(), static_cast<uint32_t>(_data.size()));
+
+            _served++;
+            Active--;
+            _serving = false;
+
+            _producer.Post();
+        }
+
+        uint32_t Waits() const
+        {
+            return (_waits);
+        }
+        uint32_t Served() const
+        {
+            return (_served);
+        }
+        bool Serving() const
+        {
+            return (_serving);
+        }
+        bool Overlap() const
+        {
+            return (_overlap);
+        }
+        // Serving blocks on the gate.
+        void Gate(Semaphore* gate)
+        {
+            _gate = gate;
+        }
+
+    private:
+        Semaphore _consumer;
+        Semaphore _producer;
+        std::vector<uint8_t> _data;
+        uint8_t _iv[8];
+        std::atomic<uint32_t> _waits;
+        std::atomic<uint32_t> _served;
+        std::atomic<bool> _serving;
+        bool _overlap;
+        Semaphore* _gate;
+    };
+
+    typedef DecryptDispatcher<Buffer> Dispatcher;
+
+    void TestStress()
+    {
+        std::vector<std::unique_ptr<Buffer>> buffers;
+        std::vector<std::thread> clients;
+        std::atomic<uint32_t> wrong(0);
+
+        Active = 0;
+        Highest = 0;
+
+        {
+            Dispatcher dispatcher(Threads);
+
+            for (uint16_t index = 0; index < Sessions; index++) {
+                buffers.emplace_back(new Buffer());
+                dispatcher.Attach(buffers.back().get());
+            }
+
+            // Idle sessions cost nothing, no watcher returns before there is a request.
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+            for (const std::unique_ptr<Buffer>& buffer : buffers) {
+                CHECK(buffer->Waits() == 0);
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+
+            for (uint16_t index = 0; index < Sessions; index++) {
+                clients.emplace_back([index, &buffers, &wrong]() {
+                    std::vector<uint8_t> clear(SampleSize);
+                    std::vector<uint8_t> sample(SampleSize);
+                    uint8_t iv[8] = { static_cast<uint8_t>(index) };
+
+                    for (uint32_t request = 0; request < Requests; request++) {
+                        for (uint32_t offset = 0; offset < SampleSize; offset++) {
+                            clear[offset] = static_cast<uint8_t>(index + request + offset);
+                        }
+
+                        iv[1] = static_cast<uint8_t>(request);
+                        sample = clear;
+                        Crypt(iv, sample.data(), SampleSize);
+
+                        buffers[index]->Decrypt(sample, iv);
+
+                        if (sample != clear) {
+                            wrong++;
+                        }
+                    }
+                });
+            }
+
+            for (std::thread& client : clients) {
+                client.join();
+            }
+
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            printf("%u sessions on %u decrypters: %.0f requests/s\n", Sessions, Threads, (Sessions * Requests) / seconds);
+
+            for (const std::unique_ptr<Buffer>& buffer : buffers) {
+                dispatcher.Detach(buffer.get());
+            }
+        }
+
+        CHECK(wrong == 0);
+        CHECK(Highest <= Threads);
+
+        // Every wake up was a request, apart from the one that ended the watcher.
+        for (const std::unique_ptr<Buffer>& buffer : buffers) {
+            CHECK(buffer->Served() == Requests);
+            CHECK(buffer->Waits() == (Requests + 1));
+            CHECK(buffer->Overlap() == false);
+        }
+    }
+
+    void TestDetach()
+    {
+        Buffer busy;
+        Buffer queued;
+        Semaphore gate;
+        std::vector<uint8_t> sample(SampleSize);
+        const uint8_t iv[8] = {};
+
+        Dispatcher dispatcher(1);
+
+        busy.Gate(&gate);
+        dispatcher.Attach(&busy);
+        dispatcher.Attach(&queued);
+
+        // The only decrypter is held up by the first buffer, the request of the second is queued.
+        std::thread first([&busy, &sample, &iv]() { std::vector<uint8_t> own(sample); busy.Decrypt(own, iv); });
+
+        while (busy.Serving() == false) {
+            std::this_thread::yield();
+        }
+
+        std::thread second([&queued, &sample, &iv]() { std::vector<uint8_t> own(sample); queued.Decrypt(own, iv); });
+
+        while (queued.Waits() == 0) {
+            std::this_thread::yield();
+        }
+
+        // A queued request is dropped, it does not wait for the decrypter.
+        dispatcher.Detach(&queued);
+
+        CHECK(queued.Served() == 0);
+
+        // A buffer being served, is only detached once it is done.
+        std::atomic<bool> detached(false);
+        std::thread detach([&dispatcher, &busy, &detached]() { dispatcher.Detach(&busy); detached = true; });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+        CHECK(detached == false);
+
+        gate.Post();
+        detach.join();
+
+        CHECK(detached == true);
+        CHECK(busy.Served() == 1);
+
+        first.join();
+
+        // The client of the dropped request is let go by hand, its session is gone.
+        queued.Serve();
+        second.join();
+    }
+}
+
+int main()
+{
+    TestStress();
+    TestDetach();
+
+    return (UnitTest::Result());
+}
@@ -0,0 +1,349 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "../CENCParser.h"
+
+#include <memory>
+#include <vector>
+
+// The init data the CENCParser test and benchmark share: a corpus of PSSH boxes, PlayReady objects and
+// headers and ClearKey key ids, all with key ids that are known, and a mutator to fuzz them with.
+
+namespace WPEFramework {
+namespace Plugin {
+namespace InitData {
+
+    static const uint8_t CommonEncryption[] = { 0x10, 0x77, 0xef, 0xec, 0xc0, 0xb2, 0x4d, 0x02, 0xac, 0xe3, 0x3c, 0x1e, 0x52, 0xe2, 0xfb, 0x4b };
+    static const uint8_t PlayReady[] = { 0x9a, 0x04, 0xf0, 0x79, 0x98, 0x40, 0x42, 0x86, 0xab, 0x92, 0xe6, 0x5b, 0xe0, 0x88, 0x5f, 0x95 };
+    static const uint8_t WideVine[] = { 0xed, 0xef, 0x8b, 0xa9, 0x79, 0xd6, 0x4a, 0xce, 0xa3, 0xc8, 0x27, 0xdc, 0xd5, 0x1d, 0x21, 0xed };
+    static const uint8_t ClearKey[] = { 0x58, 0x14, 0x7e, 0xc8, 0x04, 0x23, 0x46, 0x59, 0x92, 0xe6, 0xf5, 0x2c, 0x5c, 0xe8, 0xc3, 0xcc };
+
+    struct Entry {
+        const TCHAR* Name;
+        std::vector<uint8_t> Data;
+        std::vector<CommonEncryptionData::KeyId> Keys;
+    };
+
+    class Corpus {
+    private:
+        Corpus(const Corpus&) = delete;
+        Corpus& operator=(const Corpus&) = delete;
+
+        static constexpr uint8_t KeyLength = 16;
+
+    public:
+        Corpus()
+            : _entries()
+        {
+            for (const uint16_t count : { 1, 4, 16 }) {
+                Add((count == 1 ? _T("cenc-v1-1") : count == 4 ? _T("cenc-v1-4") : _T("cenc-v1-16")), Box(CommonEncryption, 1, Range(0, count), {}), Keys(CommonEncryptionData::COMMON, 0, count));
+            }
+
+            // Version 0, the key id is in the protobuf data: a 0x08 0x01 (algorithm) and 0x12 0x10 (key id) ahead of it.
+            std::vector<uint8_t> protobuf({ 0x08, 0x01, 0x12, 0x10 });
+            Append(protobuf, Raw(0));
+            Add(_T("widevine-v0"), Box(WideVine, 0, {}, protobuf), Keys(CommonEncryptionData::WIDEVINE, 0, 1));
+
+            Add(_T("clearkey-v1-2"), Box(ClearKey, 1, Range(0, 2), {}), Keys(CommonEncryptionData::CLEARKEY, 0, 2));
+            Add(_T("playready-v1-2"), Box(PlayReady, 1, Range(0, 2), {}), Keys(CommonEncryptionData::PLAYREADY, 0, 2));
+
+            Add(_T("playready-xml-v4.0"), Wide(Header40(0)), { Guid(0) });
+            Add(_T("playready-xml-v4.2"), Wide(Header42(1, 2)), { Guid(1), Guid(2) });
+            Add(_T("playready-object"), Object(Wide(Header40(3))), { Guid(3) });
+
+            string json(_T("{\"kids\":["));
+            for (uint16_t index = 0; index < 3; index++) {
+                json += (index == 0 ? _T("\"") : _T(", \"")) + Base64(Raw(index), true) + _T("\"");
+            }
+            json += _T("],\"type\":\"temporary\"}");
+            Add(_T("keyids-3"), std::vector<uint8_t>(json.begin(), json.end()), Keys(CommonEncryptionData::CLEARKEY, 0, 3));
+
+            // What a CENC stream with several DRM systems carries: a box for each of them.
+            std::vector<uint8_t> mixed(Box(CommonEncryption, 1, Range(0, 2), {}));
+            Append(mixed, Find(_T("widevine-v0")).Data);
+            Append(mixed, Find(_T("playready-v1-2")).Data);
+            Append(mixed, Box(ClearKey, 1, Range(2, 3), {}));
+            Add(_T("mixed"), mixed, Keys(CommonEncryptionData::COMMON, 0, 3));
+        }
+        ~Corpus()
+        {
+        }
+
+    public:
+        const std::vector<Entry>& Entries() const
+        {
+            return (_entries);
+        }
+        const Entry& Find(const TCHAR name[]) const
+        {
+            std::vector<Entry>::const_iterator index(_entries.begin());
+
+            while ((index != _entries.end()) && (string(index->Name) != name)) {
+                index++;
+            }
+
+            ASSERT(index != _entries.end());
+
+            return (*index);
+        }
+
+        // The key ids are made up, but they are all different, and carry their index in the last two bytes.
+        static std::vector<uint8_t> Raw(const uint16_t index)
+        {
+            std::vector<uint8_t> result(KeyLength);
+
+            for (uint8_t position = 0; position < (KeyLength - 2); position++) {
+                result[position] = static_cast<uint8_t>((index * 37) + (position * 11) + 1);
+            }
+            result[KeyLength - 2] = static_cast<uint8_t>(index >> 8);
+            result[KeyLength - 1] = static_cast<uint8_t>(index & 0xFF);
+
+            return (result);
+        }
+        static CommonEncryptionData::KeyId Key(const CommonEncryptionData::systemType system, const uint16_t index)
+        {
+            return (CommonEncryptionData::KeyId(system, Raw(index).data(), KeyLength));
+        }
+        // PlayReady has the key id as a GUID, the parser hands its fields to the KeyId.
+        static CommonEncryptionData::KeyId Guid(const uint16_t index)
+        {
+            const std::vector<uint8_t> raw(Raw(index));
+
+            return (CommonEncryptionData::KeyId(CommonEncryptionData::PLAYREADY,
+                (static_cast<uint32_t>(raw[0]) << 24) | (raw[1] << 16) | (raw[2] << 8) | raw[3],
+                static_cast<uint16_t>((raw[4] << 8) | raw[5]),
+                static_cast<uint16_t>((raw[6] << 8) | raw[7]),
+                &(raw[8])));
+        }
+        static uint16_t Index(const OCDM::KeyId& key)
+        {
+            return (static_cast<uint16_t>((key.Id()[KeyLength - 2] << 8) | key.Id()[KeyLength - 1]));
+        }
+
+    private:
+        void Add(const TCHAR name[], const std::vector<uint8_t>& data, const std::vector<CommonEncryptionData::KeyId>& keys)
+        {
+            _entries.push_back({ name, data, keys });
+        }
+        static void Append(std::vector<uint8_t>& data, const std::vector<uint8_t>& more)
+        {
+            data.insert(data.end(), more.begin(), more.end());
+        }
+        static void Append(std::vector<uint8_t>& data, const uint32_t value)
+        {
+            data.push_back(static_cast<uint8_t>(value >> 24));
+            data.push_back(static_cast<uint8_t>(value >> 16));
+            data.push_back(static_cast<uint8_t>(value >> 8));
+            data.push_back(static_cast<uint8_t>(value));
+        }
+        static std::vector<uint16_t> Range(const uint16_t first, const uint16_t end)
+        {
+            std::vector<uint16_t> result;
+
+            for (uint16_t index = first; index < end; index++) {
+                result.push_back(index);
+            }
+            return (result);
+        }
+        static std::vector<CommonEncryptionData::KeyId> Keys(const CommonEncryptionData::systemType system, const uint16_t first, const uint16_t end)
+        {
+            std::vector<CommonEncryptionData::KeyId> result;
+
+            for (const uint16_t index : Range(first, end)) {
+                result.push_back(Key(system, index));
+            }
+            return (result);
+        }
+        // ISO/IEC 23001-7: size, "pssh", version and flags, the system id, for version 1 the key ids, and the data.
+        static std::vector<uint8_t> Box(const uint8_t system[], const uint8_t version, const std::vector<uint16_t>& kids, const std::vector<uint8_t>& data)
+        {
+            std::vector<uint8_t> body({ 'p', 's', 's', 'h', version, 0, 0, 0 });
+
+            body.insert(body.end(), system, system + KeyLength);
+
+            if (version == 1) {
+                Append(body, static_cast<uint32_t>(kids.size()));
+                for (const uint16_t index : kids) {
+                    Append(body, Raw(index));
+                }
+            }
+            Append(body, static_cast<uint32_t>(data.size()));
+            Append(body, data);
+
+            std::vector<uint8_t> result;
+            Append(result, static_cast<uint32_t>(body.size() + 4));
+            Append(result, body);
+
+            return (result);
+        }
+        // A PlayReady object, little endian: its size, one record, of type 1 (the header), and its size.
+        static std::vector<uint8_t> Object(const std::vector<uint8_t>& header)
+        {
+            const uint32_t size = static_cast<uint32_t>(header.size() + 10);
+            std::vector<uint8_t> result({
+                static_cast<uint8_t>(size), static_cast<uint8_t>(size >> 8), static_cast<uint8_t>(size >> 16), static_cast<uint8_t>(size >> 24),
+                1, 0,
+                1, 0,
+                static_cast<uint8_t>(header.size()), static_cast<uint8_t>(header.size() >> 8) });
+
+            Append(result, header);
+
+            return (result);
+        }
+        static string Header40(const uint16_t index)
+        {
+            return (_T("<WRMHEADER xmlns=\"http://schemas.microsoft.com/DRM/2007/03/PlayReadyHeader\" version=\"4.0.0.0\"><DATA><PROTECTINFO><KEYLEN>16</KEYLEN><ALGID>AESCTR</ALGID></PROTECTINFO><KID>")
+                + Base64(Raw(index), false)
+                + _T("</KID><CHECKSUM>xNvWVxoWk04=</CHECKSUM><LA_URL>http://license.example.com/rightsmanager.asmx</LA_URL></DATA></WRMHEADER>"));
+        }
+        static string Header42(const uint16_t first, const uint16_t second)
+        {
+            return (_T("<WRMHEADER xmlns=\"http://schemas.microsoft.com/DRM/2007/03/PlayReadyHeader\" version=\"4.2.0.0\"><DATA><PROTECTINFO><KIDS><KID ALGID=\"AESCTR\" CHECKSUM=\"xNvWVxoWk04=\" VALUE=\"")
+                + Base64(Raw(first), false)
+                + _T("\"></KID><KID ALGID=\"AESCTR\" VALUE=\"")
+                + Base64(Raw(second), false)
+                + _T("\"></KID></KIDS></PROTECTINFO><LA_URL>http://license.example.com/rightsmanager.asmx</LA_URL></DATA></WRMHEADER>"));
+        }
+        // The PlayReady header is UTF-16, little endian.
+        static std::vector<uint8_t> Wide(const string& text)
+        {
+            std::vector<uint8_t> result;
+
+            for (const TCHAR character : text) {
+                result.push_back(static_cast<uint8_t>(character));
+                result.push_back(0);
+            }
+            return (result);
+        }
+        static string Base64(const std::vector<uint8_t>& data, const bool url)
+        {
+            const TCHAR* alphabet = (url == true ? _T("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_") : _T("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"));
+            string result;
+            uint32_t bits = 0;
+            uint8_t count = 0;
+
+            for (const uint8_t value : data) {
+                bits = (bits << 8) | value;
+                count += 8;
+                while (count >= 6) {
+                    count -= 6;
+                    result += alphabet[(bits >> count) & 0x3F];
+                }
+            }
+            if (count > 0) {
+                result += alphabet[(bits << (6 - count)) & 0x3F];
+            }
+            // ClearKey key ids go without the padding.
+            while ((url == false) && ((result.length() % 4) != 0)) {
+                result += '=';
+            }
+            return (result);
+        }
+
+    private:
+        std::vector<Entry> _entries;
+    };
+
+    // Mutates init data the way a broken or hostile stream would: flipped bytes, sizes and counts that lie,
+    // data that is cut short or has a piece missing or repeated.
+    class Mutator {
+    private:
+        Mutator(const Mutator&) = delete;
+        Mutator& operator=(const Mutator&) = delete;
+
+    public:
+        Mutator(const uint32_t seed)
+            : _state(seed | 1)
+        {
+        }
+        ~Mutator()
+        {
+        }
+
+    public:
+        std::vector<uint8_t> Mutate(const std::vector<uint8_t>& data)
+        {
+            std::vector<uint8_t> result(data);
+            const uint8_t steps = 1 + (Random() % 4);
+
+            for (uint8_t step = 0; (step < steps) && (result.empty() == false); step++) {
+                const uint32_t position = Random() % result.size();
+
+                switch (Random() % 5) {
+                case 0:
+                    result[position] = static_cast<uint8_t>(Random());
+                    break;
+                case 1:
+                    result.resize(position);
+                    break;
+                case 2: {
+                    static const uint32_t Lies[] = { 0, 1, 2, 16, 17, 0x7F, 0xFF, 0xFFFF, 0x7FFFFFFF, 0xFFFFFFFF };
+                    const uint32_t lie = (Random() % 2 == 0 ? Lies[Random() % (sizeof(Lies) / sizeof(Lies[0]))] : static_cast<uint32_t>(result.size() - position + (Random() % 5) - 2));
+
+                    for (uint8_t index = 0; (index < 4) && ((position + index) < result.size()); index++) {
+                        result[position + index] = static_cast<uint8_t>(lie >> (24 - (index * 8)));
+                    }
+                    break;
+                }
+                case 3: {
+                    const uint32_t length = std::min(static_cast<uint32_t>(result.size() - position), 1 + (Random() % 32));
+                    result.erase(result.begin() + position, result.begin() + position + length);
+                    break;
+                }
+                default: {
+                    const uint32_t length = std::min(static_cast<uint32_t>(result.size() - position), 1 + (Random() % 32));
+                    const std::vector<uint8_t> piece(result.begin() + position, result.begin() + position + length);
+                    result.insert(result.begin() + (Random() % result.size()), piece.begin(), piece.end());
+                    break;
+                }
+                }
+            }
+
+            return (result);
+        }
+
+    private:
+        // xorshift32, the same mutations on every platform and every run.
+        uint32_t Random()
+        {
+            _state ^= (_state << 13);
+            _state ^= (_state >> 17);
+            _state ^= (_state << 5);
+            return (_state);
+        }
+
+    private:
+        uint32_t _state;
+    };
+
+    // Parses a copy of the data in a buffer of exactly its length, so a read past the end is caught.
+    inline std::unique_ptr<CommonEncryptionData> Parse(const std::vector<uint8_t>& data)
+    {
+        std::unique_ptr<uint8_t[]> buffer(new uint8_t[data.size()]);
+
+        std::copy(data.begin(), data.end(), buffer.get());
+
+        return (std::unique_ptr<CommonEncryptionData>(new CommonEncryptionData(buffer.get(), static_cast<uint16_t>(data.size()))));
+    }
+
+} // namespace InitData
+} // namespace Plugin
+} // namespace WPEFramework
@@ -0,0 +1,159 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../SampleRing.h"
+#include "../../helpers/UnitTest.h"
+
+#include <openssl/evp.h>
+#include <semaphore.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+// Samples per second over the shared buffer, one sample per handshake against batches of them. The client
+// and the decrypting side are threads here, handing the buffer back and forth with a pair of semaphores,
+// the way the shared buffer does between the processes.
+
+namespace {
+
+    const uint8_t KeyId[16] = { 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F };
+    const uint8_t Key[16] = { 0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF };
+    const uint8_t IV[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+    const uint32_t Samples = 32 * 1024;
+    const uint32_t SampleSize = 1024; // an audio frame
+
+    class Loopback {
+    public:
+        Loopback(const uint32_t size)
+            : _buffer(size)
+            , _size(0)
+            , _done(false)
+        {
+            ::sem_init(&_consumer, 0, 0);
+            ::sem_init(&_producer, 0, 0);
+
+            _decrypter = std::thread([this]() { Serve(); });
+        }
+        ~Loopback()
+        {
+            _done = true;
+            ::sem_post(&_consumer);
+
+            _decrypter.join();
+
+            ::sem_destroy(&_consumer);
+            ::sem_destroy(&_producer);
+        }
+
+    public:
+        uint8_t* Buffer()
+        {
+            return (_buffer.data());
+        }
+        uint32_t Size() const
+        {
+            return (static_cast<uint32_t>(_buffer.size()));
+        }
+        // Produced, and wait for it to be Consumed.
+        void Handshake(const uint32_t size)
+        {
+            _size = size;
+            ::sem_post(&_consumer);
+            ::sem_wait(&_producer);
+        }
+
+    private:
+        void Serve()
+        {
+            EVP_CIPHER_CTX* context = EVP_CIPHER_CTX_new();
+
+            ::sem_wait(&_consumer);
+
+            while (_done == false) {
+                SampleRing::Process(_buffer.data(), _size, [context](const SampleRing::Slot& slot, const uint32_t[], const uint32_t, const uint8_t sample[], uint32_t& clearLength, uint8_t*& clear) -> uint32_t {
+                    uint8_t counter[16] = {};
+                    int size = 0;
+
+                    ::memcpy(counter, slot.IV, slot.IVLength);
+                    clear = const_cast<uint8_t*>(sample);
+                    clearLength = slot.Length;
+
+                    EVP_EncryptInit_ex(context, EVP_aes_128_ctr(), nullptr, Key, counter);
+                    EVP_EncryptUpdate(context, clear, &size, sample, static_cast<int>(slot.Length));
+
+                    return (0);
+                });
+
+                ::sem_post(&_producer);
+                ::sem_wait(&_consumer);
+            }
+
+            EVP_CIPHER_CTX_free(context);
+        }
+
+    private:
+        std::vector<uint8_t> _buffer;
+        uint32_t _size;
+        bool _done;
+        sem_t _consumer;
+        sem_t _producer;
+        std::thread _decrypter;
+    };
+
+    void Run(const uint16_t batch)
+    {
+        Loopback loopback(SampleRing::DataOffset() + (batch * SampleSize));
+        SampleRing::Writer writer(loopback.Buffer(), loopback.Size());
+        std::vector<uint8_t> sample(SampleSize, 0x5A);
+        uint32_t failed = 0;
+        uint16_t slot = 0;
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (uint32_t index = 0; index < Samples; index += batch) {
+            for (uint16_t count = 0; count < batch; count++) {
+                CHECK(writer.Add(sample.data(), SampleSize, IV, sizeof(IV), KeyId, sizeof(KeyId), false, slot) == true);
+            }
+
+            loopback.Handshake(writer.Size());
+
+            failed += (writer.Result(slot).Status != 0 ? 1 : 0);
+        }
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        CHECK(failed == 0);
+
+        printf("%2u samples per handshake: %9.0f samples/s, %7.0f handshakes/s\n", batch, Samples / seconds, (Samples / batch) / seconds);
+    }
+}
+
+int main()
+{
+    for (const uint16_t batch : { 1, 4, 16, 64 }) {
+        Run(batch);
+    }
+
+    return (UnitTest::Result());
+}
@@ -0,0 +1,386 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../SampleRing.h"
+#include "../../helpers/UnitTest.h"
+
+#include <openssl/evp.h>
+
+#include <functional>
+#include <vector>
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+namespace {
+
+    const uint8_t KeyId[2][16] = {
+        { 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F },
+        { 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F }
+    };
+    const uint8_t Key[2][16] = {
+        { 0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF },
+        { 0xB0, 0xB1, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xBB, 0xBC, 0xBD, 0xBE, 0xBF }
+    };
+
+    const uint32_t KeyNotFound = 0x80000002;
+
+    // The 'cenc' scheme of ISO/IEC 23001-7: AES-128-CTR, an 8 byte IV followed by a 64 bit block counter.
+    // With a subsample map, only the encrypted ranges are, as one stream, the clear ranges are left out.
+    void Crypt(const uint8_t key[], const uint8_t iv[], const uint8_t ivLength, const uint8_t input[], const uint32_t length, const uint32_t map[], const uint32_t entries, uint8_t output[])
+    {
+        uint8_t counter[16] = {};
+        EVP_CIPHER_CTX* context = EVP_CIPHER_CTX_new();
+        int size = 0;
+
+        ::memcpy(counter, iv, ivLength);
+
+        EVP_EncryptInit_ex(context, EVP_aes_128_ctr(), nullptr, key, counter);
+
+        if (entries == 0) {
+            EVP_EncryptUpdate(context, output, &size, input, static_cast<int>(length));
+        } else {
+            uint32_t position = 0;
+
+            for (uint32_t index = 0; index < entries; index += 2) {
+                position += map[index];
+                EVP_EncryptUpdate(context, &output[position], &size, &input[position], static_cast<int>(map[index + 1]));
+                position += map[index + 1];
+            }
+        }
+
+        EVP_CIPHER_CTX_free(context);
+    }
+
+    // Stands in for the DRM system behind the session, a ClearKey like one with the keys above.
+    class Decryptor {
+    public:
+        Decryptor(const bool inPlace)
+            : _inPlace(inPlace)
+            , _calls(0)
+            , _entries(0)
+            , _overrun(0)
+            , _clear()
+        {
+        }
+
+    public:
+        uint32_t operator()(const SampleRing::Slot& slot, const uint32_t subSamples[], const uint32_t entries, const uint8_t sample[], uint32_t& clearLength, uint8_t*& clear)
+        {
+            uint32_t result = KeyNotFound;
+
+            _calls++;
+            _entries = entries;
+
+            for (uint8_t index = 0; index < 2; index++) {
+                if ((slot.KeyIdLength == sizeof(KeyId[index])) && (::memcmp(slot.KeyId, KeyId[index], sizeof(KeyId[index])) == 0)) {
+                    // Some DRM systems decrypt into the buffer they got, others into one of their own. This
+                    // one only decrypts the encrypted ranges into it, the clear ranges are not copied there.
+                    clear = (_inPlace == true ? const_cast<uint8_t*>(sample) : Output(slot.Length));
+                    clearLength = slot.Length + _overrun;
+
+                    Crypt(Key[index], slot.IV, slot.IVLength, sample, slot.Length, subSamples, entries, clear);
+                    result = 0;
+                }
+            }
+
+            return (result);
+        }
+        uint32_t Calls() const
+        {
+            return (_calls);
+        }
+        // The size of the last map, in uint32_t entries.
+        uint32_t Entries() const
+        {
+            return (_entries);
+        }
+        // Report more clear bytes than there were encrypted ones.
+        void Overrun(const uint32_t bytes)
+        {
+            _overrun = bytes;
+        }
+
+    private:
+        uint8_t* Output(const uint32_t length)
+        {
+            _clear.assign(length + _overrun, 0xEE);
+            return (_clear.data());
+        }
+
+    private:
+        const bool _inPlace;
+        uint32_t _calls;
+        uint32_t _entries;
+        uint32_t _overrun;
+        std::vector<uint8_t> _clear;
+    };
+
+    // A sample as the client has it, and what it is after encryption.
+    struct Sample {
+        Sample(const uint32_t length, const uint8_t key, const uint8_t seed, const std::vector<SampleRing::SubSample>& map = {})
+            : Clear(length)
+            , Encrypted(length)
+            , IV()
+            , Key(key)
+            , Map(map)
+            , Slot(0)
+        {
+            for (uint32_t index = 0; index < length; index++) {
+                Clear[index] = static_cast<uint8_t>(seed + (index * 7));
+            }
+            for (uint8_t index = 0; index < 8; index++) {
+                IV[index] = static_cast<uint8_t>(seed ^ index);
+            }
+
+            // The clear ranges stay as they are.
+            Encrypted = Clear;
+            Crypt(::Key[key], IV, 8, Clear.data(), length, reinterpret_cast<const uint32_t*>(Map.data()), static_cast<uint32_t>(Map.size() * 2), Encrypted.data());
+        }
+
+        std::vector<uint8_t> Clear;
+        std::vector<uint8_t> Encrypted;
+        uint8_t IV[8];
+        uint8_t Key;
+        std::vector<SampleRing::SubSample> Map;
+        uint16_t Slot;
+    };
+
+    bool Add(SampleRing::Writer& writer, Sample& sample)
+    {
+        return (writer.Add(sample.Encrypted.data(), static_cast<uint32_t>(sample.Encrypted.size()), sample.Map.data(), static_cast<uint16_t>(sample.Map.size()), sample.IV, sizeof(sample.IV), KeyId[sample.Key], sizeof(KeyId[sample.Key]), false, sample.Slot));
+    }
+
+    // The sample came back in the clear, where it was written.
+    bool Decrypted(const SampleRing::Writer& writer, const std::vector<uint8_t>& buffer, const Sample& sample)
+    {
+        const SampleRing::Slot slot(writer.Result(sample.Slot));
+
+        return ((slot.Status == 0) && (slot.ClearLength == sample.Clear.size()) && (::memcmp(&buffer[slot.Offset], sample.Clear.data(), sample.Clear.size()) == 0));
+    }
+
+    void TestSingle()
+    {
+        std::vector<uint8_t> buffer(8 * 1024, 0x5A);
+        Decryptor decryptor(false);
+
+        // Whatever a single sample looks like, it does not start with a ring header.
+        CHECK(SampleRing::Pending(buffer.data(), static_cast<uint32_t>(buffer.size())) == 0);
+        CHECK(SampleRing::Process(buffer.data(), static_cast<uint32_t>(buffer.size()), decryptor) == 0);
+        CHECK(decryptor.Calls() == 0);
+        CHECK(buffer == std::vector<uint8_t>(8 * 1024, 0x5A));
+
+        // An empty ring is no batch either, nor is one that does not fit in what was handed over.
+        SampleRing::Writer writer(buffer.data(), static_cast<uint32_t>(buffer.size()));
+        Sample sample(100, 0, 1);
+
+        CHECK(SampleRing::Pending(buffer.data(), static_cast<uint32_t>(buffer.size())) == 0);
+        CHECK(Add(writer, sample) == true);
+        CHECK(SampleRing::Pending(buffer.data(), SampleRing::DataOffset() - 1) == 0);
+
+        // A buffer too small for the slots takes no samples.
+        std::vector<uint8_t> small(SampleRing::DataOffset() - 1);
+        SampleRing::Writer none(small.data(), static_cast<uint32_t>(small.size()));
+
+        CHECK(Add(none, sample) == false);
+    }
+
+    void TestBatch(const bool inPlace)
+    {
+        std::vector<uint8_t> buffer(16 * 1024);
+        SampleRing::Writer writer(buffer.data(), static_cast<uint32_t>(buffer.size()));
+        Decryptor decryptor(inPlace);
+        std::vector<Sample> samples = { Sample(1000, 0, 1), Sample(17, 1, 2), Sample(4096, 0, 3) };
+
+        for (Sample& sample : samples) {
+            CHECK(Add(writer, sample) == true);
+        }
+
+        CHECK(SampleRing::Pending(buffer.data(), writer.Size()) == 3);
+
+        // A single handshake for all of them.
+        CHECK(SampleRing::Process(buffer.data(), writer.Size(), decryptor) == 0);
+        CHECK(decryptor.Calls() == 3);
+        CHECK(SampleRing::Pending(buffer.data(), writer.Size()) == 0);
+
+        for (const Sample& sample : samples) {
+            CHECK(Decrypted(writer, buffer, sample) == true);
+        }
+    }
+
+    void TestFailures()
+    {
+        std::vector<uint8_t> buffer(16 * 1024);
+        SampleRing::Writer writer(buffer.data(), static_cast<uint32_t>(buffer.size()));
+        Decryptor decryptor(false);
+        Sample first(100, 0, 1);
+        Sample unknown(100, 0, 2);
+        Sample outside(100, 1, 3);
+        Sample last(100, 1, 4);
+
+        CHECK(Add(writer, first) == true);
+        CHECK(writer.Add(unknown.Encrypted.data(), 100, unknown.IV, 8, Key[0], 16, false, unknown.Slot) == true);
+        CHECK(Add(writer, outside) == true);
+        CHECK(Add(writer, last) == true);
+
+        // A slot pointing past what was handed over, is not even offered to the DRM system.
+        SampleRing::Slot slot;
+        ::memcpy(&slot, &buffer[SampleRing::SlotOffset(outside.Slot)], sizeof(slot));
+        slot.Offset = writer.Size() - 50;
+        ::memcpy(&buffer[SampleRing::SlotOffset(outside.Slot)], &slot, sizeof(slot));
+
+        // The first failure is the result, every sample has its own status.
+        CHECK(SampleRing::Process(buffer.data(), writer.Size(), decryptor) == KeyNotFound);
+        CHECK(decryptor.Calls() == 3);
+        CHECK(Decrypted(writer, buffer, first) == true);
+        CHECK(writer.Result(unknown.Slot).Status == KeyNotFound);
+        CHECK(writer.Result(unknown.Slot).ClearLength == 0);
+        CHECK(::memcmp(&buffer[writer.Result(unknown.Slot).Offset], unknown.Encrypted.data(), 100) == 0);
+        CHECK(writer.Result(outside.Slot).Status == SampleRing::Invalid);
+        CHECK(Decrypted(writer, buffer, last) == true);
+
+        // More clear bytes than the sample had, would run into the next one.
+        Sample grown(100, 0, 5);
+        Sample next(100, 0, 6);
+
+        decryptor.Overrun(1);
+
+        CHECK(Add(writer, grown) == true);
+        CHECK(Add(writer, next) == true);
+        CHECK(SampleRing::Process(buffer.data(), writer.Size(), decryptor) == SampleRing::Invalid);
+        CHECK(writer.Result(grown.Slot).Status == SampleRing::Invalid);
+        CHECK(::memcmp(&buffer[writer.Result(next.Slot).Offset], next.Encrypted.data(), 100) == 0);
+    }
+
+    void TestSubSamples(const bool inPlace)
+    {
+        std::vector<uint8_t> buffer(16 * 1024);
+        SampleRing::Writer writer(buffer.data(), static_cast<uint32_t>(buffer.size()));
+        Decryptor decryptor(inPlace);
+
+        // A video sample: the NAL unit headers in the clear, the slice data encrypted, one stream over all
+        // encrypted ranges. The odd length of the first sample puts the map of the next one off alignment.
+        Sample video(1581, 1, 1, { { 5, 300 }, { 22, 1024 }, { 7, 0 }, { 3, 220 } });
+        Sample whole(999, 0, 2);
+        Sample clear(300, 0, 3, { { 100, 0 }, { 200, 0 } });
+        Sample second(2000, 0, 4, { { 16, 1984 } });
+
+        CHECK(Add(writer, video) == true);
+        CHECK(Add(writer, whole) == true);
+        CHECK(Add(writer, clear) == true);
+        CHECK(Add(writer, second) == true);
+
+        CHECK(video.Encrypted != video.Clear);
+        CHECK(::memcmp(video.Encrypted.data(), video.Clear.data(), 5) == 0);
+        CHECK((writer.Result(second.Slot).SubSampleOffset & 3) == 0);
+
+        CHECK(SampleRing::Process(buffer.data(), writer.Size(), decryptor) == 0);
+
+        // Nothing encrypted in the clear one, the DRM system is not even asked.
+        CHECK(decryptor.Calls() == 3);
+        CHECK(decryptor.Entries() == 2);
+
+        for (const Sample& sample : { std::ref(video), std::ref(whole), std::ref(clear), std::ref(second) }) {
+            CHECK(Decrypted(writer, buffer, sample) == true);
+        }
+
+        // A map that does not add up to the sample, is not handed to the DRM system.
+        Sample shorter(100, 0, 5, { { 10, 80 } });
+        Sample longer(100, 0, 6, { { 10, 90 } });
+
+        longer.Map[0].Encrypted = 100;
+
+        CHECK(Add(writer, shorter) == true);
+        CHECK(Add(writer, longer) == true);
+        CHECK(SampleRing::Process(buffer.data(), writer.Size(), decryptor) == SampleRing::Invalid);
+        CHECK(decryptor.Calls() == 3);
+        CHECK(writer.Result(shorter.Slot).Status == SampleRing::Invalid);
+        CHECK(writer.Result(longer.Slot).Status == SampleRing::Invalid);
+
+        // Nor is a map outside the buffer.
+        Sample outside(100, 0, 7, { { 10, 90 } });
+        SampleRing::Slot slot;
+
+        CHECK(Add(writer, outside) == true);
+        ::memcpy(&slot, &buffer[SampleRing::SlotOffset(outside.Slot)], sizeof(slot));
+        slot.SubSampleOffset = writer.Size() - 4;
+        ::memcpy(&buffer[SampleRing::SlotOffset(outside.Slot)], &slot, sizeof(slot));
+
+        CHECK(SampleRing::Process(buffer.data(), writer.Size(), decryptor) == SampleRing::Invalid);
+        CHECK(decryptor.Calls() == 3);
+    }
+
+    void TestWrap()
+    {
+        std::vector<uint8_t> buffer(SampleRing::DataOffset() + (SampleRing::Slots * 64));
+        SampleRing::Writer writer(buffer.data(), static_cast<uint32_t>(buffer.size()));
+        Decryptor decryptor(false);
+        std::vector<Sample> first;
+        std::vector<Sample> second;
+
+        for (uint16_t index = 0; index < 40; index++) {
+            first.emplace_back(64, index & 1, static_cast<uint8_t>(index));
+            CHECK(Add(writer, first.back()) == true);
+        }
+
+        CHECK(SampleRing::Process(buffer.data(), writer.Size(), decryptor) == 0);
+
+        // The next ones go on from slot 40 and wrap around, the data starts at the beginning again.
+        for (uint16_t index = 0; index < SampleRing::Slots; index++) {
+            second.emplace_back(64, index & 1, static_cast<uint8_t>(index + 100));
+            CHECK(Add(writer, second.back()) == true);
+        }
+
+        CHECK(second.front().Slot == 40);
+        CHECK(second[SampleRing::Slots - 40].Slot == 0);
+        CHECK(writer.Result(second.front().Slot).Offset == SampleRing::DataOffset());
+
+        // The ring is full, so is the buffer.
+        Sample extra(1, 0, 0);
+        CHECK(Add(writer, extra) == false);
+
+        CHECK(SampleRing::Process(buffer.data(), writer.Size(), decryptor) == 0);
+        CHECK(decryptor.Calls() == (40 + SampleRing::Slots));
+
+        for (const Sample& sample : second) {
+            CHECK(Decrypted(writer, buffer, sample) == true);
+        }
+
+        // Handed over, there is room again, but not for more than the buffer holds.
+        Sample large(SampleRing::Slots * 64, 0, 0);
+        Sample larger((SampleRing::Slots * 64) + 1, 0, 0);
+
+        CHECK(Add(writer, larger) == false);
+        CHECK(Add(writer, large) == true);
+        CHECK(large.Slot == 40);
+    }
+}
+
+int main()
+{
+    TestSingle();
+    TestBatch(false);
+    TestBatch(true);
+    TestFailures();
+    TestSubSamples(false);
+    TestSubSamples(true);
+    TestWrap();
+
+    return (UnitTest::Result());
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Module.h"
+#include "SampleStore.h"
 #include <interfaces/IMemory.h>
 #include <interfaces/IResourceMonitor.h>
 
@@ -20,8 +21,10 @@ namespace Plugin {
             Config()
                 : Core::JSON::Container()
                 , OutOfProcess(true)
+                , Path(_T("/tmp/resource-log.bin"))
             {
                 Add(_T("outofprocess"), &OutOfProcess);
+                Add(_T("path"), &Path);
             }
             ~Config()
             {
@@ -29,6 +32,7 @@ namespace Plugin {
 
         public:
             Core::JSON::Boolean OutOfProcess;
+            Core::JSON::String Path;
         };
 
     public:
@@ -36,6 +40,7 @@ namespace Plugin {
             : _service(nullptr)
             , _monitor(nullptr)
             , _connectionId(0)
+            , _path()
         {
 
         }
@@ -67,7 +72,26 @@ namespace Plugin {
                         result->ErrorCode = Web::STATUS_OK;
                         result->ContentType = Web::MIMETypes::MIME_TEXT;
                         Core::ProxyType<Web::TextBody> body(webBodyFactory.Element());
-                        *body = _monitor->CompileMemoryCsv();
+
+                        if (request.Query.IsSet() == true) {
+                            // A window (seconds since the first sample) and/or a single process, read from
+                            // the store directly. Polling with "from" set to the last time seen, only
+                            // returns what was added since.
+                            Core::URL::KeyValue options(request.Query.Value());
+                            SampleStore::Reader store(_path);
+                            string process;
+
+                            if (options.Exists(_T("process"), true) == true) {
+                                const string name(options[_T("process")].Text());
+                                std::vector<char> decoded(name.length() + 1, '\0');
+                                Core::URL::Decode(name.c_str(), name.length(), decoded.data(), decoded.size());
+                                process = decoded.data();
+                            }
+
+                            store.Tabulate(options.Number<uint32_t>(_T("from"), 0), options.Number<uint32_t>(_T("to"), static_cast<uint32_t>(~0)), process, *body);
+                        } else {
+                            *body = _monitor->CompileMemoryCsv();
+                        }
                         result->Body(body);
                     }
                 }
@@ -94,6 +118,7 @@ namespace Plugin {
         uint32_t _connectionId;
         static Core::ProxyPoolType<Web::TextBody> webBodyFactory;
         uint32_t _skipURL;
+        string _path;
     };
 }
 }
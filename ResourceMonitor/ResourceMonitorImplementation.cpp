@@ -1,14 +1,19 @@
 #include "Module.h"
+#include "SampleStore.h"
 #include <core/ProcessInfo.h>
 #include <interfaces/IMemory.h>
 #include <interfaces/IResourceMonitor.h>
-#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
 #include <vector>
 
-using std::endl;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 using std::cerr; // TODO: temp
 using std::list;
-using std::stringstream;
 using std::vector;
 
 // TODO: don't create our own thread, use threadpool from WPEFramework
@@ -35,11 +40,15 @@ namespace Plugin {
              : Core::JSON::Container()
              , Path()
              , Interval()
+             , IntervalMs()
+             , FullScan(60)
              , Mode()
              , ParentName()
          {
             Add(_T("path"), &Path);
             Add(_T("interval"), &Interval);
+            Add(_T("interval-ms"), &IntervalMs);
+            Add(_T("full-scan"), &FullScan);
             Add(_T("mode"), &Mode);
             Add(_T("parent-name"), &ParentName);
          }
@@ -47,11 +56,15 @@ namespace Plugin {
              : Core::JSON::Container()
              , Path(copy.Path)
              , Interval(copy.Interval)
+             , IntervalMs(copy.IntervalMs)
+             , FullScan(copy.FullScan)
              , Mode(copy.Mode)
              , ParentName(copy.ParentName)
          {
             Add(_T("path"), &Path);
             Add(_T("interval"), &Interval);
+            Add(_T("interval-ms"), &IntervalMs);
+            Add(_T("full-scan"), &FullScan);
             Add(_T("mode"), &Mode);
             Add(_T("parent-name"), &ParentName);
          }
@@ -78,38 +91,58 @@ namespace Plugin {
 
      public:
          Core::JSON::String Path;
-         Core::JSON::DecUInt32 Interval;
+         Core::JSON::DecUInt32 Interval; // seconds
+         Core::JSON::DecUInt32 IntervalMs; // milliseconds, takes precedence over interval
+         Core::JSON::DecUInt32 FullScan; // rescan all processes every so many measurements
          Core::JSON::String Mode;
          Core::JSON::String ParentName;
       };
 
       class StatCollecter {
+     private:
+         // Page frames of one process, as they were at its last scan, with the sizes of its address
+         // space, text and data at that time. As long as those do not change, neither do its mappings.
+         struct Pages {
+            string Signature;
+            vector<uint32_t> Frames;
+            uint32_t Cycle;
+         };
+
      public:
          explicit StatCollecter(const Config& config)
-             : _binFile(nullptr)
+             : _store(config.Path.Value())
              , _otherMap(nullptr)
              , _ourMap(nullptr)
+             , _scanMap(nullptr)
              , _bufferEntries(0)
              , _interval(0)
+             , _fullScan(0)
+             , _cycle(0)
+             , _rescanned(0)
+             , _pages()
              , _collectMode(Config::CollectMode::Invalid)
              , _activity(*this)
          {
-            _binFile = fopen(config.Path.Value().c_str(), "w");
-
             uint32_t pageCount = Core::SystemInfo::Instance().GetPhysicalPageCount();
-            const uint32_t bitPersUint32 = 32;
-            _bufferEntries = pageCount / bitPersUint32;
-            if ((pageCount % bitPersUint32) != 0) {
-               _bufferEntries++;
+            const uint32_t bitPersUint64 = 64;
+            uint32_t words = pageCount / bitPersUint64;
+            if ((pageCount % bitPersUint64) != 0) {
+               words++;
             }
 
             // Because linux doesn't report the first couple of pages it uses itself,
             //    allocate a little extra to make sure we don't miss the highest ones.
-            _bufferEntries += _bufferEntries / 10;
+            words += words / 10;
+
+            // Allocated as 64 bit words, so they can be counted a word at a time.
+            _bufferEntries = words * 2;
+            _ourMap = reinterpret_cast<uint32_t*>(new uint64_t[words]);
+            _otherMap = reinterpret_cast<uint32_t*>(new uint64_t[words]);
+            _scanMap = reinterpret_cast<uint32_t*>(new uint64_t[words]);
+            ::memset(_scanMap, 0, _bufferEntries * sizeof(uint32_t));
 
-            _ourMap = new uint32_t[_bufferEntries];
-            _otherMap = new uint32_t[_bufferEntries];
-            _interval = config.Interval.Value();
+            _interval = (config.IntervalMs.IsSet() == true ? config.IntervalMs.Value() : config.Interval.Value() * 1000);
+            _fullScan = config.FullScan.Value();
             _collectMode = config.GetCollectMode();
             _parentName = config.ParentName.Value();
 
@@ -118,17 +151,9 @@ namespace Plugin {
 
          ~StatCollecter()
          {
-            fclose(_binFile);
-
-            delete [] _ourMap;
-            delete [] _otherMap;
-         }
-
-         void GetProcessNames(vector<string>& processNames)
-         {
-            _namesLock.Lock();
-            processNames = _processNames;
-            _namesLock.Unlock();
+            delete [] reinterpret_cast<uint64_t*>(_ourMap);
+            delete [] reinterpret_cast<uint64_t*>(_otherMap);
+            delete [] reinterpret_cast<uint64_t*>(_scanMap);
          }
 
       private:
@@ -141,51 +166,27 @@ namespace Plugin {
             // TODO: check if only one, warning otherwise?
             // TOOD: what if none found? will cause segfault when using .front() later on.
             if (processes.empty()) {
-               TRACE_L1("Failed to find process %s", _parentName);
+               TRACE_L1("Failed to find process %s", _parentName.c_str());
                return;
             }
 
             if (processes.size() > 1) {
-               TRACE_L1("Found more than one process named %s, only tracking first", _parentName);
+               TRACE_L1("Found more than one process named %s, only tracking first", _parentName.c_str());
             }
 
-            uint32_t mapBufferSize = sizeof(_ourMap[0]) * _bufferEntries;
-            memset(_ourMap, 0, mapBufferSize);
-            memset(_otherMap, 0, mapBufferSize);
-
             vector<::ThreadId> processIds;
 
             for (const Core::ProcessInfo& processInfo : processes) {
-               string processName = processInfo.Name();
-
-               _namesLock.Lock();
-               if (find(_processNames.begin(), _processNames.end(), _parentName) == _processNames.end()) {
-                  _processNames.push_back(_parentName);
-               }
-               _namesLock.Unlock();
-
                Core::ProcessTree processTree(processInfo.Id());
 
-               processTree.MarkOccupiedPages(_ourMap, mapBufferSize);
-
                std::list<::ThreadId> addedProcessIds;
                processTree.GetProcessIds(addedProcessIds);
                processIds.insert(processIds.end(), addedProcessIds.begin(), addedProcessIds.end());
             }
 
-            memset(_otherMap, 0, mapBufferSize);
-
-            // Find other processes
-            list<Core::ProcessInfo> otherProcesses;
-            Core::ProcessInfo::Iterator otherIterator;
-            while (otherIterator.Next()) {
-               ::ThreadId otherId = otherIterator.Current().Id();
-               if (find(processIds.begin(), processIds.end(), otherId) == processIds.end()) {
-                  otherIterator.Current().MarkOccupiedPages(_otherMap, mapBufferSize);
-               }
-            }
+            Account(processIds);
 
-            StartLogLine(1);
+            StartLogLine();
             LogProcess(_parentName, processes.front());
          }
 
@@ -194,33 +195,12 @@ namespace Plugin {
             list<Core::ProcessInfo> processes;
             Core::ProcessInfo::FindByName(_parentName, false, processes);
 
-            StartLogLine(processes.size());
+            StartLogLine();
 
             for (const Core::ProcessInfo& processInfo : processes) {
-               uint32_t mapBufferSize = sizeof(_ourMap[0]) * _bufferEntries;
-               memset(_ourMap, 0, mapBufferSize);
-               memset(_otherMap, 0, mapBufferSize);
-
                string processName = processInfo.Name() + " (" + std::to_string(processInfo.Id()) + ")";
 
-               _namesLock.Lock();
-               if (find(_processNames.begin(), _processNames.end(), processName) == _processNames.end()) {
-                  _processNames.push_back(processName);
-               }
-               _namesLock.Unlock();
-
-               Core::ProcessTree processTree(processInfo.Id());
-
-               processTree.MarkOccupiedPages(_ourMap, mapBufferSize);
-
-               list<Core::ProcessInfo> otherProcesses;
-               Core::ProcessInfo::Iterator otherIterator;
-               while (otherIterator.Next()) {
-                  ::ThreadId otherId = otherIterator.Current().Id();
-                  if (!processTree.ContainsProcess(otherId)) {
-                     otherIterator.Current().MarkOccupiedPages(_otherMap, mapBufferSize);
-                  }
-               }
+               AccountTree(processInfo.Id());
 
                LogProcess(processName, processInfo);
             }
@@ -237,51 +217,22 @@ namespace Plugin {
             for (const Core::ProcessInfo& processInfo : processes) {
                std::list<string> commandLine = processInfo.CommandLine();
 
-               bool shouldTrack = false;
-               string columnName;
-
                // Get callsign/classname
                std::list<string>::const_iterator i = std::find(commandLine.cbegin(), commandLine.cend(), argument);
                if (i != commandLine.cend()) {
                   i++;
                   if (i != commandLine.cend()) {
                      if (*i == _parentName) {
-                        columnName = _parentName + " (" + std::to_string(processInfo.Id()) + ")";
+                        string columnName = _parentName + " (" + std::to_string(processInfo.Id()) + ")";
                         processIds.push_back(std::pair<::ThreadId, string>(processInfo.Id(), columnName));
-                        shouldTrack = true;
                      }
                   }
                }
-
-               if (!shouldTrack) {
-                  continue;
-               }
-
-               _namesLock.Lock();
-               if (std::find(_processNames.cbegin(), _processNames.cend(), columnName) == _processNames.cend()) {
-                  _processNames.push_back(columnName);
-               }
-               _namesLock.Unlock();
             }
 
-            StartLogLine(processIds.size());
+            StartLogLine();
             for (std::pair<Core::ProcessInfo, string> processDesc : processIds) {
-               Core::ProcessTree tree(processDesc.first);
-
-               uint32_t mapBufferSize = sizeof(_ourMap[0]) * _bufferEntries;
-               memset(_ourMap, 0, mapBufferSize);
-               memset(_otherMap, 0, mapBufferSize);
-
-               tree.MarkOccupiedPages(_ourMap, mapBufferSize);
-
-               list<Core::ProcessInfo> otherProcesses;
-               Core::ProcessInfo::Iterator otherIterator;
-               while (otherIterator.Next()) {
-                  ::ThreadId otherId = otherIterator.Current().Id();
-                  if (!tree.ContainsProcess(otherId)) {
-                     otherIterator.Current().MarkOccupiedPages(_otherMap, mapBufferSize);
-                  }
-               }
+               AccountTree(processDesc.first.Id());
 
                LogProcess(processDesc.second, processDesc.first);
             }
@@ -290,6 +241,10 @@ namespace Plugin {
      protected:
          void Dispatch()
          {
+            const uint64_t start = Core::Time::Now().Ticks();
+
+            Refresh();
+
             switch(_collectMode) {
                case Config::CollectMode::Single:
                   CollectSingle();
@@ -308,25 +263,163 @@ namespace Plugin {
                   break;
             }
 
-            _activity.Schedule(Core::Time::Now().Add(_interval * 1000));
+            // What this cycle cost us, goes into the line as well.
+            _store.Cost(static_cast<uint32_t>(Core::Time::Now().Ticks() - start), _rescanned);
+            _store.Commit();
+
+            _activity.Schedule(Core::Time::Now().Add(_interval));
          }
 
     private:
-         uint32_t CountSetBits(uint32_t pageBuffer[], const uint32_t* inverseMask)
+         // Rescans the pages of the processes that are new, or of which the memory layout changed. Every
+         // "full-scan" cycles all processes are rescanned, the same layout could still be backed by other
+         // pages, e.g. after a copy on write.
+         void Refresh()
          {
-            uint32_t count = 0;
+            const uint32_t mapBufferSize = sizeof(_scanMap[0]) * _bufferEntries;
+            const bool full = ((_fullScan != 0) && ((_cycle % _fullScan) == 0));
+            Core::ProcessInfo::Iterator index;
+
+            _cycle++;
+            _rescanned = 0;
+
+            while (index.Next() == true) {
+               Core::ProcessInfo process(index.Current());
+               Pages& pages(_pages[process.Id()]);
+               string signature(Signature(process.Id()));
+
+               if ((full == true) || (pages.Cycle == 0) || (signature != pages.Signature)) {
+                  process.MarkOccupiedPages(_scanMap, mapBufferSize);
+
+                  // Collect the frames, and leave the scan map cleared again for the next one. Empty
+                  // stretches are skipped a 64 bit word at a time.
+                  const uint64_t* words = reinterpret_cast<const uint64_t*>(_scanMap);
+                  pages.Frames.clear();
+                  for (uint32_t word = 0; word < (_bufferEntries / 2); word++) {
+                     if (words[word] != 0) {
+                        for (uint32_t entry = (word * 2); entry < ((word * 2) + 2); entry++) {
+                           uint32_t bits = _scanMap[entry];
+                           while (bits != 0) {
+                              pages.Frames.push_back((entry * 32) + __builtin_ctz(bits));
+                              bits &= (bits - 1);
+                           }
+                        }
+                     }
+                  }
+                  ::memset(_scanMap, 0, mapBufferSize);
 
-            if (inverseMask == nullptr) {
-               for (uint32_t index = 0; index < _bufferEntries; index++) {
-                  count += __builtin_popcount(pageBuffer[index]);
+                  pages.Signature = std::move(signature);
+                  _rescanned++;
                }
-            } else {
-               for (uint32_t index = 0; index < _bufferEntries; index++) {
-                  count += __builtin_popcount(pageBuffer[index] & (~inverseMask[index]));
+               pages.Cycle = _cycle;
+            }
+
+            // Forget the processes that are gone.
+            std::unordered_map<::ThreadId, Pages>::iterator entry(_pages.begin());
+            while (entry != _pages.end()) {
+               if (entry->second.Cycle != _cycle) {
+                  entry = _pages.erase(entry);
+               } else {
+                  entry++;
                }
             }
+         }
+
+         // Out of /proc/<pid>/statm, only the fields that change with the mappings: the resident and
+         // shared counts next to them change with every page that is touched or swapped, and would have
+         // every process rescanned every cycle.
+         static string Signature(const ::ThreadId id)
+         {
+            char buffer[128];
+            ssize_t length = 0;
+            string result;
+            int descriptor = ::open(("/proc/" + std::to_string(id) + "/statm").c_str(), O_RDONLY);
+
+            if (descriptor != -1) {
+               length = ::read(descriptor, buffer, sizeof(buffer) - 1);
+               ::close(descriptor);
+            }
+
+            if (length > 0) {
+               unsigned long size, resident, shared, text, lib, data;
+
+               buffer[length] = '\0';
 
-            return count;
+               if (::sscanf(buffer, "%lu %lu %lu %lu %lu %lu", &size, &resident, &shared, &text, &lib, &data) == 6) {
+                  result = std::to_string(size) + ' ' + std::to_string(text) + ' ' + std::to_string(data);
+               }
+            }
+
+            return (result);
+         }
+
+         void AccountTree(const ::ThreadId root)
+         {
+            Core::ProcessTree tree(root);
+            std::list<::ThreadId> processIds;
+            tree.GetProcessIds(processIds);
+
+            Account(vector<::ThreadId>(processIds.begin(), processIds.end()));
+         }
+
+         // Marks the (cached) pages of the given processes as ours, and those of all others as other.
+         void Account(vector<::ThreadId> processIds)
+         {
+            const uint32_t mapBufferSize = sizeof(_ourMap[0]) * _bufferEntries;
+
+            std::sort(processIds.begin(), processIds.end());
+
+            ::memset(_ourMap, 0, mapBufferSize);
+            ::memset(_otherMap, 0, mapBufferSize);
+
+            for (const std::pair<const ::ThreadId, Pages>& entry : _pages) {
+               uint32_t* map = (std::binary_search(processIds.begin(), processIds.end(), entry.first) == true ? _ourMap : _otherMap);
+
+               for (const uint32_t frame : entry.second.Frames) {
+                  map[frame / 32] |= (1u << (frame % 32));
+               }
+            }
+         }
+
+         // The maps are allocated as 64 bit words, count a word at a time.
+         uint32_t CountSetBits(const uint32_t pageBuffer[], const uint32_t* inverseMask) const
+         {
+            const uint64_t* words = reinterpret_cast<const uint64_t*>(pageBuffer);
+            const uint64_t* masks = reinterpret_cast<const uint64_t*>(inverseMask);
+            const uint32_t count = _bufferEntries / 2;
+            uint32_t result = 0;
+            uint32_t index = 0;
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+            // Count the bits per byte, 16 bytes at a time, and widen the sums to fit.
+            uint64x2_t sum = vdupq_n_u64(0);
+            for (; (index + 2) <= count; index += 2) {
+               uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t*>(&words[index]));
+               if (masks != nullptr) {
+                  bytes = vbicq_u8(bytes, vld1q_u8(reinterpret_cast<const uint8_t*>(&masks[index])));
+               }
+               sum = vpadalq_u32(sum, vpaddlq_u16(vpaddlq_u8(vcntq_u8(bytes))));
+            }
+            result = static_cast<uint32_t>(vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1));
+#endif
+            for (; index < count; index++) {
+               result += PopCount(masks == nullptr ? words[index] : (words[index] & ~masks[index]));
+            }
+
+            return result;
+         }
+
+         static uint32_t PopCount(uint64_t value)
+         {
+#if defined(__POPCNT__)
+            return (__builtin_popcountll(value));
+#else
+            // Without the instruction the builtin turns into a call, count in parallel instead.
+            value = value - ((value >> 1) & 0x5555555555555555ULL);
+            value = (value & 0x3333333333333333ULL) + ((value >> 2) & 0x3333333333333333ULL);
+            value = (value + (value >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+            return (static_cast<uint32_t>((value * 0x0101010101010101ULL) >> 56));
+#endif
          }
 
          void LogProcess(const string& name, const Core::ProcessInfo& info)
@@ -335,33 +428,28 @@ namespace Plugin {
             uint32_t uss = CountSetBits(_ourMap, _otherMap);
             uint64_t jiffies = info.Jiffies();
 
-            uint32_t nameSize = name.length();
-            fwrite(&nameSize, sizeof(nameSize), 1, _binFile);
-            fwrite(name.c_str(), sizeof(name[0]), name.length(), _binFile);
-            fwrite(&vss, 1, sizeof(vss), _binFile);
-            fwrite(&uss, 1, sizeof(uss), _binFile);
-            fwrite(&jiffies, 1, sizeof(jiffies), _binFile);
-            fflush(_binFile);
+            _store.Add(name, vss, uss, jiffies);
          }
 
-         void StartLogLine(uint32_t processCount)
+         void StartLogLine()
          {
-            // TODO: no simple time_t alike in Thunder?
-            uint32_t timestamp = static_cast<uint32_t>(Core::Time::Now().Ticks() / 1000 / 1000);
+            // Milliseconds since the epoch.
+            uint64_t timestamp = Core::Time::Now().Ticks() / 1000;
             uint64_t jiffies = Core::SystemInfo::Instance().GetJiffies();
 
-            fwrite(&timestamp, 1, sizeof(timestamp), _binFile);
-            fwrite(&processCount, 1, sizeof(processCount), _binFile);
-            fwrite(&jiffies, 1, sizeof(jiffies), _binFile);
+            _store.Start(timestamp, jiffies);
          }
 
-         FILE *_binFile;
-         vector<string> _processNames; // Seen process names.
-         Core::CriticalSection _namesLock;
+         SampleStore::Writer _store; // Samples, a line per measurement, written out in one go.
          uint32_t * _otherMap; // Buffer used to mark other processes pages.
          uint32_t * _ourMap;   // Buffer for pages used by our process (tree).
+         uint32_t * _scanMap;  // Buffer a rescanned process marks its pages in, always left cleared.
          uint32_t _bufferEntries; // Numer of entries in each buffer.
-         uint32_t _interval; // Seconds between measurement.
+         uint32_t _interval; // Milliseconds between measurement.
+         uint32_t _fullScan; // Cycles between rescanning all processes, 0 is never.
+         uint32_t _cycle; // Measurements done.
+         uint32_t _rescanned; // Processes rescanned in this cycle.
+         std::unordered_map<::ThreadId, Pages> _pages; // Pages of all processes, as of their last scan.
          Config::CollectMode _collectMode; // Collection style.
          string _parentName; // Process/plugin name we are looking for.
          Core::WorkerPool::JobType<StatCollecter&> _activity;
@@ -376,7 +464,7 @@ namespace Plugin {
   public:
       ResourceMonitorImplementation()
           : _processThread(nullptr)
-          , _binPath(_T("/tmp/resource-log.bin"))
+          , _binPath()
       {
       }
 
@@ -399,6 +487,7 @@ namespace Plugin {
 
          result = Core::ERROR_NONE;
 
+         _binPath = config.Path.Value();
          _processThread = new StatCollecter(config);
 
          return (result);
@@ -406,81 +495,13 @@ namespace Plugin {
 
       string CompileMemoryCsv() override
       {
-         // TODO: should we worry about doing this as repsonse to RPC (could take too long?)
-         FILE* inFile = fopen(_binPath.c_str(), "rb");
-         stringstream output;
-
-         vector<string> processNames;
-         _processThread->GetProcessNames(processNames);
-
-         output << _T("time (s)\tJiffies");
-         for (const string& processName : processNames) {
-            output << _T("\t") << processName << _T(" (VSS)\t") << processName << _T(" (USS)\t") << processName << _T(" (jiffies)");
-         }
-         output << endl;
-
-         vector<uint64_t> pageVector(processNames.size() * 3);
-         bool seenFirstTimestamp = false;
-         uint32_t firstTimestamp = 0;
-
-         while (true) {
-            std::fill(pageVector.begin(), pageVector.end(), 0);
-
-            uint32_t timestamp = 0;
-            size_t readCount = fread(&timestamp, sizeof(timestamp), 1, inFile);
-            if (readCount != 1) {
-               break;
-            }
-
-            if (!seenFirstTimestamp) {
-               firstTimestamp = timestamp;
-               seenFirstTimestamp = true;
-            }
-
-            uint32_t processCount = 0;
-            fread(&processCount, sizeof(processCount), 1, inFile);
-
-            uint64_t totalJiffies = 0;
-            fread(&totalJiffies, sizeof(totalJiffies), 1, inFile);
-
-            for (uint32_t processIndex = 0; processIndex < processCount; processIndex++) {
-               uint32_t nameLength = 0;
-               fread(&nameLength, sizeof(nameLength), 1, inFile);
-               // TODO: unicode?
-               char nameBuffer[nameLength + 1];
-               fread(nameBuffer, sizeof(char), nameLength, inFile);
-
-               nameBuffer[nameLength] = '\0';
-               string name(nameBuffer);
-
-               vector<string>::const_iterator nameIterator = std::find(processNames.cbegin(), processNames.cend(), name);
-
-               uint32_t vss, uss;
-               uint64_t jiffies;
-               fread(&vss, sizeof(vss), 1, inFile);
-               fread(&uss, sizeof(uss), 1, inFile);
-               fread(&jiffies, sizeof(jiffies), 1, inFile);
-               if (nameIterator == processNames.cend()) {
-                   continue;
-               }
-
-               int index = nameIterator - processNames.cbegin();
-
-               pageVector[index * 3] = static_cast<uint64_t>(vss);
-               pageVector[index * 3 + 1] = static_cast<uint64_t>(uss);
-               pageVector[index * 3 + 2] = jiffies;
-            }
-
-            output << (timestamp - firstTimestamp) << "\t" << totalJiffies;
-            for (uint32_t pageEntry : pageVector) {
-               output << "\t" << pageEntry;
-            }
-            output << endl;
-         }
+         // Served straight from the mapped store, without touching the collector.
+         SampleStore::Reader store(_binPath);
+         string output;
 
-         fclose(inFile);
+         store.Tabulate(0, store.Duration(), string(), output);
 
-         return output.str();
+         return output;
       }
 
       BEGIN_INTERFACE_MAP(ResourceMonitorImplementation)
@@ -0,0 +1,374 @@
+#pragma once
+
+#include "Module.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // Time series of resource samples, in fixed size records. Every sample line starts with a system
+    // record, holding the total jiffies and the number of process records that follow. Process names
+    // are interned, the record only holds the index of the name in a names file next to the store.
+    // Records are appended in time order, so a time window is found with a binary search over the
+    // mapped file, and only the records within that window are ever touched.
+    //
+    // File layout (native byte order, the files never leave the device):
+    //   Header | Sample | Sample | ...
+    //   <path>.names: one interned process name per line
+    class SampleStore {
+    public:
+        static constexpr uint32_t Magic = 0x53534D52; // "RMSS"
+        static constexpr uint16_t Version = 2;
+        static constexpr uint16_t System = 0xFFFF;
+        // Names are interned in the indexes below System, a process with yet another name is not recorded.
+        static constexpr uint16_t MaxNames = System;
+
+        struct Header {
+            uint32_t Magic;
+            uint16_t Version;
+            uint16_t RecordSize;
+            uint32_t Reserved[2];
+        };
+
+        struct Sample {
+            uint64_t Timestamp; // milliseconds since the epoch
+            uint64_t Jiffies; // of the process, or in total for a System record
+            uint32_t VSS; // pages, or for a System record, the microseconds it took to collect the line
+            uint32_t USS; // pages, or for a System record, the number of processes that were rescanned
+            uint16_t Name; // interned name, System for the record starting a line
+            uint16_t Count; // process records following a System record
+            uint32_t Reserved;
+        };
+
+        static string NamesFile(const string& path)
+        {
+            return (path + _T(".names"));
+        }
+
+        class Writer {
+        public:
+            Writer() = delete;
+            Writer(const Writer&) = delete;
+            Writer& operator=(const Writer&) = delete;
+
+            Writer(const string& path)
+                : _store(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644))
+                , _names(::open(NamesFile(path).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644))
+                , _index()
+                , _batch()
+                , _last(0)
+                , _full(false)
+            {
+                if ((_store == -1) || (_names == -1)) {
+                    TRACE_L1("Could not create the sample store %s, error: %d", path.c_str(), errno);
+                } else {
+                    const Header header = { Magic, Version, static_cast<uint16_t>(sizeof(Sample)), { 0, 0 } };
+
+                    if (::write(_store, &header, sizeof(header)) != static_cast<ssize_t>(sizeof(header))) {
+                        TRACE_L1("Could not write the sample store header, error: %d", errno);
+                    }
+                }
+            }
+            ~Writer()
+            {
+                if (_store != -1) {
+                    ::close(_store);
+                }
+                if (_names != -1) {
+                    ::close(_names);
+                }
+            }
+
+        public:
+            bool IsValid() const
+            {
+                return ((_store != -1) && (_names != -1));
+            }
+            void Start(const uint64_t timestamp, const uint64_t jiffies)
+            {
+                // The wall clock might be set back, the time index depends on it never going back.
+                _last = std::max(_last, timestamp);
+
+                _batch.clear();
+                _batch.push_back({ _last, jiffies, 0, 0, System, 0, 0 });
+            }
+            void Add(const string& name, const uint32_t vss, const uint32_t uss, const uint64_t jiffies)
+            {
+                ASSERT(_batch.empty() == false);
+
+                uint16_t index;
+
+                if (Intern(name, index) == true) {
+                    _batch.push_back({ _last, jiffies, vss, uss, index, 0, 0 });
+                }
+            }
+            void Cost(const uint32_t microseconds, const uint32_t rescanned)
+            {
+                if (_batch.empty() == false) {
+                    _batch.front().VSS = microseconds;
+                    _batch.front().USS = rescanned;
+                }
+            }
+            // The whole line goes out in one write.
+            void Commit()
+            {
+                if ((_batch.empty() == false) && (IsValid() == true)) {
+                    const ssize_t length = static_cast<ssize_t>(_batch.size() * sizeof(Sample));
+
+                    _batch.front().Count = static_cast<uint16_t>(_batch.size() - 1);
+
+                    if (::write(_store, _batch.data(), length) != length) {
+                        TRACE_L1("Could not append %d samples to the sample store, error: %d", static_cast<uint32_t>(_batch.size()), errno);
+                    }
+                }
+                _batch.clear();
+            }
+
+        private:
+            bool Intern(const string& name, uint16_t& result)
+            {
+                std::unordered_map<string, uint16_t>::const_iterator index(_index.find(name));
+                bool interned = true;
+
+                if (index != _index.end()) {
+                    result = index->second;
+                } else if (_index.size() < MaxNames) {
+                    const string line(name + '\n');
+
+                    result = static_cast<uint16_t>(_index.size());
+                    _index.emplace(name, result);
+
+                    // Written before any record refers to it.
+                    if ((_names != -1) && (::write(_names, line.c_str(), line.length()) != static_cast<ssize_t>(line.length()))) {
+                        TRACE_L1("Could not append %s to the sample store names, error: %d", name.c_str(), errno);
+                    }
+                } else {
+                    if (_full == false) {
+                        _full = true;
+                        TRACE_L1("The sample store holds %d names, %s and any other new names are not recorded", static_cast<uint32_t>(MaxNames), name.c_str());
+                    }
+                    interned = false;
+                }
+
+                return (interned);
+            }
+
+        private:
+            int _store;
+            int _names;
+            std::unordered_map<string, uint16_t> _index;
+            std::vector<Sample> _batch;
+            uint64_t _last;
+            bool _full;
+        };
+
+        // Maps the store, as it is at construction, read only. The writer can keep on appending.
+        class Reader {
+        public:
+            Reader() = delete;
+            Reader(const Reader&) = delete;
+            Reader& operator=(const Reader&) = delete;
+
+            Reader(const string& path)
+                : _data(nullptr)
+                , _size(0)
+                , _samples(nullptr)
+                , _count(0)
+                , _names()
+            {
+                int descriptor = ::open(path.c_str(), O_RDONLY);
+
+                if (descriptor != -1) {
+                    struct stat info;
+
+                    if ((::fstat(descriptor, &info) == 0) && (static_cast<size_t>(info.st_size) >= sizeof(Header))) {
+                        void* data = ::mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+
+                        if (data != MAP_FAILED) {
+                            const Header* header = static_cast<const Header*>(data);
+
+                            _data = data;
+                            _size = info.st_size;
+
+                            if ((header->Magic == Magic) && (header->Version == Version) && (header->RecordSize == sizeof(Sample))) {
+                                _samples = reinterpret_cast<const Sample*>(static_cast<const uint8_t*>(data) + sizeof(Header));
+                                _count = static_cast<uint32_t>((_size - sizeof(Header)) / sizeof(Sample));
+                                ::madvise(data, _size, MADV_SEQUENTIAL);
+                            } else {
+                                TRACE_L1("%s is not a sample store", path.c_str());
+                            }
+                        }
+                    }
+                    ::close(descriptor);
+                }
+
+                // A line still being appended is left out, only the last line can be incomplete.
+                uint32_t last = _count;
+                while ((last > 0) && (_samples[last - 1].Name != System)) {
+                    last--;
+                }
+                if ((last == 0) || ((last + _samples[last - 1].Count) > _count)) {
+                    _count = (last > 0 ? last - 1 : 0);
+                }
+
+                // Read the names last, they are written before the records that refer to them.
+                Core::File names(NamesFile(path));
+                if ((_count > 0) && (names.Open(true) == true)) {
+                    string content(static_cast<size_t>(names.Size()), '\0');
+                    const uint32_t length = names.Read(reinterpret_cast<uint8_t*>(&content[0]), static_cast<uint32_t>(content.length()));
+                    size_t start = 0;
+                    size_t end;
+
+                    while ((start < length) && ((end = content.find('\n', start)) != string::npos)) {
+                        _names.emplace_back(content, start, end - start);
+                        start = end + 1;
+                    }
+                    names.Close();
+                }
+            }
+            ~Reader()
+            {
+                if (_data != nullptr) {
+                    ::munmap(_data, _size);
+                }
+            }
+
+        public:
+            bool IsValid() const
+            {
+                return (_count > 0);
+            }
+            const std::vector<string>& Names() const
+            {
+                return (_names);
+            }
+            // Seconds since the first sample.
+            uint32_t Duration() const
+            {
+                return (_count > 0 ? static_cast<uint32_t>((_samples[_count - 1].Timestamp - _samples[0].Timestamp + 999) / 1000) : 0);
+            }
+            // Tab separated values for the lines between from and to (inclusive), in seconds since the
+            // first sample, with a column per process, or only for the given process. The collection cost
+            // of every line is in the last two columns.
+            void Tabulate(const uint32_t from, const uint32_t to, const string& process, string& output) const
+            {
+                std::vector<uint16_t> columns;
+                std::vector<int32_t> column(_names.size(), -1);
+
+                // Lines beyond MaxNames can only come from a names file that is not ours, no record refers to them.
+                const uint32_t names = std::min(static_cast<uint32_t>(_names.size()), static_cast<uint32_t>(MaxNames));
+
+                for (uint32_t index = 0; index < names; index++) {
+                    if ((process.empty() == true) || (_names[index] == process)) {
+                        column[index] = static_cast<int32_t>(columns.size());
+                        columns.push_back(static_cast<uint16_t>(index));
+                    }
+                }
+
+                output = _T("time (s)\tJiffies");
+                for (const uint16_t index : columns) {
+                    const string& name(_names[index]);
+                    output += _T("\t") + name + _T(" (VSS)\t") + name + _T(" (USS)\t") + name + _T(" (jiffies)");
+                }
+                output += _T("\tCost (us)\tRescanned\n");
+
+                if ((_count > 0) && (from <= to)) {
+                    const uint64_t first = _samples[0].Timestamp;
+                    const uint64_t last = first + (static_cast<uint64_t>(to) * 1000) + 999;
+                    std::vector<uint64_t> values(columns.size() * 3);
+                    uint32_t index = Lower(first + (static_cast<uint64_t>(from) * 1000));
+
+                    while ((index < _count) && (_samples[index].Timestamp <= last)) {
+                        const Sample& line(_samples[index]);
+                        const uint32_t end = index + 1 + line.Count;
+
+                        std::fill(values.begin(), values.end(), 0);
+
+                        for (index = index + 1; index < end; index++) {
+                            const Sample& sample(_samples[index]);
+
+                            if ((sample.Name < column.size()) && (column[sample.Name] != -1)) {
+                                uint64_t* entry = &values[column[sample.Name] * 3];
+                                entry[0] = sample.VSS;
+                                entry[1] = sample.USS;
+                                entry[2] = sample.Jiffies;
+                            }
+                        }
+
+                        // Seconds, with the milliseconds.
+                        const uint64_t time = line.Timestamp - first;
+                        Append(output, time / 1000);
+                        output += '.';
+                        output += static_cast<char>('0' + ((time / 100) % 10));
+                        output += static_cast<char>('0' + ((time / 10) % 10));
+                        output += static_cast<char>('0' + (time % 10));
+                        output += '\t';
+                        Append(output, line.Jiffies);
+                        for (const uint64_t value : values) {
+                            output += '\t';
+                            Append(output, value);
+                        }
+                        output += '\t';
+                        Append(output, line.VSS);
+                        output += '\t';
+                        Append(output, line.USS);
+                        output += '\n';
+                    }
+                }
+            }
+
+            // Index of the first line at or after the given time. The records of a line share their time,
+            // so the first record at or after it, is always the one starting a line.
+            uint32_t Lower(const uint64_t timestamp) const
+            {
+                uint32_t low = 0;
+                uint32_t high = _count;
+
+                while (low < high) {
+                    const uint32_t middle = low + ((high - low) / 2);
+
+                    if (_samples[middle].Timestamp < timestamp) {
+                        low = middle + 1;
+                    } else {
+                        high = middle;
+                    }
+                }
+
+                return (low);
+            }
+
+        private:
+            static void Append(string& output, uint64_t value)
+            {
+                char buffer[20];
+                uint8_t length = 0;
+
+                do {
+                    buffer[length++] = static_cast<char>('0' + (value % 10));
+                    value /= 10;
+                } while (value != 0);
+
+                while (length != 0) {
+                    output += buffer[--length];
+                }
+            }
+
+        private:
+            void* _data;
+            size_t _size;
+            const Sample* _samples;
+            uint32_t _count;
+            std::vector<string> _names;
+        };
+    };
+
+} // namespace Plugin
+} // namespace WPEFramework
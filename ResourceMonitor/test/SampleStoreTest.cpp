@@ -0,0 +1,186 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../SampleStore.h"
+#include "../../helpers/UnitTest.h"
+
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+namespace {
+
+    const char StorePath[] = "SampleStoreTest.store";
+
+    // The lines of the output, the header first.
+    std::vector<std::string> Lines(const std::string& output)
+    {
+        std::vector<std::string> result;
+        size_t start = 0;
+        size_t end;
+
+        while ((end = output.find('\n', start)) != std::string::npos) {
+            result.push_back(output.substr(start, end - start));
+            start = end + 1;
+        }
+
+        return (result);
+    }
+
+    // Three lines, at 1.0 s, 2.5 s and 4.0 s:
+    //   record 0: System, 1: A, 2: B
+    //   record 3: System, 4: A
+    //   record 5: System, 6: B, 7: C
+    void Write()
+    {
+        SampleStore::Writer writer(StorePath);
+
+        CHECK(writer.IsValid() == true);
+
+        writer.Start(1000, 100);
+        writer.Add("A", 10, 5, 1);
+        writer.Add("B", 20, 6, 2);
+        writer.Cost(300, 2);
+        writer.Commit();
+
+        writer.Start(2500, 200);
+        writer.Add("A", 11, 7, 3);
+        writer.Cost(100, 0);
+        writer.Commit();
+
+        writer.Start(4000, 300);
+        writer.Add("B", 21, 8, 4);
+        writer.Add("C", 30, 9, 5);
+        writer.Cost(200, 1);
+        writer.Commit();
+    }
+
+    void TestLower()
+    {
+        SampleStore::Reader reader(StorePath);
+
+        CHECK(reader.IsValid() == true);
+        CHECK(reader.Lower(0) == 0);
+        CHECK(reader.Lower(1000) == 0);
+        CHECK(reader.Lower(1001) == 3);
+        CHECK(reader.Lower(2500) == 3);
+        CHECK(reader.Lower(2501) == 5);
+        CHECK(reader.Lower(4000) == 5);
+        CHECK(reader.Lower(4001) == 8);
+    }
+
+    void TestTabulate()
+    {
+        SampleStore::Reader reader(StorePath);
+        std::string output;
+
+        CHECK(reader.Names().size() == 3);
+        CHECK(reader.Duration() == 3);
+
+        // The whole store, "to" is in seconds and far beyond what fits in 32 bits once in milliseconds.
+        reader.Tabulate(0, ~0, std::string(), output);
+        std::vector<std::string> lines(Lines(output));
+
+        CHECK(lines.size() == 4);
+        if (lines.size() == 4) {
+            CHECK(lines[0] == "time (s)\tJiffies\tA (VSS)\tA (USS)\tA (jiffies)\tB (VSS)\tB (USS)\tB (jiffies)\tC (VSS)\tC (USS)\tC (jiffies)\tCost (us)\tRescanned");
+            CHECK(lines[1] == "0.000\t100\t10\t5\t1\t20\t6\t2\t0\t0\t0\t300\t2");
+            CHECK(lines[2] == "1.500\t200\t11\t7\t3\t0\t0\t0\t0\t0\t0\t100\t0");
+            CHECK(lines[3] == "3.000\t300\t0\t0\t0\t21\t8\t4\t30\t9\t5\t200\t1");
+        }
+
+        // A window of one second only holds the line at 1.5 s.
+        reader.Tabulate(1, 1, std::string(), output);
+        lines = Lines(output);
+
+        CHECK(lines.size() == 2);
+        if (lines.size() == 2) {
+            CHECK(lines[1].compare(0, 6, "1.500\t") == 0);
+        }
+
+        // Only the columns of the one process.
+        reader.Tabulate(0, 3, "C", output);
+        lines = Lines(output);
+
+        CHECK(lines.size() == 4);
+        if (lines.size() == 4) {
+            CHECK(lines[0] == "time (s)\tJiffies\tC (VSS)\tC (USS)\tC (jiffies)\tCost (us)\tRescanned");
+            CHECK(lines[1] == "0.000\t100\t0\t0\t0\t300\t2");
+            CHECK(lines[3] == "3.000\t300\t30\t9\t5\t200\t1");
+        }
+
+        // An empty window.
+        reader.Tabulate(5, 4, std::string(), output);
+        CHECK(Lines(output).size() == 1);
+    }
+
+    // A line that is still being written is not read.
+    void TestIncomplete()
+    {
+        FILE* file = fopen(StorePath, "ab");
+        const SampleStore::Sample line = { 5000, 400, 0, 0, SampleStore::System, 2, 0 };
+
+        CHECK(file != nullptr);
+        if (file != nullptr) {
+            fwrite(&line, sizeof(line), 1, file);
+            fclose(file);
+        }
+
+        SampleStore::Reader reader(StorePath);
+
+        CHECK(reader.Lower(~0ULL) == 8);
+        CHECK(reader.Duration() == 3);
+    }
+
+    // Names beyond the cap are not recorded, and never alias the System record.
+    void TestNames()
+    {
+        SampleStore::Writer writer(StorePath);
+
+        writer.Start(1000, 0);
+        for (uint32_t index = 0; index <= SampleStore::MaxNames; index++) {
+            writer.Add(std::to_string(index), index, 0, 0);
+        }
+        writer.Commit();
+
+        writer.Start(2000, 0);
+        writer.Add("0", 1, 0, 0);
+        writer.Commit();
+
+        SampleStore::Reader reader(StorePath);
+
+        CHECK(reader.Names().size() == SampleStore::MaxNames);
+        CHECK(reader.Lower(2000) == (1U + SampleStore::MaxNames));
+        CHECK(reader.Lower(~0ULL) == (3U + SampleStore::MaxNames));
+    }
+}
+
+int main()
+{
+    Write();
+    TestLower();
+    TestTabulate();
+    TestIncomplete();
+    TestNames();
+
+    ::remove(StorePath);
+    ::remove(SampleStore::NamesFile(StorePath).c_str());
+
+    return (UnitTest::Result());
+}
@@ -35,6 +35,7 @@ namespace Plugin {
         ERR_SESSION_FAILED,
         ERR_NO_MORE,
         ERR_TIMED_OUT,
+        ERR_REQUEST_TOO_LARGE,
 
     };
 
@@ -47,6 +48,16 @@ namespace Plugin {
             RTSP_UNKNOWN
         };
 
+        RtspMessage()
+            : message()
+            , bSRM(true)
+            , sequence(0)
+        {
+        }
+        virtual ~RtspMessage()
+        {
+        }
+
         virtual RtspMessage::Type getType()
         {
             return RTSP_UNKNOWN;
@@ -56,6 +67,7 @@ namespace Plugin {
         //RtspMessage::Type _type;
         string message;
         bool bSRM; // true: to/from SRM, false: to/from Pump
+        uint32_t sequence; // CSeq, to match a response to its request
     };
 
     typedef std::shared_ptr<RtspMessage> RtspMessagePtr;
@@ -93,10 +105,13 @@ namespace Plugin {
         {
             return RTSP_RESPONSE;
         }
+        uint16_t GetCode() const
+        {
+            return _code;
+        }
 
     private:
         uint16_t _code;
-        uint32_t _sequence;
     };
 
     class RtspAnnounce : public RtspMessage {
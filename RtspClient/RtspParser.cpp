@@ -31,7 +31,7 @@
 namespace WPEFramework {
 namespace Plugin {
 
-    unsigned int RtspParser::_sequence = 0;
+    std::atomic<unsigned int> RtspParser::_sequence(0);
 
     RtspParser::RtspParser(RtspSessionInfo& info)
         : _sessionInfo(info)
@@ -50,7 +50,8 @@ namespace Plugin {
         ss << "StbId=943BB162A323&";
         ss << "CADeviceId=943BB162A323";
         ss << " RTSP/1.0" << RtspLineTerminator;
-        ss << "CSeq:" << ++_sequence << RtspLineTerminator;
+        request->sequence = ++_sequence;
+        ss << "CSeq:" << request->sequence << RtspLineTerminator;
         ss << "User-Agent: Metro" << RtspLineTerminator;
         ss << "Transport: MP2T/DVBC/QAM;unicast;" << RtspLineTerminator;
         ss << RtspLineTerminator;
@@ -77,7 +78,8 @@ namespace Plugin {
             request->bSRM = false;
         }
         ss << cmd << " * RTSP/1.0" << RtspLineTerminator;
-        ss << "CSeq:" << ++_sequence << RtspLineTerminator;
+        request->sequence = ++_sequence;
+        ss << "CSeq:" << request->sequence << RtspLineTerminator;
         ss << "Session:" << sessionId << RtspLineTerminator;
         ss << "Range: npt=" << position << RtspLineTerminator;
         ss << "Scale: " << scale << RtspLineTerminator;
@@ -96,6 +98,7 @@ namespace Plugin {
         string strParams;
         string sessId;
 
+        request->bSRM = bSRM;
         if (bSRM) {
             sessId = _sessionInfo.sessionId;
         } else {
@@ -109,7 +112,8 @@ namespace Plugin {
 
         std::stringstream ss;
         ss << "GET_PARAMETER * RTSP/1.0" << RtspLineTerminator;
-        ss << "CSeq:" << ++_sequence << RtspLineTerminator;
+        request->sequence = ++_sequence;
+        ss << "CSeq:" << request->sequence << RtspLineTerminator;
         ss << "Session:" << sessId << RtspLineTerminator;
         ss << "Content-Type: text/parameters" << RtspLineTerminator;
         ss << "Content-Length: " << strParams.length() << RtspLineTerminator;
@@ -133,7 +137,8 @@ namespace Plugin {
         string strReason = "Cleint Intiated";
 
         ss << "TEARDOWN * RTSP/1.0" << RtspLineTerminator;
-        ss << "CSeq:" << ++_sequence << RtspLineTerminator;
+        request->sequence = ++_sequence;
+        ss << "CSeq:" << request->sequence << RtspLineTerminator;
         ss << "Session:" << _sessionInfo.sessionId << RtspLineTerminator;
         ss << "Reason:" << reason << " " << strReason << RtspLineTerminator;
         ss << RtspLineTerminator;
@@ -150,6 +155,9 @@ namespace Plugin {
         RtspMessagePtr request = RtspMessagePtr(new RtspRequst);
         string sessId = (bSRM) ? _sessionInfo.sessionId : _sessionInfo.ctrlSessionId;
 
+        request->bSRM = bSRM;
+        request->sequence = respSeq;
+
         std::stringstream ss;
         ss << "RTSP/1.0 200 OK" << RtspLineTerminator;
         ss << "CSeq:" << respSeq << RtspLineTerminator;
@@ -224,28 +232,22 @@ namespace Plugin {
             __FUNCTION__, _sessionInfo.frequency, _sessionInfo.programNum, _sessionInfo.modulation, _sessionInfo.symbolRate, _sessionInfo.bookmark, _sessionInfo.duration);
     }
 
-    void RtspParser::UpdateNPT(NAMED_ARRAY& playMap)
+    void RtspParser::UpdateNPT(const std::string& response)
     {
-        float nptStart = 0, nptEnd = 0;
+        float nptStart = 0;
         float oldScale = _sessionInfo.scale;
         float oldNPT = _sessionInfo.npt;
+        size_t offset, length;
 
-        NAMED_ARRAY::iterator it = playMap.find("Scale");
-        if (it != playMap.end())
-            _sessionInfo.scale = atof(playMap["Scale"].c_str());
-
-        it = playMap.find("Range");
-        if (it != playMap.end()) {
-            string range = playMap["Range"];
-            size_t posEq = range.find('=');
-            size_t posHyphen = range.find('-');
-            if (posEq != string::npos) {
-                if (posHyphen != string::npos) {
-                    nptStart = atof(range.substr(posEq + 1, posHyphen - 1).c_str());
-                    nptEnd = atoi(range.substr(posHyphen + 1).c_str());
-                } else {
-                    nptStart = atof(range.substr(posEq + 1).c_str());
-                }
+        // Every heartbeat ends up here, so the values are read in place, atof stops at the end of the line.
+        if (Field(response, "Scale", offset, length))
+            _sessionInfo.scale = atof(&(response.c_str()[offset]));
+
+        if (Field(response, "Range", offset, length)) {
+            const char* range = &(response.c_str()[offset]);
+            const char* posEq = static_cast<const char*>(memchr(range, '=', length));
+            if (posEq != nullptr) {
+                nptStart = atof(posEq + 1);
             }
 
             _sessionInfo.npt = SEC2MS(nptStart);
@@ -255,62 +257,93 @@ namespace Plugin {
 
     void RtspParser::ProcessPlayResponse(const std::string& response)
     {
-        NAMED_ARRAY playMap;
-        Parse(response, playMap, RtspLineTerminator, ": ");
-        UpdateNPT(playMap);
+        UpdateNPT(response);
     }
 
     void RtspParser::ProcessGetParamResponse(const std::string& response)
     {
-        NAMED_ARRAY playMap;
-        Parse(response, playMap, RtspLineTerminator, ": ");
-        UpdateNPT(playMap);
+        UpdateNPT(response);
     }
 
     void RtspParser::ProcessTeardownResponse(const std::string& response)
     {
-        NAMED_ARRAY playMap;
-        Parse(response, playMap, RtspLineTerminator, ": ");
+        TRACE_L2("%s: size=%zu", __FUNCTION__, response.size());
     }
 
     void RtspParser::Parse(const std::string& str, NAMED_ARRAY& contents, const string& sep1, const string& sep2)
     {
-        TRACE_L4("%s: size=%d input='%s'", __FUNCTION__, str.size(), str.c_str());
+        TRACE_L4("%s: size=%zu input='%s'", __FUNCTION__, str.size(), str.c_str());
         contents.clear();
 
-        bool done = false;
-        size_t pos = 0;
         size_t start = 0;
-        while (!done) {
-            pos = str.find(sep1, start);
-
-            //TRACE_L2("%s: pos=%u start=%u size=%u", __FUNCTION__, pos, start, str.size());
-            if ((pos == string::npos) || (pos >= str.size()))
-                done = true;
-
-            string sub = str.substr(start, pos - start);
-            size_t pos2 = sub.find(sep2);
-            if (pos2 == string::npos) {
-                string left = sub.substr(0, pos2);
-                contents[left] = "";
+        while (start < str.size()) {
+            size_t end = str.find(sep1, start);
+            if (end == string::npos)
+                end = str.size();
+
+            // Split the line in place, only the name and value themselves are copied, into the map.
+            size_t pos2 = str.find(sep2, start);
+            if ((pos2 == string::npos) || (pos2 >= end)) {
+                contents[str.substr(start, end - start)].clear();
             } else {
-                string left = sub.substr(0, pos2);
-                string right = sub.substr(pos2 + sep2.size());
-                TRACE_L4("%s:     left=%s right=%s pos=%u", __FUNCTION__, left.c_str(), right.c_str(), pos2);
-                contents[left] = right;
+                contents[str.substr(start, pos2 - start)].assign(str, pos2 + sep2.size(), end - pos2 - sep2.size());
             }
 
-            start = pos + sep1.size();
-            if (start >= str.size())
-                done = true;
+            start = end + sep1.size();
         }
 
-        TRACE_L4("%s: contents.size=%d", __FUNCTION__, contents.size());
+        TRACE_L4("%s: contents.size=%zu", __FUNCTION__, contents.size());
         for (NAMED_ARRAY::iterator it = contents.begin(); it != contents.end(); ++it)
             TRACE_L4("%s: %s => '%s'", __FUNCTION__, it->first.c_str(), it->second.c_str());
     }
 
-    RtspMessagePtr RtspParser::ParseResponse(const std::string str)
+    bool RtspParser::Field(const std::string& message, const char name[], size_t& offset, size_t& length, size_t limit)
+    {
+        const size_t nameLength = strlen(name);
+        const size_t size = std::min(limit, message.size());
+        bool found = false;
+        size_t start = 0;
+
+        while ((!found) && (start < size)) {
+            size_t end = message.find(RtspLineTerminator, start);
+            if ((end == string::npos) || (end > size))
+                end = size;
+
+            if (((end - start) > nameLength) && (message.compare(start, nameLength, name) == 0) && (message[start + nameLength] == ':')) {
+                offset = start + nameLength + 1;
+                while ((offset < end) && ((message[offset] == ' ') || (message[offset] == '\t')))
+                    offset++;
+                length = end - offset;
+                found = true;
+            }
+
+            start = end + 2;
+        }
+
+        return found;
+    }
+
+    size_t RtspParser::Frame(const std::string& buffer)
+    {
+        // A message is its header up to the empty line, followed by Content-Length bytes of body.
+        size_t result = 0;
+        size_t end = buffer.find("\r\n\r\n");
+
+        if (end != string::npos) {
+            size_t offset, length;
+            size_t size = end + 4;
+
+            if (Field(buffer, "Content-Length", offset, length, end))
+                size += strtoul(&(buffer.c_str()[offset]), nullptr, 10);
+
+            if (size <= buffer.size())
+                result = size;
+        }
+
+        return result;
+    }
+
+    RtspMessagePtr RtspParser::ParseResponse(const std::string& str)
     {
         int rtspCode = 0;
         RtspMessagePtr response;
@@ -323,26 +356,22 @@ namespace Plugin {
         // -------------------------------------------------------------------------
         size_t pos = str.find(RtspLineTerminator);
         if (pos != std::string::npos) {
-            string header = str.substr(0, pos);
-            std::vector<string> tokens;
-            Split(header, " ", tokens);
-            //TRACE_L2( "%s: header.length=%d tokens.size=%d", __FUNCTION__, header.length(), tokens.size());
-            //for (int i = 0; i < tokens.size(); i++)
-            //    TRACE_L2( "%s: %d. '%s'", __FUNCTION__, i, tokens.at(i).c_str());
-
-            // Parse rest, only if the header is valid
-            if (tokens.size() >= 3) {
-                string first = tokens.at(0);
-                string rtspBody = str.substr(pos + 2); // +2 CRLR
-
-                if (first.compare("ANNOUNCE") == 0) {
-                    response = ParseAnnouncement(rtspBody, 0);
-                } else if (first.compare(0, 5, "RTSP/") == 0) {
-                    rtspCode = std::stoi(tokens.at(1));
+            // Take the status line apart in place, only a valid one has (at least) three tokens.
+            size_t first = str.find(' ');
+            size_t second = (first < pos) ? str.find(' ', first + 1) : string::npos;
+
+            if ((second != string::npos) && (second < pos)) {
+                if (str.compare(0, first, "ANNOUNCE") == 0) {
+                    response = ParseAnnouncement(str.substr(pos + 2), 0); // +2 CRLR
+                } else if (str.compare(0, 5, "RTSP/") == 0) {
+                    rtspCode = atoi(&(str.c_str()[first + 1]));
                     response = RtspMessagePtr(new RtspResponse(rtspCode));
-                    response->message = rtspBody;
+                    response->message.assign(str, pos + 2, string::npos);
                 }
-                //Parse(tokenStr, contents, ":", RtspLineTerminator);
+
+                size_t offset, length;
+                if ((response) && (Field(str, "CSeq", offset, length)))
+                    response->sequence = strtoul(&(str.c_str()[offset]), nullptr, 10);
             }
         }
 
@@ -388,22 +417,6 @@ namespace Plugin {
         return RtspMessagePtr(new RtspAnnounce(code, reason));
     }
 
-    int RtspParser::Split(const string& str, const string& delim, std::vector<string>& tokens)
-    {
-        size_t prev = 0, pos = 0;
-        do {
-            pos = str.find(delim, prev);
-            if (pos == string::npos)
-                pos = str.length();
-            string token = str.substr(prev, pos - prev);
-            if (!token.empty())
-                tokens.push_back(token);
-            prev = pos + delim.length();
-        } while (pos < str.length() && prev < str.length());
-
-        return tokens.size();
-    }
-
     void RtspParser::HexDump(const char* label, const std::string& msg, uint16_t charsPerLine)
     {
         std::stringstream ssHex, ss;
@@ -20,6 +20,7 @@
 #ifndef RTSPPARSER_H
 #define RTSPPARSER_H
 
+#include <atomic>
 #include <map>
 #include <string>
 
@@ -46,21 +47,23 @@ namespace Plugin {
         void ProcessTeardownResponse(const std::string& response);
 
         void Parse(const std::string& str, NAMED_ARRAY& contents, const string& sep1, const string& sep2);
-        RtspMessagePtr ParseResponse(const std::string str);
+        RtspMessagePtr ParseResponse(const std::string& str);
         RtspMessagePtr ParseAnnouncement(const std::string& response, bool bSRM);
 
+        static size_t Frame(const std::string& buffer);
+        static bool Field(const std::string& message, const char name[], size_t& offset, size_t& length, size_t limit = string::npos);
+
         static void HexDump(const char* label, const std::string& msg, uint16_t charsPerLine = 32);
 
     private:
-        void UpdateNPT(NAMED_ARRAY& playMap);
-        int Split(const string& str, const string& delim, std::vector<string>& tokens);
+        void UpdateNPT(const std::string& response);
 
     public:
         RtspSessionInfo& _sessionInfo;
 
     private:
         static constexpr const char* const RtspLineTerminator = "\r\n";
-        static unsigned int _sequence;
+        static std::atomic<unsigned int> _sequence;
     };
 }
 } // WPEFramework::Plugin
@@ -30,13 +30,16 @@ namespace Plugin {
         , _srmSocket(nullptr)
         , _controlSocket(nullptr)
         , _parser(_sessionInfo)
-        , _requestQueue(64)
-        , _responseQueue(64)
+        , _adminLock()
+        , _transactionLock()
+        , _transactions()
         , _heartbeatTimer(Core::Thread::DefaultStackSize(), _T("RtspHeartbeatTimer"))
         , _isSessionActive(false)
         , _nextSRMHeartbeatMS(0)
         , _nextPumpHeartbeatMS(0)
         , _playDelay(2000)
+        , _setupLatency(0)
+        , _changeLatency(0)
     {
     }
 
@@ -92,10 +95,64 @@ namespace Plugin {
 
     RtspReturnCode RtspSession::Send(const RtspMessagePtr& request)
     {
-        _requestQueue.Post(request);
-        GetSocket(request->bSRM).Trigger();
+        RtspReturnCode rc = ERR_OK;
 
-        return ERR_OK; // Handle return value
+        if (GetSocket(request->bSRM).Submit(request) == false) {
+            rc = ERR_REQUEST_TOO_LARGE;
+        }
+
+        return rc;
+    }
+
+    RtspSession::TransactionPtr RtspSession::Submit(const RtspMessagePtr& request, bool async)
+    {
+        TransactionPtr transaction = std::make_shared<Transaction>(request->sequence, async);
+
+        // Register before sending, the response might be in before Send returns.
+        _transactionLock.Lock();
+        _transactions[request->sequence] = transaction;
+        _transactionLock.Unlock();
+
+        RtspReturnCode rc = Send(request);
+
+        if (rc != ERR_OK) {
+            _transactionLock.Lock();
+            _transactions.erase(request->sequence);
+            _transactionLock.Unlock();
+
+            transaction->Fail(rc);
+        }
+
+        return transaction;
+    }
+
+    RtspReturnCode RtspSession::Await(const TransactionPtr& transaction, RtspMessagePtr& response)
+    {
+        RtspReturnCode result = transaction->Wait(ResponseWaitTime, response);
+
+        _transactionLock.Lock();
+        _transactions.erase(transaction->Sequence());
+        _transactionLock.Unlock();
+
+        return result;
+    }
+
+    void RtspSession::Expire(const uint64_t now)
+    {
+        // Nobody waits for asynchronous requests, so they are cleaned up here if no response came in.
+        _transactionLock.Lock();
+
+        TransactionMap::iterator index = _transactions.begin();
+        while (index != _transactions.end()) {
+            if ((index->second->IsAsync()) && ((index->second->Issued() + (ResponseWaitTime * 1000)) < now)) {
+                TRACE_L1("%s: No response to CSeq %d", __FUNCTION__, index->first);
+                index = _transactions.erase(index);
+            } else {
+                ++index;
+            }
+        }
+
+        _transactionLock.Unlock();
     }
 
     uint64_t RtspSession::Timed(const uint64_t scheduledTime)
@@ -104,6 +161,7 @@ namespace Plugin {
             _sessionInfo.npt += NptUpdateInterwal * _sessionInfo.scale;
             TRACE(Trace::Information, ("npt=%.3f_nextSRMHeartbeat=%d _nextPumpHeartbeat=%d sessionTimeout=%d ctrlSessionTimeout=%d", _sessionInfo.npt, _nextSRMHeartbeatMS, _nextPumpHeartbeatMS, _sessionInfo.sessionTimeout, _sessionInfo.ctrlSessionTimeout));
 
+            Expire(Core::Time::Now().Ticks());
             SendHeartbeats();
 
             Core::Time NextTick = Core::Time::Now();
@@ -120,18 +178,19 @@ namespace Plugin {
         RtspMessagePtr response;
 
         if (!_isSessionActive) {
+            const uint64_t start = Core::Time::Now().Ticks();
+
+            // Responses to requests of a previous session are dropped, as nobody waits for their CSeq.
             _sessionInfo.reset();
-            // new session, flush any remaining message in the queue
-            while (!_responseQueue.IsEmpty()) {
-                TRACE_L1("%s: Removing old message", __FUNCTION__);
-                _responseQueue.Extract(response, 0);
-            }
 
             _isSessionActive = true;
             RtspMessagePtr request = _parser.BuildSetupRequest(_sessionInfo.srm.name, assetId);
-            Send(request);
+            TransactionPtr transaction = Submit(request, false);
+
+            rc = Await(transaction, response);
+            if (rc == ERR_OK) {
+                _setupLatency = static_cast<uint32_t>((Core::Time::Now().Ticks() - start) / 1000);
 
-            if (_responseQueue.Extract(response, ResponseWaitTime)) {
                 _adminLock.Lock();
                 _parser.ProcessSetupResponse(response->message);
 
@@ -152,8 +211,7 @@ namespace Plugin {
                 }
                 _adminLock.Unlock();
             } else {
-                TRACE_L1("%s: Failed to get Response", __FUNCTION__);
-                rc = ERR_TIMED_OUT;
+                TRACE_L1("%s: Failed to get Response, error %d", __FUNCTION__, rc);
             }
 
             if (rc == ERR_OK) {
@@ -161,7 +219,10 @@ namespace Plugin {
                 _nextPumpHeartbeatMS = _sessionInfo.ctrlSessionTimeout;
 
                 // implicit play
-                Play(1.0, (position == 0) ? _sessionInfo.bookmark : position);
+                if (Play(1.0, (position == 0) ? _sessionInfo.bookmark : position) == ERR_OK) {
+                    _changeLatency = static_cast<uint32_t>((Core::Time::Now().Ticks() - start) / 1000);
+                    TRACE(Trace::Information, ("Channel change took %d ms, SETUP %d ms", _changeLatency, _setupLatency));
+                }
             }
         } else {
             TRACE_L1("%s: Open failed, session is active", __FUNCTION__);
@@ -178,12 +239,12 @@ namespace Plugin {
 
         if (_isSessionActive) {
             RtspMessagePtr request = _parser.BuildTeardownRequest(reason);
-            Send(request);
-            if (_responseQueue.Extract(response, ResponseWaitTime)) {
+            TransactionPtr transaction = Submit(request, false);
+            rc = Await(transaction, response);
+            if (rc == ERR_OK) {
                 _parser.ProcessTeardownResponse(response->message);
             } else {
-                TRACE_L1("%s: Failed to get Response", __FUNCTION__);
-                rc = ERR_TIMED_OUT;
+                TRACE_L1("%s: Failed to get Response, error %d", __FUNCTION__, rc);
             }
 
             _isSessionActive = false;
@@ -204,12 +265,12 @@ namespace Plugin {
             RtspMessagePtr response;
 
             RtspMessagePtr request = _parser.BuildPlayRequest(scale, position);
-            Send(request);
-            if (_responseQueue.Extract(response, ResponseWaitTime)) {
+            TransactionPtr transaction = Submit(request, false);
+            rc = Await(transaction, response);
+            if (rc == ERR_OK) {
                 _parser.ProcessPlayResponse(response->message);
             } else {
-                TRACE_L1("%s: Failed to get Response", __FUNCTION__);
-                rc = ERR_TIMED_OUT;
+                TRACE_L1("%s: Failed to get Response, error %d", __FUNCTION__, rc);
             }
         } else {
             rc = ERR_NO_ACTIVE_SESSION;
@@ -221,6 +282,12 @@ namespace Plugin {
     {
         RtspReturnCode rc = ERR_OK;
 
+        if (name == "latency") {
+            value = Core::NumberType<uint32_t>(_changeLatency).Text();
+        } else if (name == "setuplatency") {
+            value = Core::NumberType<uint32_t>(_setupLatency).Text();
+        }
+
         return rc;
     }
 
@@ -248,7 +315,27 @@ namespace Plugin {
                 }
                 _announcementHandler.announce(announcement);
             } else if (dynamic_cast<RtspResponse*>(response.get()) != nullptr) {
-                _responseQueue.Post(response);
+                TransactionPtr transaction;
+
+                _transactionLock.Lock();
+                TransactionMap::iterator index = _transactions.find(response->sequence);
+                if (index != _transactions.end()) {
+                    transaction = index->second;
+                    if (transaction->IsAsync()) {
+                        _transactions.erase(index);
+                    }
+                }
+                _transactionLock.Unlock();
+
+                if (!transaction) {
+                    TRACE_L1("%s: Dropped response to CSeq %d, nobody is waiting for it", __FUNCTION__, response->sequence);
+                } else if (transaction->IsAsync()) {
+                    // Only heartbeats are sent asynchronously.
+                    _parser.ProcessGetParamResponse(response->message);
+                    TRACE_L2("%s: Heartbeat response in %d ms", __FUNCTION__, static_cast<uint32_t>((Core::Time::Now().Ticks() - transaction->Issued()) / 1000));
+                } else {
+                    transaction->Complete(response);
+                }
             } else {
                 TRACE_L1("%s: UNKNOWN response '%s'", __FUNCTION__, responseStr.c_str());
             }
@@ -262,7 +349,7 @@ namespace Plugin {
         RtspMessagePtr request = _parser.BuildResponse(respSeq, bSRM);
 
         TRACE_L1("%s: Sending Announcement Response", __FUNCTION__);
-        Send(request);
+        rc = Send(request);
 
         return rc;
     }
@@ -270,17 +357,11 @@ namespace Plugin {
     RtspReturnCode RtspSession::SendHeartbeat(bool bSRM)
     {
         RtspReturnCode rc = ERR_OK;
-        RtspMessagePtr response;
 
+        // Do not block the timer on the round trip, the response is processed when it comes in and
+        // the SRM and pump heartbeats are in flight together.
         RtspMessagePtr request = _parser.BuildGetParamRequest(bSRM);
-        Send(request);
-
-        if (_responseQueue.Extract(response, ResponseWaitTime)) {
-            _parser.ProcessGetParamResponse(response->message);
-        } else {
-            TRACE_L1("%s: Failed to get Response", __FUNCTION__);
-            rc = ERR_TIMED_OUT;
-        }
+        rc = Submit(request, true)->Status();
 
         return rc;
     }
@@ -313,8 +394,10 @@ namespace Plugin {
     }
 
     RtspSession::Socket::Socket(const Core::NodeId& local, const Core::NodeId& remote, RtspSession& rtspSession)
-        : Core::SocketStream(false, local, remote, 4096, 4096)
+        : Core::SocketStream(false, local, remote, SendBufferSize, 4096)
         , _rtspSession(rtspSession)
+        , _requestQueue(64)
+        , _received()
     {
         Open(1000, "");
     };
@@ -324,17 +407,36 @@ namespace Plugin {
         Close(1000);
     };
 
+    bool RtspSession::Socket::Submit(const RtspMessagePtr& request)
+    {
+        // A request goes out in one frame, refuse what can never be sent instead of dropping it later on.
+        bool result = (request->message.size() <= SendBufferSize);
+
+        if (result == true) {
+            _requestQueue.Post(request);
+            Trigger();
+        } else {
+            TRACE_L1("%s: Refused CSeq %d, %zu bytes does not fit in %d", __FUNCTION__, request->sequence, request->message.size(), static_cast<int>(SendBufferSize));
+        }
+
+        return (result);
+    }
+
     uint16_t RtspSession::Socket::SendData(uint8_t* dataFrame, const uint16_t maxSendSize)
     {
-        TRACE_L4("%s: _requestQueue.IsEmpty=%d ", __FUNCTION__, _rtspSession._requestQueue.IsEmpty());
+        TRACE_L4("%s: _requestQueue.IsEmpty=%d ", __FUNCTION__, _requestQueue.IsEmpty());
 
         uint16_t len = 0;
-        if (!_rtspSession._requestQueue.IsEmpty()) {
+        if (!_requestQueue.IsEmpty()) {
             RtspMessagePtr request;
-            _rtspSession._requestQueue.Extract(request, 0);
-            len = request->message.size();
-            memcpy(dataFrame, request->message.c_str(), len);
-            TRACE(Trace::Information, ("%s: maxSendSize=%d bytesToSend=%d", __FUNCTION__, maxSendSize, len));
+            _requestQueue.Extract(request, 0);
+            if (request->message.size() <= maxSendSize) {
+                len = request->message.size();
+                memcpy(dataFrame, request->message.c_str(), len);
+                TRACE(Trace::Information, ("%s: maxSendSize=%d bytesToSend=%d", __FUNCTION__, maxSendSize, len));
+            } else {
+                TRACE_L1("%s: Dropped CSeq %d, %zu bytes does not fit in %d", __FUNCTION__, request->sequence, request->message.size(), maxSendSize);
+            }
         }
 
         return len;
@@ -343,9 +445,22 @@ namespace Plugin {
     uint16_t RtspSession::Socket::ReceiveData(uint8_t* dataFrame, const uint16_t receivedSize)
     {
         TRACE(Trace::Information, ("%s: receivedSize=%d", __FUNCTION__, receivedSize));
-        string response((char*)dataFrame, receivedSize);
         bool bSRM = (_rtspSession._srmSocket == this);
-        _rtspSession.ProcessResponse(response, bSRM);
+        size_t size;
+
+        _received.append(reinterpret_cast<const char*>(dataFrame), receivedSize);
+
+        // With requests pipelined, a read can hold several responses, or just part of one.
+        while ((size = RtspParser::Frame(_received)) != 0) {
+            _rtspSession.ProcessResponse(_received.substr(0, size), bSRM);
+            _received.erase(0, size);
+        }
+
+        if (_received.size() > MaxPendingSize) {
+            TRACE_L1("%s: Dropped %zu bytes without a complete message", __FUNCTION__, _received.size());
+            _received.clear();
+        }
+
         return receivedSize;
     }
 
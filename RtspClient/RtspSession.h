@@ -27,8 +27,12 @@
 #include <core/NodeId.h>
 #include <core/Queue.h>
 #include <core/SocketPort.h>
+#include <core/Sync.h>
 #include <core/Timer.h>
 
+#include <map>
+#include <memory>
+
 #include "RtspCommon.h"
 #include "RtspParser.h"
 
@@ -36,7 +40,6 @@ namespace WPEFramework {
 namespace Plugin {
 
     typedef Core::QueueType<RtspMessagePtr> RequestQueue;
-    typedef Core::QueueType<RtspMessagePtr> ResponseQueue;
 
     class RtspSession {
     public:
@@ -44,14 +47,93 @@ namespace Plugin {
         public:
             Socket(const Core::NodeId& local, const Core::NodeId& remote, RtspSession& rtspSession);
             virtual ~Socket();
+            bool Submit(const RtspMessagePtr& request);
             uint16_t SendData(uint8_t* dataFrame, const uint16_t maxSendSize);
             uint16_t ReceiveData(uint8_t* dataFrame, const uint16_t receivedSize);
             void StateChange();
 
         private:
+            static constexpr uint32_t MaxPendingSize = 64 * 1024;
+            static constexpr uint16_t SendBufferSize = 4096;
+
             RtspSession& _rtspSession;
+            RequestQueue _requestQueue;
+            string _received;
+        };
+
+        // A request waiting for its response, matched on CSeq. Requests on the control path are not
+        // serialized, so several can be outstanding on a connection, and their responses are handed
+        // to whoever waits for them, or, for asynchronous requests (heartbeats), processed on arrival.
+        class Transaction {
+        public:
+            Transaction() = delete;
+            Transaction(const Transaction&) = delete;
+            Transaction& operator=(const Transaction&) = delete;
+
+            Transaction(const uint32_t sequence, const bool async)
+                : _sequence(sequence)
+                , _async(async)
+                , _issued(Core::Time::Now().Ticks())
+                , _signal(false, true)
+                , _result(ERR_OK)
+                , _response()
+            {
+            }
+            ~Transaction()
+            {
+            }
+
+        public:
+            uint32_t Sequence() const
+            {
+                return (_sequence);
+            }
+            bool IsAsync() const
+            {
+                return (_async);
+            }
+            uint64_t Issued() const
+            {
+                return (_issued);
+            }
+            // ERR_OK while the request is on its way, or once it is answered.
+            RtspReturnCode Status() const
+            {
+                return (_result);
+            }
+            RtspReturnCode Wait(const uint32_t waitTime, RtspMessagePtr& response)
+            {
+                RtspReturnCode result = ERR_TIMED_OUT;
+                if (_signal.Lock(waitTime) == Core::ERROR_NONE) {
+                    result = _result;
+                    response = _response;
+                }
+                return (result);
+            }
+            void Complete(const RtspMessagePtr& response)
+            {
+                _response = response;
+                _signal.SetEvent();
+            }
+            // The request never went out, there will be no response to wait for.
+            void Fail(const RtspReturnCode result)
+            {
+                _result = result;
+                _signal.SetEvent();
+            }
+
+        private:
+            const uint32_t _sequence;
+            const bool _async;
+            const uint64_t _issued;
+            Core::Event _signal;
+            RtspReturnCode _result;
+            RtspMessagePtr _response;
         };
 
+        typedef std::shared_ptr<Transaction> TransactionPtr;
+        typedef std::map<uint32_t, TransactionPtr> TransactionMap;
+
         class AnnouncementHandler {
         public:
             virtual void announce(const RtspAnnounce& announcement) = 0;
@@ -100,6 +182,8 @@ namespace Plugin {
         RtspReturnCode Set(const string& name, const string& value);
 
         RtspReturnCode Send(const RtspMessagePtr& request);
+        TransactionPtr Submit(const RtspMessagePtr& request, bool async);
+        RtspReturnCode Await(const TransactionPtr& transaction, RtspMessagePtr& response);
         RtspReturnCode SendHeartbeat(bool bSRM);
         RtspReturnCode SendHeartbeats();
 
@@ -121,6 +205,8 @@ namespace Plugin {
             return _sessionInfo.bSrmIsRtspProxy;
         }
 
+        void Expire(const uint64_t now);
+
     private:
         static constexpr uint16_t ResponseWaitTime = 3000;
         static constexpr uint16_t NptUpdateInterwal = 1000;
@@ -135,14 +221,18 @@ namespace Plugin {
         RtspParser _parser;
         RtspSessionInfo _sessionInfo;
         Core::CriticalSection _adminLock;
-        RequestQueue _requestQueue;
-        ResponseQueue _responseQueue;
+        Core::CriticalSection _transactionLock;
+        TransactionMap _transactions;
         Core::TimerType<HeartbeatTimer> _heartbeatTimer;
 
         bool _isSessionActive;
         int _nextSRMHeartbeatMS;
         int _nextPumpHeartbeatMS;
         int _playDelay;
+
+        // Channel change latency of the last Open, in ms.
+        uint32_t _setupLatency;
+        uint32_t _changeLatency;
     };
 }
 } // WPEFramework::Plugin
@@ -0,0 +1,180 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../Module.h"
+#include "../RtspSession.h"
+#include "../../helpers/UnitTest.h"
+#include "Server.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+// The control path of a session against a stand-in server on the loopback: the channel change latency
+// over a number of Open and Close rounds, with the server answering SETUP and PLAY after a known delay,
+// and a channel change while both heartbeats of the previous session are still waiting for a response.
+
+namespace {
+
+    const uint32_t SetupDelay = 20; // ms
+    const uint32_t PlayDelay = 10; // ms
+    const uint32_t Rounds = 20;
+    const uint32_t WaitTime = 3000; // ms
+
+    class Announcements : public RtspSession::AnnouncementHandler {
+    public:
+        Announcements(const Announcements&) = delete;
+        Announcements& operator=(const Announcements&) = delete;
+
+        Announcements()
+            : _lock()
+            , _codes()
+        {
+        }
+
+    public:
+        void announce(const RtspAnnounce& announcement) override
+        {
+            _lock.Lock();
+            _codes.push_back(announcement.GetCode());
+            _lock.Unlock();
+        }
+        uint32_t Count(const uint16_t code) const
+        {
+            _lock.Lock();
+            const uint32_t result = static_cast<uint32_t>(std::count(_codes.begin(), _codes.end(), code));
+            _lock.Unlock();
+
+            return (result);
+        }
+
+    private:
+        mutable Core::CriticalSection _lock;
+        std::vector<uint16_t> _codes;
+    };
+
+    uint32_t Value(const RtspSession& session, const string& name)
+    {
+        string value;
+        CHECK(session.Get(name, value) == ERR_OK);
+        return (static_cast<uint32_t>(::atoi(value.c_str())));
+    }
+
+    template <typename CONDITION>
+    bool WaitFor(CONDITION&& condition, const uint32_t waitTime)
+    {
+        uint32_t waited = 0;
+
+        while ((condition() == false) && (waited < waitTime)) {
+            SleepMs(10);
+            waited += 10;
+        }
+
+        return (condition());
+    }
+
+    // The latency measured is at least what the server took to answer, and not a lot more on the loopback.
+    void TestChannelChange(RtspSession& session, RtspServer::Server& server)
+    {
+        uint32_t total = 0;
+        uint32_t most = 0;
+
+        server.Configure({ SetupDelay, PlayDelay, false, false, false });
+
+        for (uint32_t round = 0; round < Rounds; round++) {
+            CHECK(session.Open("asset" + Core::NumberType<uint32_t>(round).Text()) == ERR_OK);
+
+            const uint32_t setup = Value(session, "setuplatency");
+            const uint32_t latency = Value(session, "latency");
+
+            CHECK(setup >= SetupDelay);
+            CHECK(latency >= (SetupDelay + PlayDelay));
+            CHECK(latency < (SetupDelay + PlayDelay + 1000));
+            CHECK(latency >= setup);
+
+            total += latency;
+            most = std::max(most, latency);
+
+            CHECK(session.Close() == ERR_OK);
+        }
+
+        CHECK(server.Setups() == Rounds);
+        CHECK(server.Plays() == Rounds);
+        CHECK(server.Teardowns() == Rounds);
+        CHECK(server.Mismatches() == 0);
+
+        printf("Channel change: %u rounds, %u ms average, %u ms at most (SETUP %u ms and PLAY %u ms in the server)\n",
+            Rounds, total / Rounds, most, SetupDelay, PlayDelay);
+    }
+
+    // With the heartbeats of a session unanswered, it is closed and the next one opened. The responses
+    // to the heartbeats come in late, in front of the TEARDOWN response, and the SETUP response comes
+    // in two parts. Neither may be taken for the response of another request.
+    void TestLateHeartbeats(RtspSession& session, RtspServer::Server& server, const Announcements& announcements)
+    {
+        server.Configure({ 0, 0, true, true, true });
+
+        const uint32_t setups = server.Setups();
+
+        CHECK(session.Open("late") == ERR_OK);
+
+        // The SRM and the pump heartbeat, both sent after the first second, on the same connection.
+        CHECK(WaitFor([&]() { return (server.Held() >= 2); }, WaitTime) == true);
+        CHECK(server.MaxHeld() >= 2);
+
+        CHECK(session.Close() == ERR_OK);
+
+        CHECK(session.Open("next") == ERR_OK);
+        CHECK(server.Setups() == (setups + 2));
+        CHECK(server.Mismatches() == 0);
+        CHECK(Value(session, "latency") >= Value(session, "setuplatency"));
+
+        CHECK(WaitFor([&]() { return (announcements.Count(RtspAnnounce::EosReached) >= 2); }, WaitTime) == true);
+
+        CHECK(session.Close() == ERR_OK);
+    }
+}
+
+int main()
+{
+    {
+        RtspServer::Server server;
+        Announcements announcements;
+        RtspSession session(announcements);
+
+        CHECK(server.Start() == true);
+
+        if (server.Port() != 0) {
+            CHECK(session.Initialize(_T("127.0.0.1"), server.Port()) == ERR_OK);
+
+            TestChannelChange(session, server);
+            TestLateHeartbeats(session, server, announcements);
+
+            session.Terminate();
+        }
+
+        server.Stop();
+    }
+
+    Core::Singleton::Dispose();
+
+    return (UnitTest::Result());
+}
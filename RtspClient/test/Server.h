@@ -0,0 +1,357 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace WPEFramework {
+namespace RtspServer {
+
+    // A stand-in for the session manager, on the loopback, as a proxy: the session and the control
+    // session are the same, so SETUP, PLAY, the heartbeats and TEARDOWN all come in on one connection.
+    // It answers after the delays it is given, can hold on to the heartbeat responses until the next
+    // request comes in, and can split a SETUP response over two writes. No framework dependencies, it is
+    // checked on its own.
+    class Server {
+    private:
+        struct Outgoing {
+            std::chrono::steady_clock::time_point Due;
+            std::string Data;
+        };
+
+    public:
+        struct Policy {
+            uint32_t SetupDelay; // ms
+            uint32_t PlayDelay; // ms
+            bool HoldHeartbeats;
+            bool SplitSetup;
+            bool Announce;
+        };
+
+    public:
+        Server(const Server&) = delete;
+        Server& operator=(const Server&) = delete;
+
+        Server()
+            : _lock()
+            , _policy({ 0, 0, false, false, false })
+            , _listen(-1)
+            , _port(0)
+            , _running(false)
+            , _thread()
+            , _session()
+            , _sessions(0)
+            , _setups(0)
+            , _plays(0)
+            , _heartbeats(0)
+            , _teardowns(0)
+            , _mismatches(0)
+            , _held(0)
+            , _maxHeld(0)
+        {
+        }
+        ~Server()
+        {
+            Stop();
+        }
+
+    public:
+        bool Start()
+        {
+            struct sockaddr_in address {};
+            socklen_t length = sizeof(address);
+            int enable = 1;
+
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port = 0;
+
+            _listen = ::socket(AF_INET, SOCK_STREAM, 0);
+
+            if ((_listen != -1)
+                && (::setsockopt(_listen, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) == 0)
+                && (::bind(_listen, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0)
+                && (::listen(_listen, 4) == 0)
+                && (::getsockname(_listen, reinterpret_cast<struct sockaddr*>(&address), &length) == 0)) {
+
+                _port = ntohs(address.sin_port);
+                _running = true;
+                _thread = std::thread(&Server::Run, this);
+            } else if (_listen != -1) {
+                ::close(_listen);
+                _listen = -1;
+            }
+
+            return (_running == true);
+        }
+        void Stop()
+        {
+            if (_running == true) {
+                _running = false;
+                _thread.join();
+            }
+            if (_listen != -1) {
+                ::close(_listen);
+                _listen = -1;
+            }
+        }
+        uint16_t Port() const
+        {
+            return (_port);
+        }
+        void Configure(const Policy& policy)
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _policy = policy;
+        }
+
+        uint32_t Setups() const
+        {
+            return (_setups);
+        }
+        uint32_t Plays() const
+        {
+            return (_plays);
+        }
+        uint32_t Heartbeats() const
+        {
+            return (_heartbeats);
+        }
+        uint32_t Teardowns() const
+        {
+            return (_teardowns);
+        }
+        // PLAYs and heartbeats for another session than the last one set up.
+        uint32_t Mismatches() const
+        {
+            return (_mismatches);
+        }
+        // Heartbeat responses held back right now, and the most that were ever held back at once.
+        uint32_t Held() const
+        {
+            return (_held);
+        }
+        uint32_t MaxHeld() const
+        {
+            return (_maxHeld);
+        }
+
+        // A request is its header up to the empty line, followed by Content-Length bytes of body. The
+        // CRLFs in between requests, as the pump heartbeat sends one after its body, are skipped.
+        static size_t Frame(std::string& buffer)
+        {
+            size_t result = 0;
+
+            while (buffer.compare(0, 2, "\r\n") == 0) {
+                buffer.erase(0, 2);
+            }
+
+            const size_t end = buffer.find("\r\n\r\n");
+
+            if (end != std::string::npos) {
+                const std::string length(Field(buffer.substr(0, end + 2), "Content-Length"));
+                const size_t size = end + 4 + ::strtoul(length.c_str(), nullptr, 10);
+
+                if (size <= buffer.size()) {
+                    result = size;
+                }
+            }
+
+            return (result);
+        }
+
+        // The value of a header line, with or without a space after the colon.
+        static std::string Field(const std::string& message, const char name[])
+        {
+            std::string result;
+            const std::string prefix(std::string("\r\n") + name + ':');
+            const size_t start = message.find(prefix);
+
+            if (start != std::string::npos) {
+                size_t offset = start + prefix.size();
+                const size_t end = message.find("\r\n", offset);
+
+                while ((offset < end) && (message[offset] == ' ')) {
+                    offset++;
+                }
+                result = message.substr(offset, end - offset);
+            }
+
+            return (result);
+        }
+
+    private:
+        void Run()
+        {
+            std::deque<Outgoing> outgoing;
+            std::string received;
+            std::string held;
+            int connection = -1;
+
+            while (_running == true) {
+                struct pollfd fds[2] = { { _listen, POLLIN, 0 }, { connection, POLLIN, 0 } };
+
+                ::poll(fds, (connection == -1 ? 1 : 2), 2);
+
+                if ((fds[0].revents & POLLIN) != 0) {
+                    const int accepted = ::accept(_listen, nullptr, nullptr);
+
+                    if (accepted != -1) {
+                        if (connection != -1) {
+                            ::close(connection);
+                        }
+                        connection = accepted;
+                        received.clear();
+                        held.clear();
+                        outgoing.clear();
+                        _held = 0;
+                    }
+                }
+
+                if ((connection != -1) && ((fds[1].revents & (POLLIN | POLLHUP | POLLERR)) != 0)) {
+                    char buffer[2048];
+                    const ssize_t length = ::recv(connection, buffer, sizeof(buffer), 0);
+
+                    if (length > 0) {
+                        size_t size;
+
+                        received.append(buffer, length);
+
+                        while ((size = Frame(received)) != 0) {
+                            Handle(received.substr(0, size), held, outgoing);
+                            received.erase(0, size);
+                        }
+                    } else {
+                        ::close(connection);
+                        connection = -1;
+                        outgoing.clear();
+                    }
+                }
+
+                // In order, so a delayed response is not overtaken by one that is due earlier.
+                const auto now = std::chrono::steady_clock::now();
+
+                while ((connection != -1) && (outgoing.empty() == false) && (outgoing.front().Due <= now)) {
+                    const std::string& data(outgoing.front().Data);
+                    ::send(connection, data.data(), data.size(), MSG_NOSIGNAL);
+                    outgoing.pop_front();
+                }
+            }
+
+            if (connection != -1) {
+                ::close(connection);
+            }
+        }
+
+        void Handle(const std::string& request, std::string& held, std::deque<Outgoing>& outgoing)
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+
+            const std::string method(request.substr(0, request.find(' ')));
+            const std::string session(Field(request, "Session"));
+            std::string response("RTSP/1.0 200 OK\r\nCSeq: " + Field(request, "CSeq") + "\r\n");
+            const auto now = std::chrono::steady_clock::now();
+            uint32_t delay = 0;
+
+            if (method == "SETUP") {
+                _setups++;
+                _session = "S" + std::to_string(++_sessions);
+                response += "Session: " + _session + ";timeout=1\r\n"
+                    + "ControlSession: " + _session + ";timeout=1\r\n"
+                    + "Tuning: frequency=6030000;modulation=16;symbol_rate=5361\r\n"
+                    + "Channel: Svcid=7\r\n"
+                    + "Bookmark: 0\r\n"
+                    + "Duration: 3600\r\n";
+                delay = _policy.SetupDelay;
+            } else if (method == "PLAY") {
+                _plays++;
+                _mismatches += (session != _session ? 1 : 0);
+                response += "Scale: 1\r\nRange: npt=0.000-\r\n";
+                delay = _policy.PlayDelay;
+            } else if (method == "GET_PARAMETER") {
+                _heartbeats++;
+                _mismatches += (session != _session ? 1 : 0);
+                response += "Scale: 1\r\nRange: npt=12.000-\r\n";
+            } else if (method == "TEARDOWN") {
+                _teardowns++;
+            }
+
+            response += "\r\n";
+
+            if ((method == "GET_PARAMETER") && (_policy.HoldHeartbeats == true)) {
+                held += response;
+                _held++;
+                _maxHeld = std::max(_maxHeld.load(), _held.load());
+            } else {
+                const auto due = now + std::chrono::milliseconds(delay);
+
+                // What was held back goes out first, in the same write as this response.
+                response.insert(0, held);
+                held.clear();
+                _held = 0;
+
+                if ((method == "SETUP") && (_policy.SplitSetup == true)) {
+                    const size_t half = response.size() / 2;
+                    outgoing.push_back({ due, response.substr(0, half) });
+                    outgoing.push_back({ due + std::chrono::milliseconds(5), response.substr(half) });
+                } else {
+                    outgoing.push_back({ due, response });
+                }
+
+                if ((method == "PLAY") && (_policy.Announce == true)) {
+                    outgoing.push_back({ due, "ANNOUNCE rtsp://127.0.0.1 RTSP/1.0\r\nCSeq: 1000\r\nNotice: 2101 \"End-of-Stream Reached\"\r\nSession: " + _session + "\r\n\r\n" });
+                }
+            }
+        }
+
+    private:
+        std::mutex _lock;
+        Policy _policy;
+        int _listen;
+        uint16_t _port;
+        std::atomic<bool> _running;
+        std::thread _thread;
+        std::string _session;
+        uint32_t _sessions;
+        std::atomic<uint32_t> _setups;
+        std::atomic<uint32_t> _plays;
+        std::atomic<uint32_t> _heartbeats;
+        std::atomic<uint32_t> _teardowns;
+        std::atomic<uint32_t> _mismatches;
+        std::atomic<uint32_t> _held;
+        std::atomic<uint32_t> _maxHeld;
+    };
+
+} // namespace RtspServer
+} // namespace WPEFramework
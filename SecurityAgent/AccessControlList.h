@@ -22,6 +22,7 @@
 #include "Module.h"
 
 #include <regex>
+#include <unordered_map>
 
 // helper functions
 namespace {
@@ -252,14 +253,20 @@ namespace Plugin {
     public:
         class Filter {
         private:
+            // Decisions are cached per callsign/method pair, once the pair has been seen, the
+            // security check is a single lookup. Keep the cache bounded, the method name is
+            // under control of the caller, so it should not be able to grow us indefinitely.
+            static constexpr uint16_t MaxCachedDecisions = 1024;
+
             class Plugin {
             public:
                 Plugin() = delete;
                 Plugin(const Plugin&) = delete;
                 Plugin& operator= (const Plugin&) = delete;
 
-                Plugin (const JSONACL::Plugins::Rules& rules)
-                    : _defaultBlocked(rules.Default.Value() == mode::BLOCKED) 
+                Plugin (const string& callsign, const JSONACL::Plugins::Rules& rules)
+                    : _callsign(callsign)
+                    , _defaultBlocked(rules.Default.Value() == mode::BLOCKED) 
                     , _methods() {
                     Core::JSON::ArrayType<Core::JSON::String>::ConstIterator index(rules.Methods.Elements());
                     while (index.Next() == true) {
@@ -271,16 +278,18 @@ namespace Plugin {
                 }
 
             public:
+                bool Applicable(const string& callsign) const
+                {
+                    return (std::regex_search(callsign, _callsign));
+                }
                 bool Allowed(const string& method) const
                 {
                     bool found = false;
 
-                    std::list<string>::const_iterator index(_methods.begin());
+                    std::list<std::regex>::const_iterator index(_methods.begin());
 
                     while ((index != _methods.end()) && (found == false)) { 
-                        std::regex expression(index->c_str());
-                        std::smatch matchList;
-                        found = std::regex_search(method, matchList, expression);
+                        found = std::regex_search(method, *index);
                         if (found == false) {
                             index++;
                         }
@@ -289,8 +298,9 @@ namespace Plugin {
                 }
 
             private:
+                const std::regex _callsign;
                 bool _defaultBlocked;
-                std::list<string> _methods;
+                std::list<std::regex> _methods;
             };
 
         public:
@@ -301,13 +311,17 @@ namespace Plugin {
             Filter(const JSONACL::Plugins& plugins)
                 : _defaultBlocked(plugins.Default.Value() == mode::BLOCKED)
                 , _plugins()
+                , _adminLock()
+                , _decisions()
             {
                 JSONACL::Plugins::Iterator index(plugins.Elements());
           
                 while (index.Next() == true) {
+                    string expression(CreateRegex(index.Key()));
+
                     _plugins.emplace(std::piecewise_construct,
-                            std::forward_as_tuple(CreateRegex(index.Key())),
-                            std::forward_as_tuple(index.Current()));
+                            std::forward_as_tuple(expression),
+                            std::forward_as_tuple(expression, index.Current()));
                 }
             }
             ~Filter()
@@ -315,15 +329,45 @@ namespace Plugin {
             }
 
         public:
-            bool Allowed(const string callsign, const string& method) const
+            bool Allowed(const string& callsign, const string& method) const
+            {
+                bool result;
+                string key(Core::NumberType<uint32_t>(static_cast<uint32_t>(callsign.length())).Text());
+
+                // The length of the callsign goes in front, so no callsign/method pair shares its key with
+                // another, whatever characters they contain.
+                key.reserve(key.length() + callsign.length() + method.length() + 1);
+                key.append(1, ':').append(callsign).append(method);
+
+                _adminLock.Lock();
+
+                std::unordered_map<string, bool>::const_iterator cached(_decisions.find(key));
+
+                if (cached != _decisions.end()) {
+                    result = cached->second;
+                }
+                else {
+                    result = Evaluate(callsign, method);
+
+                    if (_decisions.size() >= MaxCachedDecisions) {
+                        _decisions.clear();
+                    }
+                    _decisions.emplace(std::move(key), result);
+                }
+
+                _adminLock.Unlock();
+
+                return (result);
+            }
+
+        private:
+            bool Evaluate(const string& callsign, const string& method) const
             {
                 bool pluginFound = false;
 
                 std::map<string, Plugin>::const_iterator index(_plugins.begin());
                 while ((index != _plugins.end()) && (pluginFound == false)) {
-                    std::regex expression(index->first.c_str());
-                    std::smatch matchList;
-                    pluginFound = std::regex_search(callsign, matchList, expression);
+                    pluginFound = index->second.Applicable(callsign);
                     if (pluginFound == false) {
                         index++;
                     }
@@ -335,9 +379,11 @@ namespace Plugin {
         private:
             bool _defaultBlocked;
             std::map<string, Plugin> _plugins;
+            mutable Core::CriticalSection _adminLock;
+            mutable std::unordered_map<string, bool> _decisions;
         };
 
-        using URLList = std::list<std::pair<string, Filter&>>;
+        using URLList = std::list<std::pair<std::regex, Filter&>>;
         using Iterator = Core::IteratorType<const std::list<string>, const string&, std::list<string>::const_iterator>;
 
     public:
@@ -374,16 +420,11 @@ namespace Plugin {
         const Filter* FilterMapFromURL(const string& URL) const
         {
             const Filter* result = nullptr;
-            std::smatch matchList;
             URLList::const_iterator index = _urlMap.begin();
 
             while ((index != _urlMap.end()) && (result == nullptr)) {
-                // regex_search() for searching the regex pattern
-                // 'r' in the string 's'. 'm' is flag for determining
-                // matching behavior.
-                std::regex expression(index->first.c_str());
-
-                if (std::regex_search(URL, matchList, expression) == true) {
+                // The expressions are compiled once, at load time, here we only match.
+                if (std::regex_search(URL, index->first) == true) {
                     result = &(index->second);
                 }
                 else {
@@ -436,8 +477,8 @@ namespace Plugin {
                     // create regex for url
                     string url_regex = CreateUrlRegex(index.Current().URL.Value());
                     
-                    _urlMap.emplace_back(std::pair<string, Filter&>(
-                        url_regex, entry));
+                    _urlMap.emplace_back(std::pair<std::regex, Filter&>(
+                        std::regex(url_regex), entry));
 
                     std::list<string>::iterator found = std::find(_unusedRoles.begin(), _unusedRoles.end(), role);
 
@@ -26,6 +26,7 @@ namespace Plugin {
     SERVICE_REGISTRATION(SecurityAgent, 1, 0);
 
     static Core::ProxyPoolType<Web::TextBody> textFactory(1);
+    static Core::ProxyPoolType<Web::JSONBodyType<SecurityAgent::CacheStatistics>> jsonStatisticsFactory(1);
 
     class SecurityCallsign : public PluginHost::ISubSystem::ISecurity {
     public:
@@ -74,7 +75,10 @@ namespace Plugin {
         }
     }
 
-    SecurityAgent::SecurityAgent() : _dispatcher(nullptr)
+    SecurityAgent::SecurityAgent()
+        : _acl()
+        , _tokens(0)
+        , _dispatcher(nullptr)
     {
         RegisterAll();
 
@@ -95,6 +99,11 @@ namespace Plugin {
         string version = service->Version();
 
         _skipURL = static_cast<uint8_t>(service->WebPrefix().length());
+
+        // Whatever was validated against a previous ACL is no longer trustworthy.
+        _tokens.Clear();
+        _tokens.Size(config.CacheSize.Value());
+
         Core::File aclFile(service->PersistentPath() + config.ACL.Value(), true);
 
         if (aclFile.Exists() == false) {
@@ -155,6 +164,9 @@ namespace Plugin {
             subSystem->Set(PluginHost::ISubSystem::NOT_SECURITY, nullptr);
             subSystem->Release();
         }
+
+        // The cached contexts refer to the filters in the ACL, drop them before the ACL is cleared.
+        _tokens.Clear();
         _acl.Clear();
     }
 
@@ -174,21 +186,31 @@ namespace Plugin {
 
     /* virtual */ PluginHost::ISecurity* SecurityAgent::Officer(const string& token)
     {
-        PluginHost::ISecurity* result = nullptr;
-
-        Web::JSONWebToken webToken(Web::JSONWebToken::SHA256, sizeof(_secretKey), _secretKey);
-        uint16_t load = webToken.PayloadLength(token);
+        return (Validate(token));
+    }
 
-        // Validate the token
-        if (load != static_cast<uint16_t>(~0)) {
-            // It is potentially a valid token, extract the payload.
-            uint8_t* payload = reinterpret_cast<uint8_t*>(ALLOCA(load));
+    PluginHost::ISecurity* SecurityAgent::Validate(const string& token)
+    {
+        // If it was validated before, there is no need to redo the HMAC and the parsing of the payload.
+        PluginHost::ISecurity* result = _tokens.Find(token);
 
-            load = webToken.Decode(token, load, payload);
+        if (result == nullptr) {
+            Web::JSONWebToken webToken(Web::JSONWebToken::SHA256, sizeof(_secretKey), _secretKey);
+            uint16_t load = webToken.PayloadLength(token);
 
+            // Validate the token
             if (load != static_cast<uint16_t>(~0)) {
-                // Seems like we extracted a valid payload, time to create an security context
-                result = Core::Service<SecurityContext>::Create<SecurityContext>(&_acl, load, payload);
+                // It is potentially a valid token, extract the payload.
+                uint8_t* payload = reinterpret_cast<uint8_t*>(ALLOCA(load));
+
+                load = webToken.Decode(token, load, payload);
+
+                if (load != static_cast<uint16_t>(~0)) {
+                    // Seems like we extracted a valid payload, time to create an security context
+                    result = Core::Service<SecurityContext>::Create<SecurityContext>(&_acl, load, payload);
+
+                    _tokens.Insert(token, result);
+                }
             }
         }
         return (result);
@@ -238,28 +260,33 @@ namespace Plugin {
                 result->Message = _T("Missing token");
 
                 if (request.WebToken.IsSet()) {
-                    Web::JSONWebToken webToken(Web::JSONWebToken::SHA256, sizeof(_secretKey), _secretKey);
-                    const string& token = request.WebToken.Value().Token();
-                    uint16_t load = webToken.PayloadLength(token);
+                    PluginHost::ISecurity* context = Validate(request.WebToken.Value().Token());
+
+                    if (context == nullptr) {
+                        result->ErrorCode = Web::STATUS_FORBIDDEN;
+                        result->Message = _T("Invalid token");
+                    } else {
+                        result->ErrorCode = Web::STATUS_OK;
+                        result->Message = _T("Valid token");
+                        TRACE(Trace::Information, (_T("Token contents: %s"), context->Token().c_str()));
+                        context->Release();
+                    }
+                }
+            } else if ( (request.Verb == Web::Request::HTTP_GET) && (index.Current() == _T("Cache")) ) {
+                Core::ProxyType<Web::JSONBodyType<CacheStatistics>> response(jsonStatisticsFactory.Element());
+                uint32_t hits, misses;
+                uint16_t entries;
 
-                    // Validate the token
-                    if (load != static_cast<uint16_t>(~0)) {
-                        // It is potentially a valid token, extract the payload.
-                        uint8_t* payload = reinterpret_cast<uint8_t*>(ALLOCA(load));
+                _tokens.Statistics(hits, misses, entries);
 
-                        load = webToken.Decode(token, load, payload);
+                response->Hits = hits;
+                response->Misses = misses;
+                response->Entries = entries;
 
-                        if (load == static_cast<uint16_t>(~0)) {
-                            result->ErrorCode = Web::STATUS_FORBIDDEN;
-                            result->Message = _T("Invalid token");
-                        } else {
-                            result->ErrorCode = Web::STATUS_OK;
-                            result->Message = _T("Valid token");
-                            TRACE(Trace::Information, (_T("Token contents: %s"), reinterpret_cast<const TCHAR*>(payload)));
-                        }
-                    }
-                
-				}
+                result->Body(Core::proxy_cast<Web::IBody>(response));
+                result->ContentType = Web::MIMETypes::MIME_JSON;
+                result->ErrorCode = Web::STATUS_OK;
+                result->Message = _T("Token cache statistics");
             }
         }
 		return (result);
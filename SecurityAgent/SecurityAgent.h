@@ -25,6 +25,8 @@
 
 #include <interfaces/json/JsonData_SecurityAgent.h>
 
+#include <unordered_map>
+
 namespace WPEFramework {
 namespace Plugin {
 
@@ -81,6 +83,128 @@ namespace Plugin {
             Core::IPCChannelClientType<Core::Void, true, true> _channel;
         };
 
+        // Validating a token means an HMAC over the token and parsing its payload. Clients tend to send
+        // the same token over and over again, so keep the most recently used, already validated, security
+        // contexts around. The cache is keyed by the full token, so a hit is an exact match of a token that
+        // has been validated before.
+        class TokenCache {
+        private:
+            using Entry = std::pair<string, PluginHost::ISecurity*>;
+            using EntryList = std::list<Entry>;
+            using EntryMap = std::unordered_map<string, EntryList::iterator>;
+
+        public:
+            TokenCache() = delete;
+            TokenCache(const TokenCache&) = delete;
+            TokenCache& operator=(const TokenCache&) = delete;
+
+            TokenCache(const uint16_t size)
+                : _adminLock()
+                , _size(size)
+                , _entries()
+                , _index()
+                , _hits(0)
+                , _misses(0)
+            {
+            }
+            ~TokenCache()
+            {
+                Clear();
+            }
+
+        public:
+            void Size(const uint16_t size)
+            {
+                _adminLock.Lock();
+                _size = size;
+                while (_entries.size() > _size) {
+                    Evict();
+                }
+                _adminLock.Unlock();
+            }
+            // Returns an AddRef'ed security context if the token was validated before.
+            PluginHost::ISecurity* Find(const string& token)
+            {
+                PluginHost::ISecurity* result = nullptr;
+
+                _adminLock.Lock();
+
+                EntryMap::iterator index(_index.find(token));
+
+                if (index != _index.end()) {
+                    // Most recently used goes to the front.
+                    _entries.splice(_entries.begin(), _entries, index->second);
+                    result = index->second->second;
+                    result->AddRef();
+                    _hits++;
+                } else {
+                    _misses++;
+                }
+
+                _adminLock.Unlock();
+
+                return (result);
+            }
+            void Insert(const string& token, PluginHost::ISecurity* context)
+            {
+                ASSERT(context != nullptr);
+
+                _adminLock.Lock();
+
+                if ((_size > 0) && (_index.find(token) == _index.end())) {
+                    while (_entries.size() >= _size) {
+                        Evict();
+                    }
+
+                    context->AddRef();
+                    _entries.emplace_front(token, context);
+                    _index.emplace(token, _entries.begin());
+                }
+
+                _adminLock.Unlock();
+            }
+            // To be called whenever the outcome of a validation might change, e.g. secret or ACL change.
+            void Clear()
+            {
+                _adminLock.Lock();
+
+                for (Entry& entry : _entries) {
+                    entry.second->Release();
+                }
+                _entries.clear();
+                _index.clear();
+
+                _adminLock.Unlock();
+            }
+            void Statistics(uint32_t& hits, uint32_t& misses, uint16_t& entries) const
+            {
+                _adminLock.Lock();
+                hits = _hits;
+                misses = _misses;
+                entries = static_cast<uint16_t>(_entries.size());
+                _adminLock.Unlock();
+            }
+
+        private:
+            void Evict()
+            {
+                ASSERT(_entries.empty() == false);
+
+                Entry& last(_entries.back());
+                _index.erase(last.first);
+                last.second->Release();
+                _entries.pop_back();
+            }
+
+        private:
+            mutable Core::CriticalSection _adminLock;
+            uint16_t _size;
+            EntryList _entries;
+            EntryMap _index;
+            uint32_t _hits;
+            uint32_t _misses;
+        };
+
         class Config : public Core::JSON::Container {
         private:
             Config(const Config&) = delete;
@@ -91,9 +215,11 @@ namespace Plugin {
                 : Core::JSON::Container()
                 , ACL(_T("acl.json"))
                 , Connector()
+                , CacheSize(32)
             {
                 Add(_T("acl"), &ACL);
                 Add(_T("connector"), &Connector);
+                Add(_T("cachesize"), &CacheSize);
             }
             ~Config()
             {
@@ -102,6 +228,33 @@ namespace Plugin {
         public:
             Core::JSON::String ACL;
             Core::JSON::String Connector;
+            Core::JSON::DecUInt16 CacheSize;
+        };
+
+    public:
+        class CacheStatistics : public Core::JSON::Container {
+        public:
+            CacheStatistics(const CacheStatistics&) = delete;
+            CacheStatistics& operator=(const CacheStatistics&) = delete;
+
+            CacheStatistics()
+                : Core::JSON::Container()
+                , Hits(0)
+                , Misses(0)
+                , Entries(0)
+            {
+                Add(_T("hits"), &Hits);
+                Add(_T("misses"), &Misses);
+                Add(_T("entries"), &Entries);
+            }
+            ~CacheStatistics()
+            {
+            }
+
+        public:
+            Core::JSON::DecUInt32 Hits;
+            Core::JSON::DecUInt32 Misses;
+            Core::JSON::DecUInt16 Entries;
         };
 
     public:
@@ -152,15 +305,19 @@ namespace Plugin {
         // -------------------------------------------------------------------------------------------------------
         void RegisterAll();
         void UnregisterAll();
-        #ifdef SECURITY_TESTING_MODE
-        uint32_t endpoint_createtoken(const JsonData::SecurityAgent::CreatetokenParamsData& params, JsonData::SecurityAgent::CreatetokenResultInfo& response);
+        #ifdef SECURITY_TESTING_MODE
+        uint32_t endpoint_createtoken(const JsonData::SecurityAgent::CreatetokenParamsData& params, JsonData::SecurityAgent::CreatetokenResultInfo& response);
         #endif // DEBUG
         uint32_t endpoint_validate(const JsonData::SecurityAgent::CreatetokenResultInfo& params, JsonData::SecurityAgent::ValidateResultData& response);
 
 
+    private:
+        PluginHost::ISecurity* Validate(const string& token);
+
     private:
         uint8_t _secretKey[Crypto::SHA256::Length];
         AccessControlList _acl;
+        TokenCache _tokens;
         uint8_t _skipURL;
         TokenDispatcher* _dispatcher;
     };
@@ -78,22 +78,12 @@ namespace Plugin {
     uint32_t SecurityAgent::endpoint_validate(const CreatetokenResultInfo& params, ValidateResultData& response)
     {
         uint32_t result = Core::ERROR_NONE;
-        const string& token = params.Token.Value();
-        response.Valid = false;
+        PluginHost::ISecurity* context = Validate(params.Token.Value());
 
-        Web::JSONWebToken webToken(Web::JSONWebToken::SHA256, sizeof(_secretKey), _secretKey);
-        uint16_t load = webToken.PayloadLength(token);
+        response.Valid = (context != nullptr);
 
-        // Validate the token
-        if (load != static_cast<uint16_t>(~0)) {
-            // It is potentially a valid token, extract the payload.
-            uint8_t* payload = reinterpret_cast<uint8_t*>(ALLOCA(load));
-
-            load = webToken.Decode(token, load, payload);
-
-             if (load != static_cast<uint16_t>(~0)) {
-                response.Valid = true;
-            }
+        if (context != nullptr) {
+            context->Release();
         }
 
         return result;
@@ -0,0 +1,131 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../Module.h"
+#include "../AccessControlList.h"
+#include "../../helpers/UnitTest.h"
+
+#include <chrono>
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+namespace {
+
+    const char ACLFile[] = "AccessControlListTest.json";
+
+    // "Foo" allows one method only, with a '#' in it.
+    const char ACL[] = "{"
+                       "  \"assign\": [ { \"url\": \"*\", \"role\": \"test\" } ],"
+                       "  \"roles\": {"
+                       "    \"test\": {"
+                       "      \"default\": \"allowed\","
+                       "      \"Foo\": { \"default\": \"blocked\", \"methods\": [ \"x#y\" ] },"
+                       "      \"DeviceInfo\": { \"default\": \"allowed\", \"methods\": [ \"register\", \"unregister\" ] }"
+                       "    }"
+                       "  }"
+                       "}";
+
+    const uint32_t Calls = 200 * 1000;
+
+    bool Load(AccessControlList& acl)
+    {
+        Core::File file(string(ACLFile));
+        bool result = false;
+
+        if (file.Create() == true) {
+            file.Write(reinterpret_cast<const uint8_t*>(ACL), sizeof(ACL) - 1);
+            file.Close();
+
+            result = ((file.Open(true) == true) && (acl.Load(file) == Core::ERROR_NONE));
+
+            file.Close();
+            file.Destroy();
+        }
+
+        return (result);
+    }
+
+    // A callsign and a method that run into each other, do not share a cached decision.
+    void TestKey(const AccessControlList::Filter& filter)
+    {
+        CHECK(filter.Allowed(_T("Foo"), _T("x#y")) == true);
+        CHECK(filter.Allowed(_T("Foo#x"), _T("y")) == false);
+
+        CHECK(filter.Allowed(_T("Foo#x"), _T("y")) == false);
+        CHECK(filter.Allowed(_T("Foo"), _T("x#y")) == true);
+
+        CHECK(filter.Allowed(_T("DeviceInfo"), _T("register")) == false);
+        CHECK(filter.Allowed(_T("DeviceInfo"), _T("systeminfo")) == true);
+    }
+
+    // Checks per second, of a pair that is cached, and of pairs that are all new.
+    void Benchmark(const AccessControlList::Filter& filter)
+    {
+        std::vector<string> methods;
+        uint32_t allowed = 0;
+
+        for (uint32_t index = 0; index < Calls; index++) {
+            methods.push_back(_T("method") + Core::NumberType<uint32_t>(index).Text());
+        }
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (uint32_t index = 0; index < Calls; index++) {
+            allowed += (filter.Allowed(_T("DeviceInfo"), _T("systeminfo")) == true ? 1 : 0);
+        }
+
+        const double cached = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+
+        for (const string& method : methods) {
+            allowed += (filter.Allowed(_T("DeviceInfo"), method) == true ? 1 : 0);
+        }
+
+        const double evaluated = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        CHECK(allowed == (2 * Calls));
+
+        printf("cached:    %10.0f checks/s\n", Calls / cached);
+        printf("evaluated: %10.0f checks/s\n", Calls / evaluated);
+    }
+}
+
+int main()
+{
+    {
+        AccessControlList acl;
+
+        CHECK(Load(acl) == true);
+
+        const AccessControlList::Filter* filter = acl.FilterMapFromURL(_T("http://example.com"));
+
+        CHECK(filter != nullptr);
+
+        if (filter != nullptr) {
+            TestKey(*filter);
+            Benchmark(*filter);
+        }
+    }
+
+    Core::Singleton::Dispose();
+
+    return (UnitTest::Result());
+}
@@ -0,0 +1,199 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // The latest frame of a stream, in tiles, with for every tile the sequence number of the frame it last
+    // changed in. So a client that has frame "since" only needs the tiles stamped later than that, taken
+    // from the latest frame, however many frames it missed. No framework dependencies, it is checked on
+    // its own.
+    //
+    // A delta is a header, followed by the changed tiles stacked in a strip of TileSize pixels wide, in
+    // the order of the header. Edge tiles are smaller, the rest of their rows in the strip is zero. All
+    // numbers are little endian:
+    //     uint32_t sequence         the frame the delta brings the client to, "since" for the next one
+    //     uint16_t width, height    of the frame, in pixels
+    //     uint16_t tile size        in pixels
+    //     uint16_t count            of the tiles that follow
+    //     count x uint16_t left, top  in pixels
+    class FrameTiles {
+    public:
+        static constexpr uint16_t TileSize = 32;
+        static constexpr uint8_t PixelSize = 4;
+        static constexpr uint8_t HeaderSize = 12;
+        static constexpr uint8_t EntrySize = 4;
+
+    public:
+        FrameTiles(const FrameTiles&) = delete;
+        FrameTiles& operator=(const FrameTiles&) = delete;
+
+        FrameTiles()
+            : _frame()
+            , _stamps()
+            , _width(0)
+            , _height(0)
+            , _sequence(0)
+        {
+        }
+        ~FrameTiles()
+        {
+        }
+
+    public:
+        uint32_t Sequence() const
+        {
+            return (_sequence);
+        }
+        uint16_t Width() const
+        {
+            return (_width);
+        }
+        uint16_t Height() const
+        {
+            return (_height);
+        }
+
+        // Takes in the next frame. Returns true if it differs from the latest one, then the tiles that
+        // changed are copied and stamped with a new sequence number. A first frame, or one of another
+        // size, changed all over.
+        bool Update(const uint8_t frame[], const uint16_t width, const uint16_t height)
+        {
+            bool result = false;
+            const uint32_t stride = width * PixelSize;
+
+            if ((_frame.empty() == true) || (width != _width) || (height != _height)) {
+                _frame.assign(frame, frame + (stride * height));
+                _width = width;
+                _height = height;
+                _stamps.assign(((width + TileSize - 1) / TileSize) * ((height + TileSize - 1) / TileSize), ++_sequence);
+                result = true;
+            } else {
+                const uint32_t sequence = _sequence + 1;
+                uint32_t tile = 0;
+
+                for (uint32_t top = 0; top < height; top += TileSize) {
+                    const uint32_t rows = std::min(static_cast<uint32_t>(TileSize), height - top);
+
+                    for (uint32_t left = 0; left < width; left += TileSize, tile++) {
+                        const uint32_t span = std::min(static_cast<uint32_t>(TileSize), width - left) * PixelSize;
+                        uint32_t offset = (top * stride) + (left * PixelSize);
+                        uint32_t line = 0;
+
+                        while ((line < rows) && (::memcmp(&frame[offset], &_frame[offset], span) == 0)) {
+                            offset += stride;
+                            line++;
+                        }
+
+                        if (line < rows) {
+                            _stamps[tile] = sequence;
+                            result = true;
+
+                            while (line < rows) {
+                                ::memcpy(&_frame[offset], &frame[offset], span);
+                                offset += stride;
+                                line++;
+                            }
+                        }
+                    }
+                }
+
+                if (result == true) {
+                    _sequence = sequence;
+                }
+            }
+
+            return (result);
+        }
+
+        // The delta from frame "since" to the latest one, see above, the strip is TileSize pixels wide.
+        // Unless "since" is a frame of this stream, with the size of the latest one, all tiles are in it.
+        // Returns the number of tiles.
+        uint16_t Delta(const uint32_t since, std::string& header, std::vector<uint8_t>& strip) const
+        {
+            const uint32_t from = (since <= _sequence ? since : 0);
+            const uint32_t stride = _width * PixelSize;
+            uint16_t count = 0;
+            uint32_t tile = 0;
+
+            header.resize(HeaderSize);
+            strip.clear();
+
+            for (uint32_t top = 0; top < _height; top += TileSize) {
+                const uint32_t rows = std::min(static_cast<uint32_t>(TileSize), _height - top);
+
+                for (uint32_t left = 0; left < _width; left += TileSize, tile++) {
+                    if (_stamps[tile] > from) {
+                        const uint32_t span = std::min(static_cast<uint32_t>(TileSize), _width - left) * PixelSize;
+                        const size_t position = strip.size();
+
+                        Put(header, static_cast<uint16_t>(left));
+                        Put(header, static_cast<uint16_t>(top));
+
+                        strip.resize(position + (TileSize * TileSize * PixelSize), 0);
+
+                        for (uint32_t line = 0; line < rows; line++) {
+                            ::memcpy(&strip[position + (line * TileSize * PixelSize)], &_frame[((top + line) * stride) + (left * PixelSize)], span);
+                        }
+
+                        count++;
+                    }
+                }
+            }
+
+            Set(header, 0, static_cast<uint16_t>(_sequence & 0xFFFF));
+            Set(header, 2, static_cast<uint16_t>(_sequence >> 16));
+            Set(header, 4, _width);
+            Set(header, 6, _height);
+            Set(header, 8, TileSize);
+            Set(header, 10, count);
+
+            return (count);
+        }
+
+    private:
+        static void Set(std::string& header, const size_t offset, const uint16_t value)
+        {
+            header[offset] = static_cast<char>(value & 0xFF);
+            header[offset + 1] = static_cast<char>(value >> 8);
+        }
+        static void Put(std::string& header, const uint16_t value)
+        {
+            header += static_cast<char>(value & 0xFF);
+            header += static_cast<char>(value >> 8);
+        }
+
+    private:
+        std::vector<uint8_t> _frame;
+        std::vector<uint32_t> _stamps; // per tile, row by row
+        uint16_t _width;
+        uint16_t _height;
+        uint32_t _sequence;
+    };
+
+} // namespace Plugin
+} // namespace WPEFramework
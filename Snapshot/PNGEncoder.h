@@ -0,0 +1,156 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <png.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // Encodes a captured BGRA frame as an RGB PNG, row by row, through one row buffer, rather than first
+    // converting the whole frame, a row allocation at a time. It goes into a file, or, without one, into
+    // memory directly. No framework dependencies, it is checked on its own.
+    class PNGEncoder {
+    public:
+        PNGEncoder() = delete;
+        PNGEncoder(const PNGEncoder&) = delete;
+        PNGEncoder& operator=(const PNGEncoder&) = delete;
+
+    public:
+        // A compression below 0 leaves the zlib level, filters of 0 leave the row filters, up to libpng.
+        static bool Encode(const unsigned char* buffer, const unsigned int width, const unsigned int height, FILE* filePointer, std::string* memory, const int8_t compression, const int filters, std::vector<uint8_t>& row)
+        {
+            bool result = false;
+            png_structp pngPointer = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+            png_infop infoPointer = (pngPointer != nullptr ? png_create_info_struct(pngPointer) : nullptr);
+
+            if (infoPointer != nullptr) {
+
+                row.resize(width * 3);
+
+                // Set up error handling, libpng jumps back here on an error.
+                if (setjmp(png_jmpbuf(pngPointer)) == 0) {
+
+                    if (filePointer != nullptr) {
+                        png_init_io(pngPointer, filePointer);
+                    } else {
+                        memory->clear();
+                        png_set_write_fn(pngPointer, memory, Write, Flush);
+                    }
+
+                    // Set image attributes.
+                    int depth = 8;
+                    png_set_IHDR(pngPointer,
+                        infoPointer,
+                        width,
+                        height,
+                        depth,
+                        PNG_COLOR_TYPE_RGB,
+                        PNG_INTERLACE_NONE,
+                        PNG_COMPRESSION_TYPE_DEFAULT,
+                        PNG_FILTER_TYPE_DEFAULT);
+
+                    if (compression >= 0) {
+                        png_set_compression_level(pngPointer, compression);
+                    }
+                    if (filters != 0) {
+                        png_set_filter(pngPointer, PNG_FILTER_TYPE_BASE, filters);
+                    }
+
+                    png_write_info(pngPointer, infoPointer);
+
+                    const int pixelSize = 4; // RGBA
+                    for (unsigned int i = 0; i < height; ++i) {
+                        Swizzle(buffer + (i * width * pixelSize), row.data(), width);
+                        png_write_row(pngPointer, row.data());
+                    }
+
+                    png_write_end(pngPointer, infoPointer);
+
+                    // All went well.
+                    result = true;
+                }
+            }
+
+            png_destroy_write_struct(&pngPointer, &infoPointer);
+
+            return result;
+        }
+
+        // Red, green and blue out of the captured pixels, in that order, alpha is dropped.
+        static void Swizzle(const uint8_t source[], uint8_t destination[], unsigned int pixels)
+        {
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+            // De-interleave 16 pixels, and interleave them again without alpha, with red and blue swapped.
+            while (pixels >= 16) {
+                uint8x16x4_t bgra = vld4q_u8(source);
+                uint8x16x3_t rgb;
+                rgb.val[0] = bgra.val[2];
+                rgb.val[1] = bgra.val[1];
+                rgb.val[2] = bgra.val[0];
+                vst3q_u8(destination, rgb);
+                source += 64;
+                destination += 48;
+                pixels -= 16;
+            }
+#elif defined(__SSSE3__)
+            // Shuffle 4 pixels into 12 bytes. The store writes 16, so it is only used while the 4 bytes
+            // too many still end up within the row, to be overwritten by the next round.
+            const __m128i mask = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+            while (pixels >= 6) {
+                __m128i bgra = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(destination), _mm_shuffle_epi8(bgra, mask));
+                source += 16;
+                destination += 12;
+                pixels -= 4;
+            }
+#endif
+            while (pixels-- != 0) {
+                *destination++ = source[2]; // Red
+                *destination++ = source[1]; // Green
+                *destination++ = source[0]; // Blue
+                // ignore alpha
+                source += 4;
+            }
+        }
+
+    private:
+        static void Write(png_structp pngPointer, png_bytep data, png_size_t length)
+        {
+            static_cast<std::string*>(png_get_io_ptr(pngPointer))->append(reinterpret_cast<const char*>(data), length);
+        }
+        static void Flush(png_structp)
+        {
+        }
+    };
+
+} // namespace Plugin
+} // namespace WPEFramework
@@ -18,14 +18,17 @@
  */
  
 #include "Snapshot.h"
-
-#include <png.h>
+#include "FrameTiles.h"
+#include "PNGEncoder.h"
 
 namespace WPEFramework {
 namespace Plugin {
 
     SERVICE_REGISTRATION(Snapshot, 1, 0);
 
+    static Core::ProxyPoolType<Web::JSONBodyType<Snapshot::Data>> jsonBodyDataFactory(1);
+    static Core::ProxyPoolType<Web::TextBody> frameBodyFactory(2);
+
     class StoreImpl : public Exchange::ICapture::IStore {
     private:
         StoreImpl() = delete;
@@ -33,8 +36,12 @@ namespace Plugin {
         StoreImpl& operator=(const StoreImpl&) = delete;
 
     public:
-        StoreImpl(Core::BinairySemaphore& inProgress, const string& path)
-            : _file(FileBodyExtended::Instance(inProgress, path))
+        StoreImpl(Core::BinairySemaphore& inProgress, const string& path, const bool streaming, const int8_t compression, const int filters, std::vector<uint8_t>& row)
+            : _file(streaming == false ? FileBodyExtended::Instance(inProgress, path) : Core::ProxyType<FileBodyExtended>())
+            , _memory(streaming == true ? MemoryBodyExtended::Instance(inProgress) : Core::ProxyType<MemoryBodyExtended>())
+            , _compression(compression)
+            , _filters(filters)
+            , _row(row)
         {
         }
 
@@ -44,94 +51,37 @@ namespace Plugin {
 
         virtual bool R8_G8_B8_A8(const unsigned char* buffer, const unsigned int width, const unsigned int height)
         {
-
-            png_structp pngPointer = nullptr;
             bool result = false;
+            FILE* filePointer = nullptr;
 
-            pngPointer = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
-            if (pngPointer == nullptr) {
-
-                return result;
+            if (_file.IsValid() == true) {
+                // Duplicate file descriptor and create File stream based on it.
+                filePointer = static_cast<FILE*>(*_file);
             }
 
-            png_infop infoPointer = nullptr;
-            infoPointer = png_create_info_struct(pngPointer);
-            if (infoPointer == nullptr) {
-
-                png_destroy_write_struct(&pngPointer, &infoPointer);
-                return result;
+            if ((filePointer != nullptr) || (_memory.IsValid() == true)) {
+                result = PNGEncoder::Encode(buffer, width, height, filePointer, (_memory.IsValid() == true ? static_cast<string*>(&(*_memory)) : nullptr), _compression, _filters, _row);
             }
 
-            // Set up error handling.
-            if (setjmp(png_jmpbuf(pngPointer))) {
-
-                png_destroy_write_struct(&pngPointer, &infoPointer);
-                return result;
+            if (filePointer != nullptr) {
+                // Close stream to flush and release allocated buffers
+                fclose(filePointer);
             }
 
-            // Set image attributes.
-            int depth = 8;
-            png_set_IHDR(pngPointer,
-                infoPointer,
-                width,
-                height,
-                depth,
-                PNG_COLOR_TYPE_RGB,
-                PNG_INTERLACE_NONE,
-                PNG_COMPRESSION_TYPE_DEFAULT,
-                PNG_FILTER_TYPE_DEFAULT);
-
-            // Initialize rows of PNG.
-            png_byte** rowLines = static_cast<png_byte**>(png_malloc(pngPointer, height * sizeof(png_byte*)));
-            const int pixelSize = 4; // RGBA
-            for (unsigned int i = 0; i < height; ++i) {
-
-                png_byte* rowLine = static_cast<png_byte*>(png_malloc(pngPointer, sizeof(png_byte) * width * pixelSize));
-                const uint8_t* rowSource = buffer + (sizeof(png_byte) * i * width * pixelSize);
-                rowLines[i] = rowLine;
-                for (unsigned int j = 0; j < width * pixelSize; j += pixelSize) {
-                    *rowLine++ = rowSource[j + 2]; // Red
-                    *rowLine++ = rowSource[j + 1]; // Green
-                    *rowLine++ = rowSource[j + 0]; // Blue
-                    // ignore alpha
-                }
-            }
-
-            // Duplicate file descriptor and create File stream based on it.
-            FILE* filePointer = static_cast<FILE*>(*_file);
-            if (nullptr != filePointer) {
-                // Write the image data to "file".
-                png_init_io(pngPointer, filePointer);
-                png_set_rows(pngPointer, infoPointer, rowLines);
-                png_write_png(pngPointer, infoPointer, PNG_TRANSFORM_IDENTITY, nullptr);
-                // All went well.
-                result = true;
-            }
-
-            // Close stream to flush and release allocated buffers
-            fclose(filePointer);
-
-            for (unsigned int i = 0; i < height; i++) {
-                png_free(pngPointer, rowLines[i]);
-            }
-
-            png_free(pngPointer, rowLines);
-            png_destroy_write_struct(&pngPointer, &infoPointer);
-
             return result;
         }
 
         operator Core::ProxyType<Web::IBody>()
         {
-
-            return Core::ProxyType<Web::IBody>(*_file);
+            return (_file.IsValid() == true ? Core::ProxyType<Web::IBody>(*_file) : Core::ProxyType<Web::IBody>(*_memory));
         }
 
         bool IsValid()
         {
-            return (_file.IsValid());
+            return ((_file.IsValid() == true) || (_memory.IsValid() == true));
         }
 
+    public:
         class FileBodyExtended : public Web::FileBody {
         private:
             FileBodyExtended() = delete;
@@ -178,13 +128,213 @@ namespace Plugin {
             Core::BinairySemaphore& _semLock;
         };
 
+        class MemoryBodyExtended : public Web::TextBody {
+        private:
+            MemoryBodyExtended() = delete;
+            MemoryBodyExtended(const MemoryBodyExtended&) = delete;
+            MemoryBodyExtended& operator=(const MemoryBodyExtended&) = delete;
+
+        protected:
+            MemoryBodyExtended(Core::BinairySemaphore* semLock)
+                : Web::TextBody()
+                , _semLock(*semLock)
+            {
+            }
+
+        public:
+            virtual ~MemoryBodyExtended()
+            {
+                // Signal, It is ready for new capture
+                _semLock.Unlock();
+            }
+
+        public:
+            static Core::ProxyType<MemoryBodyExtended> Instance(Core::BinairySemaphore& semLock)
+            {
+                Core::ProxyType<MemoryBodyExtended> result;
+
+                if (semLock.Lock(0) == Core::ERROR_NONE) {
+                    // We got the lock, forward it to the body
+                    result = Core::ProxyType<MemoryBodyExtended>::Create(&semLock);
+                }
+
+                return (result);
+            }
+
+        private:
+            Core::BinairySemaphore& _semLock;
+        };
+
     private:
         Core::ProxyType<FileBodyExtended> _file;
+        Core::ProxyType<MemoryBodyExtended> _memory;
+        const int8_t _compression;
+        const int _filters;
+        std::vector<uint8_t>& _row;
+    };
+
+    // Captures frames at a fixed rate, on its own thread, into the same buffers over and over again.
+    // The device only hands out the frame to be copied, the device lock is not held any longer than
+    // that. Each frame is then compared, tile by tile, to the latest one, see FrameTiles, so a static
+    // screen costs a compare per frame. Nothing is encoded here: clients poll for what changed since the
+    // frame they have, and get only the tiles that changed, encoded at that time.
+    class Snapshot::Stream : public Core::Thread, public Exchange::ICapture::IStore {
+    private:
+        static constexpr uint8_t PixelSize = 4;
+
+    public:
+        Stream() = delete;
+        Stream(const Stream&) = delete;
+        Stream& operator=(const Stream&) = delete;
+
+        Stream(Snapshot& parent, const uint8_t fps)
+            : Core::Thread(Core::Thread::DefaultStackSize(), _T("SnapshotStream"))
+            , _parent(parent)
+            , _adminLock()
+            , _fps(fps)
+            , _interval(1000 / fps)
+            , _captured()
+            , _capturedWidth(0)
+            , _capturedHeight(0)
+            , _tiles()
+            , _frames(0)
+            , _changed(0)
+            , _skipped(0)
+            , _window(0)
+            , _windowFrames(0)
+            , _achieved(0)
+        {
+        }
+        ~Stream() override
+        {
+            Block();
+            Wait(Core::Thread::BLOCKED | Core::Thread::STOPPED, Core::infinite);
+        }
+
+    public:
+        void Status(Snapshot::Data& data) const
+        {
+            _adminLock.Lock();
+
+            data.Running = true;
+            data.FPS = _fps;
+            data.Achieved = _achieved;
+            data.Frames = _frames;
+            data.Changed = _changed;
+            data.Skipped = _skipped;
+            data.Sequence = _tiles.Sequence();
+
+            _adminLock.Unlock();
+        }
+        // Returns the sequence number of the latest frame. If it is not "since", the delta to it is copied
+        // out, see FrameTiles.
+        uint32_t Frame(const uint32_t since, string& header, std::vector<uint8_t>& strip) const
+        {
+            _adminLock.Lock();
+
+            const uint32_t result = _tiles.Sequence();
+
+            if (result != since) {
+                _tiles.Delta(since, header, strip);
+            }
+
+            _adminLock.Unlock();
+
+            return (result);
+        }
+
+        // Called by the device, with the device lock taken, so only copied here.
+        bool R8_G8_B8_A8(const unsigned char* buffer, const unsigned int width, const unsigned int height) override
+        {
+            _captured.assign(buffer, buffer + (width * height * PixelSize));
+            _capturedWidth = width;
+            _capturedHeight = height;
+
+            return (true);
+        }
+
+    private:
+        uint32_t Worker() override
+        {
+            const uint64_t start = Core::Time::Now().Ticks();
+
+            _parent._deviceLock.Lock();
+            const bool captured = ((_parent._device != nullptr) && (_parent._device->Capture(*this) == true));
+            _parent._deviceLock.Unlock();
+
+            _adminLock.Lock();
+
+            if (captured == true) {
+                if (_tiles.Update(_captured.data(), static_cast<uint16_t>(_capturedWidth), static_cast<uint16_t>(_capturedHeight)) == true) {
+                    _changed++;
+                } else {
+                    _skipped++;
+                }
+                _frames++;
+                _windowFrames++;
+            }
+
+            // Ticks are in microseconds.
+            const uint64_t now = Core::Time::Now().Ticks();
+            const uint32_t spent = static_cast<uint32_t>((now - start) / 1000);
+
+            if (_window == 0) {
+                _window = start;
+            } else if ((now - _window) >= (1000 * 1000)) {
+                _achieved = static_cast<uint8_t>(std::min(static_cast<uint64_t>(0xFF), ((_windowFrames * 1000 * 1000) + ((now - _window) / 2)) / (now - _window)));
+                _windowFrames = 0;
+                _window = now;
+            }
+
+            _adminLock.Unlock();
+
+            return (spent < _interval ? _interval - spent : 0);
+        }
+
+    private:
+        Snapshot& _parent;
+        mutable Core::CriticalSection _adminLock;
+        const uint8_t _fps;
+        const uint32_t _interval;
+        std::vector<uint8_t> _captured;
+        unsigned int _capturedWidth;
+        unsigned int _capturedHeight;
+        FrameTiles _tiles;
+        uint32_t _frames;
+        uint32_t _changed;
+        uint32_t _skipped;
+        uint64_t _window;
+        uint64_t _windowFrames;
+        uint8_t _achieved;
     };
 
     /* virtual */ const string Snapshot::Initialize(PluginHost::IShell* service)
     {
         string result;
+        Config config;
+
+        config.FromString(service->ConfigLine());
+
+        _streaming = config.Streaming.Value();
+        _compression = std::max(std::min(config.Compression.Value(), static_cast<int8_t>(9)), static_cast<int8_t>(-1));
+
+        const string& filter(config.Filter.Value());
+        if (filter == _T("none")) {
+            _filters = PNG_FILTER_NONE;
+        } else if (filter == _T("sub")) {
+            _filters = PNG_FILTER_SUB;
+        } else if (filter == _T("up")) {
+            _filters = PNG_FILTER_UP;
+        } else if (filter == _T("average")) {
+            _filters = PNG_FILTER_AVG;
+        } else if (filter == _T("paeth")) {
+            _filters = PNG_FILTER_PAETH;
+        } else if (filter == _T("all")) {
+            _filters = PNG_ALL_FILTERS;
+        } else {
+            // Leave it up to libpng.
+            _filters = 0;
+        }
 
         // Capture PNG file name
         ASSERT(service->PersistentPath() != _T(""));
@@ -217,10 +367,22 @@ namespace Plugin {
 
         ASSERT(_device != nullptr);
 
+        _adminLock.Lock();
+
+        if (_stream != nullptr) {
+            delete _stream;
+            _stream = nullptr;
+        }
+
+        _adminLock.Unlock();
+
         if (_device != nullptr) {
             _device->Release();
             _device = nullptr;
         }
+
+        _row.clear();
+        _row.shrink_to_fit();
     }
 
     /* virtual */ string Snapshot::Information() const
@@ -259,12 +421,16 @@ namespace Plugin {
                 response->ErrorCode = Web::STATUS_OK;
             } else if ((index.Current() == "Capture")) {
 
-                StoreImpl file(_inProgress, _fileName);
+                StoreImpl file(_inProgress, _fileName, _streaming, _compression, _filters, _row);
 
                 // _inProgress event is signalled, capture screen
                 if (file.IsValid() == true) {
 
-                    if (_device->Capture(file)) {
+                    _deviceLock.Lock();
+                    const bool captured = _device->Capture(file);
+                    _deviceLock.Unlock();
+
+                    if (captured == true) {
 
                         // Attach to response.
                         response->ContentType = Web::MIMETypes::MIME_IMAGE_PNG;
@@ -279,7 +445,95 @@ namespace Plugin {
                     response->Message = _T("Plugin is already in progress");
                     response->ErrorCode = Web::STATUS_PRECONDITION_FAILED;
                 }
+            } else if (index.Current() == _T("Stream")) {
+                Core::ProxyType<Web::JSONBodyType<Data>> data(jsonBodyDataFactory.Element());
+
+                _adminLock.Lock();
+                if (_stream != nullptr) {
+                    _stream->Status(*data);
+                }
+                _adminLock.Unlock();
+
+                response->ContentType = Web::MIMETypes::MIME_JSON;
+                response->Body(data);
+                response->Message = _T("Stream status");
+                response->ErrorCode = Web::STATUS_OK;
+            } else if (index.Current() == _T("Frame")) {
+                Core::URL::KeyValue options(request.Query.Value());
+                const uint32_t since = options.Number<uint32_t>(_T("since"), 0);
+                string header;
+                std::vector<uint8_t> strip;
+                uint32_t sequence = 0;
+
+                _adminLock.Lock();
+
+                const bool running = (_stream != nullptr);
+                if (running == true) {
+                    sequence = _stream->Frame(since, header, strip);
+                }
+
+                _adminLock.Unlock();
+
+                if (running == false) {
+                    response->Message = _T("No stream is running");
+                    response->ErrorCode = Web::STATUS_PRECONDITION_FAILED;
+                } else if ((sequence == since) || (sequence == 0)) {
+                    response->Message = _T("No new frame");
+                    response->ErrorCode = Web::STATUS_NO_CONTENT;
+                } else {
+                    // A binary body: the header of the delta, with the sequence number to pass as "since" next
+                    // time, followed by the strip of changed tiles as a PNG. See FrameTiles for the layout.
+                    Core::ProxyType<Web::TextBody> body(frameBodyFactory.Element());
+                    string image;
+                    std::vector<uint8_t> row;
+                    const unsigned int rows = static_cast<unsigned int>(strip.size() / (FrameTiles::TileSize * FrameTiles::PixelSize));
+
+                    if (PNGEncoder::Encode(strip.data(), FrameTiles::TileSize, rows, nullptr, &image, _compression, _filters, row) == true) {
+                        body->assign(header);
+                        body->append(image);
+
+                        response->ContentType = Web::MIMETypes::MIME_BINARY;
+                        response->Body(body);
+                        response->Message = _T("Frame");
+                        response->ErrorCode = Web::STATUS_OK;
+                    } else {
+                        response->Message = _T("Could not encode the frame");
+                        response->ErrorCode = Web::STATUS_INTERNAL_SERVER_ERROR;
+                    }
+                }
+            }
+        } else if ((request.Verb == Web::Request::HTTP_PUT) && (index.Next() == true) && (index.Current() == _T("Stream"))) {
+            Core::URL::KeyValue options(request.Query.Value());
+            // Parsed wider than it is kept, so an out of range rate is clamped rather than truncated.
+            const uint8_t fps = static_cast<uint8_t>(std::max(std::min(options.Number<uint32_t>(_T("fps"), 5), static_cast<uint32_t>(30)), static_cast<uint32_t>(1)));
+
+            _adminLock.Lock();
+
+            // (Re)start the stream, at the requested rate.
+            if (_stream != nullptr) {
+                delete _stream;
             }
+            _stream = new Stream(*this, fps);
+            _stream->Run();
+
+            _adminLock.Unlock();
+
+            response->Message = _T("Stream started");
+            response->ErrorCode = Web::STATUS_OK;
+        } else if ((request.Verb == Web::Request::HTTP_DELETE) && (index.Next() == true) && (index.Current() == _T("Stream"))) {
+            _adminLock.Lock();
+
+            if (_stream != nullptr) {
+                delete _stream;
+                _stream = nullptr;
+                response->Message = _T("Stream stopped");
+                response->ErrorCode = Web::STATUS_OK;
+            } else {
+                response->Message = _T("No stream is running");
+                response->ErrorCode = Web::STATUS_PRECONDITION_FAILED;
+            }
+
+            _adminLock.Unlock();
         }
 
         return (response);
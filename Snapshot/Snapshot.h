@@ -31,12 +31,86 @@ namespace Plugin {
         Snapshot(const Snapshot&) = delete;
         Snapshot& operator=(const Snapshot&) = delete;
 
+        class Config : public Core::JSON::Container {
+        private:
+            Config(const Config&) = delete;
+            Config& operator=(const Config&) = delete;
+
+        public:
+            Config()
+                : Core::JSON::Container()
+                , Compression(-1)
+                , Filter()
+                , Streaming(false)
+            {
+                Add(_T("compression"), &Compression);
+                Add(_T("filter"), &Filter);
+                Add(_T("streaming"), &Streaming);
+            }
+            ~Config()
+            {
+            }
+
+        public:
+            Core::JSON::DecSInt8 Compression; // zlib level 0..9, -1 is the zlib default
+            Core::JSON::String Filter; // none, sub, up, average, paeth or all
+            Core::JSON::Boolean Streaming; // encode in memory, into the response body, not into a file
+        };
+
+        class Stream;
+
+    public:
+        class Data : public Core::JSON::Container {
+        private:
+            Data(const Data&) = delete;
+            Data& operator=(const Data&) = delete;
+
+        public:
+            Data()
+                : Core::JSON::Container()
+                , Running(false)
+                , FPS(0)
+                , Achieved(0)
+                , Frames(0)
+                , Changed(0)
+                , Skipped(0)
+                , Sequence(0)
+            {
+                Add(_T("running"), &Running);
+                Add(_T("fps"), &FPS);
+                Add(_T("achieved"), &Achieved);
+                Add(_T("frames"), &Frames);
+                Add(_T("changed"), &Changed);
+                Add(_T("skipped"), &Skipped);
+                Add(_T("sequence"), &Sequence);
+            }
+            ~Data()
+            {
+            }
+
+        public:
+            Core::JSON::Boolean Running;
+            Core::JSON::DecUInt8 FPS; // requested frames per second
+            Core::JSON::DecUInt8 Achieved; // frames captured in the last second
+            Core::JSON::DecUInt32 Frames; // frames captured
+            Core::JSON::DecUInt32 Changed; // frames that differ from the previous one
+            Core::JSON::DecUInt32 Skipped; // frames equal to the previous one
+            Core::JSON::DecUInt32 Sequence; // sequence number of the latest frame that changed
+        };
+
     public:
         Snapshot()
-            : _skipURL(0)
+            : _adminLock()
+            , _deviceLock()
+            , _skipURL(0)
             , _device(nullptr)
             , _fileName()
             , _inProgress(false)
+            , _compression(-1)
+            , _filters(0)
+            , _streaming(false)
+            , _row()
+            , _stream(nullptr)
         {
         }
 
@@ -63,10 +137,17 @@ namespace Plugin {
         virtual Core::ProxyType<Web::Response> Process(const Web::Request& request);
 
     private:
+        Core::CriticalSection _adminLock;
+        Core::CriticalSection _deviceLock;
         uint8_t _skipURL;
         Exchange::ICapture* _device;
         string _fileName;
         Core::BinairySemaphore _inProgress;
+        int8_t _compression;
+        int _filters;
+        bool _streaming;
+        std::vector<uint8_t> _row;
+        Stream* _stream;
     };
 
 } // Namespace Plugin.
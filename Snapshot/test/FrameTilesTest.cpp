@@ -0,0 +1,330 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../FrameTiles.h"
+#include "../../helpers/UnitTest.h"
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+// A synthetic capture device draws the frames, the stream takes them in as it does from the real one,
+// and a client applies the deltas onto its own copy, which has to end up equal to what was drawn.
+
+namespace {
+
+    const uint8_t PixelSize = FrameTiles::PixelSize;
+    const uint16_t TileSize = FrameTiles::TileSize;
+
+    // The store a capture device hands its frame to, as ICapture::IStore.
+    struct IStore {
+        virtual ~IStore() {}
+        virtual bool R8_G8_B8_A8(const unsigned char* buffer, const unsigned int width, const unsigned int height) = 0;
+    };
+
+    // Stands in for an ICapture: a frame with a background pattern, that rectangles are drawn on.
+    class SyntheticCapture {
+    public:
+        SyntheticCapture(const uint16_t width, const uint16_t height)
+            : _width(width)
+            , _height(height)
+            , _frame(width * height * PixelSize)
+        {
+            for (uint32_t index = 0; index < _frame.size(); index++) {
+                _frame[index] = static_cast<uint8_t>((index * 31) >> 4);
+            }
+        }
+
+    public:
+        bool Capture(IStore& store)
+        {
+            return (store.R8_G8_B8_A8(_frame.data(), _width, _height));
+        }
+        void Fill(const uint16_t left, const uint16_t top, const uint16_t width, const uint16_t height, const uint8_t value)
+        {
+            for (uint16_t y = top; y < (top + height); y++) {
+                ::memset(&_frame[((y * _width) + left) * PixelSize], value, width * PixelSize);
+            }
+        }
+        const std::vector<uint8_t>& Frame() const
+        {
+            return (_frame);
+        }
+
+    private:
+        uint16_t _width;
+        uint16_t _height;
+        std::vector<uint8_t> _frame;
+    };
+
+    // As the stream does: the device lock is only held for the copy, the compare comes after.
+    class Stream : public IStore {
+    public:
+        bool R8_G8_B8_A8(const unsigned char* buffer, const unsigned int width, const unsigned int height) override
+        {
+            _captured.assign(buffer, buffer + (width * height * PixelSize));
+            _width = static_cast<uint16_t>(width);
+            _height = static_cast<uint16_t>(height);
+            return (true);
+        }
+        bool Next(SyntheticCapture& device)
+        {
+            return ((device.Capture(*this) == true) && (Tiles.Update(_captured.data(), _width, _height) == true));
+        }
+
+    public:
+        FrameTiles Tiles;
+
+    private:
+        std::vector<uint8_t> _captured;
+        uint16_t _width;
+        uint16_t _height;
+    };
+
+    uint16_t Get(const std::string& header, const size_t offset)
+    {
+        return (static_cast<uint16_t>(static_cast<uint8_t>(header[offset]) | (static_cast<uint8_t>(header[offset + 1]) << 8)));
+    }
+
+    struct Tile {
+        uint16_t Left;
+        uint16_t Top;
+    };
+
+    // The client side of a delta: the tiles in it, applied onto the frame it has.
+    class Client {
+    public:
+        Client()
+            : Sequence(0)
+            , Width(0)
+            , Height(0)
+            , Frame()
+        {
+        }
+
+    public:
+        std::vector<Tile> Apply(const std::string& header, const std::vector<uint8_t>& strip)
+        {
+            std::vector<Tile> tiles;
+
+            CHECK(header.size() >= FrameTiles::HeaderSize);
+            CHECK(Get(header, 8) == TileSize);
+
+            const uint16_t count = Get(header, 10);
+
+            CHECK(header.size() == static_cast<size_t>(FrameTiles::HeaderSize + (count * FrameTiles::EntrySize)));
+            CHECK(strip.size() == (count * TileSize * TileSize * PixelSize));
+
+            Sequence = Get(header, 0) | (Get(header, 2) << 16);
+
+            if ((Get(header, 4) != Width) || (Get(header, 6) != Height)) {
+                Width = Get(header, 4);
+                Height = Get(header, 6);
+                Frame.assign(Width * Height * PixelSize, 0);
+            }
+
+            for (uint16_t index = 0; index < count; index++) {
+                const Tile tile = { Get(header, FrameTiles::HeaderSize + (index * FrameTiles::EntrySize)), Get(header, FrameTiles::HeaderSize + (index * FrameTiles::EntrySize) + 2) };
+                const uint32_t columns = std::min(static_cast<uint32_t>(TileSize), static_cast<uint32_t>(Width - tile.Left));
+                const uint32_t rows = std::min(static_cast<uint32_t>(TileSize), static_cast<uint32_t>(Height - tile.Top));
+                const uint8_t* source = &strip[index * TileSize * TileSize * PixelSize];
+
+                CHECK((tile.Left % TileSize) == 0);
+                CHECK((tile.Top % TileSize) == 0);
+
+                for (uint32_t line = 0; line < TileSize; line++) {
+                    if (line < rows) {
+                        ::memcpy(&Frame[(((tile.Top + line) * Width) + tile.Left) * PixelSize], &source[line * TileSize * PixelSize], columns * PixelSize);
+                    }
+
+                    // What is outside the frame, is zero.
+                    for (uint32_t byte = (line < rows ? columns * PixelSize : 0); byte < (TileSize * PixelSize); byte++) {
+                        CHECK(source[(line * TileSize * PixelSize) + byte] == 0);
+                    }
+                }
+
+                tiles.push_back(tile);
+            }
+
+            return (tiles);
+        }
+        // Polls, as GET /Snapshot/Frame?since=<Sequence> does.
+        std::vector<Tile> Poll(const FrameTiles& tiles)
+        {
+            std::string header;
+            std::vector<uint8_t> strip;
+
+            tiles.Delta(Sequence, header, strip);
+
+            return (Apply(header, strip));
+        }
+
+    public:
+        uint32_t Sequence;
+        uint16_t Width;
+        uint16_t Height;
+        std::vector<uint8_t> Frame;
+    };
+
+    bool Has(const std::vector<Tile>& tiles, const uint16_t left, const uint16_t top)
+    {
+        bool result = false;
+
+        for (const Tile& tile : tiles) {
+            result = result || ((tile.Left == left) && (tile.Top == top));
+        }
+
+        return (result);
+    }
+
+    // 100 x 70 is 4 x 3 tiles, with smaller ones at the right and the bottom.
+    void TestFirst()
+    {
+        SyntheticCapture device(100, 70);
+        Stream stream;
+        Client client;
+
+        CHECK(stream.Next(device) == true);
+        CHECK(stream.Tiles.Sequence() == 1);
+
+        const std::vector<Tile> tiles(client.Poll(stream.Tiles));
+
+        CHECK(tiles.size() == 12);
+        CHECK(Has(tiles, 96, 64) == true);
+        CHECK(client.Sequence == 1);
+        CHECK(client.Frame == device.Frame());
+    }
+
+    void TestChanges()
+    {
+        SyntheticCapture device(100, 70);
+        Stream stream;
+        Client client;
+
+        stream.Next(device);
+        client.Poll(stream.Tiles);
+
+        // The same frame again changes nothing.
+        CHECK(stream.Next(device) == false);
+        CHECK(stream.Tiles.Sequence() == 1);
+
+        // Within one tile.
+        device.Fill(40, 40, 5, 5, 0xAA);
+
+        CHECK(stream.Next(device) == true);
+        CHECK(stream.Tiles.Sequence() == 2);
+
+        std::vector<Tile> tiles(client.Poll(stream.Tiles));
+
+        CHECK(tiles.size() == 1);
+        CHECK(Has(tiles, 32, 32) == true);
+        CHECK(client.Sequence == 2);
+        CHECK(client.Frame == device.Frame());
+
+        // Over the edge of four tiles, one of them at the edge of the frame.
+        device.Fill(90, 60, 10, 10, 0x55);
+
+        CHECK(stream.Next(device) == true);
+
+        tiles = client.Poll(stream.Tiles);
+
+        CHECK(tiles.size() == 4);
+        CHECK(Has(tiles, 64, 32) == true);
+        CHECK(Has(tiles, 96, 32) == true);
+        CHECK(Has(tiles, 64, 64) == true);
+        CHECK(Has(tiles, 96, 64) == true);
+        CHECK(client.Frame == device.Frame());
+    }
+
+    // A client that missed frames gets the tiles of all of them, from the latest frame, once.
+    void TestMissed()
+    {
+        SyntheticCapture device(100, 70);
+        Stream stream;
+        Client client;
+        Client late;
+
+        stream.Next(device);
+        client.Poll(stream.Tiles);
+        late.Poll(stream.Tiles);
+
+        device.Fill(0, 0, 4, 4, 0x11);
+        stream.Next(device);
+        client.Poll(stream.Tiles);
+
+        device.Fill(70, 10, 4, 4, 0x22);
+        stream.Next(device);
+
+        device.Fill(1, 1, 2, 2, 0x33);
+        stream.Next(device);
+
+        CHECK(stream.Tiles.Sequence() == 4);
+
+        std::vector<Tile> tiles(late.Poll(stream.Tiles));
+
+        CHECK(tiles.size() == 2);
+        CHECK(Has(tiles, 0, 0) == true);
+        CHECK(Has(tiles, 64, 0) == true);
+        CHECK(late.Frame == device.Frame());
+
+        tiles = client.Poll(stream.Tiles);
+
+        CHECK(tiles.size() == 2);
+        CHECK(client.Frame == device.Frame());
+
+        // Up to date, nothing to send.
+        tiles = client.Poll(stream.Tiles);
+
+        CHECK(tiles.size() == 0);
+    }
+
+    // A sequence number that is not of this stream, or a frame of another size, gets all tiles.
+    void TestUnknown()
+    {
+        SyntheticCapture device(100, 70);
+        SyntheticCapture larger(130, 70);
+        Stream stream;
+        Client client;
+
+        stream.Next(device);
+        client.Poll(stream.Tiles);
+
+        Client restarted;
+        restarted.Sequence = 1000;
+
+        CHECK(restarted.Poll(stream.Tiles).size() == 12);
+        CHECK(restarted.Sequence == 1);
+        CHECK(restarted.Frame == device.Frame());
+
+        CHECK(stream.Next(larger) == true);
+
+        CHECK(client.Poll(stream.Tiles).size() == 15);
+        CHECK(client.Width == 130);
+        CHECK(client.Frame == larger.Frame());
+    }
+}
+
+int main()
+{
+    TestFirst();
+    TestChanges();
+    TestMissed();
+    TestUnknown();
+
+    return (UnitTest::Result());
+}
@@ -0,0 +1,181 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../PNGEncoder.h"
+#include "../../helpers/UnitTest.h"
+
+#include <chrono>
+#include <cstdlib>
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+// Captures of 720p, 1080p and 4K, swizzled and encoded. Next to the encoder as it is, the way the store
+// used to do it: a row allocated and converted with a scalar loop for every scanline, the whole frame
+// at once, and written with png_write_png.
+
+namespace {
+
+    struct Resolution {
+        const char* Name;
+        unsigned int Width;
+        unsigned int Height;
+        uint32_t Rounds;
+    };
+
+    const Resolution Resolutions[] = {
+        { "720p", 1280, 720, 8 },
+        { "1080p", 1920, 1080, 4 },
+        { "4K", 3840, 2160, 2 }
+    };
+
+    // Something like a user interface: flat panels and gradients, with a bit of noise on top.
+    std::vector<uint8_t> Frame(const unsigned int width, const unsigned int height)
+    {
+        std::vector<uint8_t> result(width * height * 4);
+        uint8_t* pixel = result.data();
+
+        for (unsigned int y = 0; y < height; y++) {
+            for (unsigned int x = 0; x < width; x++) {
+                const bool panel = (((x / 160) + (y / 90)) % 3) == 0;
+
+                pixel[0] = static_cast<uint8_t>(panel == true ? 0x30 : (x * 255) / width);
+                pixel[1] = static_cast<uint8_t>(panel == true ? 0x30 : (y * 255) / height);
+                pixel[2] = static_cast<uint8_t>((panel == true ? 0x40 : 0x80) + (::rand() % 4));
+                pixel[3] = 0xFF;
+                pixel += 4;
+            }
+        }
+        return (result);
+    }
+
+    void Scalar(const uint8_t source[], uint8_t destination[], unsigned int pixels)
+    {
+        while (pixels-- != 0) {
+            *destination++ = source[2];
+            *destination++ = source[1];
+            *destination++ = source[0];
+            source += 4;
+        }
+    }
+
+    void Write(png_structp pngPointer, png_bytep data, png_size_t length)
+    {
+        static_cast<std::string*>(png_get_io_ptr(pngPointer))->append(reinterpret_cast<const char*>(data), length);
+    }
+    void Flush(png_structp)
+    {
+    }
+
+    // As the store did it, into memory rather than a file, so only the encoding is compared.
+    bool Legacy(const uint8_t buffer[], const unsigned int width, const unsigned int height, std::string& image)
+    {
+        bool result = false;
+        png_structp pngPointer = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+        png_infop infoPointer = png_create_info_struct(pngPointer);
+
+        if (setjmp(png_jmpbuf(pngPointer)) == 0) {
+            image.clear();
+            png_set_write_fn(pngPointer, &image, Write, Flush);
+            png_set_IHDR(pngPointer, infoPointer, width, height, 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+
+            png_byte** rowLines = static_cast<png_byte**>(png_malloc(pngPointer, height * sizeof(png_byte*)));
+            for (unsigned int i = 0; i < height; ++i) {
+                rowLines[i] = static_cast<png_byte*>(png_malloc(pngPointer, width * 4));
+                Scalar(buffer + (i * width * 4), rowLines[i], width);
+            }
+
+            png_set_rows(pngPointer, infoPointer, rowLines);
+            png_write_png(pngPointer, infoPointer, PNG_TRANSFORM_IDENTITY, nullptr);
+
+            for (unsigned int i = 0; i < height; i++) {
+                png_free(pngPointer, rowLines[i]);
+            }
+            png_free(pngPointer, rowLines);
+
+            result = true;
+        }
+
+        png_destroy_write_struct(&pngPointer, &infoPointer);
+
+        return (result);
+    }
+
+    template <typename ACTION>
+    double Milliseconds(const uint32_t rounds, ACTION&& action)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        for (uint32_t round = 0; round < rounds; round++) {
+            action();
+        }
+
+        return ((std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000) / rounds);
+    }
+
+    void Benchmark(const Resolution& resolution)
+    {
+        const unsigned int width = resolution.Width;
+        const unsigned int height = resolution.Height;
+        const std::vector<uint8_t> frame(Frame(width, height));
+        std::vector<uint8_t> converted(width * height * 3);
+        std::vector<uint8_t> row;
+        std::string image;
+        std::string legacy;
+        size_t fast = 0;
+
+        const double scalar = Milliseconds(resolution.Rounds * 4, [&]() {
+            for (unsigned int y = 0; y < height; y++) {
+                Scalar(&(frame[y * width * 4]), &(converted[y * width * 3]), width);
+            }
+        });
+        const double swizzle = Milliseconds(resolution.Rounds * 4, [&]() {
+            for (unsigned int y = 0; y < height; y++) {
+                PNGEncoder::Swizzle(&(frame[y * width * 4]), &(converted[y * width * 3]), width);
+            }
+        });
+        const double before = Milliseconds(resolution.Rounds, [&]() {
+            CHECK(Legacy(frame.data(), width, height, legacy) == true);
+        });
+        const double fastest = Milliseconds(resolution.Rounds, [&]() {
+            CHECK(PNGEncoder::Encode(frame.data(), width, height, nullptr, &image, 1, PNG_FILTER_SUB, row) == true);
+            fast = image.size();
+        });
+        const double now = Milliseconds(resolution.Rounds, [&]() {
+            CHECK(PNGEncoder::Encode(frame.data(), width, height, nullptr, &image, -1, 0, row) == true);
+        });
+
+        // With the same settings, the same image.
+        CHECK(image == legacy);
+
+        printf("%-6s swizzle: scalar %6.2f ms, vector %6.2f ms | encode: before %7.1f ms, now %7.1f ms (%zu bytes), level 1/sub %7.1f ms (%zu bytes)\n",
+            resolution.Name, scalar, swizzle, before, now, image.size(), fastest, fast);
+    }
+}
+
+int main()
+{
+    ::srand(3);
+
+    for (const Resolution& resolution : Resolutions) {
+        Benchmark(resolution);
+    }
+
+    return (UnitTest::Result());
+}
@@ -0,0 +1,158 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../PNGEncoder.h"
+#include "../../helpers/UnitTest.h"
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+namespace {
+
+    std::vector<uint8_t> Frame(const unsigned int width, const unsigned int height)
+    {
+        std::vector<uint8_t> result(width * height * 4);
+
+        for (uint8_t& value : result) {
+            value = static_cast<uint8_t>(::rand());
+        }
+        return (result);
+    }
+
+    std::vector<uint8_t> Reference(const std::vector<uint8_t>& frame)
+    {
+        std::vector<uint8_t> result;
+
+        for (size_t index = 0; index < frame.size(); index += 4) {
+            result.push_back(frame[index + 2]);
+            result.push_back(frame[index + 1]);
+            result.push_back(frame[index + 0]);
+        }
+        return (result);
+    }
+
+    // What a client gets to see: the PNG decoded as RGB.
+    std::vector<uint8_t> Decode(const std::string& image, unsigned int& width, unsigned int& height)
+    {
+        std::vector<uint8_t> result;
+        png_image decoded;
+
+        ::memset(&decoded, 0, sizeof(decoded));
+        decoded.version = PNG_IMAGE_VERSION;
+
+        if (png_image_begin_read_from_memory(&decoded, image.data(), image.size()) != 0) {
+            decoded.format = PNG_FORMAT_RGB;
+            result.resize(PNG_IMAGE_SIZE(decoded));
+
+            if (png_image_finish_read(&decoded, nullptr, result.data(), 0, nullptr) == 0) {
+                result.clear();
+            }
+        }
+
+        width = decoded.width;
+        height = decoded.height;
+
+        png_image_free(&decoded);
+
+        return (result);
+    }
+
+    // Every width, so the vector loops and the scalar loop after it all get their turn. The row is
+    // exactly as large as the pixels need, the vector stores must stay within it.
+    void TestSwizzle()
+    {
+        for (unsigned int width = 0; width <= 100; width++) {
+            const std::vector<uint8_t> frame(Frame(width, 1));
+            std::vector<uint8_t> row(width * 3);
+
+            PNGEncoder::Swizzle(frame.data(), row.data(), width);
+
+            CHECK(row == Reference(frame));
+        }
+    }
+
+    void TestRoundTrip()
+    {
+        struct {
+            int8_t compression;
+            int filters;
+        } const settings[] = { { -1, 0 }, { 0, PNG_FILTER_NONE }, { 1, PNG_FILTER_SUB }, { 9, PNG_ALL_FILTERS } };
+
+        std::vector<uint8_t> row;
+
+        // Odd sizes, and a wider frame after a narrow one, through the same row buffer.
+        for (const unsigned int width : { 97u, 3u, 1921u }) {
+            const std::vector<uint8_t> frame(Frame(width, 33));
+
+            for (const auto& setting : settings) {
+                std::string image;
+                unsigned int decodedWidth = 0;
+                unsigned int decodedHeight = 0;
+
+                CHECK(PNGEncoder::Encode(frame.data(), width, 33, nullptr, &image, setting.compression, setting.filters, row) == true);
+                CHECK(Decode(image, decodedWidth, decodedHeight) == Reference(frame));
+                CHECK((decodedWidth == width) && (decodedHeight == 33));
+            }
+        }
+    }
+
+    // In a file or in memory, it is the same image, byte for byte.
+    void TestFile()
+    {
+        const std::vector<uint8_t> frame(Frame(640, 48));
+        std::vector<uint8_t> row;
+        std::string image;
+        std::string stored;
+        FILE* file = ::tmpfile();
+
+        CHECK(file != nullptr);
+
+        if (file != nullptr) {
+            char buffer[4096];
+            size_t length;
+
+            CHECK(PNGEncoder::Encode(frame.data(), 640, 48, file, nullptr, 6, 0, row) == true);
+            CHECK(PNGEncoder::Encode(frame.data(), 640, 48, nullptr, &image, 6, 0, row) == true);
+
+            ::fflush(file);
+            ::rewind(file);
+            while ((length = ::fread(buffer, 1, sizeof(buffer), file)) != 0) {
+                stored.append(buffer, length);
+            }
+            ::fclose(file);
+
+            CHECK(stored.empty() == false);
+            CHECK(stored == image);
+        }
+    }
+}
+
+int main()
+{
+    ::srand(17);
+
+    TestSwizzle();
+    TestRoundTrip();
+    TestFile();
+
+    return (UnitTest::Result());
+}
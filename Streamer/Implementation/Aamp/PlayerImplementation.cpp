@@ -20,7 +20,7 @@
 #include "Administrator.h"
 #include <gst/gst.h>
 #include <main_aamp.h>
-#include <thread>
+#include <memory>
 #include <vector>
 
 #define AAMP_IDLE_LOOP_PROGRESS /* otherwise use AAMP supplied progress event */
@@ -40,19 +40,21 @@ namespace Implementation {
                 : Core::JSON::Container()
                 , Speeds()
                 , WesterosSink(false)
+                , ProgressInterval(1000)
             {
                 Add(_T("speeds"), &Speeds);
                 Add(_T("westerossink"), &WesterosSink);
+                Add(_T("progressinterval"), &ProgressInterval);
             }
 
             Core::JSON::ArrayType<Core::JSON::DecSInt32> Speeds;
             Core::JSON::Boolean WesterosSink;
+            Core::JSON::DecUInt32 ProgressInterval; // ms
         } config;
 
         class Aamp : public IPlayerPlatform, Core::Thread {
         private:
             typedef struct _GMainLoop GMainLoop;
-            static constexpr uint32_t TimeToGetPlaybackPosition = 1;
 
             class AampEventListener : public AAMPEventListener {
             public:
@@ -202,40 +204,173 @@ namespace Implementation {
             };
 
 #if defined(AAMP_IDLE_LOOP_PROGRESS)
-            class Scheduler: public Core::Thread
-            {
-            public:
-                Scheduler() = delete;
-                Scheduler(const Scheduler&) = delete;
-                Scheduler& operator=(const Scheduler&) = delete;
+            // The playback position of all playing players is reported from one shared timer, on one
+            // tick, rather than from a polling thread per player. The timer only runs if a player plays.
+            // The players share ownership, the timer thread is gone with the last player.
+            class Progress {
+            private:
+                class Handler {
+                public:
+                    Handler(Progress& parent)
+                        : _parent(&parent)
+                    {
+                    }
+                    Handler(const Handler& copy)
+                        : _parent(copy._parent)
+                    {
+                    }
+                    ~Handler()
+                    {
+                    }
 
-                Scheduler(Aamp* player)
-                : _parent(player)
+                    Handler& operator=(const Handler& RHS)
+                    {
+                        _parent = RHS._parent;
+                        return (*this);
+                    }
+
+                public:
+                    uint64_t Timed(const uint64_t scheduledTime)
+                    {
+                        ASSERT(_parent != nullptr);
+                        return (_parent->Timed(scheduledTime));
+                    }
+
+                private:
+                    Progress* _parent;
+                };
+
+            public:
+                Progress(const Progress&) = delete;
+                Progress& operator=(const Progress&) = delete;
+
+                Progress()
+                    : _adminLock()
+                    , _players()
+                    , _timer(Core::Thread::DefaultStackSize(), _T("AampProgress"))
+                    , _idle(true, false)
+                    , _reporter(0)
+                    , _reports(0)
+                    , _reporting(false)
+                    , _scheduled(false)
                 {
                 }
+                ~Progress()
+                {
+                    ASSERT(_players.empty() == true);
+                }
 
-                ~Scheduler() override
+                static std::shared_ptr<Progress> Instance()
                 {
+                    static Core::CriticalSection lock;
+                    static std::weak_ptr<Progress> instance;
+
+                    lock.Lock();
+
+                    std::shared_ptr<Progress> result(instance.lock());
+                    if (result == nullptr) {
+                        result = std::make_shared<Progress>();
+                        instance = result;
+                    }
+
+                    lock.Unlock();
+
+                    return (result);
                 }
 
-                void Quit()
+            public:
+                // Do not call these with the lock of the player taken, the lock order is progress first.
+                void Register(Aamp* player)
                 {
-                    Block();
-                    Wait(Thread::STOPPED | Thread::BLOCKED, Core::infinite);
+                    _adminLock.Lock();
+
+                    if (std::find(_players.begin(), _players.end(), player) == _players.end()) {
+                        _players.push_back(player);
+                    }
+
+                    if (_scheduled == false) {
+                        _scheduled = true;
+                        _timer.Schedule(Next(Core::Time::Now().Ticks()), Handler(*this));
+                    }
+
+                    _adminLock.Unlock();
+                }
+                // Once this returns, the player is not reported on anymore.
+                void Unregister(Aamp* player)
+                {
+                    _adminLock.Lock();
+
+                    std::vector<Aamp*>::iterator index(std::find(_players.begin(), _players.end(), player));
+                    if (index != _players.end()) {
+                        _players.erase(index);
+                    }
+
+                    // A report that is on its way might still be on this player, let it finish. Unless
+                    // the report is what got us here. A next report does not have the player anymore,
+                    // so once the count of reports moved on, it is done.
+                    if (_reporter != Core::Thread::ThreadId()) {
+                        const uint32_t report = _reports;
+
+                        while ((_reporting == true) && (_reports == report)) {
+                            _adminLock.Unlock();
+                            _idle.Lock(Core::infinite);
+                            _adminLock.Lock();
+                        }
+                    }
+
+                    _adminLock.Unlock();
                 }
 
             private:
-                uint32_t Worker() override
+                uint64_t Next(const uint64_t from) const
+                {
+                    const uint32_t interval = std::max(config.ProgressInterval.Value(), static_cast<uint32_t>(100));
+                    return (Core::Time(from).Add(interval).Ticks());
+                }
+                uint64_t Timed(const uint64_t scheduledTime)
                 {
-                    if (IsRunning() == true) {
-                        std::this_thread::sleep_for(std::chrono::seconds(TimeToGetPlaybackPosition));
-                        _parent->TimeUpdate();
+                    uint64_t result = 0;
+
+                    // The players report to their callbacks, possibly out of process, so that is not
+                    // done with the lock taken.
+                    _adminLock.Lock();
+                    std::vector<Aamp*> players(_players);
+                    _reporter = Core::Thread::ThreadId();
+                    _reporting = true;
+                    _idle.ResetEvent();
+                    _adminLock.Unlock();
+
+                    for (Aamp* player : players) {
+                        player->TimeUpdate();
+                    }
+
+                    _adminLock.Lock();
+
+                    _reporting = false;
+                    _reports++;
+                    _idle.SetEvent();
+
+                    _scheduled = (_players.empty() == false);
+
+                    if (_scheduled == true) {
+                        // Keep the cadence, also if reporting took a while.
+                        result = Next(scheduledTime);
                     }
-                    return (Core::infinite);
+
+                    _adminLock.Unlock();
+
+                    return (result);
                 }
 
             private:
-                Aamp* _parent;
+                Core::CriticalSection _adminLock;
+                std::vector<Aamp*> _players;
+                Core::TimerType<Handler> _timer;
+                Core::Event _idle; // manual reset, releases every Unregister waiting on the report
+                ::ThreadId _reporter;
+                uint32_t _reports;
+                bool _reporting;
+                bool _scheduled;
             };
 #endif /* AAMP_IDLE_LOOP_PROGRESS */
 
@@ -261,8 +396,9 @@ namespace Implementation {
                 , _aampPlayer(nullptr)
                 , _aampEventListener(nullptr)
                 , _aampGstPlayerMainLoop(nullptr)
+                , _reported(~0)
 #if defined(AAMP_IDLE_LOOP_PROGRESS)
-                , _scheduler(this)
+                , _progress(Progress::Instance())
 #endif
                 , _adminLock()
             {
@@ -293,7 +429,7 @@ namespace Implementation {
                 ASSERT(_aampEventListener == nullptr);
 
 #if defined(AAMP_IDLE_LOOP_PROGRESS)
-                _scheduler.Quit();
+                _progress->Unregister(this);
 #endif
                 _speeds.clear();
             }
@@ -444,6 +580,7 @@ namespace Implementation {
                         if ((uriType == "m3u8") || (uriType == "mpd")) {
                             TRACE(Trace::Information, (_T("URI type is %s"), uriType.c_str()));
                             _speed = -1;
+                            _reported = ~0;
                             _drmType = Exchange::IStream::drmtype::Unknown;
                             _uri = uri;
                             _error = Core::ERROR_NONE;
@@ -476,6 +613,8 @@ namespace Implementation {
             {
                 TRACE(Trace::Information, (_T("speed = %d"), speed));
                 uint32_t result = Core::ERROR_NONE;
+                bool start = false;
+                bool stop = false;
 
                 _adminLock.Lock();
                 if (speed != _speed) {
@@ -484,22 +623,26 @@ namespace Implementation {
                     if (rate != 0) {
                         auto index =  std::find(_speeds.begin(), _speeds.end(), speed);
                         if (index != _speeds.end()) {
-#if defined(AAMP_IDLE_LOOP_PROGRESS)
-                            _scheduler.Run();
-#endif
+                            start = true;
                         } else {
                             result = Core::ERROR_BAD_REQUEST;
                         }
                     } else {
-#if defined(AAMP_IDLE_LOOP_PROGRESS)
-                        _scheduler.Block();
-#endif
+                        stop = true;
                     }
 
                     _aampPlayer->SetRate(rate);
                 }
 
                 _adminLock.Unlock();
+
+#if defined(AAMP_IDLE_LOOP_PROGRESS)
+                if (start == true) {
+                    _progress->Register(this);
+                } else if (stop == true) {
+                    _progress->Unregister(this);
+                }
+#endif
                 return result;
             }
 
@@ -586,7 +729,11 @@ namespace Implementation {
                     if (position == 0) {
                         position = 1000ULL *_aampPlayer->GetPlaybackPosition();
                     }
-                    _callback->TimeUpdate(position);
+                    // Nothing moved since the last report (stalled, buffering), do not bother the frontend.
+                    if (position != _reported) {
+                        _reported = position;
+                        _callback->TimeUpdate(position);
+                    }
                 }
                 _adminLock.Unlock();
             }
@@ -665,7 +812,7 @@ namespace Implementation {
                     _adminLock.Unlock();
 
 #if defined(AAMP_IDLE_LOOP_PROGRESS)
-                    _scheduler.Block();
+                    _progress->Unregister(this);
 #endif
                     _aampPlayer->Stop();
                     Block();
@@ -747,10 +894,11 @@ namespace Implementation {
             PlayerInstanceAAMP* _aampPlayer;
             AampEventListener *_aampEventListener;
             GMainLoop *_aampGstPlayerMainLoop;
-
+            uint64_t _reported;
 #if defined(AAMP_IDLE_LOOP_PROGRESS)
-            Scheduler _scheduler;
+            std::shared_ptr<Progress> _progress;
 #endif
+
             mutable Core::CriticalSection _adminLock;
         }; // class Aamp
 
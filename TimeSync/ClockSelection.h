@@ -0,0 +1,209 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // The clock filter and selection of RFC 5905, over a burst of samples from every server: per server
+    // the sample with the lowest delay is used, and only servers whose correctness intervals intersect
+    // with those of the majority survive. No framework dependencies, it is checked on its own.
+    class ClockSelection {
+    public:
+        static constexpr uint8_t Burst = 4;
+        static constexpr double Frequency = 15e-6; // PHI, frequency tolerance in s/s
+        static constexpr double MaxDistance = 1.5; // s, servers further away are not selectable
+        static constexpr double LocalPrecision = 1.0 / 64; // s, as announced in our requests
+
+        struct Sample {
+            double Offset; // s
+            double Delay; // s
+            double Dispersion; // s
+            uint64_t Time; // us, when it was received
+        };
+
+        // The samples of one server, and the outcome of the filter and the selection.
+        struct Source {
+            Source()
+                : Count(0)
+                , Samples()
+                , Precision(0)
+                , RootDelay(0)
+                , RootDispersion(0)
+                , Offset(0)
+                , Delay(0)
+                , Dispersion(0)
+                , Jitter(0)
+                , Distance(0)
+                , Survivor(false)
+            {
+            }
+
+            uint8_t Count;
+            Sample Samples[Burst];
+            double Precision; // s, of the server
+            double RootDelay; // s
+            double RootDispersion; // s
+
+            // Result of the clock filter
+            double Offset;
+            double Delay;
+            double Dispersion;
+            double Jitter;
+            double Distance; // root distance, lambda
+            bool Survivor;
+        };
+
+    public:
+        ClockSelection() = delete;
+        ClockSelection(const ClockSelection&) = delete;
+        ClockSelection& operator=(const ClockSelection&) = delete;
+
+        // Picks the sample with the lowest delay, and works out the dispersion, jitter and root distance
+        // of the source from all of its samples.
+        static void Filter(Source& source, const uint64_t now)
+        {
+            std::sort(source.Samples, source.Samples + source.Count, [](const Sample& lhs, const Sample& rhs) { return (lhs.Delay < rhs.Delay); });
+
+            double jitter = 0;
+
+            source.Offset = source.Samples[0].Offset;
+            source.Delay = source.Samples[0].Delay;
+            source.Dispersion = 0;
+
+            for (uint8_t index = 0; index < source.Count; index++) {
+                const Sample& sample(source.Samples[index]);
+                const double difference = sample.Offset - source.Offset;
+
+                source.Dispersion += (sample.Dispersion + ((Frequency * (now - sample.Time)) / 1000000)) / (2 << index);
+                jitter += difference * difference;
+            }
+
+            jitter = (source.Count > 1 ? std::sqrt(jitter / (source.Count - 1)) : 0);
+
+            source.Jitter = (jitter > LocalPrecision ? jitter : static_cast<double>(LocalPrecision));
+            source.Distance = ((source.RootDelay + source.Delay) / 2) + source.RootDispersion + source.Dispersion + source.Jitter;
+        }
+        // True once more than half of the sources have a sample. That is enough to select the time from,
+        // the rest of the burst refines it.
+        static bool Majority(const std::vector<Source*>& sources)
+        {
+            const size_t answered = std::count_if(sources.begin(), sources.end(), [](const Source* source) { return (source->Count > 0); });
+
+            return ((2 * answered) > sources.size());
+        }
+        // The largest group of sources whose correctness intervals, the offset plus and minus the root
+        // distance, share a common intersection are the truechimers. The offset is the average of theirs,
+        // weighed by their root distance. Returns the closest survivor, or nullptr if there is no majority.
+        static const Source* Select(const std::vector<Source*>& sources, const uint64_t now, double& offset)
+        {
+            std::vector<std::pair<double, int8_t>> edges;
+            std::vector<Source*> candidates;
+
+            for (Source* source : sources) {
+                source->Survivor = false;
+
+                if (source->Count > 0) {
+                    Filter(*source, now);
+
+                    if (source->Distance < MaxDistance) {
+                        candidates.push_back(source);
+                        edges.emplace_back(source->Offset - source->Distance, -1);
+                        edges.emplace_back(source->Offset, 0);
+                        edges.emplace_back(source->Offset + source->Distance, +1);
+                    }
+                }
+            }
+
+            std::sort(edges.begin(), edges.end());
+
+            const int32_t count = static_cast<int32_t>(candidates.size());
+            double low = 0;
+            double high = 0;
+            bool found = false;
+
+            // Allow for ever more falsetickers, as long as they are a minority.
+            for (int32_t allow = 0; ((2 * allow) < count) && (found == false); allow++) {
+                int32_t chime = 0;
+                int32_t midpoints = 0;
+
+                low = std::numeric_limits<double>::max();
+                high = -std::numeric_limits<double>::max();
+
+                for (std::vector<std::pair<double, int8_t>>::const_iterator index = edges.begin(); index != edges.end(); index++) {
+                    chime -= index->second;
+                    if (chime >= (count - allow)) {
+                        low = index->first;
+                        break;
+                    }
+                    if (index->second == 0) {
+                        midpoints++;
+                    }
+                }
+
+                chime = 0;
+                for (std::vector<std::pair<double, int8_t>>::const_reverse_iterator index = edges.rbegin(); index != edges.rend(); index++) {
+                    chime += index->second;
+                    if (chime >= (count - allow)) {
+                        high = index->first;
+                        break;
+                    }
+                    if (index->second == 0) {
+                        midpoints++;
+                    }
+                }
+
+                found = ((midpoints <= allow) && (low < high));
+            }
+
+            const Source* system = nullptr;
+
+            if (found == true) {
+                double offsets = 0;
+                double weights = 0;
+
+                for (Source* source : candidates) {
+                    if (((source->Offset + source->Distance) >= low) && ((source->Offset - source->Distance) <= high)) {
+                        source->Survivor = true;
+                        offsets += source->Offset / source->Distance;
+                        weights += 1 / source->Distance;
+
+                        if ((system == nullptr) || (source->Distance < system->Distance)) {
+                            system = source;
+                        }
+                    }
+                }
+
+                offset = offsets / weights;
+            }
+
+            return (system);
+        }
+    };
+
+} // namespace Plugin
+} // namespace WPEFramework
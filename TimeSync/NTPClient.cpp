@@ -18,6 +18,8 @@
  */
 
 #include "NTPClient.h"
+#include <cmath>
+#include <limits>
 #include <stdio.h>
 
 namespace WPEFramework {
@@ -34,9 +36,23 @@ namespace Plugin {
         , _packet()
         , _syncedTimestamp()
         , _state(INITIAL)
-        , _fired(true)
         , _WaitForNetwork(2000) // Wait for 2 Seconds for a new attempt
         , _retryAttempts(5)
+        , _currentAttempt(0)
+        , _servers()
+        , _peers()
+        , _round(0)
+        , _due(0)
+        , _synced(false)
+        , _lastSent(0)
+        , _source()
+        , _offset(0)
+        , _firstRequest(0)
+        , _started(0)
+        , _firstSync(0)
+        , _firstReply(Core::infinite)
+        , _duration(0)
+        , _attempts(0)
         , _activity(Core::ProxyType<Activity>::Create(this))
         , _clients()
     {
@@ -85,8 +101,6 @@ namespace Plugin {
                 _servers.push_back(hostname);
             }
         }
-
-        _serverIndex = ServerIterator(_servers);
     }
 
     /* virtual */ uint32_t NTPClient::Synchronize()
@@ -97,9 +111,15 @@ namespace Plugin {
 
         _adminLock.Lock();
 
-        if ((_state == INITIAL) || (_state == SUCCESS) || ((_state == FAILED) && (_serverIndex.IsValid() == false))) {
+        if ((_state == INITIAL) || (_state == SUCCESS) || (_state == FAILED)) {
             result = Core::ERROR_NONE;
             _state = SENDREQUEST;
+            _started = Core::Time::Now().Ticks();
+
+            if ((_firstSync == 0) && (_firstRequest == 0)) {
+                _firstRequest = _started;
+            }
+
             Core::IWorkerPool::Instance().Submit(_activity);
         } else if (_state == SENDREQUEST || _state == INPROGRESS) {
             result = Core::ERROR_INPROGRESS;
@@ -136,7 +156,43 @@ namespace Plugin {
 
     /* virtual */ string NTPClient::Source() const
     {
-        return (_serverIndex.IsValid() == true ? string(_T("NTP://")) + (*_serverIndex) + '/' : _T("NTP:///"));
+        _adminLock.Lock();
+        string result(_source.empty() == false ? string(_T("NTP://")) + _source + '/' : _T("NTP:///"));
+        _adminLock.Unlock();
+
+        return (result);
+    }
+
+    void NTPClient::Metrics(Statistics& info) const
+    {
+        _adminLock.Lock();
+
+        info.Source = _source;
+        info.Offset = static_cast<int64_t>(_offset * MicroSeconds);
+        info.FirstSync = _firstSync;
+        info.Duration = _duration;
+        info.Attempts = _attempts;
+
+        if (_firstReply != Core::infinite) {
+            info.FirstReply = _firstReply;
+        }
+
+        for (const Peer& peer : _peers) {
+            Statistics::Server& server(info.Servers.Add());
+
+            server.Source = peer.Name;
+            server.Samples = peer.Count;
+
+            if (peer.Count > 0) {
+                server.Offset = static_cast<int64_t>(peer.Offset * MicroSeconds);
+                server.Delay = static_cast<uint32_t>(peer.Delay * MicroSeconds);
+                server.Jitter = static_cast<uint32_t>(peer.Jitter * MicroSeconds);
+                server.Distance = static_cast<uint32_t>(peer.Distance * MicroSeconds);
+                server.Survivor = peer.Survivor;
+            }
+        }
+
+        _adminLock.Unlock();
     }
 
     /* virtual */ void NTPClient::Register(Exchange::ITimeSync::INotification* notification)
@@ -174,17 +230,38 @@ namespace Plugin {
 
         _adminLock.Lock();
 
-        if (_fired == false) {
+        std::vector<Peer>::iterator index(_peers.begin());
 
-            _fired = true;
+        while ((index != _peers.end()) && (index->Pending == false)) {
+            index++;
+        }
+
+        if (index != _peers.end()) {
+            const uint64_t now = Core::Time::Now().Ticks();
+
+            // The transmit time of every request is unique, the server echoes it, so it identifies the reply.
+            _lastSent = (now > _lastSent ? now : _lastSent + 1);
+
+            index->Pending = false;
+            index->Sent = _lastSent;
+
+            // The frame goes out to the remote node after we return.
+            RemoteNode(index->Node);
 
             DataFrame newFrame(dataFrame, maxSendSize);
             DataFrame::Writer writer(newFrame, 0);
-            _packet.TransmitTimestamp(NTPPacket::Timestamp(Core::Time::Now()));
+            _packet.TransmitTimestamp(NTPPacket::Timestamp(Core::Time(_lastSent)));
             _packet.Serialize(writer);
 
             result = newFrame.Size();
-            TRACE_L1("Timesync: Send data: %d bytes", result);
+            TRACE_L1("Timesync: Send data: %d bytes to %s", result, index->Name.c_str());
+
+            while ((++index != _peers.end()) && (index->Pending == false)) {
+            }
+            if (index != _peers.end()) {
+                // More servers are waiting for their request.
+                Trigger();
+            }
         }
 
         _adminLock.Unlock();
@@ -192,20 +269,20 @@ namespace Plugin {
         return result;
     }
 
-    inline static uint64_t SecondsToTicks(double seconds)
+    inline static int64_t SecondsToTicks(double seconds)
     {
-        return static_cast<uint64_t>(seconds * NTPClient::MicroSeconds);
+        return static_cast<int64_t>(seconds * NTPClient::MicroSeconds);
     }
 
     /* virtual */ uint16_t NTPClient::ReceiveData(uint8_t* dataFrame, const uint16_t receivedSize)
     {
-        double received = static_cast<double>(Core::Time::Now().Ticks() / MicroSeconds);
+        const uint64_t now = Core::Time::Now().Ticks();
 
         TRACE_L1("Timesync: Received data: %d bytes", receivedSize);
 
         _adminLock.Lock();
 
-        if (receivedSize == NTPPacket::PacketSize) {
+        if ((receivedSize == NTPPacket::PacketSize) && (_state == INPROGRESS)) {
 
             DataFrame frame(dataFrame, receivedSize, receivedSize);
             NTPPacket packet;
@@ -215,49 +292,58 @@ namespace Plugin {
 // packet.DisplayPacket();
 #endif
 
-            double receivedServerTS = packet.ReceiveTimestamp().TimeSeconds();
-            double sentServerTS = packet.TransmitTimestamp().TimeSeconds();
-            double sentTS = packet.OriginalTimestamp().TimeSeconds();
-
-            double diffRequest = receivedServerTS - sentTS;
-            double diffResponse = sentServerTS - received;
-            double offset = (diffRequest + diffResponse) / 2;
-
-#ifdef __DEBUG__
-            double elapsedServer = sentServerTS - receivedServerTS;
-            double elapsedTotal = received - sentTS;
-            double roundTrip = elapsedTotal - elapsedServer;
-#endif
-
-            TRACE_L1("Request time diff  = %lf", diffRequest);
-            TRACE_L1("Response time diff = %lf", diffResponse);
-            TRACE_L1("Offset time        = %lf", offset);
+            // Only a reply to an outstanding request is accepted, and only once.
+            const uint64_t origin = Core::Time(packet.OriginalTimestamp()).Ticks();
+            std::vector<Peer>::iterator index(_peers.begin());
 
-#ifdef __DEBUG__
-            TRACE_L1("Server elapsed time = %lf", elapsedServer);
-            TRACE_L1("Total elapsed time  = %lf", elapsedTotal);
-            TRACE_L1("Round trip time     = %lf", roundTrip);
-#endif
-            TRACE(Trace::Information, (_T("TimeSync: Request time diff   = %lf s"), diffRequest));
-            TRACE(Trace::Information, (_T("TimeSync: Response time diff  = %lf s"), diffResponse));
-            TRACE(Trace::Information, (_T("TimeSync: Offset time         = %lf s"), offset));
+            while ((index != _peers.end()) && ((index->Sent == 0) || (index->Sent != origin))) {
+                index++;
+            }
 
-            uint64_t receivedTicks = SecondsToTicks(received);
-            TRACE(Trace::Information, (_T("TimeSync: Current time: %s"), Core::Time(receivedTicks).ToRFC1123(false).c_str()));
-            _syncedTimestamp = Core::Time(receivedTicks + SecondsToTicks(offset));
-            TRACE(Trace::Information, (_T("TimeSync: New time:     %s"), _syncedTimestamp.ToRFC1123(false).c_str()));
+            if (index == _peers.end()) {
+                TRACE_L1("TimeSync: %s", "Dropping a reply that does not match a request");
+            } else if ((packet.NTPMode() != 4) || (packet.LeapIndicator() == 3) || (packet.Stratum() == 0) || (packet.Stratum() > 15)) {
+                // A kiss-o'-death, or a server that is not synchronized itself.
+                TRACE(Trace::Warning, (_T("TimeSync: Unusable reply from [%s], stratum %d"), index->Name.c_str(), packet.Stratum()));
+                index->Sent = 0;
+            } else {
+                const double sentTS = static_cast<double>(index->Sent) / MicroSeconds;
+                const double receivedServerTS = packet.ReceiveTimestamp().TimeSeconds();
+                const double sentServerTS = packet.TransmitTimestamp().TimeSeconds();
+                const double received = static_cast<double>(now) / MicroSeconds;
 
-            _state = SUCCESS;
+                const double diffRequest = receivedServerTS - sentTS;
+                const double diffResponse = sentServerTS - received;
+                const double offset = (diffRequest + diffResponse) / 2;
+                const double roundTrip = (received - sentTS) - (sentServerTS - receivedServerTS);
 
-            // We don't need the socket anymore, so close it
-            TRACE_L1("TimeSync: %s", "Closing socket, no longer needed");
-            Close(0);
+                TRACE(Trace::Information, (_T("TimeSync: [%s] offset = %lf s, round trip = %lf s"), index->Name.c_str(), offset, roundTrip));
 
-            // Lets remove the watchdog subject, we do not want to wait anymore, we got an answer.
-            Core::IWorkerPool::Instance().Revoke(_activity);
+                if (_firstReply == Core::infinite) {
+                    _firstReply = static_cast<uint32_t>((now - _started) / MilliSeconds);
+                }
 
-            // Schedule it again to broadcast the successfull update of the time.
-            Core::IWorkerPool::Instance().Submit(_activity);
+                index->Sent = 0;
+                index->Precision = std::ldexp(1.0, static_cast<int8_t>(packet.Precision()));
+                index->RootDelay = packet.RootDelay() / 65536.0;
+                index->RootDispersion = packet.RootDispersion() / 65536.0;
+
+                ASSERT(index->Count < Burst);
+
+                Sample& sample(index->Samples[index->Count++]);
+                sample.Offset = offset;
+                sample.Delay = (roundTrip > LocalPrecision ? roundTrip : static_cast<double>(LocalPrecision));
+                sample.Dispersion = index->Precision + LocalPrecision;
+                sample.Time = now;
+
+                // Once a majority answered, the time is selected right away, the rest of the burst refines
+                // it. If the burst is over and nothing is outstanding anymore, there is no need to wait any
+                // longer either.
+                if (((_synced == false) && (_round < Burst) && (ClockSelection::Majority(Sources()) == true)) || ((_round == Burst) && (Outstanding() == false))) {
+                    Core::IWorkerPool::Instance().Revoke(_activity);
+                    Core::IWorkerPool::Instance().Submit(_activity);
+                }
+            }
         }
 
         _adminLock.Unlock();
@@ -275,63 +361,102 @@ namespace Plugin {
         }
     }
 
+    bool NTPClient::Resolve()
+    {
+        // Every attempt starts from scratch, the servers might have moved in the mean time.
+        _peers.clear();
+
+        for (const string& server : _servers) {
+            Core::NodeId remote(server.c_str(), Core::NodeId::TYPE_IPV4);
+
+            if (remote.IsValid() == true) {
+                _peers.emplace_back(server, remote);
+            }
+            else {
+                TRACE(Trace::Warning, (_T("Could not resolve NTP Server [%s]"), server.c_str()));
+            }
+        }
+
+        if ((_peers.empty() == false) && (IsClosed() == true)) {
+            // One socket for all servers, the remote node is set for every request that goes out.
+            RemoteNode(_peers.front().Node);
+            LocalNode(_peers.front().Node.AnyInterface());
+
+            // UDP should open by definition directly...
+            uint32_t status = Open(100);
+
+            if ((status != Core::ERROR_NONE) && (status != Core::ERROR_INPROGRESS)) {
+                TRACE(Trace::Warning, (_T("Could not open a socket for the NTP Servers")));
+                _peers.clear();
+            }
+        }
+
+        return (_peers.empty() == false);
+    }
+
     bool NTPClient::FireRequest()
     {
+        bool activated = (IsOpen() == true);
 
-        bool activated = false;
+        if (activated == true) {
+            for (Peer& peer : _peers) {
+                // A reply to an earlier request of the burst, that is still underway, is too late to be of use.
+                peer.Sent = 0;
+                peer.Pending = (peer.Count < Burst);
+            }
 
-        // Make sure socket is closed otherwise an assert will fire.
-        if (!IsClosed()) {
-            TRACE(Trace::Information, (_T("Lingering socket, closing")));
-            Close(1000);
+            Trigger();
         }
 
-        if (true == IsClosed() && (_serverIndex.Count() > 0)) {
+        return (activated);
+    }
 
-            uint32_t lastonetried = _serverIndex.Index();
+    // Needs to be called within the lock.
+    std::vector<ClockSelection::Source*> NTPClient::Sources()
+    {
+        std::vector<ClockSelection::Source*> sources;
 
-            do {
+        for (Peer& peer : _peers) {
+            sources.push_back(&peer);
+        }
 
-                // next server
-                if( _serverIndex.Index() >= _serverIndex.Count() ) {
-                    _serverIndex.Reset(0);
-                }
-                _serverIndex.Next();
-                ASSERT(_serverIndex.IsValid());
+        return (sources);
+    }
 
-                TRACE(Trace::Information, (_T("Trying NTP Server: [%s]"), (*_serverIndex).c_str()));
+    // Needs to be called within the lock.
+    bool NTPClient::Outstanding() const
+    {
+        return (std::find_if(_peers.begin(), _peers.end(), [](const Peer& peer) { return ((peer.Sent != 0) || (peer.Pending == true)); }) != _peers.end());
+    }
 
-                // Set the socket to send to the remote
-                Core::NodeId remote((*_serverIndex).c_str(), Core::NodeId::TYPE_IPV4);
+    // Needs to be called within the lock.
+    bool NTPClient::Select()
+    {
+        const ClockSelection::Source* system = ClockSelection::Select(Sources(), Core::Time::Now().Ticks(), _offset);
 
-                if (remote.IsValid() == true) {
-                    // Set the remote endpoint for the socket to the selected NTP server
-                    RemoteNode(remote);
-                    LocalNode(remote.AnyInterface());
+        if (system != nullptr) {
+            _source = static_cast<const Peer*>(system)->Name;
 
-                    // UDP should open by definition directly...
-                    uint32_t status = Open(100);
+            TRACE(Trace::Information, (_T("TimeSync: Offset %lf s, from %d out of %d servers, [%s] is the closest"), _offset, static_cast<uint32_t>(std::count_if(_peers.begin(), _peers.end(), [](const Peer& peer) { return (peer.Survivor); })), static_cast<uint32_t>(_peers.size()), _source.c_str()));
+        }
 
-                    if ((status == Core::ERROR_NONE) || (status == Core::ERROR_INPROGRESS)) {
+        return (system != nullptr);
+    }
 
-                        activated = true;
-                        _fired = false;
-                        Trigger();
-                    }
-                    else {
-                        TRACE(Trace::Warning, (_T("Could not open connection to NTP Server [%s]"), (*_serverIndex).c_str()));
-                    }
-                }
-                else {
-                    TRACE(Trace::Warning, (_T("Could not resolve NTP Server [%s]"), (*_serverIndex).c_str()));
-                }
-            }
-            while ((activated == false) && ( ((lastonetried != 0) && (lastonetried != _serverIndex.Index())) ||
-                                             ((lastonetried == 0) && (_serverIndex.Index() != _serverIndex.Count())) 
-                                           ) );
+    // Needs to be called within the lock.
+    void NTPClient::Synchronized(const uint64_t now)
+    {
+        _syncedTimestamp = Core::Time(static_cast<uint64_t>(static_cast<int64_t>(now) + SecondsToTicks(_offset)));
+        TRACE(Trace::Information, (_T("TimeSync: New time:     %s"), _syncedTimestamp.ToRFC1123(false).c_str()));
+
+        _duration = static_cast<uint32_t>((now - _started) / MilliSeconds);
+        if (_firstRequest != 0) {
+            _firstSync = static_cast<uint32_t>((now - _firstRequest) / MilliSeconds);
+            _firstRequest = 0;
+            TRACE(Trace::Information, (_T("TimeSync: First synchronization took %d ms"), _firstSync));
         }
 
-        return (activated);
+        Update();
     }
 
     void NTPClient::Update()
@@ -360,32 +485,83 @@ namespace Plugin {
 
         switch (_state) {
         case SENDREQUEST: {
-            // This case means that nothing has started yet, let reset the list of servers and start at the beginning...
-            _serverIndex.Reset(0);
+            // This case means that nothing has started yet, the first attempt queries all servers.
             _state = INPROGRESS;
             _currentAttempt = _retryAttempts;
+            _attempts = 0;
+            _round = 0;
+            _firstReply = Core::infinite;
         }
         case INPROGRESS: {
-            // If we end up here in this state, it means that the package was send but no response was received,
-            // or a response was received but is was not properly formatted...
-            // Lets move to the next server in the list, see if that one responds correctly, if we tried all servers let's
-            // start at the first one again, this time it might work
-            if (FireRequest() == true) {
-              result = WaitForResponse;
-            } else {
-                if (_currentAttempt-- != 0) {
+            const uint64_t now = Core::Time::Now().Ticks();
+
+            if (_round == 0) {
+                // A new attempt, all servers are queried at once.
+                _attempts++;
+                _synced = false;
+
+                if ((Resolve() == true) && (FireRequest() == true)) {
+                    _round = 1;
+                    result = (_round < Burst ? static_cast<uint32_t>(BurstInterval) : WaitForResponse);
+                    _due = now + (result * MilliSeconds);
+                } else if (_currentAttempt-- != 0) {
 
                     // Looks like there is no network connectivity, Just sleep and retry later
                     result = _WaitForNetwork;
                 } else {
-
-                    // Looks like there is no valid server anymore that we could use. There where servers
-                    // that did resolve correctly, so it is not a network connectivity problem.
                     _state = FAILED;
 
                     // Report the failure. Always report back when we are finished.
                     Update();
                 }
+                break;
+            }
+
+            if ((_synced == false) && (_round < Burst) && (ClockSelection::Majority(Sources()) == true) && (Select() == true)) {
+                // A majority answered, no need to wait for the whole burst to have a time.
+                Synchronized(now);
+                _synced = true;
+
+                // The time might just have been set, the samples and the requests underway are of the clock
+                // before that. The rest of the burst starts over, so the refinement is all on the new one.
+                for (Peer& peer : _peers) {
+                    peer.Count = 0;
+                    peer.Sent = 0;
+                }
+            }
+
+            if ((now < _due) && ((_round < Burst) || (Outstanding() == true))) {
+                // Woken up by a reply, the next step is not due yet.
+                result = static_cast<uint32_t>((_due - now + MilliSeconds - 1) / MilliSeconds);
+            } else if (_round < Burst) {
+                // The next request of the burst.
+                FireRequest();
+                _round++;
+                result = (_round < Burst ? static_cast<uint32_t>(BurstInterval) : WaitForResponse);
+                _due = now + (result * MilliSeconds);
+            } else if (Select() == true) {
+                Synchronized(now);
+
+                _state = SUCCESS;
+
+                // We don't need the socket anymore, so close it
+                TRACE_L1("TimeSync: %s", "Closing socket, no longer needed");
+                Close(0);
+            } else if (_synced == true) {
+                // Nothing to refine with, the time selected early stands.
+                _state = SUCCESS;
+                Close(0);
+            } else if (_currentAttempt-- != 0) {
+
+                // None of the servers gave a usable time, try them all again later.
+                _round = 0;
+                result = _WaitForNetwork;
+            } else {
+                _state = FAILED;
+                Close(0);
+
+                // Report the failure. Always report back when we are finished.
+                Update();
             }
             break;
         }
@@ -21,6 +21,7 @@
 #define TIMESYNC_NTPCLIENT_H
 
 #include "Module.h"
+#include "ClockSelection.h"
 #include <interfaces/ITimeSync.h>
 
 namespace WPEFramework {
@@ -34,17 +35,117 @@ namespace Plugin {
 
         using SourceIterator = Core::JSON::ArrayType<Core::JSON::String>::Iterator;
 
+        class Statistics : public Core::JSON::Container {
+        public:
+            class Server : public Core::JSON::Container {
+            private:
+                Server& operator=(const Server&) = delete;
+
+            public:
+                Server()
+                    : Core::JSON::Container()
+                    , Source()
+                    , Samples(0)
+                    , Offset(0)
+                    , Delay(0)
+                    , Jitter(0)
+                    , Distance(0)
+                    , Survivor(false)
+                {
+                    Add(_T("source"), &Source);
+                    Add(_T("samples"), &Samples);
+                    Add(_T("offset"), &Offset);
+                    Add(_T("delay"), &Delay);
+                    Add(_T("jitter"), &Jitter);
+                    Add(_T("distance"), &Distance);
+                    Add(_T("survivor"), &Survivor);
+                }
+                Server(const Server& copy)
+                    : Core::JSON::Container()
+                    , Source(copy.Source)
+                    , Samples(copy.Samples)
+                    , Offset(copy.Offset)
+                    , Delay(copy.Delay)
+                    , Jitter(copy.Jitter)
+                    , Distance(copy.Distance)
+                    , Survivor(copy.Survivor)
+                {
+                    Add(_T("source"), &Source);
+                    Add(_T("samples"), &Samples);
+                    Add(_T("offset"), &Offset);
+                    Add(_T("delay"), &Delay);
+                    Add(_T("jitter"), &Jitter);
+                    Add(_T("distance"), &Distance);
+                    Add(_T("survivor"), &Survivor);
+                }
+                ~Server()
+                {
+                }
+
+            public:
+                Core::JSON::String Source;
+                Core::JSON::DecUInt8 Samples; // replies received in the last synchronization
+                Core::JSON::DecSInt64 Offset; // us
+                Core::JSON::DecUInt32 Delay; // us, round trip
+                Core::JSON::DecUInt32 Jitter; // us
+                Core::JSON::DecUInt32 Distance; // us, root distance
+                Core::JSON::Boolean Survivor; // a truechimer, used for the time
+            };
+
+        private:
+            Statistics(const Statistics&) = delete;
+            Statistics& operator=(const Statistics&) = delete;
+
+        public:
+            Statistics()
+                : Core::JSON::Container()
+                , Source()
+                , Offset(0)
+                , FirstSync(0)
+                , FirstReply(0)
+                , Duration(0)
+                , Attempts(0)
+                , Servers()
+            {
+                Add(_T("source"), &Source);
+                Add(_T("offset"), &Offset);
+                Add(_T("firstsync"), &FirstSync);
+                Add(_T("firstreply"), &FirstReply);
+                Add(_T("duration"), &Duration);
+                Add(_T("attempts"), &Attempts);
+                Add(_T("servers"), &Servers);
+            }
+            ~Statistics()
+            {
+            }
+
+        public:
+            Core::JSON::String Source; // the server with the smallest root distance
+            Core::JSON::DecSInt64 Offset; // us, combined over the survivors
+            Core::JSON::DecUInt32 FirstSync; // ms from the first request to the first synchronized time
+            Core::JSON::DecUInt32 FirstReply; // ms from the start of the last synchronization to its first valid reply
+            Core::JSON::DecUInt32 Duration; // ms the last synchronization took
+            Core::JSON::DecUInt16 Attempts; // attempts the last synchronization took
+            Core::JSON::ArrayType<Server> Servers;
+        };
+
     private:
         using ServerList = std::vector<string>;
-        using ServerIterator = Core::IteratorType<const ServerList, const string&, ServerList::const_iterator>;
         using DataFrame = Core::FrameType<0>;
 
+        // All servers are queried at once, Burst times, BurstInterval apart. The samples go through the
+        // clock filter and selection of RFC 5905, see ClockSelection. The time is selected as soon as a
+        // majority of the servers answered, the rest of the burst refines it.
+        static constexpr uint8_t Burst = ClockSelection::Burst;
+        static constexpr uint32_t BurstInterval = 500; // ms
+        static constexpr double LocalPrecision = ClockSelection::LocalPrecision;
+
         // This enum tracks the state for actions begin performed. As the Worker() method is re-entered,
         // we need to keep track of state.
         enum state {
             INITIAL, // Initial state
-            SENDREQUEST, // Let send out an NTP request to a legitimate server.
-            INPROGRESS, // A request has been sent to a NTP server, waiting for a response
+            SENDREQUEST, // Let send out NTP requests to all legitimate servers.
+            INPROGRESS, // Requests have been sent to the NTP servers, collecting the responses
             SUCCESS, // Action succeeded, we received a valid response from an NTP server
             FAILED // Action failed, we did not receive any valid response from any of the NTP servers
         };
@@ -354,6 +455,25 @@ namespace Plugin {
             NTPClient& _parent;
         };
 
+        using Sample = ClockSelection::Sample;
+
+        // A configured server, with its samples of the ongoing synchronization.
+        struct Peer : public ClockSelection::Source {
+            Peer(const string& name, const Core::NodeId& node)
+                : ClockSelection::Source()
+                , Name(name)
+                , Node(node)
+                , Sent(0)
+                , Pending(false)
+            {
+            }
+
+            string Name;
+            Core::NodeId Node;
+            uint64_t Sent; // ticks, transmit time of the outstanding request, 0 if there is none
+            bool Pending; // a request still has to be sent
+        };
+
     private:
         NTPClient(const NTPClient&) = delete;
         NTPClient& operator=(const NTPClient&) = delete;
@@ -372,6 +492,8 @@ namespace Plugin {
         virtual string Source() const override;
         virtual uint64_t SyncTime() const override;
 
+        void Metrics(Statistics& info) const;
+
         // ITime methods
         virtual uint64_t TimeSync() const override
         {
@@ -393,19 +515,35 @@ namespace Plugin {
 
         void Update();
         void Dispatch();
+        bool Resolve();
         bool FireRequest();
+        std::vector<ClockSelection::Source*> Sources();
+        bool Outstanding() const;
+        bool Select();
+        void Synchronized(const uint64_t now);
 
     private:
-        Core::CriticalSection _adminLock;
+        mutable Core::CriticalSection _adminLock;
         NTPPacket _packet;
         Core::Time _syncedTimestamp;
         state _state;
-        bool _fired;
         uint32_t _WaitForNetwork;
         uint32_t _retryAttempts;
         uint32_t _currentAttempt;
         ServerList _servers;
-        ServerIterator _serverIndex;
+        std::vector<Peer> _peers;
+        uint8_t _round;
+        uint64_t _due; // ticks, the next request of the burst, or the end of it
+        bool _synced; // the time was selected early, the burst refines it
+        uint64_t _lastSent;
+        string _source;
+        double _offset;
+        uint64_t _firstRequest; // ticks, the first synchronization started, 0 once it succeeded
+        uint64_t _started; // ticks, the last synchronization started
+        uint32_t _firstSync;
+        uint32_t _firstReply;
+        uint32_t _duration;
+        uint16_t _attempts;
         Core::ProxyType<Core::IDispatchType<void>> _activity;
         std::list<Exchange::ITimeSync::INotification*> _clients;
     };
@@ -37,6 +37,7 @@ namespace Plugin {
     TimeSync::TimeSync()
         : _skipURL(0)
         , _periodicity(0)
+        , _nextSync(0)
         , _client(Core::Service<NTPClient>::Create<Exchange::ITimeSync>())
         , _activity(Core::ProxyType<PeriodicSync>::Create(_client))
         , _sink(this)
@@ -90,8 +91,13 @@ namespace Plugin {
 
     /* virtual */ string TimeSync::Information() const
     {
-        // No additional info to report.
-        return (string());
+        string result;
+        NTPClient::Statistics info;
+
+        static_cast<const NTPClient*>(_client)->Metrics(info);
+        info.ToString(result);
+
+        return (result);
     }
 
     /* virtual */ void TimeSync::Inbound(Web::Request& request)
@@ -156,6 +162,7 @@ namespace Plugin {
                         // Stop automatic synchronisation
                         _client->Cancel();
                         Core::IWorkerPool::Instance().Revoke(_activity);
+                        _nextSync = 0;
 
                         if (newTime.IsValid()) {
                             Core::SystemInfo::Instance().SetTime(newTime);
@@ -181,11 +188,16 @@ namespace Plugin {
         if (_periodicity != 0) {
             Core::Time newSyncTime(Core::Time::Now());
 
-            newSyncTime.Add(_periodicity);
+            // A sync reports the time selected early and again once it is refined, the next one is
+            // scheduled only once.
+            if (_nextSync <= newSyncTime.Ticks()) {
+                newSyncTime.Add(_periodicity);
+                _nextSync = newSyncTime.Ticks();
 
-            // Seems we are synchronised with the time. Schedule the next timesync.
-            TRACE_L1("Waking up again at %s.", newSyncTime.ToRFC1123(false).c_str());
-            Core::IWorkerPool::Instance().Schedule(newSyncTime, _activity);
+                // Seems we are synchronised with the time. Schedule the next timesync.
+                TRACE_L1("Waking up again at %s.", newSyncTime.ToRFC1123(false).c_str());
+                Core::IWorkerPool::Instance().Schedule(newSyncTime, _activity);
+            }
 
             event_timechange();
         }
@@ -248,6 +248,7 @@ namespace Plugin {
     private:
         uint16_t _skipURL;
         uint32_t _periodicity;
+        uint64_t _nextSync; // ticks, the periodic sync that is scheduled
         Exchange::ITimeSync* _client;
         Core::ProxyType<Core::IDispatch> _activity;
         Core::Sink<Notification> _sink;
@@ -0,0 +1,164 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../ClockSelection.h"
+#include "../../helpers/UnitTest.h"
+
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+namespace {
+
+    bool Near(const double value, const double expected)
+    {
+        return (std::fabs(value - expected) < 1e-9);
+    }
+
+    const uint64_t Now = 1000000000ULL; // us
+
+    // A source with one sample per given offset, all with the given delay and dispersion, received now.
+    ClockSelection::Source Server(const double offset, const double delay, const double dispersion = 0.01)
+    {
+        ClockSelection::Source source;
+
+        source.Count = 1;
+        source.Samples[0] = { offset, delay, dispersion, Now };
+
+        return (source);
+    }
+
+    void TestFilter()
+    {
+        ClockSelection::Source source;
+
+        // Out of order, the one with the lowest delay is picked. Sample 3 is 2 s old.
+        source.Count = 4;
+        source.Samples[0] = { 0.3, 0.30, 0.01, Now };
+        source.Samples[1] = { 0.1, 0.10, 0.01, Now };
+        source.Samples[2] = { 0.4, 0.40, 0.01, Now };
+        source.Samples[3] = { 0.2, 0.20, 0.01, Now - 2000000 };
+        source.RootDelay = 0.02;
+        source.RootDispersion = 0.005;
+
+        ClockSelection::Filter(source, Now);
+
+        CHECK(Near(source.Offset, 0.1));
+        CHECK(Near(source.Delay, 0.1));
+
+        // Sorted on delay: weights 1/2, 1/4, 1/8 and 1/16, the 2 s old sample aged by PHI.
+        const double dispersion = (0.01 / 2) + ((0.01 + (ClockSelection::Frequency * 2)) / 4) + (0.01 / 8) + (0.01 / 16);
+        CHECK(Near(source.Dispersion, dispersion));
+
+        // RMS of the offsets against the one picked, over n - 1.
+        const double jitter = std::sqrt(((0.1 * 0.1) + (0.2 * 0.2) + (0.3 * 0.3)) / 3);
+        CHECK(Near(source.Jitter, jitter));
+
+        CHECK(Near(source.Distance, ((0.02 + 0.1) / 2) + 0.005 + dispersion + jitter));
+
+        // One sample has no jitter, the local precision is the floor.
+        ClockSelection::Source single(Server(0.5, 0.05));
+        ClockSelection::Filter(single, Now);
+
+        CHECK(Near(single.Jitter, ClockSelection::LocalPrecision));
+        CHECK(Near(single.Distance, (0.05 / 2) + (0.01 / 2) + ClockSelection::LocalPrecision));
+    }
+
+    void TestMajority()
+    {
+        ClockSelection::Source first(Server(1.00, 0.02));
+        ClockSelection::Source second(Server(1.01, 0.04));
+        ClockSelection::Source third(Server(0.99, 0.06));
+        ClockSelection::Source falseticker(Server(10.0, 0.02));
+        std::vector<ClockSelection::Source*> sources({ &first, &second, &third, &falseticker });
+        double offset = 0;
+
+        const ClockSelection::Source* system = ClockSelection::Select(sources, Now, offset);
+
+        CHECK(system == &first);
+        CHECK(first.Survivor == true);
+        CHECK(second.Survivor == true);
+        CHECK(third.Survivor == true);
+        CHECK(falseticker.Survivor == false);
+
+        // Weighed by the root distance.
+        const double expected = ((first.Offset / first.Distance) + (second.Offset / second.Distance) + (third.Offset / third.Distance))
+            / ((1 / first.Distance) + (1 / second.Distance) + (1 / third.Distance));
+        CHECK(Near(offset, expected));
+        CHECK((offset > 0.99) && (offset < 1.01));
+    }
+
+    void TestNoMajority()
+    {
+        ClockSelection::Source first(Server(1.0, 0.02));
+        ClockSelection::Source second(Server(5.0, 0.02));
+        std::vector<ClockSelection::Source*> sources({ &first, &second });
+        double offset = 42;
+
+        CHECK(ClockSelection::Select(sources, Now, offset) == nullptr);
+        CHECK(offset == 42);
+        CHECK(first.Survivor == false);
+        CHECK(second.Survivor == false);
+    }
+
+    void TestSelectable()
+    {
+        ClockSelection::Source distant(Server(1.0, 0.02));
+        ClockSelection::Source silent;
+        ClockSelection::Source near(Server(2.0, 0.02));
+        std::vector<ClockSelection::Source*> sources({ &distant, &silent, &near });
+        double offset = 0;
+
+        // Beyond the maximum distance, and a server that did not answer, neither is a candidate.
+        distant.RootDispersion = ClockSelection::MaxDistance;
+
+        const ClockSelection::Source* system = ClockSelection::Select(sources, Now, offset);
+
+        CHECK(system == &near);
+        CHECK(distant.Survivor == false);
+        CHECK(silent.Survivor == false);
+        CHECK(Near(offset, 2.0));
+    }
+
+    void TestAnswered()
+    {
+        ClockSelection::Source first(Server(0.1, 0.05));
+        ClockSelection::Source second(Server(0.1, 0.05));
+        ClockSelection::Source silent;
+        ClockSelection::Source quiet;
+
+        // Half is not a majority, one more is.
+        CHECK(ClockSelection::Majority({ &first, &silent }) == false);
+        CHECK(ClockSelection::Majority({ &first, &silent, &quiet }) == false);
+        CHECK(ClockSelection::Majority({ &first, &second, &silent }) == true);
+        CHECK(ClockSelection::Majority({ &first }) == true);
+        CHECK(ClockSelection::Majority({}) == false);
+    }
+}
+
+int main()
+{
+    TestFilter();
+    TestMajority();
+    TestNoMajority();
+    TestSelectable();
+    TestAnswered();
+
+    return (UnitTest::Result());
+}
@@ -0,0 +1,104 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // Merges the trace entries of all sources on timestamp, with a min-heap over the sources that have
+    // an entry loaded. A source is only reloaded once its current entry has been dispatched, so every
+    // entry costs O(log sources). No framework dependencies, it is checked on its own. A SOURCE has:
+    //     state Load();              loads the next entry, if there is none loaded, LOADED, EMPTY or FAILURE
+    //     uint64_t Timestamp();      of the loaded entry
+    //     void Dispatched(now);      marks the loaded entry as handled
+    //     void Flush();              drops all that is buffered, after a FAILURE
+    template <typename SOURCE>
+    class SourceMerge {
+    private:
+        SourceMerge(const SourceMerge&) = delete;
+        SourceMerge& operator=(const SourceMerge&) = delete;
+
+    public:
+        SourceMerge()
+            : _pending()
+        {
+        }
+        ~SourceMerge()
+        {
+        }
+
+    public:
+        void Clear()
+        {
+            _pending.clear();
+        }
+        // Takes part in the merge, if the source has an entry.
+        void Enqueue(SOURCE& source)
+        {
+            const typename SOURCE::state state(source.Load());
+
+            if (state == SOURCE::LOADED) {
+                _pending.emplace_back(source.Timestamp(), &source);
+                std::push_heap(_pending.begin(), _pending.end(), Later);
+            } else if (state == SOURCE::FAILURE) {
+                // Oops this requires recovery, so let's flush
+                source.Flush();
+            }
+        }
+        // Hands the oldest entries to the dispatch, at most maxBatch of them. Returns how many.
+        template <typename DISPATCH>
+        uint16_t Drain(const uint64_t now, const uint16_t maxBatch, DISPATCH&& dispatch)
+        {
+            uint16_t dispatched = 0;
+
+            while ((_pending.empty() == false) && (dispatched < maxBatch)) {
+                std::pop_heap(_pending.begin(), _pending.end(), Later);
+                SOURCE& selected(*(_pending.back().second));
+                _pending.pop_back();
+
+                dispatch(selected);
+
+                // Ready to load a new one..
+                selected.Dispatched(now);
+                Enqueue(selected);
+
+                dispatched++;
+            }
+
+            return (dispatched);
+        }
+
+    private:
+        static bool Later(const std::pair<uint64_t, SOURCE*>& lhs, const std::pair<uint64_t, SOURCE*>& rhs)
+        {
+            return (lhs.first > rhs.first);
+        }
+
+    private:
+        std::vector<std::pair<uint64_t, SOURCE*>> _pending;
+    };
+
+} // namespace Plugin
+} // namespace WPEFramework
@@ -36,6 +36,7 @@ namespace Plugin {
 
     // Declare the local trace iterator exposing the remote interface.
     /* static */ TraceControl::Observer::Source::LocalIterator TraceControl::Observer::Source::_localIterator;
+    /* static */ constexpr char TraceOutput::TruncatedMarker[];
     static Core::ProxyPoolType<Web::JSONBodyType<TraceControl::Data>> jsonBodyDataFactory(4);
 
     /* static */ string TraceControl::Observer::Source::SourceName(const string& prefix, RPC::IRemoteConnection* connection)
@@ -67,16 +68,35 @@ namespace Plugin {
 
         _skipURL = static_cast<uint8_t>(_service->WebPrefix().length());
 
+        uint8_t sinks = 0;
+        Trace::ITraceMedia* remote = nullptr;
+
         if (((service->Background() == false) && (_config.Console.IsSet() == false) && (_config.SysLog.IsSet() == false)) || ((_config.Console.IsSet() == true) && (_config.Console.Value() == true))) {
-            _outputs.push_back(new Plugin::TraceOutput(false, false));
+            sinks |= Plugin::TraceOutput::CONSOLE;
         }
         if (((service->Background() == true) && (_config.Console.IsSet() == false) && (_config.SysLog.IsSet() == false)) || ((_config.SysLog.IsSet() == true) && (_config.SysLog.Value() == true))) {
-            _outputs.push_back(new Plugin::TraceOutput(true, _config.Abbreviated.Value()));
+            sinks |= Plugin::TraceOutput::SYSLOG;
+        }
+        if (_config.File.Value().empty() == false) {
+            sinks |= Plugin::TraceOutput::LOGFILE;
         }
         if (_config.Remote.IsSet() == true) {
             Core::NodeId logNode(_config.Remote.Binding.Value().c_str(), _config.Remote.Port.Value());
 
-            _outputs.push_back(new Trace::TraceMedia(logNode));
+            remote = new Trace::TraceMedia(logNode);
+        }
+
+        if ((sinks != 0) || (remote != nullptr)) {
+            // All outputs are served from a single writer thread, so a slow output does not hold up the observer.
+            _outputs.push_back(new Plugin::TraceOutput(
+                sinks,
+                _config.Abbreviated.Value(),
+                _config.QueueSize.Value(),
+                _config.RateLimit.Value(),
+                TraceFile(_config.File.Value()),
+                _config.FileSize.Value() * 1024,
+                _config.Binary.Value(),
+                remote));
         }
 
         _service->Register(&_observer);
@@ -153,6 +173,13 @@ namespace Plugin {
                 }
             }
 
+            std::list<Observer::Source::Statistics> sources;
+            _observer.Statistics(sources);
+
+            for (const Observer::Source::Statistics& info : sources) {
+                response->Sources.Add(Data::Source(info));
+            }
+
             result->Body(Core::proxy_cast<Web::IBody>(response));
             result->ContentType = Web::MIME_JSON;
         } else if ((request.Verb == Web::Request::HTTP_PUT) && (index.Next() == true)) {
@@ -209,6 +236,12 @@ namespace Plugin {
         return (result);
     }
 
+    string TraceControl::TraceFile(const string& fileName) const
+    {
+        // Relative file names end up in the volatile storage of this plugin.
+        return (((fileName.empty() == true) || (fileName[0] == '/')) ? fileName : _service->VolatilePath() + fileName);
+    }
+
     void TraceControl::Dispatch(Observer::Source& information)
     {
         std::list<Trace::ITraceMedia*>::iterator index(_outputs.begin());
@@ -20,6 +20,7 @@
 #pragma once
 
 #include "Module.h"
+#include "SourceMerge.h"
 #include <interfaces/json/JsonData_TraceControl.h>
 
 namespace WPEFramework {
@@ -117,6 +118,13 @@ namespace Plugin {
                     FAILURE
                 };
 
+                struct Statistics {
+                    uint32_t Id;
+                    uint32_t Dispatched;
+                    uint32_t Dropped;
+                    uint64_t MaxLag;
+                };
+
             public:
                 Source(const string& tracePath, RPC::IRemoteConnection* connection)
                     : Core::CyclicBuffer(SourceName(tracePath, connection), Core::File::USER_WRITE|Core::File::USER_READ|Core::File::SHAREABLE, 0, true)
@@ -128,6 +136,9 @@ namespace Plugin {
                     , _classname(0)
                     , _information()
                     , _state(EMPTY)
+                    , _dispatched(0)
+                    , _dropped(0)
+                    , _maxLag(0)
                 {
                     if (_connection != nullptr) {
                         TRACE_L1("Constructing TraceControl::Source (%d)", connection->Id());
@@ -301,15 +312,50 @@ namespace Plugin {
                 {
                     return (_length);
                 }
+                // Drop everything that is buffered, after an entry that could not be loaded. Count what is
+                // lost: the failed entry, every entry that can still be read behind it, and, if the rest of
+                // the buffer can not be read as entries anymore, that as one more.
                 void Flush()
                 {
+                    uint32_t length;
+
+                    if (_state == FAILURE) {
+                        _dropped++;
+                    }
+
+                    while ((Used() > 0) && ((length = Read(_traceBuffer, sizeof(_traceBuffer))) >= 2) && (((_traceBuffer[1] << 8) | _traceBuffer[0]) == length)) {
+                        _dropped++;
+                    }
+
+                    if (Used() > 0) {
+                        _dropped++;
+                        Core::CyclicBuffer::Flush();
+                    }
+
                     _state = EMPTY;
-                    Core::CyclicBuffer::Flush();
                 }
                 void Clear()
                 {
                     _state = EMPTY;
                 }
+                // Mark the loaded entry as handled, keeping track of how far we run behind on this source.
+                void Dispatched(const uint64_t now)
+                {
+                    const uint64_t stamp = Timestamp();
+
+                    if ((now > stamp) && ((now - stamp) > _maxLag)) {
+                        _maxLag = now - stamp;
+                    }
+                    _dispatched++;
+                    _state = EMPTY;
+                }
+                void Info(Statistics& info) const
+                {
+                    info.Id = Id();
+                    info.Dispatched = _dispatched;
+                    info.Dropped = _dropped;
+                    info.MaxLag = _maxLag;
+                }
 
             private:
                 virtual uint32_t GetReadSize(Core::CyclicBuffer::Cursor& cursor) override
@@ -329,6 +375,9 @@ namespace Plugin {
                 uint16_t _information;
                 uint16_t _length;
                 state _state;
+                uint32_t _dispatched;
+                uint32_t _dropped;
+                uint64_t _maxLag;
                 uint8_t _traceBuffer[Trace::CyclicBufferSize];
                 static LocalIterator _localIterator;
             };
@@ -556,6 +605,7 @@ namespace Plugin {
             Observer(TraceControl& parent)
                 : Thread(Core::Thread::DefaultStackSize(), _T("TraceWorker"))
                 , _buffers()
+                , _merge()
                 , _traceControl(Trace::TraceUnit::Instance())
                 , _parent(parent)
                 , _refcount(0)
@@ -656,6 +706,19 @@ namespace Plugin {
                 return (ModuleIterator(_buffers));
             }
 
+            void Statistics(std::list<Source::Statistics>& sources) const
+            {
+                _adminLock.Lock();
+
+                for (const std::pair<const uint32_t, Source*>& entry : _buffers) {
+                    Source::Statistics info;
+                    entry.second->Info(info);
+                    sources.push_back(info);
+                }
+
+                _adminLock.Unlock();
+            }
+
         private:
             BEGIN_INTERFACE_MAP(Observer)
             INTERFACE_ENTRY(RPC::IRemoteConnection::INotification)
@@ -673,68 +736,47 @@ namespace Plugin {
             }
             virtual uint32_t Worker()
             {
-                
                 while ((IsRunning() == true) && (_traceControl.Wait(Core::infinite) == Core::ERROR_NONE)) {
                     // Before we start we reset the flag, if new info is coming in, we will get a retrigger flag.
                     _traceControl.Acknowledge();
 
-                    Source* selected;
-
-                    uint64_t timeStamp;
+                    uint16_t dispatched;
 
                     do {
-                        selected = nullptr;
+                        dispatched = 0;
 
                         _adminLock.Lock();
 
-                        timeStamp = static_cast<uint64_t>(~0);
+                        _merge.Clear();
 
                         std::map<const uint32_t, Source*>::iterator index(_buffers.begin());
 
                         while (index != _buffers.end()) {
-
-                            Source::state state(index->second->Load());
-
-                            if (state == Source::LOADED) {
-                                if (index->second->Timestamp() < timeStamp) {
-                                    timeStamp = index->second->Timestamp();
-
-                                    if (state == Source::LOADED) {
-                                        selected = index->second;
-                                    }
-                                }
-                            } else if (state == Source::FAILURE) {
-                                // Oops this requires recovery, so let's flush
-                                index->second->Flush();
-                            }
-
+                            _merge.Enqueue(*(index->second));
                             index++;
                         }
 
-                        if (selected != nullptr) {
-
+                        dispatched = _merge.Drain(Core::Time::Now().Ticks(), MaxBatchSize, [this](Source& selected) {
                             // Oke, output this entry
-                            _parent.Dispatch(*selected);
-
-                            // Ready to load a new one..
-                            selected->Clear();
-                        } else if (timeStamp != static_cast<uint64_t>(~0)) {
-                            // Looks like we are waiting for a message to be completed.
-                            // Give up our slice, so the producer, can produce.
-                            ::SleepMs(0);
-                        }
+                            _parent.Dispatch(selected);
+                        });
 
+                        // Release the lock between batches, so sources can come and go.
                         _adminLock.Unlock();
 
-                    } while ((IsRunning() == true) && (timeStamp != static_cast<uint64_t>(~0)));
+                    } while ((IsRunning() == true) && (dispatched == MaxBatchSize));
                 }
 
                 return (Core::infinite);
             }
 
         private:
-            Core::CriticalSection _adminLock;
+            // Number of entries dispatched before the administration lock is released.
+            static constexpr uint16_t MaxBatchSize = 64;
+
+            mutable Core::CriticalSection _adminLock;
             std::map<const uint32_t, Source*> _buffers;
+            SourceMerge<Source> _merge;
             Trace::TraceUnit& _traceControl;
             TraceControl& _parent;
             mutable uint32_t _refcount;
@@ -824,11 +866,21 @@ namespace Plugin {
                 , SysLog(true)
                 , Abbreviated(true)
                 , Remote()
+                , File()
+                , FileSize(1024)
+                , Binary(false)
+                , QueueSize(256)
+                , RateLimit(0)
             {
                 Add(_T("console"), &Console);
                 Add(_T("syslog"), &SysLog);
                 Add(_T("abbreviated"), &Abbreviated);
                 Add(_T("remote"), &Remote);
+                Add(_T("file"), &File);
+                Add(_T("filesize"), &FileSize);
+                Add(_T("binary"), &Binary);
+                Add(_T("queuesize"), &QueueSize);
+                Add(_T("ratelimit"), &RateLimit);
             }
             ~Config()
             {
@@ -839,6 +891,11 @@ namespace Plugin {
             Core::JSON::Boolean SysLog;
             Core::JSON::Boolean Abbreviated;
             NetworkNode Remote;
+            Core::JSON::String File; // Trace file, written next to the other outputs
+            Core::JSON::DecUInt32 FileSize; // KB, the trace file moves aside to <file>.1 when it is full (0 is unlimited)
+            Core::JSON::Boolean Binary; // Use the compact binary record format for the trace file
+            Core::JSON::DecUInt16 QueueSize; // Number of traces that can be pending for output
+            Core::JSON::DecUInt32 RateLimit; // Maximum number of traces per second, per category (0 is unlimited)
         };
         class Data : public Core::JSON::Container {
         public:
@@ -861,6 +918,55 @@ namespace Plugin {
                 Core::JSON::String Category; // Category name
             }; // class StatusDataParam
 
+            class Source : public Core::JSON::Container {
+            private:
+                Source& operator=(const Source&);
+
+            public:
+                Source()
+                    : Core::JSON::Container()
+                {
+                    Add(_T("id"), &Id);
+                    Add(_T("dispatched"), &Dispatched);
+                    Add(_T("dropped"), &Dropped);
+                    Add(_T("lag"), &Lag);
+                }
+                Source(const Observer::Source::Statistics& info)
+                    : Core::JSON::Container()
+                {
+                    Add(_T("id"), &Id);
+                    Add(_T("dispatched"), &Dispatched);
+                    Add(_T("dropped"), &Dropped);
+                    Add(_T("lag"), &Lag);
+
+                    Id = info.Id;
+                    Dispatched = info.Dispatched;
+                    Dropped = info.Dropped;
+                    Lag = info.MaxLag;
+                }
+                Source(const Source& copy)
+                    : Core::JSON::Container()
+                    , Id(copy.Id)
+                    , Dispatched(copy.Dispatched)
+                    , Dropped(copy.Dropped)
+                    , Lag(copy.Lag)
+                {
+                    Add(_T("id"), &Id);
+                    Add(_T("dispatched"), &Dispatched);
+                    Add(_T("dropped"), &Dropped);
+                    Add(_T("lag"), &Lag);
+                }
+                ~Source()
+                {
+                }
+
+            public:
+                Core::JSON::DecUInt32 Id;
+                Core::JSON::DecUInt32 Dispatched;
+                Core::JSON::DecUInt32 Dropped;
+                Core::JSON::DecUInt64 Lag; // Worst observed delay, in microseconds, between tracing and dispatching
+            };
+
             class Trace : public Core::JSON::Container {
             private:
                 Trace& operator=(const Trace&);
@@ -915,6 +1021,7 @@ namespace Plugin {
                 Add(_T("console"), &Console);
                 Add(_T("remote"), &Remote);
                 Add(_T("settings"), &Settings);
+                Add(_T("sources"), &Sources);
             }
             ~Data()
             {
@@ -924,6 +1031,7 @@ namespace Plugin {
             Core::JSON::Boolean Console;
             NetworkNode Remote;
             Core::JSON::ArrayType<Trace> Settings;
+            Core::JSON::ArrayType<Source> Sources;
         };
 
     public:
@@ -989,6 +1097,7 @@ namespace Plugin {
 
     private:
         void Dispatch(Observer::Source& information);
+        string TraceFile(const string& fileName) const;
 
         void RegisterAll();
         void UnregisterAll();
@@ -16,60 +16,426 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
- 
+
 #pragma once
 
 #include "Module.h"
 
 #ifndef __WINDOWS__
 #include <syslog.h>
+#include <sys/uio.h>
+#include <unistd.h>
 #endif
 
+#include <unordered_map>
+
 namespace WPEFramework {
 namespace Plugin {
 
-    class TraceOutput : public Trace::ITraceMedia {
+    // The trace output is decoupled from the observer draining the trace buffers. Output() only
+    // copies the trace into a preallocated ring of records and wakes up the writer thread, which
+    // formats and writes out all pending records in one go. If the ring is full, or a category
+    // exceeds its rate, the trace is dropped and counted, rather than stalling the observer.
+    // The trace file is capped: when it is full it moves aside to "<file>.1", replacing the one that
+    // was there, and a new file is started.
+    class TraceOutput : public Trace::ITraceMedia, public Core::Thread {
+    public:
+        enum sink : uint8_t {
+            CONSOLE = 0x01,
+            SYSLOG = 0x02,
+            LOGFILE = 0x04
+        };
+
+    private:
+        static constexpr uint16_t MaxNameLength = 64;
+        static constexpr uint16_t MaxTextLength = 1024;
+        static constexpr uint16_t MaxBatchSize = 32;
+
+        // Replaces the end of a trace that does not fit in a record.
+        static constexpr char TruncatedMarker[] = " ...[truncated]";
+        static constexpr uint16_t TruncatedMarkerLength = sizeof(TruncatedMarker) - 1;
+
+        struct Record {
+            uint64_t Time;
+            uint32_t Line;
+            uint16_t Length;
+            char File[MaxNameLength];
+            char ClassName[MaxNameLength];
+            char Category[MaxNameLength];
+            char Module[MaxNameLength];
+            char Text[MaxTextLength];
+        };
+
+        class RecordWrapper : public Trace::ITrace {
+        public:
+            RecordWrapper() = delete;
+            RecordWrapper(const RecordWrapper&) = delete;
+            RecordWrapper& operator=(const RecordWrapper&) = delete;
+
+            RecordWrapper(const Record& record)
+                : _record(record)
+            {
+            }
+            ~RecordWrapper()
+            {
+            }
+
+        public:
+            const char* Category() const override
+            {
+                return (_record.Category);
+            }
+            const char* Module() const override
+            {
+                return (_record.Module);
+            }
+            const char* Data() const override
+            {
+                return (_record.Text);
+            }
+            uint16_t Length() const override
+            {
+                return (_record.Length);
+            }
+
+        private:
+            const Record& _record;
+        };
+
+        // Token bucket, refilled with "rate" tokens per second, holding at most one second worth.
+        struct Bucket {
+            uint64_t Refilled;
+            uint32_t Tokens;
+        };
+
     public:
+        TraceOutput() = delete;
         TraceOutput(const TraceOutput&) = delete;
         TraceOutput& operator=(const TraceOutput&) = delete;
 
-        TraceOutput(const bool syslogging, const bool abbreviated)
-            : _syslogging(syslogging)
+        // A fileSize of 0 lets the trace file grow without a limit.
+        TraceOutput(const uint8_t sinks, const bool abbreviated, const uint16_t queueSize, const uint32_t rate, const string& fileName, const uint32_t fileSize, const bool binary, Trace::ITraceMedia* remote)
+            : Core::Thread(Core::Thread::DefaultStackSize(), _T("TraceOutput"))
+            , _adminLock()
+            , _sinks(sinks)
             , _abbreviated(abbreviated)
+            , _binary(binary)
+            , _rate(rate)
+            , _ring(queueSize > 0 ? queueSize : 1)
+            , _head(0)
+            , _count(0)
+            , _dropped(0)
+            , _limited(0)
+            , _buckets()
+            , _file(fileName)
+            , _fileSize(fileSize)
+            , _written(0)
+            , _remote(remote)
+            , _line()
         {
+            if (((_sinks & LOGFILE) != 0) && (_file.Create() == false)) {
+                TRACE_L1("Could not create trace file %s", fileName.c_str());
+                _sinks &= ~LOGFILE;
+            }
+            _line.reserve(MaxTextLength + (4 * MaxNameLength));
         }
-        virtual ~TraceOutput()
+        ~TraceOutput() override
         {
+            Block();
+            Wait(Core::Thread::BLOCKED | Core::Thread::STOPPED, Core::infinite);
+
+            // Whatever is still pending, is written out on this thread.
+            Flush();
+
+            _file.Close();
+
+            if (_remote != nullptr) {
+                delete _remote;
+            }
         }
 
     public:
-        virtual void Output(const char fileName[], const uint32_t lineNumber, const char className[], const Trace::ITrace* information)
+        void Output(const char fileName[], const uint32_t lineNumber, const char className[], const Trace::ITrace* information) override
         {
-#ifndef __WINDOWS__
-            if (_syslogging == true) {
-                if( _abbreviated == true ) {
-                    string time(Core::Time::Now().ToTimeOnly(true));
-                    syslog(LOG_NOTICE, "[%s]: %s\n", time.c_str(), information->Data());
+            const uint64_t now = Core::Time::Now().Ticks();
+
+            _adminLock.Lock();
+
+            if (Allowed(information->Category(), now) == false) {
+                _limited++;
+            } else if (_count == _ring.size()) {
+                _dropped++;
+            } else {
+                Record& record(_ring[(_head + _count) % _ring.size()]);
+
+                record.Time = now;
+                record.Line = lineNumber;
+                Copy(record.File, Core::FileNameOnly(fileName));
+                Copy(record.ClassName, className);
+                Copy(record.Category, information->Category());
+                Copy(record.Module, information->Module());
+
+                if (information->Length() < MaxTextLength) {
+                    record.Length = information->Length();
+                    ::memcpy(record.Text, information->Data(), record.Length);
                 } else {
-                    string time(Core::Time::Now().ToRFC1123(true));
-                    syslog(LOG_NOTICE, "[%s]:[%s:%d] %s: %s\n", time.c_str(), Core::FileNameOnly(fileName), lineNumber, information->Category(), information->Data());
+                    // What is cut off, is marked as such, in every output.
+                    record.Length = MaxTextLength - 1;
+                    ::memcpy(record.Text, information->Data(), record.Length - TruncatedMarkerLength);
+                    ::memcpy(&(record.Text[record.Length - TruncatedMarkerLength]), TruncatedMarker, TruncatedMarkerLength);
                 }
-            } else
-#endif
-            {
-                if( _abbreviated == true ) {
-                    string time(Core::Time::Now().ToTimeOnly(true));
-                    printf("[%s]: %s\n", time.c_str(), information->Data());
+                record.Text[record.Length] = '\0';
+
+                _count++;
+            }
+
+            _adminLock.Unlock();
+
+            Run();
+        }
+
+    private:
+        template <size_t LENGTH>
+        static void Copy(char (&destination)[LENGTH], const char source[])
+        {
+            if (source == nullptr) {
+                destination[0] = '\0';
+            } else {
+                ::strncpy(destination, source, LENGTH - 1);
+                destination[LENGTH - 1] = '\0';
+            }
+        }
+        static uint32_t Hash(const char text[])
+        {
+            // FNV-1a, categories sharing a hash, just share a bucket.
+            uint32_t hash = 2166136261;
+
+            while ((text != nullptr) && (*text != '\0')) {
+                hash = (hash ^ static_cast<uint8_t>(*text++)) * 16777619;
+            }
+            return (hash);
+        }
+        // Needs to be called within the lock.
+        bool Allowed(const char category[], const uint64_t now)
+        {
+            bool result = true;
+
+            if (_rate != 0) {
+                Bucket& bucket(_buckets[Hash(category)]);
+
+                if (bucket.Refilled == 0) {
+                    bucket.Refilled = now;
+                    bucket.Tokens = _rate;
+                } else if (now > bucket.Refilled) {
+                    // Ticks are in microseconds.
+                    const uint64_t refill = ((now - bucket.Refilled) * _rate) / (1000 * 1000);
+
+                    if (refill > 0) {
+                        bucket.Tokens = static_cast<uint32_t>(std::min(static_cast<uint64_t>(_rate), bucket.Tokens + refill));
+                        bucket.Refilled = now;
+                    }
+                }
+
+                if (bucket.Tokens > 0) {
+                    bucket.Tokens--;
                 } else {
-                    string time(Core::Time::Now().ToRFC1123(true));
-                    printf("[%s]:[%s:%d] %s: %s\n", time.c_str(), Core::FileNameOnly(fileName), lineNumber, information->Category(), information->Data());
+                    result = false;
+                }
+            }
+
+            return (result);
+        }
+        // The console and the file always get the full format, the abbreviated format is for syslog.
+        void Format(const Record& record)
+        {
+            _line.clear();
+            _line.append(1, '[').append(Core::Time(record.Time).ToRFC1123(true)).append(_T("]:"));
+            _line.append(1, '[').append(record.File).append(1, ':').append(Core::NumberType<uint32_t>(record.Line).Text()).append(_T("] "));
+            _line.append(record.Category).append(_T(": "));
+            _line.append(record.Text, record.Length).append(1, '\n');
+        }
+        void Serialize(const Record& record, std::vector<uint8_t>& buffer) const
+        {
+            // Compact record: length(2) time(8) line(4) category(1+n) module(1+n) text(2+n)
+            const uint8_t categoryLength = static_cast<uint8_t>(::strlen(record.Category));
+            const uint8_t moduleLength = static_cast<uint8_t>(::strlen(record.Module));
+            const uint16_t length = static_cast<uint16_t>(2 + 8 + 4 + 1 + categoryLength + 1 + moduleLength + 2 + record.Length);
+            const size_t offset = buffer.size();
+
+            buffer.resize(offset + length);
+
+            uint8_t* data = &(buffer[offset]);
+            ::memcpy(data, &length, 2);
+            ::memcpy(&data[2], &record.Time, 8);
+            ::memcpy(&data[10], &record.Line, 4);
+            data[14] = categoryLength;
+            ::memcpy(&data[15], record.Category, categoryLength);
+            data[15 + categoryLength] = moduleLength;
+            ::memcpy(&data[16 + categoryLength], record.Module, moduleLength);
+            ::memcpy(&data[16 + categoryLength + moduleLength], &record.Length, 2);
+            ::memcpy(&data[18 + categoryLength + moduleLength], record.Text, record.Length);
+        }
+        void Write(const uint16_t first, const uint16_t count)
+        {
+            std::vector<uint8_t> batch;
+            std::vector<string> lines;
+
+            lines.reserve(count);
+
+            for (uint16_t index = 0; index < count; index++) {
+                const Record& record(_ring[(first + index) % _ring.size()]);
+
+                if ((_sinks & (CONSOLE | LOGFILE)) != 0) {
+                    if (((_sinks & LOGFILE) != 0) && (_binary == true)) {
+                        Serialize(record, batch);
+                    }
+                    if (((_sinks & CONSOLE) != 0) || (_binary == false)) {
+                        Format(record);
+                        lines.push_back(_line);
+                    }
+                }
+#ifndef __WINDOWS__
+                if ((_sinks & SYSLOG) != 0) {
+                    if (_abbreviated == true) {
+                        syslog(LOG_NOTICE, "[%s]: %s\n", Core::Time(record.Time).ToTimeOnly(true).c_str(), record.Text);
+                    } else {
+                        syslog(LOG_NOTICE, "[%s]:[%s:%d] %s: %s\n", Core::Time(record.Time).ToRFC1123(true).c_str(), record.File, record.Line, record.Category, record.Text);
+                    }
+                }
+#endif
+                if (_remote != nullptr) {
+                    RecordWrapper wrapper(record);
+                    _remote->Output(record.File, record.Line, record.ClassName, &wrapper);
+                }
+            }
+
+            if ((_sinks & CONSOLE) != 0) {
+                Emit(lines);
+            }
+            if ((_sinks & LOGFILE) != 0) {
+                uint32_t size = static_cast<uint32_t>(batch.size());
+
+                for (const string& line : lines) {
+                    size += static_cast<uint32_t>(line.length());
+                }
+
+                if ((_fileSize != 0) && (_written != 0) && ((_written + size) > _fileSize)) {
+                    Rotate();
+                }
+
+                if ((_sinks & LOGFILE) != 0) {
+                    if (_binary == true) {
+                        _file.Write(batch.data(), static_cast<uint32_t>(batch.size()));
+                    } else {
+                        for (const string& line : lines) {
+                            _file.Write(reinterpret_cast<const uint8_t*>(line.c_str()), static_cast<uint32_t>(line.length()));
+                        }
+                    }
+                    _written += size;
                 }
             }
         }
+        // Keeps one earlier file, so there is never more than twice the file size on disk.
+        void Rotate()
+        {
+            const string name(_file.Name());
+            const string previous(name + _T(".1"));
+
+            _file.Close();
+
+            if (::rename(name.c_str(), previous.c_str()) != 0) {
+                TRACE_L1("Could not move trace file %s aside, error: %d", name.c_str(), errno);
+            }
+
+            _written = 0;
+
+            if (_file.Create() == false) {
+                TRACE_L1("Could not create trace file %s", name.c_str());
+                _sinks &= ~LOGFILE;
+            }
+        }
+        void Emit(const std::vector<string>& lines) const
+        {
+#ifdef __WINDOWS__
+            for (const string& line : lines) {
+                fwrite(line.c_str(), 1, line.length(), stdout);
+            }
+            fflush(stdout);
+#else
+            // One system call for the whole batch.
+            struct iovec vector[MaxBatchSize];
+            uint16_t count = 0;
+
+            for (const string& line : lines) {
+                vector[count].iov_base = const_cast<char*>(line.c_str());
+                vector[count].iov_len = line.length();
+                count++;
+            }
+            if (count > 0) {
+                fflush(stdout);
+                if (::writev(STDOUT_FILENO, vector, count) < 0) {
+                    TRACE_L1("Could not write traces to the console, error: %d", errno);
+                }
+            }
+#endif
+        }
+        void Flush()
+        {
+            uint32_t dropped = 0;
+            uint32_t limited = 0;
+            uint16_t count;
+
+            do {
+                _adminLock.Lock();
+                const uint16_t first = _head;
+                count = static_cast<uint16_t>(std::min(static_cast<size_t>(MaxBatchSize), _count));
+                _adminLock.Unlock();
+
+                if (count > 0) {
+                    // The slots being written are not touched by Output(), it only appends.
+                    Write(first, count);
+
+                    _adminLock.Lock();
+                    _head = static_cast<uint16_t>((_head + count) % _ring.size());
+                    _count -= count;
+                    dropped = _dropped;
+                    limited = _limited;
+                    _dropped = 0;
+                    _limited = 0;
+                    _adminLock.Unlock();
+
+                    if ((dropped != 0) || (limited != 0)) {
+                        TRACE_L1("Trace output dropped %d traces (queue full) and %d traces (rate limited).", dropped, limited);
+                    }
+                }
+            } while (count == MaxBatchSize);
+        }
+        uint32_t Worker() override
+        {
+            Block();
+
+            Flush();
+
+            return (Core::infinite);
+        }
 
     private:
-        bool _syslogging;
-        bool _abbreviated;
+        Core::CriticalSection _adminLock;
+        uint8_t _sinks;
+        const bool _abbreviated;
+        const bool _binary;
+        const uint32_t _rate;
+        std::vector<Record> _ring;
+        uint16_t _head;
+        size_t _count;
+        uint32_t _dropped;
+        uint32_t _limited;
+        std::unordered_map<uint32_t, Bucket> _buckets;
+        Core::File _file;
+        const uint32_t _fileSize;
+        uint32_t _written;
+        Trace::ITraceMedia* _remote;
+        string _line;
     };
 }
 }
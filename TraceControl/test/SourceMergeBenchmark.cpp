@@ -0,0 +1,171 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../SourceMerge.h"
+#include "../../helpers/UnitTest.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+// Floods a growing number of sources, and drains them with the merge, in batches as the observer does,
+// and with a scan over all sources for every entry, as the observer did before.
+
+namespace {
+
+    const uint32_t Entries = 1000 * 1000;
+    const uint32_t Counts[] = { 1, 8, 32, 128 };
+    const uint16_t BatchSize = 64;
+
+    // A flooded source: all its entries are there already, in order of their timestamps.
+    class Source {
+    public:
+        enum state {
+            EMPTY,
+            LOADED,
+            FAILURE
+        };
+
+    public:
+        Source(const Source&) = delete;
+        Source& operator=(const Source&) = delete;
+
+        Source()
+            : _stamps()
+            , _next(0)
+            , _maxLag(0)
+        {
+        }
+
+    public:
+        void Produce(const uint64_t stamp)
+        {
+            _stamps.push_back(stamp);
+        }
+        void Rewind()
+        {
+            _next = 0;
+            _maxLag = 0;
+        }
+        state Load()
+        {
+            return (_next < _stamps.size() ? LOADED : EMPTY);
+        }
+        uint64_t Timestamp() const
+        {
+            return (_stamps[_next]);
+        }
+        void Dispatched(const uint64_t now)
+        {
+            _maxLag = std::max(_maxLag, now - _stamps[_next]);
+            _next++;
+        }
+        void Flush()
+        {
+        }
+
+    private:
+        std::vector<uint64_t> _stamps;
+        uint32_t _next;
+        uint64_t _maxLag;
+    };
+
+    double Merged(std::vector<std::unique_ptr<Source>>& sources, uint64_t& checksum)
+    {
+        SourceMerge<Source> merge;
+        uint16_t dispatched;
+
+        const auto start = std::chrono::steady_clock::now();
+
+        do {
+            merge.Clear();
+
+            for (std::unique_ptr<Source>& source : sources) {
+                merge.Enqueue(*source);
+            }
+
+            dispatched = merge.Drain(Entries, BatchSize, [&checksum](Source& selected) {
+                checksum = (checksum * 31) + selected.Timestamp();
+            });
+        } while (dispatched == BatchSize);
+
+        return (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    double Scanned(std::vector<std::unique_ptr<Source>>& sources, uint64_t& checksum)
+    {
+        Source* selected;
+
+        const auto start = std::chrono::steady_clock::now();
+
+        do {
+            selected = nullptr;
+
+            for (std::unique_ptr<Source>& source : sources) {
+                if ((source->Load() == Source::LOADED) && ((selected == nullptr) || (source->Timestamp() < selected->Timestamp()))) {
+                    selected = source.get();
+                }
+            }
+
+            if (selected != nullptr) {
+                checksum = (checksum * 31) + selected->Timestamp();
+                selected->Dispatched(Entries);
+            }
+        } while (selected != nullptr);
+
+        return (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+}
+
+int main()
+{
+    for (const uint32_t count : Counts) {
+        std::vector<std::unique_ptr<Source>> sources;
+        uint64_t merged = 0;
+        uint64_t scanned = 0;
+
+        ::srand(count);
+
+        for (uint32_t index = 0; index < count; index++) {
+            sources.emplace_back(new Source());
+        }
+
+        for (uint64_t stamp = 0; stamp < Entries; stamp++) {
+            sources[::rand() % count]->Produce(stamp);
+        }
+
+        const double heap = Merged(sources, merged);
+
+        for (std::unique_ptr<Source>& source : sources) {
+            source->Rewind();
+        }
+
+        const double scan = Scanned(sources, scanned);
+
+        // Both drained it all, in the same order.
+        CHECK(merged == scanned);
+
+        printf("%4u sources: merge %10.0f entries/s, scan %10.0f entries/s\n", count, Entries / heap, Entries / scan);
+    }
+
+    return (UnitTest::Result());
+}
@@ -0,0 +1,195 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../SourceMerge.h"
+#include "../../helpers/UnitTest.h"
+
+#include <cstdlib>
+#include <deque>
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+namespace {
+
+    const uint16_t BatchSize = 64;
+
+    // Stands in for the cyclic buffer of a process: entries in the order they were written, with the
+    // timestamp they were written at. An entry can be marked as one that does not load.
+    class Source {
+    public:
+        enum state {
+            EMPTY,
+            LOADED,
+            FAILURE
+        };
+
+    public:
+        Source(const Source&) = delete;
+        Source& operator=(const Source&) = delete;
+
+        Source(const uint32_t id)
+            : Id(id)
+            , Handled(0)
+            , Dropped(0)
+            , _entries()
+            , _state(EMPTY)
+        {
+        }
+
+    public:
+        void Produce(const uint64_t stamp, const bool corrupt = false)
+        {
+            _entries.emplace_back(stamp, corrupt);
+        }
+        state Load()
+        {
+            if ((_state == EMPTY) && (_entries.empty() == false)) {
+                _state = (_entries.front().second == true ? FAILURE : LOADED);
+            }
+            return (_state);
+        }
+        uint64_t Timestamp() const
+        {
+            return (_entries.front().first);
+        }
+        void Dispatched(const uint64_t)
+        {
+            _entries.pop_front();
+            Handled++;
+            _state = EMPTY;
+        }
+        void Flush()
+        {
+            Dropped += static_cast<uint32_t>(_entries.size());
+            _entries.clear();
+            _state = EMPTY;
+        }
+
+    public:
+        const uint32_t Id;
+        uint32_t Handled;
+        uint32_t Dropped;
+
+    private:
+        std::deque<std::pair<uint64_t, bool>> _entries;
+        state _state;
+    };
+
+    struct Output {
+        uint64_t Stamp;
+        uint32_t Id;
+    };
+
+    // As the observer does on a wake up: all sources in the merge, batch after batch, until one is not full.
+    std::vector<Output> Run(std::vector<Source*>& sources, uint32_t& batches)
+    {
+        SourceMerge<Source> merge;
+        std::vector<Output> result;
+        uint16_t dispatched;
+
+        batches = 0;
+
+        do {
+            merge.Clear();
+
+            for (Source* source : sources) {
+                merge.Enqueue(*source);
+            }
+
+            dispatched = merge.Drain(0, BatchSize, [&result](Source& selected) {
+                result.push_back({ selected.Timestamp(), selected.Id });
+            });
+
+            CHECK(dispatched <= BatchSize);
+
+            batches++;
+        } while (dispatched == BatchSize);
+
+        return (result);
+    }
+
+    // Every source in order of its own, interleaved at random with the others.
+    void TestOrder()
+    {
+        std::vector<Source*> sources;
+        uint32_t batches = 0;
+        uint32_t total = 0;
+
+        ::srand(5);
+
+        for (uint32_t index = 0; index < 16; index++) {
+            sources.push_back(new Source(index));
+        }
+
+        for (uint64_t stamp = 1; stamp <= 5000; stamp++) {
+            sources[::rand() % sources.size()]->Produce(stamp);
+            total++;
+        }
+
+        const std::vector<Output> output(Run(sources, batches));
+
+        CHECK(output.size() == total);
+        CHECK(batches == ((total / BatchSize) + 1));
+
+        for (uint32_t index = 1; index < output.size(); index++) {
+            CHECK(output[index - 1].Stamp < output[index].Stamp);
+        }
+
+        for (Source* source : sources) {
+            CHECK(source->Load() == Source::EMPTY);
+            delete source;
+        }
+    }
+
+    // Equal timestamps from different sources all make it, a source that fails is flushed and counted,
+    // the others go on.
+    void TestFailure()
+    {
+        Source first(1);
+        Source second(2);
+        Source third(3);
+        std::vector<Source*> sources({ &first, &second, &third });
+        uint32_t batches = 0;
+
+        first.Produce(10);
+        first.Produce(20);
+        second.Produce(10);
+        second.Produce(15, true);
+        second.Produce(30);
+        third.Produce(5);
+
+        const std::vector<Output> output(Run(sources, batches));
+
+        CHECK(output.size() == 4);
+        CHECK((output.size() == 4) && (output[0].Id == 3) && (output[3].Id == 1) && (output[3].Stamp == 20));
+        CHECK(first.Handled == 2);
+        CHECK(second.Handled == 1);
+        CHECK(second.Dropped == 2);
+        CHECK(third.Handled == 1);
+    }
+}
+
+int main()
+{
+    TestOrder();
+    TestFailure();
+
+    return (UnitTest::Result());
+}
@@ -22,410 +22,244 @@
 namespace WPEFramework {
 
 DataModel::DataModel(Handler* handler)
-    : _dmHandle(0)
-    , _handler(handler)
+    : _handler(handler)
+    , _nodes()
+    , _objects()
+    , _parameters()
 {
 }
 
 DataModel::~DataModel()
 {
-    if (_dmHandle) {
-        TiXmlDocument* doc = reinterpret_cast<TiXmlDocument*>(_dmHandle);
-        delete (doc);
-    }
 }
 
 DMStatus DataModel::LoadDM(const std::string& filename)
 {
-    TiXmlDocument* doc = new TiXmlDocument(filename.c_str());
+    TiXmlDocument doc(filename.c_str());
     DMStatus status = DM_FAILURE;
 
-    if (nullptr != doc) {
-        bool loadOK = doc->LoadFile();
-        if (loadOK) {
-            _dmHandle = reinterpret_cast<int>(doc);
+    _nodes.clear();
+    _objects.clear();
+    _parameters.clear();
+
+    if (doc.LoadFile() == true) {
+        // Goto actual Object node ie "Device."
+        const TiXmlElement* first = FirstObject(&doc);
+
+        if (first != nullptr) {
+            // The root of the trie, the empty path.
+            _nodes.push_back(Node());
+
+            for (const TiXmlElement* object = first; object != nullptr; object = object->NextSiblingElement("object")) {
+                Compile(object);
+            }
+            TRACE(Trace::Information, (_T("Data model compiled into %d nodes, %d parameters"), static_cast<uint32_t>(_nodes.size()), static_cast<uint32_t>(_parameters.size())));
             status = DM_SUCCESS;
-        } else {
-            _dmHandle = 0;
         }
-    } else {
-        _dmHandle = 0;
     }
+    // The document goes here, the compiled model holds all that is looked up.
     return status;
 }
 
-int16_t DataModel::ParameterInstanceCount(const std::string& paramName) const
+// The first object element, depth first. The objects might be preceded by other elements (a description,
+// imports), at any level.
+/* static */ const TiXmlElement* DataModel::FirstObject(const TiXmlNode* node)
 {
-    int16_t instanceCount = 0;
-
-    if (paramName.empty() != true) {
-        std::size_t found = paramName.find(InstanceNumberIndicator);
-        if (found != std::string::npos) {
-
-            // Get the number of instances from Adapter
-            std::string paramType;
-
-            if (IsValidParameter (paramName, paramType)) {
-                TRACE(Trace::Information, (_T( "Valid Parameter..! ")));
-                string name(paramName, 0, found - 1 );
-                Data param(name + "NumberOfEntries", static_cast<const int>(0));
-
-                FaultCode status = (static_cast<const Handler&>(*_handler)).Parameter(param);
-                if (status != FaultCode::NoFault) {
-                    TRACE(Trace::Error, (_T("[%s:%s:%d] Error in Get Message Handler : faultCode = %d"), __FILE__, __FUNCTION__, __LINE__, status));
-                } else {
-                    TRACE(Trace::Information, (_T("[%s:%s:%d] The value for param: %s is %d"), __FILE__, __FUNCTION__, __LINE__, param.Name().c_str(), param.Value().Integer()));
-                    instanceCount = param.Value().Integer();
-                }
+    const TiXmlElement* result = nullptr;
 
-            }
+    for (const TiXmlNode* child = node->FirstChild(); (child != nullptr) && (result == nullptr); child = child->NextSibling()) {
+        if (child->Type() == TiXmlNode::TINYXML_ELEMENT) {
+            result = (strcmp(child->Value(), "object") == 0 ? child->ToElement() : FirstObject(child));
         }
     }
-    return instanceCount;
-}
 
-
-void DataModel::ReplaceWithInstanceNumber(string& paramName, uint16_t instanceNumber) const
-{
-    if (paramName.empty() != true) {
-        std::size_t position = paramName.find(InstanceNumberIndicator);
-        if (position != std::string::npos) {
-            std::string number = std::to_string(instanceNumber);
-            paramName.replace(position, strlen(InstanceNumberIndicator) - 1, number);
-        }
-    }
+    return result;
 }
 
-bool DataModel::CheckMatchingParameter(const char* attrValue, const char* paramName, uint32_t& ret) const
+void DataModel::Compile(const TiXmlElement* object)
 {
-    bool status = false;
+    const char* objectName = object->Attribute("base");
 
-    int i = 10;
-    int inst = 0;
+    if (objectName != nullptr) {
+        Node& node = _nodes[Insert(objectName)];
 
-    while (true) {
-        if (!(*attrValue && *paramName && (*attrValue == *paramName))) {
+        for (const TiXmlElement* parameter = object->FirstChildElement("parameter"); parameter != nullptr; parameter = parameter->NextSiblingElement("parameter")) {
+            const char* name = parameter->Attribute("base");
+            const TiXmlElement* syntax = parameter->FirstChildElement("syntax");
+            const TiXmlElement* type = (syntax != nullptr ? syntax->FirstChildElement() : nullptr);
 
-            ret = 0;
-            if (*attrValue == '{' && *paramName >= 48 && *paramName <= 56) {
-                attrValue += 3;
-                while(*paramName &&* paramName != '.') {
-                    ret = ret*i + (*paramName - 48);
-                    paramName++;
-                    inst = ret;
-                }
-            } else {
-
-                ret = 0;
-                if (!*paramName) {
-                    if (!*attrValue && (*(attrValue - 2) == '}')) {
-                        ret = inst;
-                    }
-                    status = true;
+            if ((name != nullptr) && (type != nullptr)) {
+                const char* getIdx = parameter->Attribute("getIdx");
+
+                _parameters[objectName + std::string(name)] = type->Value();
+
+                if ((getIdx != nullptr) && (strtol(getIdx, nullptr, 10) >= 1)) {
+                    node.Parameters.emplace_back(name, type->Value());
                 }
-                break;
             }
         }
-        attrValue++;
-        paramName++;
     }
-    return status;
 }
 
-TiXmlNode* DataModel::Parameters(TiXmlNode* parent, const std::string& paramName, std::string& currentParam, std::map<uint32_t, std::pair<std::string, std::string>>& paramList) const
+uint32_t DataModel::Insert(const std::string& objectName)
 {
-    // If parent is Null Return
-    if (!parent) {
-        return nullptr;
-    }
+    uint32_t parent = 0;
+    std::size_t offset = 0;
+    std::size_t end;
 
-    int isReccursiveCall = 0;
-    // Identify whether the call is recursive or initial call
-    if (currentParam.empty() != true) {
-        isReccursiveCall = 1;
-    }
+    // Every step towards the object gets a node, not all of them are objects in the model.
+    while ((end = objectName.find('.', offset)) != std::string::npos) {
+        const std::string path(objectName, 0, end + 1);
+        std::unordered_map<std::string, uint32_t>::const_iterator index(_objects.find(path));
 
-    TiXmlNode* child;
-    // Goto actual Object node ie "Device."
-    if (parent->Type() != TiXmlNode::TINYXML_ELEMENT) {
-        for (child = parent->FirstChild(); child != 0;) {
-            if (child->Type() != TiXmlNode::TINYXML_ELEMENT) {
-                child = child->NextSibling();
-            } else {
-                if (!strcmp (child->Value(), "object"))
-                    break;
-                child = child->FirstChild();
-            }
+        if (index != _objects.end()) {
+            parent = index->second;
+        } else {
+            const uint32_t node = static_cast<uint32_t>(_nodes.size());
+
+            _nodes.push_back(Node());
+            _nodes[node].Segment.assign(objectName, offset, end + 1 - offset);
+            _nodes[parent].Children.push_back(node);
+            _objects.emplace(path, node);
+            parent = node;
         }
-    } else {
-        child = parent;
+        offset = end + 1;
     }
 
-    std::string zeroInstance;
-    while (child) {
-        TiXmlElement* pElement =  child->ToElement();
-        TiXmlAttribute* pAttrib = pElement->FirstAttribute();
-        uint32_t inst = 0;
-        int status = 0;
-
-        // Check if node is an Object
-        if (!strcmp(child->Value(),"object")) {
-            if (strstr(pAttrib->Value(), paramName.c_str()) || (status = CheckMatchingParameter(pAttrib->Value(), paramName.c_str(), inst))) {
-                // If the number of instances are 0 then skip this object and go to next sibling
-                if ((zeroInstance.empty() != true) && strstr(pAttrib->Value(), zeroInstance.c_str())) {
-                    child = child->NextSibling();
-                    continue;
-                } else if (zeroInstance.empty() != true) {
-                    zeroInstance = "";
-                }
-                // If matching found update the current parameter with wild card input std::string
-                if (status && !isReccursiveCall) {
-                    currentParam = paramName;
-                }
-                currentParam = pAttrib->Value();
-                TiXmlNode* bChild, *sChild;
-                bChild = child;
-                // Goto the parameters
-                child = child->FirstChild();
-
-                // Object not having any parameter thus go to next Sibling
-                if (nullptr == child) {
-                    child = bChild->NextSibling();
-                }
+    return parent;
+}
 
-                char* endPtr = nullptr;
-                const std::string maxEntries = pElement->Attribute("maxEntries");
-                // Seems like a {i} instance
-                if (maxEntries.empty() != true && ((!strcmp(maxEntries.c_str(),"unbounded")) || (strtol(maxEntries.c_str(), &endPtr, 10) > 1))) {
-                    // Make Sure that its ends with {i}
-                    if (IsParamEndsWithInstance(pAttrib->Value()) == true ) {
-                        uint16_t instanceNumber = 0;
-                        uint16_t i = 1;
-                        // Get the Number of instances for that attribute
-                        uint16_t actualInstance = ParameterInstanceCount(pAttrib->Value());
-                        if (inst) {
-                            // Check if valid instance count is given in input wild card if not make it as zero, this will skip current branch
-                            if (actualInstance >= inst)
-                                i = instanceNumber = inst;
-                            else
-                                instanceNumber = 0;
-                        } else {
-                            instanceNumber = actualInstance;
-
-                        }
-                        sChild = child;
-                        // Number of instances are > 0 go through each and populate data for each instance
-                        std::string tempParamName;
-                        while (i <= instanceNumber) {
-                            tempParamName = child->Parent()->ToElement()->FirstAttribute()->Value();
-                            currentParam = tempParamName;
-
-                            // Replace {i} with current instance number and call recursively
-                            ReplaceWithInstanceNumber(currentParam, i);
-
-                            sChild = Parameters(child, tempParamName, currentParam, paramList);
-                            i++;
-                        }
-                        child = sChild;
-                        // Seems like instance count is empty
-                        if (!instanceNumber) {
-                            zeroInstance = pAttrib->Value();
-                            child = child->Parent();
-                        }
-                    }
-                }
-            }
-            else if (isReccursiveCall) { // Tree found once and processed and going to another branch so break
-                return child;
-            }
-            else { // Tree not found yet goto next sibling and get it
-                child = child->NextSibling();
-            }
+// Finds the path, as in the model, of the given object or parameter name, where every instance number
+// can stand for a {i}. A name is taken literally first.
+bool DataModel::Template(const std::string& paramName, std::size_t offset, std::string& path) const
+{
+    bool found = false;
+    const std::size_t length = path.length();
+    const std::size_t end = paramName.find('.', offset);
+
+    if (end == std::string::npos) {
+        path.append(paramName, offset, std::string::npos);
+        found = (_parameters.find(path) != _parameters.end());
+    } else {
+        path.append(paramName, offset, end + 1 - offset);
+        if (_objects.find(path) != _objects.end()) {
+            found = (((end + 1) == paramName.length()) || (Template(paramName, end + 1, path) == true));
         }
-        // Found the Parameter
-        else if (!strcmp(child->Value(),"parameter")) {
-            TiXmlNode* bChild;
-            // Find all parameters
-            for (bChild = child ; child ; child=child->NextSibling()) {
-                if (paramList.size() <= MaxNumParameters) {
-                    if (currentParam.length() > 0) {
-                        if (child->ToElement()->Attribute("getIdx") && strtol(child->ToElement()->Attribute("getIdx"),nullptr,10) >= 1) {
-                            paramList.insert(std::make_pair(paramList.size(), std::make_pair(currentParam + child->ToElement()->FirstAttribute()->Value(), child->FirstChild()->FirstChild()->Value())));
-                        }
-                    }
-                }
+
+        if ((found == false) && (end > offset) && (paramName.find_first_not_of("0123456789", offset) == end)) {
+            path.resize(length);
+            path += InstanceNumberIndicator;
+            if (_objects.find(path) != _objects.end()) {
+                found = (((end + 1) == paramName.length()) || (Template(paramName, end + 1, path) == true));
             }
-            // Go to next object
-            child = bChild->Parent();
-            child = child->NextSibling();
         }
     }
-    return child;
-}
 
-DMStatus DataModel::Parameters(const std::string& paramName, std::map<uint32_t, std::pair<std::string, std::string>>& paramList) const
-{
-    std::string currentParam;
-    std::string parameterName = paramName;
-
-    ASSERT(_dmHandle != 0);
-    DMStatus status = DM_SUCCESS;
-    if (Utils::IsWildCardParam(parameterName)) {
-        Parameters(reinterpret_cast<TiXmlDocument*>(_dmHandle), parameterName, currentParam, paramList);
-        if (paramList.size() == 0) {
-            status = DM_ERR_INVALID_PARAMETER;
-        }
-    } else {
-        status = DM_ERR_WILDCARD_NOT_SUPPORTED;
+    if (found == false) {
+        path.resize(length);
     }
-    return status;
+    return found;
 }
 
-void DataModel::CheckforParameterMatch(TiXmlNode* parent, const std::string& paramName, bool& match, std::string& dataType) const
+void DataModel::Collect(const uint32_t node, std::string& currentParam, std::map<uint32_t, std::pair<std::string, std::string>>& paramList) const
 {
-    if (!parent)
-        return;
-
-    static bool isObject = false;
-    static bool isMatched = false;
-
-    if (parent->Type() == TiXmlNode::TINYXML_ELEMENT) {
-        TiXmlElement* pElement = parent->ToElement();
-        TiXmlAttribute* pAttrib = pElement->FirstAttribute();
-        if (!strcmp(parent->Value(), "object")) {
-            isObject = true;
-        }
-
-        if (pAttrib) {
-            // Construct Object without parameter from input ParamName
-            std::size_t found = paramName.find_last_of(".");
-
-            std::string tempObject;
-            if (found != std::string::npos) {
-                tempObject.assign(paramName, 0, found + 1);
-            } else {
-                tempObject = paramName;
-            }
+    const Node& object = _nodes[node];
 
-            static std::string objectName;
-            if (!strcmp(pAttrib->Value(), tempObject.c_str())) {
-                objectName = pAttrib->Value();
-                isMatched = true;
-            }
-
-            if (isMatched || !isObject) {
-                if (objectName == paramName) {
-                    match = true;
-                    return;
-                } else {
-                    isObject = 0;
-                    if (!strcmp(parent->Value(), "parameter")) {
-                        std::string nameFromParamater = objectName + pAttrib->Value();
-
-                        if ((objectName + pAttrib->Value()) == paramName) {
-                            dataType = parent->FirstChild()->FirstChild()->Value();
-                            match = true;
-                            return;
-                        }
-                    }
-                }
-            }
+    for (const std::pair<std::string, std::string>& parameter : object.Parameters) {
+        if (paramList.size() >= MaxNumParameters) {
+            return;
         }
+        paramList.insert(std::make_pair(paramList.size(), std::make_pair(currentParam + parameter.first, parameter.second)));
     }
 
-    for (TiXmlNode* child = parent->FirstChild(); child != 0; child = child->NextSibling()) {
-        CheckforParameterMatch(child, paramName, match, dataType);
-        if (match == true) {
-            break;
+    const std::size_t length = currentParam.length();
+    for (const uint32_t child : object.Children) {
+        const std::string& segment = _nodes[child].Segment;
+
+        if (segment == InstanceNumberIndicator) {
+            // Populate data for each instance the table has now
+            const uint16_t instances = ParameterInstanceCount(currentParam);
+            for (uint16_t i = 1; (i <= instances) && (paramList.size() < MaxNumParameters); ++i) {
+                currentParam += std::to_string(i);
+                currentParam += '.';
+                Collect(child, currentParam, paramList);
+                currentParam.resize(length);
+            }
+        } else if (paramList.size() < MaxNumParameters) {
+            currentParam += segment;
+            Collect(child, currentParam, paramList);
+            currentParam.resize(length);
         }
     }
-    isMatched = 0;
 }
 
-uint8_t DataModel::FindInstanceOccurance(const std::string& paramName, std::map<uint8_t, std::pair<std::size_t, std::size_t>>& positions) const
+uint16_t DataModel::ParameterInstanceCount(const std::string& tableName) const
 {
-    uint8_t count = 0;
-    std::string name = paramName;
-    std::size_t separator = 0;
-    while (true) {
-        std::size_t position =  name.find_first_of("0123456789", separator);
-        if (position != std::string::npos) {
-            separator = name.find(".", position);
-            if (separator != std::string::npos) {
-                positions.insert(std::make_pair(count, std::make_pair(position, separator)));
-                count++;
-            } else {
-                break;
-            }
+    uint16_t instanceCount = 0;
+
+    if (tableName.length() > 1) {
+        // Get the number of instances from Adapter, ie Device.WiFi.SSIDNumberOfEntries for Device.WiFi.SSID.
+        Data param(std::string(tableName, 0, tableName.length() - 1) + "NumberOfEntries", static_cast<const int>(0));
+
+        FaultCode status = (static_cast<const Handler&>(*_handler)).Parameter(param);
+        if (status != FaultCode::NoFault) {
+            TRACE(Trace::Error, (_T("[%s:%s:%d] Error in Get Message Handler : faultCode = %d"), __FILE__, __FUNCTION__, __LINE__, status));
         } else {
-            break;
+            TRACE(Trace::Information, (_T("[%s:%s:%d] The value for param: %s is %d"), __FILE__, __FUNCTION__, __LINE__, param.Name().c_str(), param.Value().Integer()));
+            instanceCount = static_cast<uint16_t>(param.Value().Integer());
         }
     }
-
-    return count;
+    return instanceCount;
 }
 
-bool DataModel::ValidateParameterInstance(const std::string& paramName, std::string& dataType) const
+DMStatus DataModel::Parameters(const std::string& paramName, std::map<uint32_t, std::pair<std::string, std::string>>& paramList) const
 {
-    bool valid = false;
-
-    std::map<uint8_t, std::pair<std::size_t, std::size_t>> positions;
-    uint8_t occurrences = FindInstanceOccurance(paramName, positions);
-
-    for (uint8_t i = occurrences; (i > 0) && (valid != true); --i) {
-        uint8_t index = occurrences - i;
-
-        std::string tempName = paramName;
-        std::map<uint8_t, std::pair<std::size_t, std::size_t>>::iterator position = positions.find(index);
-        if (positions.end() != position) {
-            tempName.replace(position->second.first, ((position->second.second + 1) - position->second.first), InstanceNumberIndicator);
-            uint16_t maxCombinations = pow(2, i - 1);
-            for (uint16_t j = 0; j < maxCombinations; ++j) {
-                std::string name = tempName;
-                int8_t newPosition = 0;
-                for (uint8_t k = 0; k < i; ++k) {
-                    if ((j & (1 << k))) {
-
-                        index = (occurrences - 1) - k;
-                        std::map<uint8_t, std::pair<std::size_t, std::size_t>>::iterator position = positions.find(index);
-                        if (positions.end() != position) {
-
-                            newPosition = strlen(InstanceNumberIndicator) - ((position->second.second + 1) - position->second.first);
-                            name.replace(position->second.first + newPosition, ((position->second.second + 1) - position->second.first), InstanceNumberIndicator);
-                        }
-                    }
-                }
-                CheckforParameterMatch(reinterpret_cast<TiXmlDocument*>(_dmHandle), name, valid, dataType);
-                if (valid == true) {
-                    break;
+    ASSERT(_nodes.empty() == false);
+    DMStatus status = DM_SUCCESS;
+
+    if (Utils::IsWildCardParam(paramName)) {
+        std::string path;
+
+        if (Template(paramName, 0, path) == true) {
+            // The instance numbers in the wild card should exist, or there is nothing to populate.
+            bool valid = true;
+            std::size_t position = 0;
+
+            while ((valid == true) && ((position = path.find(InstanceNumberIndicator, position)) != std::string::npos)) {
+                // The segments before it are the same, so is the number of them.
+                const uint8_t segments = static_cast<uint8_t>(std::count(path.begin(), path.begin() + position, '.'));
+                std::size_t offset = 0;
+                for (uint8_t i = 0; i < segments; ++i) {
+                    offset = paramName.find('.', offset) + 1;
                 }
+                const uint32_t instance = strtoul(paramName.c_str() + offset, nullptr, 10);
+                valid = ((instance >= 1) && (instance <= ParameterInstanceCount(paramName.substr(0, offset))));
+                position += strlen(InstanceNumberIndicator);
+            }
+
+            if (valid == true) {
+                std::string currentParam(paramName);
+                Collect(_objects.find(path)->second, currentParam, paramList);
             }
         }
+        if (paramList.size() == 0) {
+            status = DM_ERR_INVALID_PARAMETER;
+        }
+    } else {
+        status = DM_ERR_WILDCARD_NOT_SUPPORTED;
     }
-    return valid;
+    return status;
 }
 
 bool DataModel::IsValidParameter(const std::string& paramName, std::string& dataType) const
 {
-    bool valid = false;
-    ASSERT(_dmHandle != 0);
-    CheckforParameterMatch(reinterpret_cast<TiXmlDocument*>(_dmHandle), paramName, valid, dataType);
-    if (valid != true) {
-        valid = ValidateParameterInstance(paramName, dataType);
-    }
-    return valid;
-}
-
-bool DataModel::IsParamEndsWithInstance(const std::string& paramName) const
-{
-    bool isInstance = false;
+    ASSERT(_nodes.empty() == false);
+    std::string path;
 
-    if (paramName.empty() != true) {
-        std::size_t position = paramName.find(string(InstanceNumberIndicator));
-        if ((position != std::string::npos) && ((position + strlen(InstanceNumberIndicator)) != std::string::npos)) {
-            isInstance = true;
-        }
+    bool valid = Template(paramName, 0, path);
+    if ((valid == true) && (Utils::IsWildCardParam(path) != true)) {
+        dataType = _parameters.find(path)->second;
     }
-    return isInstance;
+    return valid;
 }
 }
@@ -23,6 +23,7 @@
 #include "Utils.h"
 
 #include <tinyxml.h>
+#include <unordered_map>
 
 namespace WPEFramework {
 
@@ -37,11 +38,22 @@ typedef enum
 }
 DMStatus;
 
+// The XML data model is compiled once, by LoadDM, into a trie of the object paths. Every node is an
+// object (or a step towards one) with the parameters it holds, an instance object ({i}.) is a child
+// node of its table. Every object and parameter path is also hashed, so a name is resolved segment by
+// segment, without walking the document. After LoadDM the model is read only, so lookups from
+// several threads need no locking.
 class DataModel {
 private:
     static constexpr const uint32_t  MaxNumParameters = 2048;
     static constexpr const TCHAR* InstanceNumberIndicator = "{i}.";
 
+    struct Node {
+        std::string Segment; // "Name." or "{i}."
+        std::vector<uint32_t> Children; // in document order
+        std::vector<std::pair<std::string, std::string>> Parameters; // name and data type, gettable ones only
+    };
+
 public:
     DataModel() = delete;
     DataModel(const DataModel&) = delete;
@@ -53,20 +65,20 @@ public:
     DMStatus LoadDM(const std::string& filename);
     DMStatus Parameters(const std::string& paramName, std::map<uint32_t, std::pair<std::string, std::string>>& paramList) const;
     bool IsValidParameter(const std::string& paramName, std::string& dataType) const;
-    int DMHandle() { return _dmHandle; }
+    int DMHandle() const { return (_nodes.empty() == true ? 0 : 1); }
 
 private:
-    TiXmlNode* Parameters(TiXmlNode* pParent, const std::string& paramName, std::string& currentParam, std::map<uint32_t, std::pair<std::string, std::string>>& paramList) const;
-    void CheckforParameterMatch(TiXmlNode *pParent, const std::string& paramName, bool& pMatch, std::string& dataType) const;
-    bool IsParamEndsWithInstance(const std::string& paramName) const;
-    void ReplaceWithInstanceNumber(string& paramName, uint16_t instanceNumber) const;
-    bool CheckMatchingParameter(const char* attrValue, const char* paramName, uint32_t& ret) const;
-    bool ValidateParameterInstance(const std::string& paramName, std::string& dataType) const;
-    uint8_t FindInstanceOccurance(const std::string& paramName, std::map<uint8_t, std::pair<std::size_t, std::size_t>>& positions) const;
-    int16_t ParameterInstanceCount(const std::string& paramName) const;
+    static const TiXmlElement* FirstObject(const TiXmlNode* node);
+    void Compile(const TiXmlElement* object);
+    uint32_t Insert(const std::string& objectName);
+    bool Template(const std::string& paramName, std::size_t offset, std::string& path) const;
+    void Collect(const uint32_t node, std::string& currentParam, std::map<uint32_t, std::pair<std::string, std::string>>& paramList) const;
+    uint16_t ParameterInstanceCount(const std::string& tableName) const;
 
 private:
-    int _dmHandle;
     Handler* _handler;
+    std::vector<Node> _nodes;
+    std::unordered_map<std::string, uint32_t> _objects; // object path, as in the model, to its node
+    std::unordered_map<std::string, std::string> _parameters; // parameter path, as in the model, to its data type
 };
 }
@@ -0,0 +1,121 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DataModel.h"
+#include "../../../../helpers/UnitTest.h"
+
+#include <chrono>
+
+using namespace WPEFramework;
+
+// Wildcard GET latency on the shipped data-model.xml, with 4 instances in every table, and the lookup of
+// a single parameter, as a SET does. The number of parameters every wildcard returns is what the model
+// holds, so a change to how it is compiled or walked that loses or repeats one, shows here too.
+
+namespace {
+
+    const int Instances = 4;
+    const uint32_t Rounds = 2000;
+
+    struct Wildcard {
+        const TCHAR* Name;
+        uint32_t Parameters;
+    };
+
+    const Wildcard Wildcards[] = {
+        { _T("Device."), 2048 }, // all of it is more than a GET returns
+        { _T("Device.DeviceInfo."), 164 },
+        { _T("Device.DeviceInfo.ProcessStatus."), 26 },
+        { _T("Device.DSL.Line.2."), 98 },
+        { _T("Device.DSL.BondingGroup.1.BondedChannel.3."), 10 }
+    };
+
+    void Get(const DataModel& model, const Wildcard& wildcard)
+    {
+        std::map<uint32_t, std::pair<std::string, std::string>> parameters;
+        bool valid = true;
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (uint32_t round = 0; round < Rounds; round++) {
+            parameters.clear();
+            valid = (model.Parameters(wildcard.Name, parameters) == DM_SUCCESS) && (valid == true);
+        }
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        CHECK(valid == true);
+        CHECK(parameters.size() == wildcard.Parameters);
+        CHECK((parameters.empty() == true) || (parameters.begin()->second.first.compare(0, ::strlen(wildcard.Name), wildcard.Name) == 0));
+
+        printf("GET %-44s %5u parameters: %9.1f us\n", wildcard.Name, static_cast<uint32_t>(parameters.size()), (seconds * 1000000) / Rounds);
+    }
+
+    void Lookup(const DataModel& model, const TCHAR name[], const bool expected, const TCHAR type[])
+    {
+        std::string dataType;
+        bool valid = false;
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (uint32_t round = 0; round < (Rounds * 100); round++) {
+            valid = model.IsValidParameter(name, dataType);
+        }
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        CHECK(valid == expected);
+        CHECK((expected == false) || (dataType == type));
+
+        printf("SET %-44s %-5s: %9.3f us\n", name, (valid == true ? _T("valid") : _T("not")), (seconds * 1000000) / (Rounds * 100));
+    }
+}
+
+int main()
+{
+    {
+        Handler handler(Instances);
+        DataModel model(&handler);
+
+        const auto start = std::chrono::steady_clock::now();
+
+        CHECK(model.LoadDM(DATA_MODEL) == DM_SUCCESS);
+
+        printf("Compiled %s in %.1f ms\n", DATA_MODEL, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000);
+
+        if (model.DMHandle() != 0) {
+            for (const Wildcard& wildcard : Wildcards) {
+                Get(model, wildcard);
+            }
+
+            // Instance numbers beyond what the table has, do not exist.
+            std::map<uint32_t, std::pair<std::string, std::string>> parameters;
+            CHECK(model.Parameters(_T("Device.DSL.Line.5."), parameters) == DM_ERR_INVALID_PARAMETER);
+            CHECK(parameters.empty() == true);
+
+            Lookup(model, _T("Device.DeviceInfo.Manufacturer"), true, _T("string"));
+            Lookup(model, _T("Device.DSL.Line.3.Stats.Total.ErroredSecs"), true, _T("unsignedInt"));
+            Lookup(model, _T("Device.DeviceInfo.NoSuchParameter"), false, _T(""));
+        }
+    }
+
+    Core::Singleton::Dispose();
+
+    return (UnitTest::Result());
+}
@@ -0,0 +1,61 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+#include "IAdapter.h"
+
+namespace WPEFramework {
+
+// Stands in for the handler of the adapter, found ahead of Handler/Handler.h by the tests. All the data
+// model asks it for are the <table>NumberOfEntries, it has the same number of instances for every table,
+// without going through the profiles.
+class Handler {
+public:
+    Handler(const Handler&) = delete;
+    Handler& operator=(const Handler&) = delete;
+
+    Handler(const int instances)
+        : _instances(instances)
+        , _requests(0)
+    {
+    }
+    ~Handler()
+    {
+    }
+
+public:
+    const FaultCode Parameter(Data& value) const
+    {
+        _requests++;
+        value.Value(Variant(_instances));
+        return (FaultCode::NoFault);
+    }
+    uint32_t Requests() const
+    {
+        return (_requests);
+    }
+
+private:
+    const int _instances;
+    mutable uint32_t _requests;
+};
+
+}
@@ -101,20 +101,28 @@ namespace Plugin {
                     , Path()
                     , Subst()
                     , Server()
+                    , Connections(0)
+                    , Pipeline(0)
                 {
                     Add(_T("path"), &Path);
                     Add(_T("subst"), &Subst);
                     Add(_T("server"), &Server);
+                    Add(_T("connections"), &Connections);
+                    Add(_T("pipeline"), &Pipeline);
                 }
                 Proxy(const Proxy& copy)
                     : Core::JSON::Container()
                     , Path(copy.Path)
                     , Subst(copy.Subst)
                     , Server(copy.Server)
+                    , Connections(copy.Connections)
+                    , Pipeline(copy.Pipeline)
                 {
                     Add(_T("path"), &Path);
                     Add(_T("subst"), &Subst);
                     Add(_T("server"), &Server);
+                    Add(_T("connections"), &Connections);
+                    Add(_T("pipeline"), &Pipeline);
                 }
                 virtual ~Proxy()
                 {
@@ -124,6 +132,8 @@ namespace Plugin {
                 Core::JSON::String Path;
                 Core::JSON::String Subst;
                 Core::JSON::String Server;
+                Core::JSON::DecUInt8 Connections; // 0 is the global setting
+                Core::JSON::DecUInt8 Pipeline; // 0 is the global setting
             };
 
         public:
@@ -134,12 +144,16 @@ namespace Plugin {
                 , Interface()
                 , Path(_T("www"))
                 , IdleTime(180)
+                , Connections(4)
+                , Pipeline(1)
             {
                 Add(_T("port"), &Port);
                 Add(_T("binding"), &Binding);
                 Add(_T("interface"), &Interface);
                 Add(_T("path"), &Path);
                 Add(_T("idletime"), &IdleTime);
+                Add(_T("connections"), &Connections);
+                Add(_T("pipeline"), &Pipeline);
                 Add(_T("proxies"), &Proxies);
             }
             ~Config()
@@ -152,6 +166,8 @@ namespace Plugin {
             Core::JSON::String Interface;
             Core::JSON::String Path;
             Core::JSON::DecUInt16 IdleTime;
+            Core::JSON::DecUInt8 Connections; // Connections per proxied server
+            Core::JSON::DecUInt8 Pipeline; // Requests in flight per connection, 1 is no pipelining
             Core::JSON::ArrayType<Proxy> Proxies;
         };
 
@@ -198,12 +214,14 @@ namespace Plugin {
         };
 
         // IMPORTANT NOTE:
-        // There is no need to lock/unlock usage on this server as all action->response senarious take place on
-        // the communication thread from the SoketPortMonitor. There is only 1 such thread per process.
-        // Given this, make sure that all actions done by the ProxyMap are deterministic and short <100ms as it
-        // upholds all other network traffic.
+        // All action->response senarious take place on the communication thread from the SoketPortMonitor. There
+        // is only 1 such thread per process. Given this, make sure that all actions done by the ProxyMap are
+        // deterministic and short <100ms as it upholds all other network traffic. Only the list of proxies is
+        // locked, it is changed over COM-RPC and reported on from the timer thread.
         class ProxyMap {
         private:
+            class Upstream;
+
             class OutgoingChannel : public Web::WebLinkType<Core::SocketStream, Web::Response, Web::Request, ResponseFactory> {
             private:
                 OutgoingChannel() = delete;
@@ -213,38 +231,36 @@ namespace Plugin {
                 struct OutstandingMessage {
                     Core::ProxyType<Web::Request> Request;
                     uint32_t Id;
+                    uint64_t Issued;
                 };
 
             public:
-                OutgoingChannel(const string& path, const string& replacement, ProxyMap& proxyMap, const Core::NodeId& remoteId)
+                OutgoingChannel(Upstream& upstream, const Core::NodeId& remoteId, const uint8_t pipeline)
                     : Web::WebLinkType<Core::SocketStream, Web::Response, Web::Request, ResponseFactory>(2, false, remoteId.AnyInterface(), remoteId, 1024, 1024)
-                    , _path(path)
-                    , _replacement(replacement)
+                    , _upstream(upstream)
+                    , _pipeline(pipeline > 0 ? pipeline : 1)
+                    , _submitted(0)
                     , _outstandingMessages()
-                    , _proxyMap(proxyMap)
                 {
                 }
 
                 void ProxyRequest(Core::ProxyType<Web::Request>& request, uint32_t id)
                 {
-
-                    OutstandingMessage message = { request, id };
+                    OutstandingMessage message = { request, id, Core::Time::Now().Ticks() };
 
                     _outstandingMessages.push_back(message);
 
-                    if (_outstandingMessages.size() == 1) {
-                        if (IsOpen() == false) {
-                            Open(0);
-                        } else {
-                            Submit(request);
-                        }
+                    if (IsOpen() == true) {
+                        Pump();
+                    } else if (_outstandingMessages.size() == 1) {
+                        Open(0);
                     }
                 }
 
             public:
-                inline const string& Path() const
+                inline uint32_t Outstanding() const
                 {
-                    return (_path);
+                    return (static_cast<uint32_t>(_outstandingMessages.size()));
                 }
                 virtual void LinkBody(Core::ProxyType<Web::Response>& response)
                 {
@@ -252,7 +268,7 @@ namespace Plugin {
                 }
                 virtual void Send(const Core::ProxyType<Web::Request>& request)
                 {
-                    std::list<OutstandingMessage>::iterator index(_outstandingMessages.begin());
+                    std::deque<OutstandingMessage>::iterator index(_outstandingMessages.begin());
 
                     while ((index != _outstandingMessages.end()) && (index->Request.IsValid() == false)) {
                         index++;
@@ -267,20 +283,168 @@ namespace Plugin {
                 virtual void StateChange()
                 {
                     if (IsOpen() == true) {
+                        Pump();
+                    } else {
+                        Abandon();
+                    }
+                }
+                virtual void Received(Core::ProxyType<Web::Response>& response);
+
+            private:
+                // Keep up to the pipeline depth of requests in flight, responses arrive in the same order.
+                void Pump()
+                {
+                    while ((_submitted < _outstandingMessages.size()) && (_submitted < _pipeline)) {
+                        ASSERT(_outstandingMessages[_submitted].Request.IsValid() == true);
 
-                        if (!_outstandingMessages.empty()) {
-                            Submit(_outstandingMessages.front().Request);
+                        Submit(_outstandingMessages[_submitted].Request);
+                        _submitted++;
+                    }
+                }
+                // The server closed the connection, or could not be reached. Nothing outstanding will
+                // be answered anymore, do not leave the clients waiting for it.
+                void Abandon();
+
+            private:
+                Upstream& _upstream;
+                const uint8_t _pipeline;
+                uint8_t _submitted;
+                std::deque<OutstandingMessage> _outstandingMessages;
+            };
+
+            // Latency of the proxied requests, from relaying it till the response is received, in
+            // buckets of powers of two milliseconds: <= 1ms, <= 2ms, ..., <= 1024ms and anything above.
+            // It is reported from the timer thread, hence the lock.
+            class Histogram {
+            public:
+                static constexpr uint8_t Buckets = 12;
+
+                Histogram(const Histogram&) = delete;
+                Histogram& operator=(const Histogram&) = delete;
+
+                Histogram()
+                    : _adminLock()
+                    , _buckets()
+                    , _count(0)
+                {
+                    ::memset(_buckets, 0, sizeof(_buckets));
+                }
+                ~Histogram()
+                {
+                }
+
+            public:
+                void Add(const uint64_t microseconds)
+                {
+                    uint64_t limit = 1000;
+                    uint8_t index = 0;
+
+                    while ((index < (Buckets - 1)) && (microseconds > limit)) {
+                        limit <<= 1;
+                        index++;
+                    }
+
+                    _adminLock.Lock();
+                    _buckets[index]++;
+                    _count++;
+                    _adminLock.Unlock();
+                }
+                string ToString() const
+                {
+                    string result;
+
+                    _adminLock.Lock();
+
+                    for (uint8_t index = 0; index < Buckets; index++) {
+                        if (_buckets[index] != 0) {
+                            result += (index < (Buckets - 1) ? _T("<=") : _T(">")) + Core::NumberType<uint32_t>(1 << (index < (Buckets - 1) ? index : index - 1)).Text() + _T("ms:") + Core::NumberType<uint32_t>(_buckets[index]).Text() + _T(" ");
                         }
                     }
+
+                    _adminLock.Unlock();
+
+                    return (result);
+                }
+                uint32_t Count() const
+                {
+                    _adminLock.Lock();
+                    const uint32_t result = _count;
+                    _adminLock.Unlock();
+
+                    return (result);
+                }
+
+            private:
+                mutable Core::CriticalSection _adminLock;
+                uint32_t _buckets[Buckets];
+                uint32_t _count;
+            };
+
+            // A pool of keep-alive connections to one proxied server. A request goes out on the connection
+            // with the least requests outstanding, so concurrent clients do not queue up behind each other.
+            class Upstream {
+            private:
+                Upstream() = delete;
+                Upstream(const Upstream&) = delete;
+                Upstream& operator=(const Upstream&) = delete;
+
+            public:
+                Upstream(const string& path, const string& replacement, ProxyMap& proxyMap, const Core::NodeId& remoteId, const uint8_t connections, const uint8_t pipeline)
+                    : _path(path)
+                    , _replacement(replacement)
+                    , _proxyMap(proxyMap)
+                    , _channels()
+                    , _latency()
+                {
+                    const uint8_t count = (connections > 0 ? connections : 1);
+
+                    for (uint8_t index = 0; index < count; index++) {
+                        _channels.push_back(new OutgoingChannel(*this, remoteId, pipeline));
+                    }
+                }
+                ~Upstream()
+                {
+                    for (OutgoingChannel* channel : _channels) {
+                        delete channel;
+                    }
+                }
+
+            public:
+                inline const string& Path() const
+                {
+                    return (_path);
+                }
+                inline const Histogram& Latency() const
+                {
+                    return (_latency);
+                }
+                void ProxyRequest(Core::ProxyType<Web::Request>& request, uint32_t id)
+                {
+                    std::vector<OutgoingChannel*>::iterator index(_channels.begin());
+                    OutgoingChannel* selected = *index;
+
+                    while ((selected->Outstanding() > 0) && (++index != _channels.end())) {
+                        if ((*index)->Outstanding() < selected->Outstanding()) {
+                            selected = *index;
+                        }
+                    }
+
+                    selected->ProxyRequest(request, id);
+                }
+                void Submit(uint32_t channelId, Core::ProxyType<Web::Response>& response, const uint64_t issued)
+                {
+                    const uint64_t now = Core::Time::Now().Ticks();
+
+                    _latency.Add(now > issued ? now - issued : 0);
+                    _proxyMap.Submit(channelId, response);
                 }
-                virtual void Received(Core::ProxyType<Web::Response>& response);
 
             private:
                 const string _path;
                 const string _replacement;
-
-                std::list<OutstandingMessage> _outstandingMessages;
                 ProxyMap& _proxyMap;
+                std::vector<OutgoingChannel*> _channels;
+                Histogram _latency;
             };
 
         private:
@@ -290,8 +454,11 @@ namespace Plugin {
 
         public:
             ProxyMap(ChannelMap& server)
-                : _server(server)
+                : _adminLock()
+                , _server(server)
                 , _proxies()
+                , _connections(1)
+                , _pipeline(1)
             {
             }
             ~ProxyMap()
@@ -304,8 +471,10 @@ namespace Plugin {
             }
 
         public:
-            void Create(Core::JSON::ArrayType<Config::Proxy>::ConstIterator& index)
+            void Create(Core::JSON::ArrayType<Config::Proxy>::ConstIterator& index, const uint8_t connections, const uint8_t pipeline)
             {
+                _connections = connections;
+                _pipeline = pipeline;
 
                 index.Reset();
 
@@ -314,18 +483,21 @@ namespace Plugin {
                     const string& path(index.Current().Path.Value());
                     const string& subst(index.Current().Subst.Value());
                     const Core::NodeId address(index.Current().Server.Value().c_str());
+                    const uint8_t poolSize(index.Current().Connections.Value() != 0 ? index.Current().Connections.Value() : _connections);
+                    const uint8_t depth(index.Current().Pipeline.Value() != 0 ? index.Current().Pipeline.Value() : _pipeline);
 
                     if (address.IsValid() == true) {
 
-                        _proxies.push_back(new OutgoingChannel(path, subst, *this, address));
+                        _proxies.push_back(new Upstream(path, subst, *this, address, poolSize, depth));
                     }
                 }
             }
 
             void Destroy()
             {
+                _adminLock.Lock();
 
-                std::list<OutgoingChannel*>::iterator index(_proxies.begin());
+                std::list<Upstream*>::iterator index(_proxies.begin());
 
                 while (index != _proxies.end()) {
 
@@ -334,6 +506,8 @@ namespace Plugin {
                     index++;
                 }
                 _proxies.clear();
+
+                _adminLock.Unlock();
             }
 
             bool Relay(Core::ProxyType<Web::Request>& request, uint32_t channelId)
@@ -341,9 +515,12 @@ namespace Plugin {
 
                 bool found = false;
                 const string& originalPath = request->Path;
-                std::list<OutgoingChannel*>::iterator index(_proxies.begin());
                 string proxyPath;
 
+                _adminLock.Lock();
+
+                std::list<Upstream*>::iterator index(_proxies.begin());
+
                 while ((found == false) && (index != _proxies.end())) {
 
                     proxyPath = (*index)->Path();
@@ -366,6 +543,8 @@ namespace Plugin {
                     (*index)->ProxyRequest(request, channelId);
                 }
 
+                _adminLock.Unlock();
+
                 return (found);
             }
 
@@ -375,12 +554,16 @@ namespace Plugin {
 
                 if (node.IsValid() == true) {
 
-                    _proxies.push_back(new OutgoingChannel(path, subst, *this, node));
+                    _adminLock.Lock();
+                    _proxies.push_back(new Upstream(path, subst, *this, node, _connections, _pipeline));
+                    _adminLock.Unlock();
                 }
             }
             inline void RemoveProxy(const string& path)
             {
-                std::list<OutgoingChannel*>::iterator index(_proxies.begin());
+                _adminLock.Lock();
+
+                std::list<Upstream*>::iterator index(_proxies.begin());
 
                 while ((index != _proxies.end()) && ((*index)->Path() != path)) {
 
@@ -392,15 +575,33 @@ namespace Plugin {
                     delete (*index);
                     _proxies.erase(index);
                 }
+
+                _adminLock.Unlock();
             }
             inline void Submit(uint32_t channelId, Core::ProxyType<Web::Response>& response)
             {
                 _server.Submit(channelId, response);
             }
+            // Runs on the timer thread, proxies are added and removed on other threads.
+            void Report() const
+            {
+                _adminLock.Lock();
+
+                for (const Upstream* upstream : _proxies) {
+                    if (upstream->Latency().Count() > 0) {
+                        TRACE(Trace::Information, (_T("Proxy %s latency: %s"), upstream->Path().c_str(), upstream->Latency().ToString().c_str()));
+                    }
+                }
+
+                _adminLock.Unlock();
+            }
 
         private:
+            mutable Core::CriticalSection _adminLock;
             ChannelMap& _server;
-            std::list<OutgoingChannel*> _proxies;
+            std::list<Upstream*> _proxies;
+            uint8_t _connections;
+            uint8_t _pipeline;
         };
 
         class IncomingChannel : public Web::WebLinkType<Core::SocketStream, Web::Request, Web::Response, RequestFactory> {
@@ -547,7 +748,7 @@ namespace Plugin {
                     _prefixPath = prefixPath + Core::Directory::Normalize(configuration.Path.Value());
                 }
 
-                _proxyMap.Create(index);
+                _proxyMap.Create(index, configuration.Connections.Value(), configuration.Pipeline.Value());
 
                 if (configuration.Interface.Value().empty() == false) {
                     Core::NodeId selectedNode = Plugin::Config::IPV4UnicastNode(configuration.Interface.Value());
@@ -635,6 +836,8 @@ namespace Plugin {
                 // First clear all shit from last time..
                 Cleanup();
 
+                _proxyMap.Report();
+
                 // Now suspend those that have no activity.
                 BaseClass::Iterator index(BaseClass::Clients());
 
@@ -790,17 +993,35 @@ namespace Plugin {
         ASSERT(_outstandingMessages.front().Request.IsValid() == false);
 
         if (_outstandingMessages.empty() == false) {
-            _proxyMap.Submit(_outstandingMessages.front().Id, response);
+            _upstream.Submit(_outstandingMessages.front().Id, response, _outstandingMessages.front().Issued);
             _outstandingMessages.pop_front();
+            _submitted--;
 
             // See if ther is a next one to send.
-            if (_outstandingMessages.size() > 0) {
+            Pump();
+        }
+    }
 
-                ASSERT(_outstandingMessages.front().Request.IsValid() == true);
+    void WebServerImplementation::ProxyMap::OutgoingChannel::Abandon()
+    {
+        while (_outstandingMessages.empty() == false) {
+            Core::ProxyType<Web::Response> response(PluginHost::IFactories::Instance().Response());
 
-                Submit(_outstandingMessages.front().Request);
+            // Only the requests in flight were lost by the proxied server, the others never reached it.
+            if (_submitted > 0) {
+                response->ErrorCode = Web::STATUS_BAD_GATEWAY;
+                response->Message = _T("Proxied server closed the connection.");
+                _submitted--;
+            } else {
+                response->ErrorCode = Web::STATUS_SERVICE_UNAVAILABLE;
+                response->Message = _T("Proxied server is not reachable.");
             }
+
+            _upstream.Submit(_outstandingMessages.front().Id, response, _outstandingMessages.front().Issued);
+            _outstandingMessages.pop_front();
         }
+
+        _submitted = 0;
     }
 
 } /* namespace Plugin */
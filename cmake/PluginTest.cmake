@@ -0,0 +1,45 @@
+# If not stated otherwise in this file or this component's LICENSE file the
+# following copyright and licenses apply:
+#
+# Copyright 2020 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+include(CMakeParseArguments)
+
+# add_plugin_test(<name> SOURCES <file>... [LINK <library>...] [BENCHMARK])
+#
+# Builds ${MODULE_NAME}<name>Test from the given sources and registers it with CTest as
+# ${PLUGIN_NAME}<name>. The checks come from helpers/UnitTest.h. A BENCHMARK is labelled
+# "benchmark", so "ctest -LE benchmark" leaves the slow ones out.
+function(add_plugin_test NAME)
+    cmake_parse_arguments(TEST "BENCHMARK" "" "SOURCES;LINK" ${ARGN})
+
+    set(TEST_TARGET ${MODULE_NAME}${NAME}Test)
+
+    add_executable(${TEST_TARGET} ${TEST_SOURCES})
+
+    set_target_properties(${TEST_TARGET} PROPERTIES
+            CXX_STANDARD 11
+            CXX_STANDARD_REQUIRED YES)
+
+    if(TEST_LINK)
+        target_link_libraries(${TEST_TARGET} PRIVATE ${TEST_LINK})
+    endif()
+
+    add_test(NAME ${PLUGIN_NAME}${NAME} COMMAND ${TEST_TARGET})
+
+    if(TEST_BENCHMARK)
+        set_tests_properties(${PLUGIN_NAME}${NAME} PROPERTIES LABELS benchmark)
+    endif()
+endfunction()
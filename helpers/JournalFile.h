@@ -0,0 +1,249 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifdef __WINDOWS__
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace WPEFramework {
+namespace Plugin {
+
+    // The file handling shared by the plugins that keep their state as a binary snapshot with a journal of
+    // modifications on top of it. Every record in either file is followed by its checksum, so a torn write at
+    // the end of a journal is recognized, and dropped, when it is replayed.
+    //
+    // Compacting a journal goes:
+    //   1. Rotate() the journal to <journal>.old and start a fresh journal for new records,
+    //   2. Store() the snapshot, it is only renamed into place once it is on the disk,
+    //   3. remove <journal>.old.
+    // Going down anywhere in between leaves either the old snapshot with <journal>.old, or the new snapshot,
+    // so at startup the snapshot, <journal>.old and the journal are replayed, in that order.
+    //
+    // No Core dependencies on purpose, the record handling is checked without the framework.
+    class JournalFile {
+    public:
+        JournalFile() = delete;
+        JournalFile(const JournalFile&) = delete;
+        JournalFile& operator=(const JournalFile&) = delete;
+
+        // The number of bytes in the record, without its checksum, as told by its header.
+        typedef std::function<uint64_t(const uint8_t header[])> Measure;
+        // Called for every record with a valid checksum, return false to stop the replay there.
+        typedef std::function<bool(const uint8_t record[], const uint32_t length)> Apply;
+
+    public:
+        static uint32_t Checksum(const uint8_t data[], const uint32_t length)
+        {
+            // Adler-32, it only needs to catch torn writes, not tampering.
+            uint32_t a = 1;
+            uint32_t b = 0;
+
+            for (uint32_t index = 0; index < length; index++) {
+                a = (a + data[index]) % 65521;
+                b = (b + a) % 65521;
+            }
+            return ((b << 16) | a);
+        }
+        // Appends the checksum of the first length bytes of the record, there must be room for it.
+        // Returns the size of the sealed record.
+        static uint32_t Seal(uint8_t record[], const uint32_t length)
+        {
+            const uint32_t checksum = Checksum(record, length);
+            ::memcpy(&record[length], &checksum, sizeof(checksum));
+            return (length + sizeof(checksum));
+        }
+        // Returns the number of bytes replayed. Anything after that is a torn or corrupt record.
+        static uint32_t Replay(const uint8_t data[], const uint32_t size, const uint16_t headerSize, const Measure& measure, const Apply& apply)
+        {
+            uint32_t offset = 0;
+            bool valid = true;
+
+            while ((valid == true) && ((size - offset) >= (headerSize + sizeof(uint32_t)))) {
+                const uint8_t* record = &data[offset];
+                const uint64_t length = measure(record);
+
+                valid = ((length >= headerSize) && ((length + sizeof(uint32_t)) <= (size - offset)));
+
+                if (valid == true) {
+                    uint32_t checksum;
+                    ::memcpy(&checksum, &record[length], sizeof(checksum));
+
+                    valid = ((checksum == Checksum(record, static_cast<uint32_t>(length))) && (apply(record, static_cast<uint32_t>(length)) == true));
+                }
+                if (valid == true) {
+                    offset += static_cast<uint32_t>(length + sizeof(uint32_t));
+                }
+            }
+
+            return (offset);
+        }
+        // Hands the complete contents of the file to the handler. Returns false if there is no such file,
+        // or if it is empty.
+        static bool Read(const std::string& fileName, const std::function<void(const uint8_t data[], const uint32_t size)>& handler)
+        {
+            bool result = false;
+
+#ifdef __WINDOWS__
+            FILE* file = ::fopen(fileName.c_str(), "rb");
+
+            if (file != nullptr) {
+                std::vector<uint8_t> buffer;
+                uint8_t block[4096];
+                size_t loaded;
+
+                while ((loaded = ::fread(block, 1, sizeof(block), file)) > 0) {
+                    buffer.insert(buffer.end(), block, block + loaded);
+                }
+                ::fclose(file);
+
+                if (buffer.empty() == false) {
+                    handler(buffer.data(), static_cast<uint32_t>(buffer.size()));
+                    result = true;
+                }
+            }
+#else
+            // Map the file, instead of copying it into a buffer, the records are parsed straight from the page cache.
+            const int descriptor = ::open(fileName.c_str(), O_RDONLY);
+
+            if (descriptor >= 0) {
+                struct stat info;
+
+                if ((::fstat(descriptor, &info) == 0) && (info.st_size > 0)) {
+                    const uint32_t size = static_cast<uint32_t>(info.st_size);
+                    void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+                    if (data != MAP_FAILED) {
+                        ::madvise(data, size, MADV_SEQUENTIAL);
+                        handler(static_cast<const uint8_t*>(data), size);
+                        ::munmap(data, size);
+                        result = true;
+                    }
+                }
+                ::close(descriptor);
+            }
+#endif
+
+            return (result);
+        }
+        // Replaces the file with the given contents. The contents are written to <fileName>.tmp first and are
+        // on the disk before that is renamed into place, so a power cut never leaves a partial file behind.
+        static bool Store(const std::string& fileName, const uint8_t data[], const uint32_t size)
+        {
+            const std::string temporary(fileName + ".tmp");
+            bool result = Write(temporary, data, size, false);
+
+            if ((result == true) && (::rename(temporary.c_str(), fileName.c_str()) == 0)) {
+                SyncDirectory(fileName);
+            } else {
+                ::remove(temporary.c_str());
+                result = false;
+            }
+
+            return (result);
+        }
+        // Moves the journal out of the way, to the rotated file. If there is a rotated file already, from a
+        // compaction that did not complete, its records are not in any snapshot yet. The journal is added to
+        // it in that case, so both are replayed, in order, until a snapshot holds them.
+        static bool Rotate(const std::string& journal, const std::string& rotated)
+        {
+            bool result = false;
+
+            if (Exists(rotated) == false) {
+                result = (::rename(journal.c_str(), rotated.c_str()) == 0);
+            } else {
+                std::vector<uint8_t> records;
+
+                Read(journal, [&records](const uint8_t data[], const uint32_t size) {
+                    records.assign(data, data + size);
+                });
+
+                result = (records.empty() == true) || (Write(rotated, records.data(), static_cast<uint32_t>(records.size()), true) == true);
+
+                if (result == true) {
+                    result = (::remove(journal.c_str()) == 0);
+                }
+            }
+
+            if (result == true) {
+                SyncDirectory(journal);
+            }
+
+            return (result);
+        }
+        static bool Exists(const std::string& fileName)
+        {
+            FILE* file = ::fopen(fileName.c_str(), "rb");
+
+            if (file != nullptr) {
+                ::fclose(file);
+            }
+            return (file != nullptr);
+        }
+
+    private:
+        static bool Write(const std::string& fileName, const uint8_t data[], const uint32_t size, const bool append)
+        {
+            bool result = false;
+            FILE* file = ::fopen(fileName.c_str(), (append == true ? "ab" : "wb"));
+
+            if (file != nullptr) {
+                result = (::fwrite(data, 1, size, file) == size) && (::fflush(file) == 0);
+
+#ifdef __WINDOWS__
+                result = (result == true) && (::_commit(::_fileno(file)) == 0);
+#else
+                result = (result == true) && (::fdatasync(::fileno(file)) == 0);
+#endif
+                result = (::fclose(file) == 0) && (result == true);
+            }
+
+            return (result);
+        }
+        static void SyncDirectory(const std::string& fileName)
+        {
+#ifndef __WINDOWS__
+            // The rename itself is only durable once the directory holding the file is on the disk.
+            const size_t slash = fileName.find_last_of('/');
+            const std::string directory(slash == std::string::npos ? std::string(".") : (slash == 0 ? std::string("/") : fileName.substr(0, slash)));
+            const int descriptor = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+
+            if (descriptor >= 0) {
+                ::fsync(descriptor);
+                ::close(descriptor);
+            }
+#endif
+        }
+    };
+
+} // namespace Plugin
+} // namespace WPEFramework
@@ -0,0 +1,55 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+// The checks shared by the unit tests of the plugins, see add_plugin_test() in cmake/PluginTest.cmake.
+// A failed CHECK is reported and counted, the test carries on, so one run shows every failure. The
+// main() of a test ends with "return (UnitTest::Result());".
+
+namespace WPEFramework {
+namespace UnitTest {
+
+    inline uint32_t& Failures()
+    {
+        static uint32_t failures = 0;
+        return (failures);
+    }
+    inline int Result()
+    {
+        if (Failures() != 0) {
+            fprintf(stderr, "%u checks failed\n", Failures());
+        }
+
+        return (Failures() == 0 ? 0 : 1);
+    }
+
+} // namespace UnitTest
+} // namespace WPEFramework
+
+#define CHECK(condition)                                                            \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            fprintf(stderr, "%s:%d: failed: %s\n", __FILE__, __LINE__, #condition); \
+            WPEFramework::UnitTest::Failures()++;                                   \
+        }                                                                           \
+    } while (false)